@@ -21,6 +21,9 @@
 #ifndef CONTEXT_H
 #define CONTEXT_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include <template.h>
 
 #define _XYTH_CONTEXT_INIT_MAGIC_NUMBER 0x004D4742
@@ -38,12 +41,30 @@ struct _XYTH_match_config {
                                      // consider two templates
                                      // compatible
 
-    // FIXME: The actual failure threshold is 0, regardless of the value
-    // configured here.
-    unsigned int failure_threshold; // No. of non-compatible minutiae required
-                                    // to abort a match
+    unsigned int failure_threshold; // No. of consecutive non-compatible
+                                    // minutiae required to abort a match
                                     // (0 - Do not abort)
 
+    unsigned int accept_threshold; // Template score that makes a match
+                                   // certain, once no other template can
+                                   // reach it (0 - Do not accept early)
+
+    unsigned int rerank_candidates; // No. of best candidates re-scored by the
+                                    // pairwise matcher
+                                    // (0 - Do not re-rank)
+    unsigned int rerank_threshold;  // Pairwise score required to keep a
+                                    // re-ranked candidate
+
+    unsigned int group_policy;       // How over-populated groups are read
+                                     // (XYTH_group_policy)
+    unsigned int group_length_limit; // Group length above which the policy
+                                     // applies
+
+    unsigned int probe_order;        // Order of the probe minutiae
+                                     // (XYTH_probe_order)
+    unsigned int probe_drop_percent; // Most expensive probe minutiae left
+                                     // out, in percent (0 - Keep all)
+
     unsigned int x_tolerance; // Coordinates tolerance...
     unsigned int y_tolerance; // ...when comparing neighbors.
     unsigned int t_tolerance; // Angle tolerance when comparing neighbors.
@@ -60,6 +81,24 @@ struct _XYTH_match_config {
 #define DB_PIXELS_PER_GROUP_DFL 1
 #define DB_DEGREES_PER_GROUP_DFL 2
 #define DB_ALLOC_STEP_DFL 32
+#define DB_INDEX_MODE_DFL DB_INDEX_QUERY_EXPANSION
+#define DB_X_TOLERANCE_DFL 5
+#define DB_Y_TOLERANCE_DFL 5
+#define DB_T_TOLERANCE_DFL 7
+#define DB_NUM_PARTITIONS_DFL 1
+#define DB_HUGE_PAGES_DFL 0
+
+// Largest number of partitions, so a set of them fits a 32-bit mask
+#define DB_MAX_PARTITIONS 32
+
+// Index modes
+#define DB_INDEX_QUERY_EXPANSION 0  // Tolerances applied by each query
+#define DB_INDEX_ENROLL_EXPANSION 1 // Tolerances applied when adding templates
+#define DB_INDEX_MULTIRES 2         // Coarse groups, postings filtered by
+                                    // their position inside the group
+
+// Largest group size, in pixels or degrees, in DB_INDEX_MULTIRES mode
+#define DB_MULTIRES_MAX_RESIDUAL 128
 
 // Structure used to hold/transmit configuration
 struct XYTH_database_config {
@@ -68,6 +107,12 @@ struct XYTH_database_config {
     unsigned int pixels_per_group;
     unsigned int degrees_per_group;
     unsigned int alloc_step; // in members, not bytes
+    unsigned int index_mode;
+    unsigned int x_tolerance; // Tolerances written into the index, in
+    unsigned int y_tolerance; // DB_INDEX_ENROLL_EXPANSION mode only.
+    unsigned int t_tolerance; // Angle tolerance must be less than 180.
+    unsigned int num_partitions; // Partitions templates can be added to
+    unsigned int huge_pages; // Large arrays asked for huge pages (0 - No)
 };
 
 // Macros for basic structure manipulation
@@ -83,6 +128,29 @@ struct XYTH_database_config {
         cfg.degrees_per_group = dpg;                                           \
     } while (0)
 
+#define _XYTH_DB_CONFIG_SET_ENROLL_EXPANSION(cfg, x_tol, y_tol, t_tol)         \
+    do {                                                                       \
+        cfg.index_mode = DB_INDEX_ENROLL_EXPANSION;                            \
+        cfg.x_tolerance = x_tol;                                               \
+        cfg.y_tolerance = y_tol;                                               \
+        cfg.t_tolerance = t_tol;                                               \
+    } while (0)
+
+#define _XYTH_DB_CONFIG_SET_PARTITIONS(cfg, n)                                 \
+    do {                                                                       \
+        cfg.num_partitions = n;                                                \
+    } while (0)
+
+#define _XYTH_DB_CONFIG_SET_HUGE_PAGES(cfg, enabled)                           \
+    do {                                                                       \
+        cfg.huge_pages = enabled;                                              \
+    } while (0)
+
+#define _XYTH_DB_CONFIG_SET_MULTIRES(cfg)                                      \
+    do {                                                                       \
+        cfg.index_mode = DB_INDEX_MULTIRES;                                    \
+    } while (0)
+
 #define _XYTH_DB_CONFIG_INIT(cfg)                                              \
     do {                                                                       \
         cfg.max_x = DB_MAX_X_COORD_DFL;                                        \
@@ -90,17 +158,95 @@ struct XYTH_database_config {
         cfg.pixels_per_group = DB_PIXELS_PER_GROUP_DFL;                        \
         cfg.degrees_per_group = DB_DEGREES_PER_GROUP_DFL;                      \
         cfg.alloc_step = DB_ALLOC_STEP_DFL;                                    \
+        cfg.index_mode = DB_INDEX_MODE_DFL;                                    \
+        cfg.x_tolerance = DB_X_TOLERANCE_DFL;                                  \
+        cfg.y_tolerance = DB_Y_TOLERANCE_DFL;                                  \
+        cfg.t_tolerance = DB_T_TOLERANCE_DFL;                                  \
+        cfg.num_partitions = DB_NUM_PARTITIONS_DFL;                            \
+        cfg.huge_pages = DB_HUGE_PAGES_DFL;                                    \
     } while (0)
 
 //
 // Database
 //
+
+// Absolute location of a template's minutia
+struct _XYTH_xyt {
+    unsigned int x;
+    unsigned int y;
+    unsigned int angle;
+};
+
+// Minutiae kept for each template added, used to re-rank candidates
+struct _XYTH_template_record {
+    unsigned int num_minutiae;
+    unsigned int partition;
+    unsigned int subject; // XYTH_RESERVED_SUBJECT_ID if not set
+    unsigned int finger;  // Finger position, 0 - Unknown
+    unsigned int num_neighbors; // Neighbors per minutia it was added with
+    struct _XYTH_xyt *minutiae; // NULL if the id is not in use
+};
+
+// Immutable part of the index, sealed from the mutable head (see segment.c).
+// Only the groups it holds are listed, so its size follows its postings: group
+// g's place in 'groups' is found by hashing g into 'directory'.
+struct _XYTH_segment {
+    unsigned int first_template; // Holds the templates in
+    unsigned int end_template;   // [first_template, end_template)
+    unsigned int *groups;        // Groups holding postings, ascending
+    unsigned int num_held;       // Members of 'groups'
+    unsigned int *directory;     // Open addressing, 1 + place in 'groups' of
+                                 // the group hashed to each slot (0 - Free)
+    unsigned int directory_bits; // 'directory' has 1 << directory_bits slots
+    uint64_t *offsets;           // Start of each group held, plus the end
+    unsigned int *postings;
+    uint32_t *residuals; // NULL unless DB_INDEX_MULTIRES
+    uint8_t *partitions; // NULL if the context has a single partition
+    uint64_t num_postings;
+    uint64_t *tombstones; // One bit per template removed since it was sealed
+                          // (NULL if none)
+    unsigned int num_tombstones;
+};
+
 struct _XYTH_database {
     unsigned int templates_counter;
     unsigned int next_template_id;
     unsigned int **data;
     unsigned int *alloc_counter; // in members, not bytes
+    unsigned int *group_length;  // Postings stored in each group
     unsigned int num_groups;
+    unsigned int x_groups; // Groups along each dimension.
+    unsigned int y_groups; // The index of a group is:
+    unsigned int t_groups; // (x * y_groups + y) * t_groups + t
+    uint64_t *occupancy;         // One bit per non-empty group
+    uint64_t *occupancy_summary; // One bit per non-zero 'occupancy' word
+    uint32_t **residuals; // Position of each posting inside its group,
+                          // parallel to 'data' (DB_INDEX_MULTIRES only)
+    uint8_t **partitions; // Partition of each posting, parallel to 'data'
+                          // (NULL if the context has a single partition)
+    struct _XYTH_template_record *records; // indexed by template id
+    unsigned int num_records;              // in members, not bytes
+    unsigned int generation; // Changes whenever templates are added/removed
+    unsigned int config_generation; // Changes whenever the index is rebuilt
+                                    // with another configuration
+    // Postings of all groups back to back, group i's starting at 'offsets[i]'
+    // of each array. Used instead of 'data', 'residuals' and 'partitions' by
+    // contexts attached to a published index (NULL otherwise).
+    const uint64_t *offsets;
+    const unsigned int *postings;
+    const uint32_t *packed_residuals;
+    const uint8_t *packed_partitions;
+    // Sealed segments, oldest first. The arrays above are the head, holding
+    // the templates added since the last one was sealed.
+    struct _XYTH_segment *segments;
+    unsigned int num_segments;
+    unsigned int head_first_template; // First template id in the head
+    unsigned int *head_groups; // Groups the head allocated, so sealing only
+                               // visits those
+    unsigned int num_head_groups;
+    unsigned int head_groups_size; // in members, not bytes
+    unsigned int seal_threshold; // Templates the head takes before it is
+                                 // sealed (0 - Never)
 };
 
 //
@@ -111,6 +257,19 @@ struct XYTH_context {
     struct _XYTH_match_config match_cfg;
     struct XYTH_database_config db_cfg;
     struct _XYTH_database db;
+    struct _XYTH_result_cache *result_cache; // NULL if disabled
+    struct _XYTH_lock *enroll_lock; // Serializes adding/removing templates
+    // Shared by identifications, taken alone to change or replace the index
+    struct _XYTH_index_lock *index_lock;
+    // Serializes merging the sealed segments and replacing the index. Taken
+    // before the other two, as a merge builds holding this one alone
+    struct _XYTH_lock *merge_lock;
+    bool merge_scheduled; // A merge task is queued on the pool (under
+                          // 'enroll_lock')
+    struct _XYTH_async *async;      // NULL if no pool runs its requests
+    struct _XYTH_regions *regions;  // Index directory and score arrays
+    struct _XYTH_shared *shared;    // NULL unless attached to a published
+                                    // index, which is then read-only
 };
 
 #define _XYTH_IS_CONTEXT_INITIALIZED(ctx)                                      \
@@ -29,6 +29,12 @@ extern "C" {
 #include <stdbool.h>
 
 #define XYTH_RESERVED_TEMPLATE_ID ((unsigned int)-1)
+#define XYTH_RESERVED_SUBJECT_ID ((unsigned int)-1)
+
+// Finger positions, numbered 1 - 10 (right thumb to left little finger, as in
+// ANSI/NIST-ITL). An unknown position matches any other.
+#define XYTH_FINGER_UNKNOWN 0
+#define XYTH_MAX_FINGER_POSITION 10
 
 extern unsigned int XYTH_version_major;
 extern unsigned int XYTH_version_minor;
@@ -49,9 +55,148 @@ typedef enum {
     XYTH_E_NOT_FOUND = -10,
     XYTH_E_INCOMPLETE_REMOVAL = -11,
     XYTH_E_VALUE_OUT_OF_RANGE = -12,
-    XYTH_E_MINUTIAE_EXTRACTOR_ERROR = -13
+    XYTH_E_MINUTIAE_EXTRACTOR_ERROR = -13,
+    XYTH_E_CANCELLED = -14,
+    XYTH_E_READ_ONLY = -15
 } XYTH_status;
 
+// Why an identification stopped
+typedef enum {
+    XYTH_STOP_COMPLETED = 0,         // All probe minutiae were processed
+    XYTH_STOP_FAILURE_THRESHOLD = 1, // Too many non-compatible minutiae
+    XYTH_STOP_ACCEPTED = 2,          // The best template became certain
+    XYTH_STOP_CALLBACK = 3,          // The progress callback stopped it
+    XYTH_STOP_TRUNCATED = 4          // The postings or time budget ran out
+} XYTH_stop_reason;
+
+// How identify reads groups holding more than a given number of postings
+typedef enum {
+    XYTH_GROUP_POLICY_NONE = 0,  // Read every group
+    XYTH_GROUP_POLICY_SKIP = 1,  // Ignore the group
+    XYTH_GROUP_POLICY_WEIGHT = 2 // Down-weight its votes by limit / length
+} XYTH_group_policy;
+
+// Order in which identify processes the probe minutiae
+typedef enum {
+    XYTH_PROBE_ORDER_TEMPLATE = 0, // As they appear in the template
+    XYTH_PROBE_ORDER_CHEAPEST = 1, // Fewest estimated postings first
+    XYTH_PROBE_ORDER_SELECTIVE = 2 // Most neighbor windows holding postings
+                                   // first, then cheapest
+} XYTH_probe_order;
+
+// Match configuration of a single identification, see XYTH_prepare_options()
+struct XYTH_match_options {
+    unsigned int x_tolerance; // See XYTH_set_match_tolerances()
+    unsigned int y_tolerance;
+    unsigned int t_tolerance;
+    unsigned int minutia_threshold; // See XYTH_set_match_thresholds()
+    unsigned int template_threshold;
+    unsigned int failure_threshold;
+    unsigned int accept_threshold;  // See XYTH_set_accept_threshold()
+    unsigned int rerank_candidates; // See XYTH_set_cascade()
+    unsigned int rerank_threshold;
+    XYTH_group_policy group_policy; // See XYTH_set_group_policy()
+    unsigned int group_length_limit;
+    XYTH_probe_order probe_order; // See XYTH_set_probe_plan()
+    unsigned int probe_drop_percent;
+};
+
+// Match options ready to be used with a context, see XYTH_prepare_options()
+struct XYTH_prepared_options;
+
+// Stops the identifications given it, once XYTH_cancel() is called from any
+// thread
+struct XYTH_cancel_token;
+
+// Threads shared by the contexts attached to them, see XYTH_create_pool()
+struct XYTH_pool;
+
+// Copies of a context's index, one per NUMA node, see XYTH_create_replicas()
+struct XYTH_replicas;
+
+// A template returned by XYTH_identify_ex(), with the evidence behind it
+struct XYTH_candidate {
+    unsigned int tpl_id;
+    unsigned int template_score;     // No. of probe minutiae matched
+    unsigned int matched_minutiae;   // No. of distinct template minutiae
+                                     // matched
+    unsigned int best_minutia_votes; // Highest no. of matching neighbors
+                                     // found for a single minutia
+    unsigned int pairwise_score;     // Re-rank score (0 - Not re-ranked)
+};
+
+// A subject returned by XYTH_identify_multi()
+struct XYTH_subject_candidate {
+    unsigned int subject_id;
+    unsigned int subject_score;   // Sum, over the probes, of the best template
+                                  // score among the subject's templates
+    unsigned int fingers_matched; // Probes whose best template reached the
+                                  // template threshold
+};
+
+// Called by XYTH_identify_streaming() with the best templates so far, best
+// template score first. Returning false stops the search.
+typedef bool (*XYTH_progress_callback)(
+    void *user_data, unsigned int minutiae_processed,
+    unsigned int num_candidates, const struct XYTH_candidate *candidates);
+
+// Called by XYTH_split_context() for each template. Returning true sends it
+// to the first context.
+typedef bool (*XYTH_template_predicate)(void *user_data, unsigned int tpl_id);
+
+// Kind of a request submitted to a context's workers
+typedef enum {
+    XYTH_REQUEST_IDENTIFY = 0, // XYTH_submit_identify()
+    XYTH_REQUEST_ADD = 1       // XYTH_submit_add()
+} XYTH_request_kind;
+
+// Query-level totals reported by XYTH_identify_ex()
+struct XYTH_identify_stats {
+    unsigned long long postings_scanned;   // Template minutiae references read
+    unsigned long long groups_visited;     // Non-empty groups read
+    unsigned long long groups_skipped;     // Groups ignored by the group policy
+    unsigned long long estimated_postings; // Planned cost (0 - Not planned)
+    unsigned int minutiae_processed;       // Probe minutiae processed
+    unsigned int minutiae_dropped; // Probe minutiae left out by the plan
+    unsigned int num_matches; // Templates that reached the template threshold
+    unsigned int candidates_reranked; // Candidates re-scored by the pairwise
+                                      // matcher
+    unsigned int cached; // 1 - Result served from the result cache
+    XYTH_stop_reason stop_reason;
+};
+
+// Best candidates kept in a completion
+#define XYTH_COMPLETION_CANDIDATES 16
+
+// Outcome of a submitted request, returned by XYTH_poll_completion()
+struct XYTH_completion {
+    unsigned int ticket; // As returned on submission
+    XYTH_request_kind kind;
+    XYTH_status status;
+    unsigned int tpl_id;         // Template added (XYTH_REQUEST_ADD only)
+    unsigned int num_candidates; // Candidates found (XYTH_REQUEST_IDENTIFY
+                                 // only), best template score first
+    struct XYTH_candidate candidates[XYTH_COMPLETION_CANDIDATES];
+    struct XYTH_identify_stats stats;
+};
+
+// Size of a context's database, reported by XYTH_get_database_stats()
+struct XYTH_database_stats {
+    unsigned int num_templates;
+    unsigned int num_groups;           // Groups in the index
+    unsigned int occupied_groups;      // Groups holding at least one posting
+    unsigned int max_group_length;     // Postings in the largest group
+    unsigned long long num_postings;   // Template minutiae references stored
+    unsigned long long alloc_postings; // Posting slots allocated
+    unsigned long long index_bytes;    // Memory used by the index
+    unsigned long long record_bytes;   // Memory used by the stored minutiae
+    unsigned long long region_bytes;   // Memory mapped for the index
+                                       // directory, the kept score arrays
+                                       // and, on huge pages, the postings
+    unsigned long long huge_page_bytes; // ...of it backed by huge pages
+    unsigned int num_segments;          // Sealed segments of the index
+};
+
 //
 // Public functions/macros
 //
@@ -64,6 +209,38 @@ typedef enum {
 #define XYTH_DB_CONFIG_SET_DENSITY(cfg, ppg, dpg)                              \
     _XYTH_DB_CONFIG_SET_DENSITY(cfg, ppg, dpg)
 
+// Applies the tolerances when templates are added, rather than in each query.
+// Each neighbor is written into every group of its tolerance window, so the
+// index grows by about the window's size in groups, while a query reads a
+// single group per neighbor. A coarser density (see
+// XYTH_DB_CONFIG_SET_DENSITY) keeps the window small.
+// XYTH_set_match_tolerances() has no effect on such a context.
+#define XYTH_DB_CONFIG_SET_ENROLL_EXPANSION(cfg, x_tol, y_tol, t_tol)          \
+    _XYTH_DB_CONFIG_SET_ENROLL_EXPANSION(cfg, x_tol, y_tol, t_tol)
+
+// Makes the density coarse buckets, while keeping the exact match tolerances.
+// Each posting also stores its position inside the bucket, and a query reads
+// the few buckets overlapping a neighbor's window, keeping only the postings
+// whose position falls inside it. Group sizes are limited to
+// DB_MULTIRES_MAX_RESIDUAL pixels/degrees.
+#define XYTH_DB_CONFIG_SET_MULTIRES(cfg) _XYTH_DB_CONFIG_SET_MULTIRES(cfg)
+
+// Splits the gallery into 'n' partitions (at most DB_MAX_PARTITIONS), e.g. by
+// site or customer. Postings of each group are kept sorted by partition, so
+// XYTH_identify_in_partitions() reads only the partitions asked for.
+#define XYTH_DB_CONFIG_SET_PARTITIONS(cfg, n)                                  \
+    _XYTH_DB_CONFIG_SET_PARTITIONS(cfg, n)
+
+// Backs the arrays indexed by group, the postings, and the score arrays of
+// each query, with 2 MB pages: reserved ones if the system has any free,
+// transparent ones otherwise. The postings of the groups are packed into slabs
+// of one page, and arrays larger than a page, e.g. those of sealed segments,
+// are mapped on their own. Each query's score arrays are then kept for the
+// next one. See 'huge_page_bytes' in XYTH_database_stats for what the system
+// granted.
+#define XYTH_DB_CONFIG_SET_HUGE_PAGES(cfg, enabled)                            \
+    _XYTH_DB_CONFIG_SET_HUGE_PAGES(cfg, enabled)
+
 /**
  * Creates a fingerprint identification context.
  * @note Use XYTH_destroy_context() to release the resources allocated for the
@@ -83,6 +260,97 @@ typedef enum {
 XYTH_status XYTH_create_context(struct XYTH_context *ctx,
                                 struct XYTH_database_config *db_cfg);
 
+/**
+ * Rebuilds the index of a context with another database configuration, e.g.
+ * a coarser density. Templates keep their id, partition, subject and finger.
+ * A DB_INDEX_MULTIRES index has its postings moved to the new groups as they
+ * are; any other is rebuilt from the minutiae kept for each template.
+ * Identifications keep reading the old index while the new one is built, and
+ * the new one replaces it once no identification is running; identifications
+ * starting meanwhile wait for the swap. Adding or removing templates waits
+ * for the build, and those done before the swap are carried over to the new
+ * index.
+ * @note Options prepared for the context before are no longer valid, even if
+ *       the configuration is unchanged; prepare them again.
+ *
+ * @param[in]  ctx     The identification context.
+ * @param[in]  db_cfg  The new database configuration. May be NULL.
+ *
+ * @retval XYTH_SUCCESS                  Index rebuilt successfully.
+ * @retval XYTH_E_INVALID_PARAMETER      'ctx' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED        'ctx' is invalid.
+ * @retval XYTH_E_READ_ONLY              'ctx' is attached to a published
+ *                                       index.
+ * @retval XYTH_E_NO_MEMORY              System is out of memory.
+ * @retval XYTH_E_INVALID_CONFIGURATION  The configuration in 'db_cfg' is not
+ *                                       valid. The context keeps its index.
+ */
+XYTH_status XYTH_reconfigure_context(struct XYTH_context *ctx,
+                                     struct XYTH_database_config *db_cfg);
+
+/**
+ * Moves a copy of the templates of 'src' into 'dst', e.g. to combine galleries
+ * built by several processes. Template 'i' of 'src' becomes template
+ * 'id_offset' + 'i' of 'dst', with the same partition, subject and finger.
+ * Each group's postings are merged in one sequential pass, so the cost grows
+ * linearly with the postings, and no template is added again. Identifications
+ * on 'dst' wait for the merge.
+ * @note Both contexts must index postings the same way: same coordinates,
+ *       density, index mode, tolerances written into the index, and number
+ *       of partitions.
+ *
+ * @param[in,out]  dst        The context merged into.
+ * @param[in]      src        The context merged from. It is left unchanged.
+ * @param[in]      id_offset  Added to the template ids of 'src'. At least the
+ *                            id of the last template added to 'dst', plus
+ *                            one.
+ *
+ * @retval XYTH_SUCCESS                  Contexts merged successfully.
+ * @retval XYTH_E_INVALID_PARAMETER      'dst', or 'src' is NULL, or both are
+ *                                       the same context.
+ * @retval XYTH_E_NOT_INITIALIZED        'dst', or 'src' is invalid.
+ * @retval XYTH_E_READ_ONLY              'dst' is attached to a published
+ *                                       index.
+ * @retval XYTH_E_INVALID_CONFIGURATION  The contexts index postings
+ *                                       differently.
+ * @retval XYTH_E_VALUE_OUT_OF_RANGE     'id_offset' is below an id of 'dst',
+ *                                       or the merged ids do not fit.
+ * @retval XYTH_E_NO_MEMORY              System is out of memory. 'dst' is
+ *                                       left unchanged.
+ */
+XYTH_status XYTH_merge_contexts(struct XYTH_context *dst,
+                                struct XYTH_context *src,
+                                unsigned int id_offset);
+
+/**
+ * Splits the templates of 'src' between two new contexts, e.g. to rebalance
+ * shards. Templates for which 'predicate' returns true go to 'dst_a', the
+ * others to 'dst_b', keeping their ids. Both are created with the database
+ * and match configuration of 'src', and their postings are copied from those
+ * of 'src' in one sequential pass. 'src' is left unchanged.
+ * @note Use XYTH_destroy_context() to release 'dst_a' and 'dst_b'.
+ *
+ * @param[in]   src        The context split.
+ * @param[in]   predicate  Tells the context each template goes to.
+ * @param[in]   user_data  Passed to 'predicate'.
+ * @param[out]  dst_a      Uninitialized context, receives the templates
+ *                         'predicate' accepts.
+ * @param[out]  dst_b      Uninitialized context, receives the others.
+ *
+ * @retval XYTH_SUCCESS                Context split successfully.
+ * @retval XYTH_E_INVALID_PARAMETER    'src', 'predicate', 'dst_a', or 'dst_b'
+ *                                     is NULL, or 'dst_a' and 'dst_b' are the
+ *                                     same context.
+ * @retval XYTH_E_NOT_INITIALIZED      'src' is invalid.
+ * @retval XYTH_E_ALREADY_INITIALIZED  'dst_a', or 'dst_b' was already
+ *                                     initialized.
+ * @retval XYTH_E_NO_MEMORY            System is out of memory.
+ */
+XYTH_status XYTH_split_context(struct XYTH_context *src,
+                               XYTH_template_predicate predicate,
+                               void *user_data, struct XYTH_context *dst_a,
+                               struct XYTH_context *dst_b);
+
 /**
  * Releases the resources associated with a context.
  *
@@ -111,6 +379,65 @@ void XYTH_destroy_context(struct XYTH_context *ctx);
 XYTH_status XYTH_add_template(struct XYTH_context *ctx,
                               struct XYTH_template *tpl, unsigned int *tpl_id);
 
+/**
+ * Adds a fingerprint template to one partition of an identification context
+ * (see XYTH_DB_CONFIG_SET_PARTITIONS). XYTH_add_template() adds to partition
+ * 0.
+ *
+ * @param[in]   ctx        The identification context.
+ * @param[in]   tpl        The template that will be added to the context.
+ * @param[in]   partition  The partition, less than the number configured.
+ * @param[out]  tpl_id     The id assigned to the template.
+ *
+ * @retval XYTH_SUCCESS               Template added successfully.
+ * @retval XYTH_E_INVALID_PARAMETER   'ctx', 'tpl', or 'tpl_id' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED     'ctx', or 'tpl' is invalid.
+ * @retval XYTH_E_TOO_FEW_MINUTIAE    The template doesn't have enough minutiae.
+ * @retval XYTH_E_NO_MEMORY           System is out of memory.
+ * @retval XYTH_E_VALUE_OUT_OF_RANGE  'partition' is not configured, or the
+ *                                    template is not compatible with the
+ *                                    context.
+ */
+XYTH_status XYTH_add_template_to_partition(struct XYTH_context *ctx,
+                                           struct XYTH_template *tpl,
+                                           unsigned int partition,
+                                           unsigned int *tpl_id);
+
+/**
+ * Adds a fingerprint template unless it is already enrolled, as
+ * XYTH_identify() followed by XYTH_add_template(). Both steps run under the
+ * context's enrollment lock, also taken by XYTH_add_template() and
+ * XYTH_remove_template(), so two threads enrolling the same finger cannot both
+ * succeed. Identifications, and requests run by the context's workers, wait
+ * for both steps too.
+ * The groups of the template's neighbors are worked out once, for both steps.
+ * @note The check neither reads nor fills the result cache.
+ *
+ * @param[in]      ctx             The identification context.
+ * @param[in]      tpl             The template that will be added.
+ * @param[out]     tpl_id          The id assigned to the template, or
+ *                                 XYTH_RESERVED_TEMPLATE_ID if duplicates
+ *                                 were found.
+ * @param[in,out]  num_duplicates  In: capacity of 'duplicate_ids'.
+ *                                 Out: No. of ids returned.
+ * @param[out]     duplicate_ids   Templates matched, best first.
+ *
+ * @retval XYTH_SUCCESS               Template added, or duplicates found.
+ * @retval XYTH_E_INVALID_PARAMETER   'ctx', 'tpl', 'tpl_id',
+ *                                    'num_duplicates', or 'duplicate_ids' is
+ *                                    NULL.
+ * @retval XYTH_E_NOT_INITIALIZED     'ctx', or 'tpl' is invalid.
+ * @retval XYTH_E_TOO_FEW_MINUTIAE    The template doesn't have enough minutiae.
+ * @retval XYTH_E_NO_MEMORY           System is out of memory.
+ * @retval XYTH_E_VALUE_OUT_OF_RANGE  The template is not compatible with the
+ *                                    context.
+ */
+XYTH_status XYTH_enroll_if_unique(struct XYTH_context *ctx,
+                                  struct XYTH_template *tpl,
+                                  unsigned int *tpl_id,
+                                  unsigned int *num_duplicates,
+                                  unsigned int *duplicate_ids);
+
 /**
  * Removes a fingerprint template from an identification context.
  *
@@ -137,6 +464,413 @@ XYTH_status XYTH_remove_template(struct XYTH_context *ctx,
 XYTH_status XYTH_identify(struct XYTH_context *ctx, struct XYTH_template *tpl,
                           unsigned int *num_ids, unsigned int *ids);
 
+/**
+ * Identifies a fingerprint template, reporting the score and the evidence of
+ * each candidate.
+ *
+ * @param[in]      ctx             The identification context.
+ * @param[in]      tpl             The probe template.
+ * @param[in,out]  num_candidates  In: capacity of 'candidates'.
+ *                                 Out: No. of candidates returned.
+ * @param[out]     candidates      Candidates, best template score first.
+ * @param[out]     stats           Query-level totals. May be NULL.
+ *
+ * @retval XYTH_SUCCESS              Identification performed successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx', 'tpl', 'num_candidates', or
+ *                                   'candidates' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx', or 'tpl' is invalid.
+ * @retval XYTH_E_NO_MEMORY          System is out of memory.
+ */
+XYTH_status XYTH_identify_ex(struct XYTH_context *ctx,
+                             struct XYTH_template *tpl,
+                             unsigned int *num_candidates,
+                             struct XYTH_candidate *candidates,
+                             struct XYTH_identify_stats *stats);
+
+/**
+ * Identifies a fingerprint template against a subset of the context's
+ * templates (1:few), e.g. the enrollments of one customer or site. Postings
+ * of other templates are skipped, and the scores are sized to the subset, so
+ * the cost follows the subset rather than the whole context.
+ * @note Results are not kept in the result cache.
+ *
+ * @param[in]      ctx             The identification context.
+ * @param[in]      tpl             The probe template.
+ * @param[in]      num_subset_ids  No. of ids in 'subset_ids'.
+ * @param[in]      subset_ids      Ids of the templates compared. Unknown and
+ *                                 repeated ids are ignored.
+ * @param[in,out]  num_candidates  In: capacity of 'candidates'.
+ *                                 Out: No. of candidates returned.
+ * @param[out]     candidates      Candidates, best template score first.
+ * @param[out]     stats           Query-level totals. May be NULL.
+ *
+ * @retval XYTH_SUCCESS              Identification performed successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx', 'tpl', 'subset_ids',
+ *                                   'num_candidates', or 'candidates' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx', or 'tpl' is invalid.
+ * @retval XYTH_E_NO_MEMORY          System is out of memory.
+ */
+XYTH_status XYTH_identify_in_subset(struct XYTH_context *ctx,
+                                    struct XYTH_template *tpl,
+                                    unsigned int num_subset_ids,
+                                    const unsigned int *subset_ids,
+                                    unsigned int *num_candidates,
+                                    struct XYTH_candidate *candidates,
+                                    struct XYTH_identify_stats *stats);
+
+/**
+ * Identifies a fingerprint template against the templates of some partitions
+ * (see XYTH_add_template_to_partition()). Only the postings of those
+ * partitions are read.
+ * @note Results are not kept in the result cache, unless every partition is
+ * asked for.
+ *
+ * @param[in]      ctx             The identification context.
+ * @param[in]      tpl             The probe template.
+ * @param[in]      partition_mask  Partitions compared, bit N for partition N.
+ * @param[in,out]  num_candidates  In: capacity of 'candidates'.
+ *                                 Out: No. of candidates returned.
+ * @param[out]     candidates      Candidates, best template score first.
+ * @param[out]     stats           Query-level totals. May be NULL.
+ *
+ * @retval XYTH_SUCCESS              Identification performed successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx', 'tpl', 'num_candidates', or
+ *                                   'candidates' is NULL, or 'partition_mask'
+ *                                   is 0.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx', or 'tpl' is invalid.
+ * @retval XYTH_E_NO_MEMORY          System is out of memory.
+ */
+XYTH_status XYTH_identify_in_partitions(struct XYTH_context *ctx,
+                                        struct XYTH_template *tpl,
+                                        uint32_t partition_mask,
+                                        unsigned int *num_candidates,
+                                        struct XYTH_candidate *candidates,
+                                        struct XYTH_identify_stats *stats);
+
+/**
+ * Records the subject a template belongs to, and its finger position, so it is
+ * fused with the subject's other templates by XYTH_identify_multi().
+ *
+ * @param[in]  ctx              The identification context.
+ * @param[in]  tpl_id           The template id assigned by
+ *                              XYTH_add_template().
+ * @param[in]  subject_id       Any id but XYTH_RESERVED_SUBJECT_ID.
+ * @param[in]  finger_position  1 - XYTH_MAX_FINGER_POSITION, or
+ *                              XYTH_FINGER_UNKNOWN.
+ *
+ * @retval XYTH_SUCCESS              Subject recorded successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx' is NULL, or 'subject_id', or
+ *                                   'finger_position' is invalid.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx' is invalid.
+ * @retval XYTH_E_NOT_FOUND          'tpl_id' is not in use.
+ */
+XYTH_status XYTH_set_template_subject(struct XYTH_context *ctx,
+                                      unsigned int tpl_id,
+                                      unsigned int subject_id,
+                                      unsigned int finger_position);
+
+/**
+ * Identifies several fingers of one subject in a single call (e.g. a
+ * ten-print). Each probe is scored against the templates of its finger
+ * position, reusing the same score buffers, and the best template score of
+ * each subject is summed over the probes. Templates without a subject are not
+ * returned. If an accept threshold is set (see XYTH_set_accept_threshold()),
+ * the remaining probes are skipped once the best subject score reaches it and
+ * no other subject can catch up.
+ *
+ * @param[in]      ctx               The identification context.
+ * @param[in]      probes            The probe templates, one per finger.
+ * @param[in]      finger_positions  Finger position of each probe. May be
+ *                                   NULL if unknown.
+ * @param[in]      num_probes        No. of probes.
+ * @param[in,out]  num_candidates    In: capacity of 'candidates'.
+ *                                   Out: No. of candidates returned.
+ * @param[out]     candidates        Subjects that reached the template
+ *                                   threshold, best subject score first.
+ * @param[out]     stats             Totals over the probes. May be NULL.
+ *
+ * @retval XYTH_SUCCESS              Identification performed successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx', 'probes', 'num_candidates', or
+ *                                   'candidates' is NULL, 'num_probes' is 0,
+ *                                   or a finger position is invalid.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx', or a probe is invalid.
+ * @retval XYTH_E_NO_MEMORY          System is out of memory.
+ */
+XYTH_status XYTH_identify_multi(struct XYTH_context *ctx,
+                                struct XYTH_template *probes,
+                                const unsigned int *finger_positions,
+                                unsigned int num_probes,
+                                unsigned int *num_candidates,
+                                struct XYTH_subject_candidate *candidates,
+                                struct XYTH_identify_stats *stats);
+
+/**
+ * Identifies a fingerprint template, reporting the best templates found so far
+ * after every 'batch_size' probe minutiae, so an interactive caller can show
+ * them early, and stop the search once one is confirmed. Re-ranking, if
+ * enabled, only applies to the final list.
+ * @note Results are not kept in the result cache.
+ *
+ * @param[in]      ctx             The identification context.
+ * @param[in]      tpl             The probe template.
+ * @param[in]      batch_size      Probe minutiae processed between calls.
+ * @param[in]      callback        Receives the best templates so far.
+ * @param[in]      user_data       Passed to 'callback'.
+ * @param[in,out]  num_candidates  In: capacity of 'candidates'.
+ *                                 Out: No. of candidates returned.
+ * @param[out]     candidates      Final candidates, best template score
+ *                                 first.
+ * @param[out]     stats           Query-level totals. May be NULL.
+ *
+ * @retval XYTH_SUCCESS              Identification performed successfully,
+ *                                   or stopped by 'callback'.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx', 'tpl', 'callback',
+ *                                   'num_candidates', or 'candidates' is
+ *                                   NULL, or 'batch_size' is 0.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx', or 'tpl' is invalid.
+ * @retval XYTH_E_NO_MEMORY          System is out of memory.
+ */
+XYTH_status XYTH_identify_streaming(struct XYTH_context *ctx,
+                                    struct XYTH_template *tpl,
+                                    unsigned int batch_size,
+                                    XYTH_progress_callback callback,
+                                    void *user_data,
+                                    unsigned int *num_candidates,
+                                    struct XYTH_candidate *candidates,
+                                    struct XYTH_identify_stats *stats);
+
+/**
+ * Identifies a fingerprint template within a postings and/or time budget. The
+ * budget is checked between probe minutiae (and, for postings, between
+ * windows), so it may be exceeded by about one minutia's cost. If it runs
+ * out, the best candidates found so far are returned, and 'stats->stop_reason'
+ * is XYTH_STOP_TRUNCATED. Unless a probe order is set (see
+ * XYTH_set_probe_plan()), the most selective minutiae are processed first, so
+ * a truncated answer is still useful.
+ * @note Results are not kept in the result cache.
+ *
+ * @param[in]      ctx               The identification context.
+ * @param[in]      tpl               The probe template.
+ * @param[in]      max_postings      Postings that may be read (0 - No limit).
+ * @param[in]      max_microseconds  Time allowed (0 - No limit).
+ * @param[in,out]  num_candidates    In: capacity of 'candidates'.
+ *                                   Out: No. of candidates returned.
+ * @param[out]     candidates        Candidates, best template score first.
+ * @param[out]     stats             Query-level totals. May be NULL.
+ *
+ * @retval XYTH_SUCCESS              Identification performed, or truncated.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx', 'tpl', 'num_candidates', or
+ *                                   'candidates' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx', or 'tpl' is invalid.
+ * @retval XYTH_E_NO_MEMORY          System is out of memory.
+ */
+XYTH_status XYTH_identify_bounded(struct XYTH_context *ctx,
+                                  struct XYTH_template *tpl,
+                                  unsigned long long max_postings,
+                                  unsigned int max_microseconds,
+                                  unsigned int *num_candidates,
+                                  struct XYTH_candidate *candidates,
+                                  struct XYTH_identify_stats *stats);
+
+/**
+ * Copies the context's match configuration, as a starting point for per-call
+ * options.
+ *
+ * @param[in]   ctx      The identification context.
+ * @param[out]  options  The context's match configuration.
+ *
+ * @retval XYTH_SUCCESS              Options returned.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx', or 'options' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx' is invalid.
+ */
+XYTH_status XYTH_get_match_options(struct XYTH_context *ctx,
+                                   struct XYTH_match_options *options);
+
+/**
+ * Checks 'options' and precomputes the tolerance windows they need, so they
+ * can be used by XYTH_identify_with_options() on 'ctx'. Prepared options are
+ * only read, so they may be shared by concurrent identifications.
+ * @note Prepared options must be destroyed before 'ctx'. They are only valid
+ *       until 'ctx' is reconfigured, see XYTH_reconfigure_context(), or
+ *       refreshed to a generation built with another configuration.
+ *
+ * @param[in]   ctx       The identification context.
+ * @param[in]   options   The match configuration.
+ * @param[out]  prepared  Receives the prepared options. Must be destroyed
+ *                        with XYTH_destroy_prepared_options().
+ *
+ * @retval XYTH_SUCCESS              Options prepared successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx', 'options', or 'prepared' is NULL,
+ *                                   or 'options' holds an invalid group
+ *                                   policy or probe plan.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx' is invalid.
+ * @retval XYTH_E_NO_MEMORY          System is out of memory.
+ */
+XYTH_status XYTH_prepare_options(struct XYTH_context *ctx,
+                                 const struct XYTH_match_options *options,
+                                 struct XYTH_prepared_options **prepared);
+
+void XYTH_destroy_prepared_options(struct XYTH_prepared_options *prepared);
+
+/**
+ * Same as XYTH_identify_ex(), but matching with 'options' instead of the
+ * context's match configuration, which is left untouched. Identifications
+ * with different options may run concurrently on the same context. Templates
+ * added or removed meanwhile wait for them.
+ * @note Results are not kept in the result cache.
+ *
+ * @param[in]      ctx             The identification context.
+ * @param[in]      options         Options prepared for 'ctx'.
+ * @param[in]      tpl             The probe template.
+ * @param[in,out]  num_candidates  In: capacity of 'candidates'.
+ *                                 Out: No. of candidates returned.
+ * @param[out]     candidates      Candidates, best template score first.
+ * @param[out]     stats           Query-level totals. May be NULL.
+ *
+ * @retval XYTH_SUCCESS              Identification performed.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx', 'options', 'tpl',
+ *                                   'num_candidates', or 'candidates' is
+ *                                   NULL, or 'options' were prepared for
+ *                                   another context, or before 'ctx' was
+ *                                   reconfigured.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx', or 'tpl' is invalid.
+ * @retval XYTH_E_NO_MEMORY          System is out of memory.
+ */
+XYTH_status
+XYTH_identify_with_options(struct XYTH_context *ctx,
+                           const struct XYTH_prepared_options *options,
+                           struct XYTH_template *tpl,
+                           unsigned int *num_candidates,
+                           struct XYTH_candidate *candidates,
+                           struct XYTH_identify_stats *stats);
+
+XYTH_status XYTH_create_cancel_token(struct XYTH_cancel_token **token);
+
+void XYTH_destroy_cancel_token(struct XYTH_cancel_token *token);
+
+// Trips 'token'. Safe to call from any thread, while searches use it.
+void XYTH_cancel(struct XYTH_cancel_token *token);
+
+// Makes 'token' usable again, once no search uses it.
+void XYTH_reset_cancel_token(struct XYTH_cancel_token *token);
+
+/**
+ * Same as XYTH_identify_ex(), but stops as soon as 'cancel' is tripped. The
+ * token is checked between neighbor windows, so a cancelled search stops
+ * within a fraction of a probe minutia.
+ * @note Results are not kept in the result cache.
+ *
+ * @param[in]      ctx             The identification context.
+ * @param[in]      tpl             The probe template.
+ * @param[in]      cancel          The cancellation token.
+ * @param[in,out]  num_candidates  In: capacity of 'candidates'.
+ *                                 Out: No. of candidates returned.
+ * @param[out]     candidates      Candidates, best template score first.
+ * @param[out]     stats           Query-level totals. May be NULL.
+ *
+ * @retval XYTH_SUCCESS              Identification performed.
+ * @retval XYTH_E_CANCELLED          'cancel' was tripped. No candidates are
+ *                                   returned.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx', 'tpl', 'cancel', 'num_candidates',
+ *                                   or 'candidates' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx', or 'tpl' is invalid.
+ * @retval XYTH_E_NO_MEMORY          System is out of memory.
+ */
+XYTH_status XYTH_identify_cancellable(struct XYTH_context *ctx,
+                                      struct XYTH_template *tpl,
+                                      const struct XYTH_cancel_token *cancel,
+                                      unsigned int *num_candidates,
+                                      struct XYTH_candidate *candidates,
+                                      struct XYTH_identify_stats *stats);
+
+/**
+ * Queues the identification of 'tpl' for the context's workers (see
+ * XYTH_set_workers()). Identifications run concurrently with each other,
+ * and one at a time with submitted additions, in no guaranteed order.
+ * @note 'tpl' must stay valid until the request's completion is polled.
+ * @note Results are not kept in the result cache.
+ * @note Templates added or removed synchronously wait for the running
+ *       identifications, as submitted additions do.
+ *
+ * @param[in]   ctx     The identification context.
+ * @param[in]   tpl     The probe template.
+ * @param[out]  ticket  Identifies the request's completion.
+ *
+ * @retval XYTH_SUCCESS              Request queued.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx', 'tpl', or 'ticket' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx', or 'tpl' is invalid, or the
+ *                                   context runs no workers.
+ * @retval XYTH_E_NO_MEMORY          System is out of memory.
+ */
+XYTH_status XYTH_submit_identify(struct XYTH_context *ctx,
+                                 struct XYTH_template *tpl,
+                                 unsigned int *ticket);
+
+/**
+ * Queues the addition of 'tpl' to the context, as XYTH_add_template() does,
+ * for the context's workers. The id of the template added is returned in
+ * the request's completion.
+ * @note 'tpl' must stay valid until the request's completion is polled.
+ *
+ * @param[in]   ctx     The identification context.
+ * @param[in]   tpl     The template to add.
+ * @param[out]  ticket  Identifies the request's completion.
+ *
+ * @retval XYTH_SUCCESS              Request queued.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx', 'tpl', or 'ticket' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx', or 'tpl' is invalid, or the
+ *                                   context runs no workers.
+ * @retval XYTH_E_NO_MEMORY          System is out of memory.
+ */
+XYTH_status XYTH_submit_add(struct XYTH_context *ctx,
+                            struct XYTH_template *tpl, unsigned int *ticket);
+
+/**
+ * Takes the oldest completion of the requests submitted to the context.
+ *
+ * @param[in]   ctx         The identification context.
+ * @param[out]  completion  The request's outcome.
+ *
+ * @retval XYTH_SUCCESS              Completion returned.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx', or 'completion' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx' is invalid, or the context runs no
+ *                                   workers.
+ * @retval XYTH_E_NOT_FOUND          No request has completed yet.
+ */
+XYTH_status XYTH_poll_completion(struct XYTH_context *ctx,
+                                 struct XYTH_completion *completion);
+
+/**
+ * Returns a file descriptor that is readable while completions are waiting
+ * to be polled, for use with poll(), epoll, or an event loop. It must not be
+ * read or closed by the caller, and is valid until the workers stop.
+ *
+ * @param[in]   ctx  The identification context.
+ * @param[out]  fd   The file descriptor.
+ *
+ * @retval XYTH_SUCCESS              File descriptor returned.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx', or 'fd' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx' is invalid, or the context runs no
+ *                                   workers.
+ */
+XYTH_status XYTH_get_completion_fd(struct XYTH_context *ctx, int *fd);
+
+/**
+ * Cancels a submitted request that did not complete yet. The request still
+ * completes, with XYTH_E_CANCELLED as its status, unless it was an addition
+ * already running.
+ *
+ * @param[in]  ctx     The identification context.
+ * @param[in]  ticket  As returned on submission.
+ *
+ * @retval XYTH_SUCCESS              Request cancelled.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx' is invalid, or the context runs no
+ *                                   workers.
+ * @retval XYTH_E_NOT_FOUND          The request already completed.
+ */
+XYTH_status XYTH_cancel_request(struct XYTH_context *ctx, unsigned int ticket);
+
 XYTH_status XYTH_template_from_xyt(char *xyt_buffer, struct XYTH_template *tpl,
                                    unsigned int num_neighbors);
 
@@ -151,14 +885,498 @@ XYTH_status XYTH_set_match_tolerances(struct XYTH_context *ctx,
                                       unsigned int x_tol, unsigned int y_tol,
                                       unsigned int angle_tol);
 
+/**
+ * Configures the match thresholds of XYTH_identify().
+ * A template scores at most one point per probe minutia, so its score is the
+ * no. of probe minutiae that matched it, whatever the no. of its own minutiae
+ * that fall in the probe's neighborhood.
+ *
+ * @param[in]  ctx                 The identification context.
+ * @param[in]  minutia_threshold   Votes a template needs from a probe minutia
+ *                                 for that minutia to match it.
+ * @param[in]  template_threshold  Matched probe minutiae a template needs to
+ *                                 be returned.
+ * @param[in]  failure_threshold   Consecutive probe minutiae without any
+ *                                 matching template after which the
+ *                                 identification gives up. 0 disables early
+ *                                 stop.
+ *
+ * @retval XYTH_SUCCESS              Thresholds configured successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx' is invalid.
+ */
 XYTH_status XYTH_set_match_thresholds(struct XYTH_context *ctx,
                                       unsigned int minutia_threshold,
                                       unsigned int template_threshold,
                                       unsigned int failure_threshold);
 
+/**
+ * Configures early acceptance in XYTH_identify().
+ * The identification stops as soon as the best template reaches
+ * 'accept_threshold' and no other template can reach it with the remaining
+ * probe minutiae.
+ *
+ * @param[in]  ctx               The identification context.
+ * @param[in]  accept_threshold  Template score that makes a match certain.
+ *                               0 disables early acceptance.
+ *
+ * @retval XYTH_SUCCESS              Threshold configured successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx' is invalid.
+ */
+XYTH_status XYTH_set_accept_threshold(struct XYTH_context *ctx,
+                                      unsigned int accept_threshold);
+
+/**
+ * Configures the identification cascade. The best candidates found by the
+ * index are re-scored by a pairwise matcher (in the spirit of NBIS' bozorth3)
+ * against the minutiae stored for each template, and returned in the order of
+ * the new score.
+ *
+ * @param[in]  ctx                The identification context.
+ * @param[in]  rerank_candidates  No. of best candidates re-scored.
+ *                                0 disables the cascade.
+ * @param[in]  rerank_threshold   Pairwise score required to keep a candidate.
+ *
+ * @retval XYTH_SUCCESS              Cascade configured successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx' is invalid.
+ */
+XYTH_status XYTH_set_cascade(struct XYTH_context *ctx,
+                             unsigned int rerank_candidates,
+                             unsigned int rerank_threshold);
+
+/**
+ * Configures a cache of identification results. Identifying the same probe
+ * template, with the same match configuration, returns the cached result as
+ * long as no template was added to or removed from the context. Threads
+ * identifying at the same time share the cache, under a lock of its own.
+ *
+ * @param[in]  ctx       The identification context.
+ * @param[in]  capacity  No. of results kept, least recently used first out.
+ *                       0 disables the cache.
+ *
+ * @retval XYTH_SUCCESS              Cache configured successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx' is invalid.
+ * @retval XYTH_E_NO_MEMORY          System is out of memory.
+ */
+XYTH_status XYTH_set_result_cache(struct XYTH_context *ctx,
+                                  unsigned int capacity);
+
+/**
+ * Starts a pool of worker threads, owned by the context, that runs the
+ * requests submitted with XYTH_submit_identify() and XYTH_submit_add().
+ * Requests already queued complete first, then the previous workers, or
+ * attached pool, are replaced. Completions not polled yet are dropped.
+ *
+ * @param[in]  ctx          The identification context.
+ * @param[in]  num_workers  No. of worker threads. 0 stops the workers.
+ *
+ * @retval XYTH_SUCCESS               Workers configured successfully.
+ * @retval XYTH_E_INVALID_PARAMETER   'ctx' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED     'ctx' is invalid.
+ * @retval XYTH_E_VALUE_OUT_OF_RANGE  'num_workers' is too large.
+ * @retval XYTH_E_NO_MEMORY           System is out of memory.
+ */
+XYTH_status XYTH_set_workers(struct XYTH_context *ctx,
+                             unsigned int num_workers);
+
+/**
+ * Creates a work-stealing thread pool. Each thread takes work from its own
+ * queue first, and steals from the others once it runs dry. A pool can be
+ * attached to any number of contexts, bounding the threads the library uses
+ * as a whole.
+ *
+ * @param[in]   num_threads  No. of threads.
+ * @param[in]   cpus         CPU each thread is pinned to, 'num_threads'
+ *                           members. NULL leaves the threads unpinned.
+ * @param[out]  pool         Receives the pool. Must be destroyed with
+ *                           XYTH_destroy_pool().
+ *
+ * @retval XYTH_SUCCESS               Pool created successfully.
+ * @retval XYTH_E_INVALID_PARAMETER   'pool' is NULL, or 'num_threads' is 0.
+ * @retval XYTH_E_VALUE_OUT_OF_RANGE  'num_threads' is too large.
+ * @retval XYTH_E_NO_MEMORY           System is out of memory.
+ */
+XYTH_status XYTH_create_pool(unsigned int num_threads,
+                             const unsigned int *cpus,
+                             struct XYTH_pool **pool);
+
+// Runs the work still queued, then stops the threads. Contexts using the
+// pool must be detached, or destroyed, first.
+void XYTH_destroy_pool(struct XYTH_pool *pool);
+
+/**
+ * Runs the context's submitted requests on 'pool', instead of on workers of
+ * its own (see XYTH_set_workers()). Requests already queued complete first.
+ * Completions not polled yet are dropped.
+ *
+ * @param[in]  ctx   The identification context.
+ * @param[in]  pool  The pool. NULL detaches the current one.
+ *
+ * @retval XYTH_SUCCESS              Pool attached successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx' is invalid.
+ * @retval XYTH_E_NO_MEMORY          System is out of memory.
+ */
+XYTH_status XYTH_attach_pool(struct XYTH_context *ctx, struct XYTH_pool *pool);
+
+/**
+ * Creates a pool with one thread pinned to each CPU of a NUMA node. Attached
+ * to a context moved to the same node (see XYTH_move_to_node()), its
+ * identifications read local memory, and allocate their score arrays there.
+ *
+ * @param[in]  node  The node, as numbered in /sys/devices/system/node.
+ * @param[out] pool  The new pool.
+ *
+ * @retval XYTH_SUCCESS               Pool created successfully.
+ * @retval XYTH_E_INVALID_PARAMETER   'pool' is NULL.
+ * @retval XYTH_E_VALUE_OUT_OF_RANGE  'node' does not exist or has no CPUs.
+ * @retval XYTH_E_NO_MEMORY           System is out of memory.
+ */
+XYTH_status XYTH_create_node_pool(unsigned int node, struct XYTH_pool **pool);
+
+/**
+ * Moves the index and the stored templates of a context to the memory of a
+ * NUMA node. Memory allocated later is placed by the thread first touching
+ * it, so templates should be added from that node, e.g. through
+ * XYTH_submit_add() on a pool from XYTH_create_node_pool(). To serve several
+ * nodes, see XYTH_create_replicas().
+ *
+ * @param[in]  ctx   The identification context.
+ * @param[in]  node  The node, as numbered in /sys/devices/system/node.
+ *
+ * @retval XYTH_SUCCESS               Memory moved successfully.
+ * @retval XYTH_E_INVALID_PARAMETER   'ctx' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED     'ctx' is invalid.
+ * @retval XYTH_E_VALUE_OUT_OF_RANGE  'node' does not exist.
+ * @retval XYTH_E_NOT_IMPLEMENTED     The system cannot move pages.
+ * @retval XYTH_ERROR                 Pages could not be moved.
+ */
+XYTH_status XYTH_move_to_node(struct XYTH_context *ctx, unsigned int node);
+
+/**
+ * Replicates a context to several NUMA nodes: each node gets a copy of the
+ * whole index and of the stored templates, moved to its memory (see
+ * XYTH_move_to_node()), so identifications routed to the copy of their node
+ * (see XYTH_get_local_replica()) only read local memory. The copies hold the
+ * templates of 'ctx' under the same ids, with its configuration, and are
+ * independent of it afterwards. Memory costs one index per node.
+ * @note Use XYTH_destroy_replicas() to release the copies. Add and remove
+ *       templates through XYTH_add_to_replicas() and
+ *       XYTH_remove_from_replicas(), so every copy keeps the same ids.
+ *
+ * @param[in]   ctx        The identification context replicated.
+ * @param[in]   num_nodes  Number of nodes in 'nodes', up to 8.
+ * @param[in]   nodes      The nodes, as numbered in /sys/devices/system/node.
+ * @param[out]  replicas   The new copies.
+ *
+ * @retval XYTH_SUCCESS               Context replicated successfully. On
+ *                                    systems that cannot move pages, the
+ *                                    copies stay where they were built.
+ * @retval XYTH_E_INVALID_PARAMETER   'ctx', 'nodes', or 'replicas' is NULL,
+ *                                    'num_nodes' is 0, or a node is given
+ *                                    twice.
+ * @retval XYTH_E_NOT_INITIALIZED     'ctx' is invalid.
+ * @retval XYTH_E_VALUE_OUT_OF_RANGE  Too many nodes, or a node does not exist.
+ * @retval XYTH_E_NO_MEMORY           System is out of memory.
+ */
+XYTH_status XYTH_create_replicas(struct XYTH_context *ctx,
+                                 unsigned int num_nodes,
+                                 const unsigned int *nodes,
+                                 struct XYTH_replicas **replicas);
+
+void XYTH_destroy_replicas(struct XYTH_replicas *replicas);
+
+/**
+ * Gets the copy on a given node, e.g. to attach the pool of that node to it
+ * (see XYTH_create_node_pool()). The copy must not be destroyed, nor have
+ * templates added or removed, other than through the replicas.
+ *
+ * @param[in]   replicas  The copies of a context.
+ * @param[in]   node      The node.
+ * @param[out]  ctx       The copy on 'node'.
+ *
+ * @retval XYTH_SUCCESS              Copy returned.
+ * @retval XYTH_E_INVALID_PARAMETER  'replicas', or 'ctx' is NULL.
+ * @retval XYTH_E_NOT_FOUND          No copy is on 'node'.
+ */
+XYTH_status XYTH_get_replica(struct XYTH_replicas *replicas, unsigned int node,
+                             struct XYTH_context **ctx);
+
+/**
+ * Gets the copy on the node the calling thread runs on, to identify against,
+ * with any identification function. Threads on a node holding no copy get
+ * the first one. Threads may be moved between nodes by the system, unless
+ * pinned, e.g. as the threads of XYTH_create_node_pool() are.
+ *
+ * @param[in]   replicas  The copies of a context.
+ * @param[out]  ctx       The copy of the caller's node.
+ *
+ * @retval XYTH_SUCCESS              Copy returned.
+ * @retval XYTH_E_INVALID_PARAMETER  'replicas', or 'ctx' is NULL.
+ */
+XYTH_status XYTH_get_local_replica(struct XYTH_replicas *replicas,
+                                   struct XYTH_context **ctx);
+
+/**
+ * Adds a fingerprint template to every copy, under the same id. Its postings
+ * are allocated by the calling thread, so they land on its node in every
+ * copy, until XYTH_move_to_node() is run again on the others. Threads adding
+ * to or removing from the same copies take turns.
+ *
+ * @param[in]   replicas  The copies of a context.
+ * @param[in]   tpl       The template to add.
+ * @param[out]  tpl_id    The template's id in every copy.
+ *
+ * @retval XYTH_SUCCESS              Template added to every copy. Otherwise,
+ *                                   it is added to none, and 'tpl_id' is
+ *                                   XYTH_RESERVED_TEMPLATE_ID. The id it got
+ *                                   from some copies is skipped by all.
+ * @retval XYTH_E_INVALID_PARAMETER  'replicas', 'tpl', or 'tpl_id' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'tpl' is invalid.
+ * @retval XYTH_E_NO_MEMORY          System is out of memory.
+ */
+XYTH_status XYTH_add_to_replicas(struct XYTH_replicas *replicas,
+                                 struct XYTH_template *tpl,
+                                 unsigned int *tpl_id);
+
+/**
+ * Removes a fingerprint template from every copy.
+ *
+ * @param[in]  replicas  The copies of a context.
+ * @param[in]  tpl       The template, as added.
+ * @param[in]  tpl_id    Its id.
+ *
+ * @retval XYTH_SUCCESS              Template removed from every copy.
+ * @retval XYTH_E_INVALID_PARAMETER  'replicas', or 'tpl' is NULL.
+ * @retval XYTH_E_NOT_FOUND          No template has the id 'tpl_id'.
+ */
+XYTH_status XYTH_remove_from_replicas(struct XYTH_replicas *replicas,
+                                      struct XYTH_template *tpl,
+                                      unsigned int tpl_id);
+
+/**
+ * Publishes the index of a context, read-only, to POSIX shared memory, so
+ * worker processes on the host identify against a single copy of it (see
+ * XYTH_attach_index()). Each call publishes a new generation to its own
+ * object, "<name>.<generation>", then names it current in 'name'. The
+ * previous generation is unlinked, and stays mapped by the workers still
+ * using it.
+ *
+ * @param[in]  ctx         The identification context.
+ * @param[in]  name        Shared memory name, such as "/gallery".
+ * @param[out] generation  The generation published. May be NULL.
+ *
+ * @retval XYTH_SUCCESS              Index published successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx' is NULL, or 'name' is not a valid
+ *                                   shared memory name.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx' is invalid.
+ * @retval XYTH_E_READ_ONLY          'ctx' is attached to a published index.
+ * @retval XYTH_E_NO_MEMORY          The generation could not be allocated.
+ * @retval XYTH_ERROR                Shared memory could not be opened.
+ */
+XYTH_status XYTH_publish_index(struct XYTH_context *ctx, const char *name,
+                               unsigned int *generation);
+
+/**
+ * Initializes a context on the current generation of an index published with
+ * XYTH_publish_index(). Postings and minutiae are read where the builder
+ * wrote them; only the template records are copied. Templates cannot be
+ * added to, or removed from, the context.
+ * @note Use XYTH_destroy_context() to release the context.
+ *
+ * @param[out] ctx   The identification context.
+ * @param[in]  name  Shared memory name the index was published to.
+ *
+ * @retval XYTH_SUCCESS                  Context attached successfully.
+ * @retval XYTH_E_INVALID_PARAMETER      'ctx' is NULL, or 'name' is not a
+ *                                       valid shared memory name.
+ * @retval XYTH_E_ALREADY_INITIALIZED    'ctx' was already initialized.
+ * @retval XYTH_E_NOT_FOUND              Nothing was published to 'name'.
+ * @retval XYTH_E_INVALID_CONFIGURATION  The index was published by another
+ *                                       version of the library.
+ * @retval XYTH_E_NO_MEMORY              System is out of memory.
+ * @retval XYTH_ERROR                    Shared memory could not be opened.
+ */
+XYTH_status XYTH_attach_index(struct XYTH_context *ctx, const char *name);
+
+/**
+ * Removes an index published with XYTH_publish_index(). Workers attached to it
+ * keep their mapping until they are destroyed.
+ *
+ * @param[in]  name  Shared memory name the index was published to.
+ *
+ * @retval XYTH_SUCCESS              Index removed successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'name' is not a valid shared memory name.
+ * @retval XYTH_E_NOT_FOUND          Nothing was published to 'name'.
+ * @retval XYTH_ERROR                Shared memory could not be opened.
+ */
+XYTH_status XYTH_unpublish_index(const char *name);
+
+/**
+ * Swaps an attached context to the generation published last, if newer.
+ * Identifications running, on any thread, finish on the generation they
+ * started on.
+ *
+ * @param[in]  ctx         The identification context.
+ * @param[out] generation  The generation in use. May be NULL.
+ *
+ * @retval XYTH_SUCCESS                  Context up to date.
+ * @retval XYTH_E_INVALID_PARAMETER      'ctx' is NULL, or not attached to a
+ *                                       published index.
+ * @retval XYTH_E_NOT_INITIALIZED        'ctx' is invalid.
+ * @retval XYTH_E_NOT_FOUND              The generation was replaced too many
+ *                                       times while it was being opened.
+ * @retval XYTH_E_INVALID_CONFIGURATION  The index was published by another
+ *                                       version of the library.
+ * @retval XYTH_E_NO_MEMORY              System is out of memory.
+ */
+XYTH_status XYTH_refresh_index(struct XYTH_context *ctx,
+                               unsigned int *generation);
+
+/**
+ * Splits the index into a small mutable head, which new templates are added
+ * to, and immutable sealed segments. Once the head holds 'num_templates'
+ * templates, it is sealed: its postings are packed into a segment, laid out
+ * back to back without spare slots, and the head starts over empty. Removing
+ * a sealed template only marks it in its segment; its postings are dropped
+ * when the segment is merged.
+ *
+ * @note The add that fills the head seals it, at a cost that grows with the
+ * postings of the head only. A segment takes memory for the groups it holds
+ * only, not for every group of the index. The seal queues merging the
+ * segments on the context's pool (see XYTH_set_workers() and
+ * XYTH_attach_pool()), which builds the merged segment while templates are
+ * added, removed and identified; see XYTH_merge_segments(). Once 32 segments
+ * are sealed, the head is left to grow until the queued merge makes room.
+ * Without a pool, the add that seals the head then merges every segment.
+ *
+ * @param[in]  ctx            The identification context.
+ * @param[in]  num_templates  Templates the head takes before it is sealed.
+ *                            0 (the default) never seals it.
+ *
+ * @retval XYTH_SUCCESS              Threshold configured successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx' is invalid.
+ */
+XYTH_status XYTH_set_seal_threshold(struct XYTH_context *ctx,
+                                    unsigned int num_templates);
+
+/**
+ * Merges the newest sealed segments while the newest is not the smaller one,
+ * so the context keeps a few segments, larger the older they are, and drops
+ * the postings of their removed templates. Then seals the head, if it was
+ * left full while the segments were. Contexts with a pool merge their
+ * segments on it as they are sealed, so it is only needed without one. The
+ * merged segment is built while templates are added, removed and identified
+ * by other threads; they wait only while it replaces the segments merged.
+ *
+ * @param[in]  ctx  The identification context.
+ *
+ * @retval XYTH_SUCCESS              Segments merged successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx' is invalid.
+ * @retval XYTH_E_READ_ONLY          'ctx' is attached to a published index.
+ * @retval XYTH_E_NO_MEMORY          System is out of memory.
+ */
+XYTH_status XYTH_merge_segments(struct XYTH_context *ctx);
+
+/**
+ * Merges the head and every sealed segment into a single segment, dropping
+ * the postings of removed templates. Identifications, and templates added or
+ * removed by other threads, wait for it to finish, so it can be run on a
+ * thread of its own. Waits for a merge running on the context's pool.
+ *
+ * @param[in]  ctx  The identification context.
+ *
+ * @retval XYTH_SUCCESS              Index compacted successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx' is invalid.
+ * @retval XYTH_E_READ_ONLY          'ctx' is attached to a published index.
+ * @retval XYTH_E_NO_MEMORY          System is out of memory.
+ */
+XYTH_status XYTH_compact_index(struct XYTH_context *ctx);
+
+/**
+ * Configures how identification reads over-populated groups. A few groups
+ * (e.g., near the origin, with common relative angles) collect far more
+ * postings than the others, and dominate the identification time while adding
+ * little discrimination. Groups holding more than 'max_group_length' postings
+ * are either skipped, or their votes are weighted by
+ * 'max_group_length' / length, in the spirit of inverse document frequency.
+ * A smaller 'max_group_length' is faster, and less accurate.
+ *
+ * @param[in]  ctx               The identification context.
+ * @param[in]  policy            What to do with over-populated groups.
+ * @param[in]  max_group_length  Largest group length read normally.
+ *
+ * @retval XYTH_SUCCESS              Policy configured successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx' is NULL, 'policy' is invalid, or
+ *                                   'max_group_length' is 0 and 'policy' is
+ *                                   not XYTH_GROUP_POLICY_NONE.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx' is invalid.
+ */
+XYTH_status XYTH_set_group_policy(struct XYTH_context *ctx,
+                                  XYTH_group_policy policy,
+                                  unsigned int max_group_length);
+
+/**
+ * Configures the identification plan. Before scanning the index, the cost of
+ * each probe minutia is estimated as the postings its neighbor windows will
+ * read. Processing the cheapest, or the most selective, minutiae first lets
+ * early acceptance and the failure threshold decide sooner. Dropping the most
+ * expensive minutiae trades accuracy for speed.
+ *
+ * @param[in]  ctx           The identification context.
+ * @param[in]  order         Order of the probe minutiae.
+ * @param[in]  drop_percent  Percentage of the probe minutiae, most expensive
+ *                           first, left out (at least one is kept).
+ *
+ * @retval XYTH_SUCCESS              Plan configured successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx' is NULL, 'order' is invalid, or
+ *                                   'drop_percent' is not less than 100.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx' is invalid.
+ */
+XYTH_status XYTH_set_probe_plan(struct XYTH_context *ctx,
+                                XYTH_probe_order order,
+                                unsigned int drop_percent);
+
+/**
+ * Estimates the postings an identification of 'tpl' would read, following
+ * the configured plan, without running it. Useful for admission control.
+ *
+ * @param[in]   ctx       The identification context.
+ * @param[in]   tpl       The probe template.
+ * @param[out]  postings  Estimated postings read.
+ *
+ * @retval XYTH_SUCCESS              Cost estimated successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx', 'tpl', or 'postings' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx', or 'tpl' is invalid.
+ * @retval XYTH_E_NO_MEMORY          System is out of memory.
+ */
+XYTH_status XYTH_estimate_identify_cost(struct XYTH_context *ctx,
+                                        struct XYTH_template *tpl,
+                                        unsigned long long *postings);
+
 XYTH_status XYTH_get_template_counter(struct XYTH_context *ctx,
                                       unsigned int *tpl_counter);
 
+/**
+ * Reports the size of a context's database, so the memory used by each index
+ * mode can be compared.
+ *
+ * @param[in]   ctx    The identification context.
+ * @param[out]  stats  The database totals.
+ *
+ * @retval XYTH_SUCCESS              Totals reported successfully.
+ * @retval XYTH_E_INVALID_PARAMETER  'ctx', or 'stats' is NULL.
+ * @retval XYTH_E_NOT_INITIALIZED    'ctx' is invalid.
+ */
+XYTH_status XYTH_get_database_stats(struct XYTH_context *ctx,
+                                    struct XYTH_database_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
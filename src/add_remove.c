@@ -26,88 +26,231 @@
 #include <template.h>
 #include <xyth.h>
 
+#include "add_remove.h"
 #include "common.h"
 #include "config.h"
+#include "lock.h"
+#include "region.h"
+#include "segment.h"
+#include "template-common.h"
+
+//
+// Allocates 'new_count' members for one of a group's parallel arrays, copying
+// the 'old_count' members of 'old_array'.
+//
+static void *_XYTH_copy_positions(struct XYTH_context *ctx, void *old_array,
+                                  unsigned int old_count,
+                                  unsigned int new_count, size_t member_size)
+{
+    void *array =
+        _XYTH_alloc_postings(ctx->regions, (size_t)new_count * member_size);
+
+    if (array != NULL && old_count > 0) {
+        memcpy(array, old_array, old_count * member_size);
+    }
+
+    return array;
+}
+
+//
+// Frees the parallel arrays of a group in the head, as allocated for its
+// 'alloc_counter'. Leaves the pointers to the caller.
+//
+void _XYTH_free_group_positions(struct XYTH_context *ctx,
+                                unsigned int group_index)
+{
+    struct _XYTH_database *db = &ctx->db;
+    size_t alloc_counter = db->alloc_counter[group_index];
+
+    _XYTH_free_postings(ctx->regions, db->data[group_index],
+                        alloc_counter * sizeof(unsigned int));
+    if (db->residuals != NULL) {
+        _XYTH_free_postings(ctx->regions, db->residuals[group_index],
+                            alloc_counter * sizeof(uint32_t));
+    }
+    if (db->partitions != NULL) {
+        _XYTH_free_postings(ctx->regions, db->partitions[group_index],
+                            alloc_counter);
+    }
+}
 
 static XYTH_status _XYTH_add_positions(struct XYTH_context *ctx,
                                        unsigned int group_index)
 {
     XYTH_status status;
+    unsigned int old_alloc_counter = ctx->db.alloc_counter[group_index];
+    unsigned int new_alloc_counter = old_alloc_counter + ctx->db_cfg.alloc_step;
+    unsigned int *data;
+    uint32_t *residuals = NULL;
+    uint8_t *partitions = NULL;
+
+    if (old_alloc_counter == 0) {
+        // The head lists its groups, so sealing it visits only those
+        status = _XYTH_reserve_head_groups(&ctx->db, 1);
+        if (status != XYTH_SUCCESS) {
+            PRINT_IF_ERROR(status);
+            return status;
+        }
+    }
 
-    if (ctx->db.alloc_counter[group_index] == 0) {
-        ctx->db.data[group_index] =
-            malloc(ctx->db_cfg.alloc_step * sizeof(unsigned int));
-        if (ctx->db.data[group_index] != NULL) {
-            ctx->db.alloc_counter[group_index] = ctx->db_cfg.alloc_step;
-            memset(ctx->db.data[group_index], -1,
-                   ctx->db_cfg.alloc_step * sizeof(unsigned int));
-            status = XYTH_SUCCESS;
-        } else {
-            status = XYTH_E_NO_MEMORY;
+    data = _XYTH_copy_positions(ctx, ctx->db.data[group_index],
+                                old_alloc_counter, new_alloc_counter,
+                                sizeof(unsigned int));
+    if (ctx->db.residuals != NULL) {
+        residuals = _XYTH_copy_positions(ctx, ctx->db.residuals[group_index],
+                                         old_alloc_counter, new_alloc_counter,
+                                         sizeof(uint32_t));
+    }
+    if (ctx->db.partitions != NULL) {
+        partitions = _XYTH_copy_positions(
+            ctx, ctx->db.partitions[group_index], old_alloc_counter,
+            new_alloc_counter, sizeof(uint8_t));
+    }
+
+    if (data != NULL && (ctx->db.residuals == NULL || residuals != NULL) &&
+        (ctx->db.partitions == NULL || partitions != NULL)) {
+        memset(&data[old_alloc_counter], -1,
+               ctx->db_cfg.alloc_step * sizeof(unsigned int));
+
+        _XYTH_free_group_positions(ctx, group_index);
+        ctx->db.data[group_index] = data;
+        if (residuals != NULL) {
+            ctx->db.residuals[group_index] = residuals;
         }
-    } else {
-        unsigned int *old_ptr;
-        unsigned int old_alloc_counter;
-
-        old_ptr = ctx->db.data[group_index];
-        old_alloc_counter = ctx->db.alloc_counter[group_index];
-
-        ctx->db.data[group_index] = malloc(
-            (ctx->db.alloc_counter[group_index] + ctx->db_cfg.alloc_step) *
-            sizeof(unsigned int));
-        if (ctx->db.data[group_index] != NULL) {
-            ctx->db.alloc_counter[group_index] += ctx->db_cfg.alloc_step;
-            memcpy(ctx->db.data[group_index], old_ptr,
-                   old_alloc_counter * sizeof(unsigned int));
-            free(old_ptr);
-            memset(&ctx->db.data[group_index][old_alloc_counter], -1,
-                   ctx->db_cfg.alloc_step * sizeof(unsigned int));
-            status = XYTH_SUCCESS;
-        } else {
-            status = XYTH_E_NO_MEMORY;
+        if (partitions != NULL) {
+            ctx->db.partitions[group_index] = partitions;
+        }
+        if (old_alloc_counter == 0) {
+            _XYTH_add_head_group(&ctx->db, group_index);
         }
+        ctx->db.alloc_counter[group_index] = new_alloc_counter;
+        status = XYTH_SUCCESS;
+    } else {
+        _XYTH_free_postings(ctx->regions, data,
+                            new_alloc_counter * sizeof(unsigned int));
+        _XYTH_free_postings(ctx->regions, residuals,
+                            new_alloc_counter * sizeof(uint32_t));
+        _XYTH_free_postings(ctx->regions, partitions, new_alloc_counter);
+        status = XYTH_E_NO_MEMORY;
     }
 
     PRINT_IF_ERROR(status);
     return status;
 }
 
-static XYTH_status _XYTH_add_neighbor(struct XYTH_context *ctx,
-                                      struct _XYTH_neighbor *nei,
-                                      unsigned int tpl_id, unsigned int min_id)
+//
+// Partition of the template a posting belongs to.
+//
+static unsigned int _XYTH_calc_posting_partition(struct XYTH_context *ctx,
+                                                 unsigned int posting)
 {
-    XYTH_status status;
-    unsigned int group_index;
+    unsigned int tpl_id = posting / MAX_MINUTIAE_PER_TEMPLATE;
+
+    return tpl_id < ctx->db.num_records ? ctx->db.records[tpl_id].partition
+                                        : 0;
+}
+
+static XYTH_status _XYTH_add_posting(struct XYTH_context *ctx,
+                                     unsigned int group_index,
+                                     unsigned int posting, uint32_t residual)
+{
+    XYTH_status status = XYTH_SUCCESS;
+    // Postings are kept packed at the group's start
+    unsigned int length = ctx->db.group_length[group_index];
+    unsigned int position = length;
+
+    if (length >= ctx->db.alloc_counter[group_index]) {
+        status = _XYTH_add_positions(ctx, group_index);
+    }
 
-    status = _XYTH_calc_group_index(ctx, nei->relative_x, nei->relative_y,
-                                    nei->relative_angle, &group_index);
     if (status == XYTH_SUCCESS) {
-        if (ctx->db.alloc_counter[group_index] == 0) {
-            status = _XYTH_add_positions(ctx, group_index);
+        if (ctx->db.partitions != NULL) {
+            // ...and in partition segments, so the new posting goes to the end
+            // of its segment
+            uint8_t *partitions = ctx->db.partitions[group_index];
+            unsigned int partition =
+                _XYTH_calc_posting_partition(ctx, posting);
+
+            position = _XYTH_partition_lower_bound(partitions, 0, length,
+                                                   partition + 1);
+            memmove(&partitions[position + 1], &partitions[position],
+                    (length - position) * sizeof(uint8_t));
+            memmove(&ctx->db.data[group_index][position + 1],
+                    &ctx->db.data[group_index][position],
+                    (length - position) * sizeof(unsigned int));
+            if (ctx->db.residuals != NULL) {
+                memmove(&ctx->db.residuals[group_index][position + 1],
+                        &ctx->db.residuals[group_index][position],
+                        (length - position) * sizeof(uint32_t));
+            }
+            partitions[position] = partition;
         }
 
-        if (status == XYTH_SUCCESS) {
-            unsigned int position;
-            // Find the first free position
-            // TODO: It would be better to start at the group's top, going
-            // downwards to find the
-            // first
-            //       free position.
-            for (position = 0;
-                 position < ctx->db.alloc_counter[group_index] &&
-                 ctx->db.data[group_index][position] != (unsigned int)-1;
-                 position++)
-                ;
+        ctx->db.data[group_index][position] = posting;
+        if (ctx->db.residuals != NULL) {
+            ctx->db.residuals[group_index][position] = residual;
+        }
+        ctx->db.group_length[group_index]++;
+        _XYTH_mark_group_occupied(ctx, group_index);
+    }
 
-            status = XYTH_SUCCESS;
-            if (position >= ctx->db.alloc_counter[group_index]) {
-                status = _XYTH_add_positions(ctx, group_index);
-            }
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+static XYTH_status _XYTH_remove_posting(struct XYTH_context *ctx,
+                                        unsigned int group_index,
+                                        unsigned int posting,
+                                        uint32_t residual)
+{
+    XYTH_status status = XYTH_SUCCESS;
+
+    if (ctx->db.alloc_counter[group_index] != 0) {
+        unsigned int position = 0;
+        unsigned int end = ctx->db.group_length[group_index];
+        unsigned int last = ctx->db.group_length[group_index] - 1;
+        uint32_t *residuals = ctx->db.residuals != NULL
+                                  ? ctx->db.residuals[group_index]
+                                  : NULL;
+        uint8_t *partitions = ctx->db.partitions != NULL
+                                  ? ctx->db.partitions[group_index]
+                                  : NULL;
+
+        if (partitions != NULL) {
+            // Only the posting's partition segment is searched
+            unsigned int partition =
+                _XYTH_calc_posting_partition(ctx, posting);
+            position =
+                _XYTH_partition_lower_bound(partitions, 0, end, partition);
+            end = _XYTH_partition_lower_bound(partitions, position, end,
+                                              partition + 1);
+        }
 
-            if (status == XYTH_SUCCESS) {
-                ctx->db.data[group_index][position] =
-                    (tpl_id * MAX_MINUTIAE_PER_TEMPLATE) + min_id;
+        for (; position < end &&
+               (ctx->db.data[group_index][position] != posting ||
+                (residuals != NULL && residuals[position] != residual));
+             position++)
+            ;
+
+        if (position < end) {
+            memmove(&ctx->db.data[group_index][position],
+                    &ctx->db.data[group_index][position + 1],
+                    (last - position) * sizeof(unsigned int));
+            ctx->db.data[group_index][last] = (unsigned int)-1;
+            if (residuals != NULL) {
+                memmove(&residuals[position], &residuals[position + 1],
+                        (last - position) * sizeof(uint32_t));
+            }
+            if (partitions != NULL) {
+                memmove(&partitions[position], &partitions[position + 1],
+                        (last - position) * sizeof(uint8_t));
+            }
+            ctx->db.group_length[group_index]--;
+            if (ctx->db.group_length[group_index] == 0) {
+                _XYTH_mark_group_empty(ctx, group_index);
             }
+        } else {
+            status = XYTH_E_NOT_FOUND;
         }
     }
 
@@ -115,52 +258,155 @@ static XYTH_status _XYTH_add_neighbor(struct XYTH_context *ctx,
     return status;
 }
 
+//
+// Removes 'posting' from the first 'limit' groups of 'window', in the order
+// they are visited by _XYTH_add_window_postings().
+//
+static XYTH_status
+_XYTH_remove_window_postings(struct XYTH_context *ctx,
+                             struct _XYTH_group_window *window,
+                             unsigned int posting, uint32_t residual,
+                             unsigned int limit)
+{
+    XYTH_status status = XYTH_SUCCESS;
+    unsigned int x_block_size = ctx->db.y_groups * ctx->db.t_groups;
+    unsigned int y_block_size = ctx->db.t_groups;
+    unsigned int visited = 0;
+
+    for (unsigned int x = window->x.first; x <= window->x.last; x++) {
+        for (unsigned int y = window->y.first; y <= window->y.last; y++) {
+            unsigned int base = x * x_block_size + y * y_block_size;
+            for (unsigned int i = 0; i < window->angle.num_runs; i++) {
+                for (unsigned int t = window->angle.runs[i].first;
+                     t <= window->angle.runs[i].last; t++) {
+                    if (visited++ == limit) {
+                        return status;
+                    }
+                    if (_XYTH_remove_posting(ctx, base + t, posting,
+                                             residual) != XYTH_SUCCESS) {
+                        status = XYTH_E_NOT_FOUND;
+                    }
+                }
+            }
+        }
+    }
+
+    return status;
+}
+
+//
+// Adds 'posting' to every group of 'window'. On failure, the groups already
+// updated are restored.
+//
+static XYTH_status _XYTH_add_window_postings(struct XYTH_context *ctx,
+                                             struct _XYTH_group_window *window,
+                                             unsigned int posting,
+                                             uint32_t residual)
+{
+    XYTH_status status = XYTH_SUCCESS;
+    unsigned int x_block_size = ctx->db.y_groups * ctx->db.t_groups;
+    unsigned int y_block_size = ctx->db.t_groups;
+    unsigned int added = 0;
+
+    for (unsigned int x = window->x.first; x <= window->x.last; x++) {
+        for (unsigned int y = window->y.first; y <= window->y.last; y++) {
+            unsigned int base = x * x_block_size + y * y_block_size;
+            for (unsigned int i = 0; i < window->angle.num_runs; i++) {
+                for (unsigned int t = window->angle.runs[i].first;
+                     t <= window->angle.runs[i].last; t++) {
+                    status =
+                        _XYTH_add_posting(ctx, base + t, posting, residual);
+                    if (status != XYTH_SUCCESS) {
+                        XYTH_status debug_status;
+                        debug_status = _XYTH_remove_window_postings(
+                            ctx, window, posting, residual, added);
+                        PRINT_IF_ERROR(debug_status);
+                        return status;
+                    }
+                    added++;
+                }
+            }
+        }
+    }
+
+    return status;
+}
+
+//
+// Calculates the groups that hold 'nei'. Unless the context applies the
+// tolerances when templates are added, that is a single group.
+//
+static XYTH_status _XYTH_calc_neighbor_groups(
+    struct XYTH_context *ctx, struct _XYTH_neighbor *nei,
+    struct _XYTH_neighbor_groups *groups)
+{
+    XYTH_status status;
+    struct _XYTH_group_window *window = &groups->window;
+
+    status = _XYTH_calc_group_index(ctx, nei->relative_x, nei->relative_y,
+                                    nei->relative_angle, &groups->group_index);
+    if (status == XYTH_SUCCESS) {
+        if (ctx->db_cfg.index_mode == DB_INDEX_ENROLL_EXPANSION) {
+            // The window contains, at least, the neighbor's own group
+            _XYTH_calc_group_window(ctx, nei->relative_x, nei->relative_y,
+                                    nei->relative_angle,
+                                    ctx->db_cfg.x_tolerance,
+                                    ctx->db_cfg.y_tolerance,
+                                    ctx->db_cfg.t_tolerance, window);
+        } else {
+            unsigned int t = groups->group_index % ctx->db.t_groups;
+            unsigned int xy = groups->group_index / ctx->db.t_groups;
+            window->x.first = window->x.last = xy / ctx->db.y_groups;
+            window->y.first = window->y.last = xy % ctx->db.y_groups;
+            window->angle.runs[0].first = window->angle.runs[0].last = t;
+            window->angle.num_runs = 1;
+            window->angle.min_group = window->angle.max_group = t;
+        }
+        groups->residual = _XYTH_calc_residual(
+            ctx, nei->relative_x, nei->relative_y, nei->relative_angle);
+    }
+
+    return status;
+}
+
 static XYTH_status _XYTH_remove_neighbor(struct XYTH_context *ctx,
                                          struct _XYTH_neighbor *nei,
                                          unsigned int tpl_id,
                                          unsigned int min_id)
 {
     XYTH_status status;
-    unsigned int group_index;
+    struct _XYTH_neighbor_groups groups;
 
-    status = _XYTH_calc_group_index(ctx, nei->relative_x, nei->relative_y,
-                                    nei->relative_angle, &group_index);
+    status = _XYTH_calc_neighbor_groups(ctx, nei, &groups);
     if (status == XYTH_SUCCESS) {
-        if (ctx->db.alloc_counter[group_index] != 0) {
-            unsigned int position;
-            for (position = 0;
-                 position < ctx->db.alloc_counter[group_index] &&
-                 ctx->db.data[group_index][position] != (tpl_id << 6) + min_id;
-                 position++)
-                ;
-
-            if (position < ctx->db.alloc_counter[group_index]) {
-                memmove(&ctx->db.data[group_index][position],
-                        &ctx->db.data[group_index][position + 1],
-                        (ctx->db.alloc_counter[group_index] - position + 1));
-            } else {
-                status = XYTH_E_NOT_FOUND;
-            }
-        }
+        status = _XYTH_remove_window_postings(
+            ctx, &groups.window, (tpl_id * MAX_MINUTIAE_PER_TEMPLATE) + min_id,
+            groups.residual, (unsigned int)-1);
     }
 
     PRINT_IF_ERROR(status);
     return status;
 }
 
-static XYTH_status _XYTH_add_minutia(struct XYTH_context *ctx,
-                                     struct _XYTH_minutia *min,
-                                     unsigned int tpl_id)
+//
+// Adds the neighbors of 'min' to the groups worked out for them in 'groups'.
+//
+static XYTH_status
+_XYTH_add_minutia(struct XYTH_context *ctx, struct _XYTH_minutia *min,
+                  struct _XYTH_neighbor_groups *groups, unsigned int tpl_id)
 {
     XYTH_status status = XYTH_SUCCESS;
+    unsigned int posting = (tpl_id * MAX_MINUTIAE_PER_TEMPLATE) + min->id;
 
     for (unsigned int i = 0; i < min->num_neighbors; i++) {
-        status = _XYTH_add_neighbor(ctx, &min->neighbors[i], tpl_id, min->id);
+        status = _XYTH_add_window_postings(ctx, &groups[i].window, posting,
+                                           groups[i].residual);
         if (status != XYTH_SUCCESS) {
             for (unsigned int j = 0; j < i; j++) {
                 XYTH_status debug_status;
-                debug_status = _XYTH_remove_neighbor(ctx, &min->neighbors[j],
-                                                     tpl_id, min->id);
+                debug_status = _XYTH_remove_window_postings(
+                    ctx, &groups[j].window, posting, groups[j].residual,
+                    (unsigned int)-1);
                 PRINT_IF_ERROR(debug_status);
             }
             break;
@@ -189,15 +435,172 @@ static XYTH_status _XYTH_remove_minutia(struct XYTH_context *ctx,
     return (error_count == 0) ? XYTH_SUCCESS : XYTH_E_NOT_FOUND;
 }
 
-static XYTH_status _XYTH_add_template(struct XYTH_context *ctx,
-                                      struct XYTH_template *tpl,
-                                      unsigned int *tpl_id)
+//
+// Grows the records of 'ctx' to at least 'num_records', the new ones unused.
+//
+XYTH_status _XYTH_reserve_template_records(struct XYTH_context *ctx,
+                                           unsigned int num_records)
+{
+    XYTH_status status = XYTH_SUCCESS;
+
+    if (num_records > ctx->db.num_records) {
+        unsigned int new_num_records = ctx->db.num_records > 0
+                                           ? 2 * ctx->db.num_records
+                                           : ctx->db_cfg.alloc_step;
+        struct _XYTH_template_record *new_records;
+
+        if (new_num_records < num_records) {
+            new_num_records = num_records;
+        }
+        new_records = realloc(ctx->db.records,
+                              new_num_records * sizeof(*new_records));
+        if (new_records != NULL) {
+            memset(&new_records[ctx->db.num_records], 0,
+                   (new_num_records - ctx->db.num_records) *
+                       sizeof(*new_records));
+            ctx->db.records = new_records;
+            ctx->db.num_records = new_num_records;
+        } else {
+            status = XYTH_E_NO_MEMORY;
+        }
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Keeps a copy of the template's minutiae, so candidates can be re-ranked.
+//
+static XYTH_status _XYTH_store_template_record(struct XYTH_context *ctx,
+                                               struct XYTH_template *tpl,
+                                               unsigned int tpl_id,
+                                               unsigned int partition)
+{
+    XYTH_status status;
+    struct _XYTH_template_record *record;
+
+    status = _XYTH_reserve_template_records(ctx, tpl_id + 1);
+    if (status == XYTH_SUCCESS) {
+        record = &ctx->db.records[tpl_id];
+        record->minutiae =
+            malloc(tpl->num_minutiae * sizeof(*record->minutiae));
+        if (record->minutiae != NULL) {
+            for (unsigned int i = 0; i < tpl->num_minutiae; i++) {
+                record->minutiae[i].x = tpl->minutiae[i].x;
+                record->minutiae[i].y = tpl->minutiae[i].y;
+                record->minutiae[i].angle = tpl->minutiae[i].angle;
+            }
+            record->num_minutiae = tpl->num_minutiae;
+            record->partition = partition;
+            record->subject = XYTH_RESERVED_SUBJECT_ID;
+            record->finger = XYTH_FINGER_UNKNOWN;
+            record->num_neighbors = tpl->minutiae[0].num_neighbors;
+        } else {
+            status = XYTH_E_NO_MEMORY;
+        }
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+static void _XYTH_release_template_record(struct XYTH_context *ctx,
+                                          unsigned int tpl_id)
+{
+    if (tpl_id < ctx->db.num_records) {
+        free(ctx->db.records[tpl_id].minutiae);
+        ctx->db.records[tpl_id].minutiae = NULL;
+        ctx->db.records[tpl_id].num_minutiae = 0;
+        ctx->db.records[tpl_id].partition = 0;
+        ctx->db.records[tpl_id].subject = XYTH_RESERVED_SUBJECT_ID;
+        ctx->db.records[tpl_id].finger = XYTH_FINGER_UNKNOWN;
+        ctx->db.records[tpl_id].num_neighbors = 0;
+    }
+}
+
+XYTH_status _XYTH_calc_template_groups(struct XYTH_context *ctx,
+                                       struct XYTH_template *tpl,
+                                       struct _XYTH_template_groups *groups)
+{
+    XYTH_status status = XYTH_SUCCESS;
+    unsigned int num_neighbors = 0;
+
+    // One more of each, so an empty template is not mistaken for a failure
+    groups->neighbors = NULL;
+    groups->first_neighbor =
+        malloc((tpl->num_minutiae + 1) * sizeof(*groups->first_neighbor));
+    if (groups->first_neighbor == NULL) {
+        PRINT_IF_ERROR(XYTH_E_NO_MEMORY);
+        return XYTH_E_NO_MEMORY;
+    }
+    for (unsigned int i = 0; i < tpl->num_minutiae; i++) {
+        groups->first_neighbor[i] = num_neighbors;
+        num_neighbors += tpl->minutiae[i].num_neighbors;
+    }
+
+    groups->neighbors =
+        malloc((num_neighbors + 1) * sizeof(*groups->neighbors));
+    if (groups->neighbors == NULL) {
+        status = XYTH_E_NO_MEMORY;
+    }
+
+    for (unsigned int i = 0; i < tpl->num_minutiae && status == XYTH_SUCCESS;
+         i++) {
+        struct _XYTH_minutia *min = &tpl->minutiae[i];
+        for (unsigned int j = 0; j < min->num_neighbors; j++) {
+            status = _XYTH_calc_neighbor_groups(
+                ctx, &min->neighbors[j],
+                &groups->neighbors[groups->first_neighbor[i] + j]);
+            if (status != XYTH_SUCCESS) {
+                break;
+            }
+        }
+    }
+
+    if (status != XYTH_SUCCESS) {
+        _XYTH_free_template_groups(groups);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+void _XYTH_free_template_groups(struct _XYTH_template_groups *groups)
+{
+    free(groups->neighbors);
+    free(groups->first_neighbor);
+    groups->neighbors = NULL;
+    groups->first_neighbor = NULL;
+}
+
+XYTH_status _XYTH_add_template_in_groups(
+    struct XYTH_context *ctx, struct XYTH_template *tpl,
+    unsigned int partition, const struct _XYTH_template_groups *groups,
+    unsigned int *tpl_id)
 {
     XYTH_status status = XYTH_E_TOO_FEW_MINUTIAE;
 
+    if (ctx->shared != NULL) {
+        PERROR("context is attached to a published index\n");
+        return XYTH_E_READ_ONLY;
+    }
+
+    if (tpl->num_minutiae > 0) {
+        // The record comes first, as it tells the partition of each posting
+        status = _XYTH_store_template_record(
+            ctx, tpl, ctx->db.next_template_id, partition);
+        if (status != XYTH_SUCCESS) {
+            PRINT_IF_ERROR(status);
+            return status;
+        }
+    }
+
     for (unsigned int i = 0; i < tpl->num_minutiae; i++) {
-        status =
-            _XYTH_add_minutia(ctx, &tpl->minutiae[i], ctx->db.next_template_id);
+        status = _XYTH_add_minutia(
+            ctx, &tpl->minutiae[i],
+            &groups->neighbors[groups->first_neighbor[i]],
+            ctx->db.next_template_id);
         if (status != XYTH_SUCCESS) {
             for (unsigned int j = 0; j < i; j++) {
                 XYTH_status debug_status;
@@ -213,6 +616,147 @@ static XYTH_status _XYTH_add_template(struct XYTH_context *ctx,
         *tpl_id = ctx->db.next_template_id;
         ctx->db.next_template_id++;
         ctx->db.templates_counter++;
+        ctx->db.generation++;
+        if (ctx->db.seal_threshold > 0 &&
+            ctx->db.next_template_id - ctx->db.head_first_template >=
+                ctx->db.seal_threshold) {
+            // The template is in; failing to seal only leaves the head larger
+            XYTH_status debug_status = _XYTH_seal_head(ctx);
+            PRINT_IF_ERROR(debug_status);
+        }
+    } else {
+        _XYTH_release_template_record(ctx, ctx->db.next_template_id);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status _XYTH_add_template(struct XYTH_context *ctx,
+                               struct XYTH_template *tpl,
+                               unsigned int partition, unsigned int *tpl_id)
+{
+    XYTH_status status;
+    struct _XYTH_template_groups groups;
+
+    status = _XYTH_calc_template_groups(ctx, tpl, &groups);
+    if (status == XYTH_SUCCESS) {
+        status =
+            _XYTH_add_template_in_groups(ctx, tpl, partition, &groups, tpl_id);
+        _XYTH_free_template_groups(&groups);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Builds 'tpl' from the minutiae kept in 'record'. The neighbors are found
+// again, as they were when the template was first added.
+//
+static XYTH_status
+_XYTH_load_template_record(const struct _XYTH_template_record *record,
+                           struct XYTH_template *tpl)
+{
+    XYTH_status status;
+
+    _XYTH_reset_template(tpl);
+    tpl->minutiae = calloc(record->num_minutiae, sizeof(*tpl->minutiae));
+    if (tpl->minutiae == NULL) {
+        PRINT_IF_ERROR(XYTH_E_NO_MEMORY);
+        return XYTH_E_NO_MEMORY;
+    }
+    tpl->num_minutiae = record->num_minutiae;
+    for (unsigned int i = 0; i < record->num_minutiae; i++) {
+        tpl->minutiae[i].id = i;
+        tpl->minutiae[i].x = record->minutiae[i].x;
+        tpl->minutiae[i].y = record->minutiae[i].y;
+        tpl->minutiae[i].angle = record->minutiae[i].angle;
+    }
+
+    status = _XYTH_intialize_template(tpl, record->num_neighbors);
+    if (status != XYTH_SUCCESS) {
+        XYTH_destroy_template(tpl);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Adds the template kept in 'record' to 'ctx', under the id 'tpl_id', along
+// with its subject and finger.
+//
+XYTH_status _XYTH_add_template_record(
+    struct XYTH_context *ctx, const struct _XYTH_template_record *record,
+    unsigned int tpl_id)
+{
+    XYTH_status status;
+    struct XYTH_template tpl;
+    unsigned int added_id;
+
+    status = _XYTH_load_template_record(record, &tpl);
+    if (status != XYTH_SUCCESS) {
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    ctx->db.next_template_id = tpl_id;
+    status = _XYTH_add_template(ctx, &tpl, record->partition, &added_id);
+    if (status == XYTH_SUCCESS) {
+        ctx->db.records[tpl_id].subject = record->subject;
+        ctx->db.records[tpl_id].finger = record->finger;
+    }
+
+    XYTH_destroy_template(&tpl);
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Keeps a copy of 'record' under 'tpl_id', so the template's postings can be
+// added one by one with _XYTH_add_neighbor_posting().
+//
+XYTH_status _XYTH_keep_template_record(
+    struct XYTH_context *ctx, const struct _XYTH_template_record *record,
+    unsigned int tpl_id)
+{
+    XYTH_status status;
+    struct _XYTH_template_record *copy;
+
+    status = _XYTH_reserve_template_records(ctx, tpl_id + 1);
+    if (status == XYTH_SUCCESS) {
+        copy = &ctx->db.records[tpl_id];
+        *copy = *record;
+        copy->minutiae =
+            malloc(record->num_minutiae * sizeof(*copy->minutiae));
+        if (copy->minutiae != NULL) {
+            memcpy(copy->minutiae, record->minutiae,
+                   record->num_minutiae * sizeof(*copy->minutiae));
+        } else {
+            _XYTH_release_template_record(ctx, tpl_id);
+            status = XYTH_E_NO_MEMORY;
+        }
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Adds 'posting' for a neighbor seen at ('x', 'y', 't') from its minutia.
+//
+XYTH_status _XYTH_add_neighbor_posting(struct XYTH_context *ctx, int x, int y,
+                                       unsigned int t, unsigned int posting)
+{
+    XYTH_status status;
+    struct _XYTH_neighbor nei = {x, y, t, 0};
+    struct _XYTH_neighbor_groups groups;
+
+    status = _XYTH_calc_neighbor_groups(ctx, &nei, &groups);
+    if (status == XYTH_SUCCESS) {
+        status = _XYTH_add_window_postings(ctx, &groups.window, posting,
+                                           groups.residual);
     }
 
     PRINT_IF_ERROR(status);
@@ -239,7 +783,50 @@ XYTH_status XYTH_add_template(struct XYTH_context *ctx,
 
     if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
         if (_XYTH_IS_TEMPLATE_INITIALIZED(*tpl)) {
-            status = _XYTH_add_template(ctx, tpl, tpl_id);
+            _XYTH_lock_index(ctx->index_lock);
+            _XYTH_acquire_lock(ctx->enroll_lock);
+            status = _XYTH_add_template(ctx, tpl, 0, tpl_id);
+            _XYTH_release_lock(ctx->enroll_lock);
+            _XYTH_unlock_index(ctx->index_lock);
+        } else {
+            PERROR("template not initialized\n");
+            status = XYTH_E_NOT_INITIALIZED;
+        }
+    } else {
+        PERROR("context not initialized\n");
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_add_template_to_partition(struct XYTH_context *ctx,
+                                           struct XYTH_template *tpl,
+                                           unsigned int partition,
+                                           unsigned int *tpl_id)
+{
+    XYTH_status status;
+
+    if (ctx == NULL || tpl == NULL || tpl_id == NULL) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(tpl);
+        PRINT_IF_NULL(tpl_id);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        if (partition >= ctx->db_cfg.num_partitions) {
+            PERROR("partition out of range\n");
+            status = XYTH_E_VALUE_OUT_OF_RANGE;
+        } else if (_XYTH_IS_TEMPLATE_INITIALIZED(*tpl)) {
+            _XYTH_lock_index(ctx->index_lock);
+            _XYTH_acquire_lock(ctx->enroll_lock);
+            status = _XYTH_add_template(ctx, tpl, partition, tpl_id);
+            _XYTH_release_lock(ctx->enroll_lock);
+            _XYTH_unlock_index(ctx->index_lock);
         } else {
             PERROR("template not initialized\n");
             status = XYTH_E_NOT_INITIALIZED;
@@ -253,13 +840,53 @@ XYTH_status XYTH_add_template(struct XYTH_context *ctx,
     return status;
 }
 
+//
+// Removes a template sealed in 'segment'. Its postings stay until the segment
+// is merged, hidden behind a tombstone.
+//
+static XYTH_status _XYTH_remove_sealed_template(struct XYTH_context *ctx,
+                                                struct XYTH_template *tpl,
+                                                struct _XYTH_segment *segment,
+                                                unsigned int tpl_id)
+{
+    XYTH_status status;
+
+    if (tpl->num_minutiae == 0) {
+        status = XYTH_E_TOO_FEW_MINUTIAE;
+    } else if (tpl_id >= ctx->db.num_records ||
+               ctx->db.records[tpl_id].minutiae == NULL) {
+        status = XYTH_E_NOT_FOUND;
+    } else {
+        status = _XYTH_add_tombstone(segment, tpl_id);
+        if (status == XYTH_SUCCESS) {
+            ctx->db.templates_counter--;
+            ctx->db.generation++;
+            _XYTH_release_template_record(ctx, tpl_id);
+        }
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
 XYTH_status _XYTH_remove_template(struct XYTH_context *ctx,
                                   struct XYTH_template *tpl,
                                   unsigned int tpl_id)
 {
     XYTH_status status;
+    struct _XYTH_segment *segment;
     unsigned int removed_minutiae = 0;
 
+    if (ctx->shared != NULL) {
+        PERROR("context is attached to a published index\n");
+        return XYTH_E_READ_ONLY;
+    }
+
+    segment = _XYTH_find_segment(&ctx->db, tpl_id);
+    if (segment != NULL) {
+        return _XYTH_remove_sealed_template(ctx, tpl, segment, tpl_id);
+    }
+
     for (unsigned int i = 0; i < tpl->num_minutiae; i++) {
         status = _XYTH_remove_minutia(ctx, &tpl->minutiae[i], tpl_id);
         if (status == XYTH_SUCCESS) {
@@ -270,12 +897,16 @@ XYTH_status _XYTH_remove_template(struct XYTH_context *ctx,
     if (removed_minutiae == tpl->num_minutiae) {
         if (removed_minutiae > 0) {
             ctx->db.templates_counter--;
+            ctx->db.generation++;
+            _XYTH_release_template_record(ctx, tpl_id);
             status = XYTH_SUCCESS;
         } else {
             status = XYTH_E_TOO_FEW_MINUTIAE;
         }
     } else {
         if (removed_minutiae > 0) {
+            ctx->db.generation++;
+            _XYTH_release_template_record(ctx, tpl_id);
             status = XYTH_E_INCOMPLETE_REMOVAL;
         } else {
             status = XYTH_E_NOT_FOUND;
@@ -286,6 +917,32 @@ XYTH_status _XYTH_remove_template(struct XYTH_context *ctx,
     return status;
 }
 
+//
+// Removes a template from 'ctx', finding its neighbors again from the minutiae
+// kept for it.
+//
+XYTH_status _XYTH_remove_template_record(struct XYTH_context *ctx,
+                                         unsigned int tpl_id)
+{
+    XYTH_status status;
+    struct XYTH_template tpl;
+
+    if (tpl_id >= ctx->db.num_records ||
+        ctx->db.records[tpl_id].minutiae == NULL) {
+        PRINT_IF_ERROR(XYTH_E_NOT_FOUND);
+        return XYTH_E_NOT_FOUND;
+    }
+
+    status = _XYTH_load_template_record(&ctx->db.records[tpl_id], &tpl);
+    if (status == XYTH_SUCCESS) {
+        status = _XYTH_remove_template(ctx, &tpl, tpl_id);
+        XYTH_destroy_template(&tpl);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
 XYTH_status XYTH_remove_template(struct XYTH_context *ctx,
                                  struct XYTH_template *tpl, unsigned int tpl_id)
 {
@@ -301,7 +958,11 @@ XYTH_status XYTH_remove_template(struct XYTH_context *ctx,
 
     if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
         if (_XYTH_IS_TEMPLATE_INITIALIZED(*tpl)) {
+            _XYTH_lock_index(ctx->index_lock);
+            _XYTH_acquire_lock(ctx->enroll_lock);
             status = _XYTH_remove_template(ctx, tpl, tpl_id);
+            _XYTH_release_lock(ctx->enroll_lock);
+            _XYTH_unlock_index(ctx->index_lock);
         } else {
             PERROR("template not initialized\n");
             status = XYTH_E_NOT_INITIALIZED;
@@ -314,3 +975,41 @@ XYTH_status XYTH_remove_template(struct XYTH_context *ctx,
     PRINT_IF_ERROR(status);
     return status;
 }
+
+XYTH_status XYTH_set_template_subject(struct XYTH_context *ctx,
+                                      unsigned int tpl_id,
+                                      unsigned int subject_id,
+                                      unsigned int finger_position)
+{
+    XYTH_status status;
+
+    if (ctx == NULL || subject_id == XYTH_RESERVED_SUBJECT_ID ||
+        finger_position > XYTH_MAX_FINGER_POSITION) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_TRUE(subject_id == XYTH_RESERVED_SUBJECT_ID);
+        PRINT_IF_TRUE(finger_position > XYTH_MAX_FINGER_POSITION);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        if (ctx->shared != NULL) {
+            PERROR("context is attached to a published index\n");
+            status = XYTH_E_READ_ONLY;
+        } else if (tpl_id < ctx->db.num_records &&
+            ctx->db.records[tpl_id].minutiae != NULL) {
+            ctx->db.records[tpl_id].subject = subject_id;
+            ctx->db.records[tpl_id].finger = finger_position;
+            status = XYTH_SUCCESS;
+        } else {
+            status = XYTH_E_NOT_FOUND;
+        }
+    } else {
+        PERROR("context not initialized\n");
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
@@ -0,0 +1,97 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef ADD_REMOVE_H
+#define ADD_REMOVE_H
+
+#include <stdint.h>
+
+#include <context.h>
+#include <xyth.h>
+
+#include "common.h"
+
+// Groups written for one neighbor of a template being added
+struct _XYTH_neighbor_groups {
+    unsigned int group_index;         // The neighbor's own group
+    struct _XYTH_group_window window; // Groups written, the own group unless
+                                      // tolerances are applied on addition
+    uint32_t residual;
+};
+
+// Groups of every neighbor of a template, minutia by minutia
+struct _XYTH_template_groups {
+    struct _XYTH_neighbor_groups *neighbors;
+    unsigned int *first_neighbor; // Index in 'neighbors' of each minutia's
+                                  // first neighbor
+};
+
+// Frees the arrays of a group in the head, leaving its pointers as they are
+void _XYTH_free_group_positions(struct XYTH_context *ctx,
+                                unsigned int group_index);
+
+// The caller holds the context's lock
+XYTH_status _XYTH_add_template(struct XYTH_context *ctx,
+                               struct XYTH_template *tpl,
+                               unsigned int partition, unsigned int *tpl_id);
+
+// Works out the groups of 'tpl' ahead of its addition, so they can serve a
+// query first. Fails if a neighbor is outside the index
+XYTH_status _XYTH_calc_template_groups(struct XYTH_context *ctx,
+                                       struct XYTH_template *tpl,
+                                       struct _XYTH_template_groups *groups);
+
+void _XYTH_free_template_groups(struct _XYTH_template_groups *groups);
+
+// _XYTH_add_template() with the groups already worked out
+XYTH_status _XYTH_add_template_in_groups(
+    struct XYTH_context *ctx, struct XYTH_template *tpl,
+    unsigned int partition, const struct _XYTH_template_groups *groups,
+    unsigned int *tpl_id);
+
+XYTH_status _XYTH_remove_template(struct XYTH_context *ctx,
+                                  struct XYTH_template *tpl,
+                                  unsigned int tpl_id);
+
+// Re-adds a kept template, e.g. to another context. The caller holds the
+// context's lock
+XYTH_status _XYTH_add_template_record(
+    struct XYTH_context *ctx, const struct _XYTH_template_record *record,
+    unsigned int tpl_id);
+
+// Removes a template using the minutiae kept for it. The caller holds the
+// context's lock
+XYTH_status _XYTH_remove_template_record(struct XYTH_context *ctx,
+                                         unsigned int tpl_id);
+
+// Keeps a copy of 'record' without adding its postings
+XYTH_status _XYTH_keep_template_record(
+    struct XYTH_context *ctx, const struct _XYTH_template_record *record,
+    unsigned int tpl_id);
+
+// Adds one posting of a template whose record is kept already, for a neighbor
+// at ('x', 'y', 't') from its minutia
+XYTH_status _XYTH_add_neighbor_posting(struct XYTH_context *ctx, int x, int y,
+                                       unsigned int t, unsigned int posting);
+
+XYTH_status _XYTH_reserve_template_records(struct XYTH_context *ctx,
+                                           unsigned int num_records);
+
+#endif // ADD_REMOVE_H
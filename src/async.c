@@ -0,0 +1,468 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <context.h>
+#include <debug.h>
+#include <template.h>
+#include <xyth.h>
+
+#include "add_remove.h"
+#include "async.h"
+#include "cancel.h"
+#include "identify.h"
+#include "lock.h"
+#include "pool.h"
+
+// A submitted request, which becomes a completion once it has run
+struct _XYTH_request {
+    struct _XYTH_task task; // Runs the request on the pool, must be first
+    struct _XYTH_async *async;
+    XYTH_request_kind kind;
+    struct XYTH_template *tpl;
+    struct XYTH_cancel_token cancel; // Tripped by XYTH_cancel_request()
+    struct XYTH_completion completion;
+    struct _XYTH_request *next; // In 'pending', then in 'completions'
+};
+
+// FIFO of requests
+struct _XYTH_request_queue {
+    struct _XYTH_request *head;
+    struct _XYTH_request *tail;
+};
+
+struct _XYTH_async {
+    struct XYTH_context *ctx;
+    struct XYTH_pool *pool;
+    bool owns_pool; // Pool created by XYTH_set_workers()
+    // Protects the lists and the ticket counter
+    pthread_mutex_t mutex;
+    pthread_cond_t drained; // Signaled when 'pending' becomes empty and no
+                            // background task runs
+    struct _XYTH_request *pending; // Submitted, not completed yet
+    struct _XYTH_request_queue completions;
+    unsigned int next_ticket;
+    unsigned int num_background; // Tasks run apart from the requests
+    // Counts the completions not polled yet
+    int event_fd;
+};
+
+static void _XYTH_push_request(struct _XYTH_request_queue *queue,
+                               struct _XYTH_request *request)
+{
+    request->next = NULL;
+    if (queue->tail != NULL) {
+        queue->tail->next = request;
+    } else {
+        queue->head = request;
+    }
+    queue->tail = request;
+}
+
+static struct _XYTH_request *
+_XYTH_pop_request(struct _XYTH_request_queue *queue)
+{
+    struct _XYTH_request *request = queue->head;
+
+    if (request != NULL) {
+        queue->head = request->next;
+        if (queue->head == NULL) {
+            queue->tail = NULL;
+        }
+    }
+
+    return request;
+}
+
+static void _XYTH_free_requests(struct _XYTH_request_queue *queue)
+{
+    struct _XYTH_request *request;
+
+    while ((request = _XYTH_pop_request(queue)) != NULL) {
+        free(request);
+    }
+}
+
+static void _XYTH_remove_pending(struct _XYTH_async *async,
+                                 struct _XYTH_request *request)
+{
+    struct _XYTH_request **link = &async->pending;
+
+    while (*link != request) {
+        link = &(*link)->next;
+    }
+    *link = request->next;
+}
+
+//
+// Runs one request, leaving its results in the request's completion.
+//
+static void _XYTH_execute_request(struct _XYTH_async *async,
+                                  struct _XYTH_request *request)
+{
+    struct XYTH_completion *completion = &request->completion;
+    struct XYTH_context *ctx = async->ctx;
+
+    if (_XYTH_is_cancelled(&request->cancel)) {
+        // Cancelled while queued
+        completion->status = XYTH_E_CANCELLED;
+    } else if (request->kind == XYTH_REQUEST_IDENTIFY) {
+        struct XYTH_candidate candidates[XYTH_COMPLETION_CANDIDATES];
+        unsigned int num_candidates = XYTH_COMPLETION_CANDIDATES;
+
+        _XYTH_share_index(ctx->index_lock);
+        completion->status = _XYTH_identify_uncached(
+            ctx, request->tpl, NULL, NULL, NULL, &request->cancel,
+            &num_candidates, candidates, &completion->stats);
+        _XYTH_unlock_index(ctx->index_lock);
+
+        if (completion->status == XYTH_SUCCESS) {
+            completion->num_candidates = num_candidates;
+            memcpy(completion->candidates, candidates,
+                   num_candidates * sizeof(candidates[0]));
+        }
+    } else {
+        _XYTH_lock_index(ctx->index_lock);
+        _XYTH_acquire_lock(ctx->enroll_lock);
+        completion->status =
+            _XYTH_add_template(ctx, request->tpl, 0, &completion->tpl_id);
+        _XYTH_release_lock(ctx->enroll_lock);
+        _XYTH_unlock_index(ctx->index_lock);
+    }
+}
+
+//
+// Pool task of a request. Once it is queued as a completion, the request
+// belongs to whoever polls it.
+//
+static void _XYTH_run_request(struct _XYTH_task *task)
+{
+    struct _XYTH_request *request = (struct _XYTH_request *)task;
+    struct _XYTH_async *async = request->async;
+    const uint64_t one = 1;
+
+    _XYTH_execute_request(async, request);
+
+    // Signaled under the mutex so the count never lags the queue
+    pthread_mutex_lock(&async->mutex);
+    _XYTH_remove_pending(async, request);
+    _XYTH_push_request(&async->completions, request);
+    if (write(async->event_fd, &one, sizeof(one)) != sizeof(one)) {
+        PERROR("completion not signaled\n");
+    }
+    if (async->pending == NULL && async->num_background == 0) {
+        pthread_cond_broadcast(&async->drained);
+    }
+    pthread_mutex_unlock(&async->mutex);
+}
+
+//
+// Creates the completion queue of requests run on 'pool'. The queue is
+// signaled through an eventfd in semaphore mode, so it stays readable exactly
+// while completions are pending.
+//
+XYTH_status _XYTH_create_async(struct XYTH_context *ctx,
+                               struct XYTH_pool *pool, bool owns_pool,
+                               struct _XYTH_async **async)
+{
+    XYTH_status status = XYTH_E_NO_MEMORY;
+    struct _XYTH_async *new_async;
+
+    new_async = calloc(1, sizeof(*new_async));
+    if (new_async == NULL) {
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    new_async->ctx = ctx;
+    new_async->pool = pool;
+    new_async->owns_pool = owns_pool;
+    new_async->event_fd =
+        eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK | EFD_SEMAPHORE);
+
+    if (new_async->event_fd >= 0 &&
+        pthread_mutex_init(&new_async->mutex, NULL) == 0) {
+        if (pthread_cond_init(&new_async->drained, NULL) == 0) {
+            status = XYTH_SUCCESS;
+        } else {
+            pthread_mutex_destroy(&new_async->mutex);
+        }
+    }
+
+    if (status == XYTH_SUCCESS) {
+        *async = new_async;
+    } else {
+        if (new_async->event_fd >= 0) {
+            close(new_async->event_fd);
+        }
+        free(new_async);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Waits for the requests already submitted, then releases the queue, and the
+// pool if it owns it.
+//
+void _XYTH_destroy_async(struct _XYTH_async *async)
+{
+    if (async == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&async->mutex);
+    while (async->pending != NULL || async->num_background > 0) {
+        pthread_cond_wait(&async->drained, &async->mutex);
+    }
+    pthread_mutex_unlock(&async->mutex);
+
+    if (async->owns_pool) {
+        XYTH_destroy_pool(async->pool);
+    }
+
+    _XYTH_free_requests(&async->completions);
+    pthread_cond_destroy(&async->drained);
+    pthread_mutex_destroy(&async->mutex);
+    close(async->event_fd);
+    free(async);
+}
+
+//
+// Runs 'task' on the pool, apart from the requests. The queue is not released
+// until the task calls _XYTH_finish_background().
+//
+void _XYTH_submit_background(struct _XYTH_async *async,
+                             struct _XYTH_task *task)
+{
+    pthread_mutex_lock(&async->mutex);
+    async->num_background++;
+    pthread_mutex_unlock(&async->mutex);
+
+    _XYTH_submit_task(async->pool, task);
+}
+
+//
+// Ends a task of _XYTH_submit_background(), which must not use the queue or
+// its context any longer.
+//
+void _XYTH_finish_background(struct _XYTH_async *async)
+{
+    pthread_mutex_lock(&async->mutex);
+    async->num_background--;
+    if (async->pending == NULL && async->num_background == 0) {
+        pthread_cond_broadcast(&async->drained);
+    }
+    pthread_mutex_unlock(&async->mutex);
+}
+
+//
+// Queues a request. 'tpl' is read when the request runs, so it must be kept
+// until its completion is polled.
+//
+static XYTH_status _XYTH_submit_request(struct _XYTH_async *async,
+                                        XYTH_request_kind kind,
+                                        struct XYTH_template *tpl,
+                                        unsigned int *ticket)
+{
+    XYTH_status status;
+    struct _XYTH_request *request;
+
+    request = calloc(1, sizeof(*request));
+    if (request != NULL) {
+        request->task.run = _XYTH_run_request;
+        request->async = async;
+        request->kind = kind;
+        request->tpl = tpl;
+        request->completion.kind = kind;
+        request->completion.tpl_id = XYTH_RESERVED_TEMPLATE_ID;
+
+        pthread_mutex_lock(&async->mutex);
+        request->completion.ticket = async->next_ticket++;
+        *ticket = request->completion.ticket;
+        request->next = async->pending;
+        async->pending = request;
+        pthread_mutex_unlock(&async->mutex);
+
+        _XYTH_submit_task(async->pool, &request->task);
+        status = XYTH_SUCCESS;
+    } else {
+        status = XYTH_E_NO_MEMORY;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Checks the parameters of a submission.
+//
+static XYTH_status _XYTH_check_submission(struct XYTH_context *ctx,
+                                          struct XYTH_template *tpl,
+                                          unsigned int *ticket)
+{
+    if (ctx == NULL || tpl == NULL || ticket == NULL) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(tpl);
+        PRINT_IF_NULL(ticket);
+        return XYTH_E_INVALID_PARAMETER;
+    }
+
+    if (!_XYTH_IS_CONTEXT_INITIALIZED(*ctx) ||
+        !_XYTH_IS_TEMPLATE_INITIALIZED(*tpl) || ctx->async == NULL) {
+        return XYTH_E_NOT_INITIALIZED;
+    }
+
+    return XYTH_SUCCESS;
+}
+
+XYTH_status XYTH_submit_identify(struct XYTH_context *ctx,
+                                 struct XYTH_template *tpl,
+                                 unsigned int *ticket)
+{
+    XYTH_status status;
+
+    status = _XYTH_check_submission(ctx, tpl, ticket);
+    if (status == XYTH_SUCCESS) {
+        status = _XYTH_submit_request(ctx->async, XYTH_REQUEST_IDENTIFY, tpl,
+                                      ticket);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_submit_add(struct XYTH_context *ctx,
+                            struct XYTH_template *tpl, unsigned int *ticket)
+{
+    XYTH_status status;
+
+    status = _XYTH_check_submission(ctx, tpl, ticket);
+    if (status == XYTH_SUCCESS) {
+        status =
+            _XYTH_submit_request(ctx->async, XYTH_REQUEST_ADD, tpl, ticket);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Takes the oldest completion, if any.
+//
+XYTH_status XYTH_poll_completion(struct XYTH_context *ctx,
+                                 struct XYTH_completion *completion)
+{
+    struct _XYTH_async *async;
+    struct _XYTH_request *request;
+    uint64_t count;
+
+    if (ctx == NULL || completion == NULL) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(completion);
+        PRINT_IF_ERROR(XYTH_E_INVALID_PARAMETER);
+        return XYTH_E_INVALID_PARAMETER;
+    }
+
+    if (!_XYTH_IS_CONTEXT_INITIALIZED(*ctx) || ctx->async == NULL) {
+        PRINT_IF_ERROR(XYTH_E_NOT_INITIALIZED);
+        return XYTH_E_NOT_INITIALIZED;
+    }
+
+    async = ctx->async;
+    pthread_mutex_lock(&async->mutex);
+    request = _XYTH_pop_request(&async->completions);
+    // Takes one from the eventfd's count, which matches the queue's length
+    if (request != NULL &&
+        read(async->event_fd, &count, sizeof(count)) != sizeof(count)) {
+        PERROR("completion count not updated\n");
+    }
+    pthread_mutex_unlock(&async->mutex);
+
+    if (request == NULL) {
+        // Nothing completed yet, not worth an error message
+        return XYTH_E_NOT_FOUND;
+    }
+
+    *completion = request->completion;
+    free(request);
+    return XYTH_SUCCESS;
+}
+
+//
+// Trips the cancellation token of a request that did not complete yet. It
+// still completes, with XYTH_E_CANCELLED unless it was past cancelling.
+//
+XYTH_status XYTH_cancel_request(struct XYTH_context *ctx, unsigned int ticket)
+{
+    XYTH_status status = XYTH_E_NOT_FOUND;
+    struct _XYTH_async *async;
+    struct _XYTH_request *request;
+
+    if (ctx == NULL) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_ERROR(XYTH_E_INVALID_PARAMETER);
+        return XYTH_E_INVALID_PARAMETER;
+    }
+
+    if (!_XYTH_IS_CONTEXT_INITIALIZED(*ctx) || ctx->async == NULL) {
+        PRINT_IF_ERROR(XYTH_E_NOT_INITIALIZED);
+        return XYTH_E_NOT_INITIALIZED;
+    }
+
+    async = ctx->async;
+    pthread_mutex_lock(&async->mutex);
+    for (request = async->pending; request != NULL; request = request->next) {
+        if (request->completion.ticket == ticket) {
+            _XYTH_set_cancelled(&request->cancel, 1);
+            status = XYTH_SUCCESS;
+        }
+    }
+    pthread_mutex_unlock(&async->mutex);
+
+    // Already completed, or never submitted, not worth an error message
+    return status;
+}
+
+XYTH_status XYTH_get_completion_fd(struct XYTH_context *ctx, int *fd)
+{
+    XYTH_status status;
+
+    if (ctx == NULL || fd == NULL) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(fd);
+        status = XYTH_E_INVALID_PARAMETER;
+    } else if (!_XYTH_IS_CONTEXT_INITIALIZED(*ctx) || ctx->async == NULL) {
+        status = XYTH_E_NOT_INITIALIZED;
+    } else {
+        *fd = ctx->async->event_fd;
+        status = XYTH_SUCCESS;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
@@ -0,0 +1,47 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef ASYNC_H
+#define ASYNC_H
+
+#include <stdbool.h>
+
+#include <xyth.h>
+
+#include "pool.h"
+
+// Requests submitted to a pool, and the queue of their completions
+struct _XYTH_async;
+
+XYTH_status _XYTH_create_async(struct XYTH_context *ctx,
+                               struct XYTH_pool *pool, bool owns_pool,
+                               struct _XYTH_async **async);
+
+// Waits for the requests already submitted, and the background tasks, then
+// releases the pool if owned
+void _XYTH_destroy_async(struct _XYTH_async *async);
+
+// Runs work of the context itself on its pool, e.g. merging segments
+void _XYTH_submit_background(struct _XYTH_async *async,
+                             struct _XYTH_task *task);
+
+void _XYTH_finish_background(struct _XYTH_async *async);
+
+#endif // ASYNC_H
@@ -0,0 +1,330 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <debug.h>
+#include <xyth.h>
+
+#include "cache.h"
+#include "config.h"
+#include "lock.h"
+
+#define _XYTH_NO_ENTRY ((unsigned int)-1)
+
+struct _XYTH_cache_entry {
+    struct _XYTH_query_key key;
+    unsigned int generation;
+    bool with_evidence;
+    // LRU list and hash chain, as entry indexes
+    unsigned int prev;
+    unsigned int next;
+    unsigned int chain;
+    // result
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates;
+    struct XYTH_candidate candidates[MATCH_MAX_CANDIDATES];
+};
+
+struct _XYTH_result_cache {
+    struct _XYTH_cache_entry *entries;
+    unsigned int capacity;
+    unsigned int num_entries;
+    unsigned int *buckets;
+    unsigned int bucket_mask;
+    unsigned int lru_head; // most recently used
+    unsigned int lru_tail; // least recently used
+    // taken by lookups too, as they reorder the LRU list
+    struct _XYTH_lock *lock;
+};
+
+//
+// 128-bit hash state, fed with 32-bit words. Each half mixes the words with a
+// different multiplier, and both are finalized with MurmurHash3's fmix64.
+//
+struct _XYTH_hash {
+    uint64_t h1;
+    uint64_t h2;
+};
+
+static inline uint64_t _XYTH_rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t _XYTH_fmix64(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+static inline void _XYTH_hash_word(struct _XYTH_hash *hash, uint32_t word)
+{
+    hash->h1 ^= word * 0x87c37b91114253d5ULL;
+    hash->h1 = _XYTH_rotl64(hash->h1, 31) * 0x4cf5ad432745937fULL;
+    hash->h2 += word * 0x9e3779b97f4a7c15ULL;
+    hash->h2 = _XYTH_rotl64(hash->h2 ^ hash->h1, 27) * 5 + 0x52dce729;
+}
+
+static void _XYTH_lru_unlink(struct _XYTH_result_cache *cache,
+                             unsigned int index)
+{
+    struct _XYTH_cache_entry *entry = &cache->entries[index];
+
+    if (entry->prev != _XYTH_NO_ENTRY) {
+        cache->entries[entry->prev].next = entry->next;
+    } else {
+        cache->lru_head = entry->next;
+    }
+    if (entry->next != _XYTH_NO_ENTRY) {
+        cache->entries[entry->next].prev = entry->prev;
+    } else {
+        cache->lru_tail = entry->prev;
+    }
+}
+
+static void _XYTH_lru_push_front(struct _XYTH_result_cache *cache,
+                                 unsigned int index)
+{
+    struct _XYTH_cache_entry *entry = &cache->entries[index];
+
+    entry->prev = _XYTH_NO_ENTRY;
+    entry->next = cache->lru_head;
+    if (cache->lru_head != _XYTH_NO_ENTRY) {
+        cache->entries[cache->lru_head].prev = index;
+    } else {
+        cache->lru_tail = index;
+    }
+    cache->lru_head = index;
+}
+
+static unsigned int *_XYTH_bucket_of(struct _XYTH_result_cache *cache,
+                                     struct _XYTH_query_key *key)
+{
+    return &cache->buckets[key->low & cache->bucket_mask];
+}
+
+static void _XYTH_unchain(struct _XYTH_result_cache *cache, unsigned int index)
+{
+    unsigned int *link = _XYTH_bucket_of(cache, &cache->entries[index].key);
+
+    while (*link != index) {
+        link = &cache->entries[*link].chain;
+    }
+    *link = cache->entries[index].chain;
+}
+
+static unsigned int _XYTH_find_entry(struct _XYTH_result_cache *cache,
+                                     struct _XYTH_query_key *key)
+{
+    unsigned int index = *_XYTH_bucket_of(cache, key);
+
+    while (index != _XYTH_NO_ENTRY &&
+           (cache->entries[index].key.high != key->high ||
+            cache->entries[index].key.low != key->low)) {
+        index = cache->entries[index].chain;
+    }
+
+    return index;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+XYTH_status _XYTH_create_result_cache(unsigned int capacity,
+                                      struct _XYTH_result_cache **cache)
+{
+    XYTH_status status = XYTH_E_NO_MEMORY;
+    unsigned int num_buckets = 1;
+
+    // About one entry per bucket
+    while (num_buckets < capacity) {
+        num_buckets <<= 1;
+    }
+
+    *cache = malloc(sizeof(**cache));
+    if (*cache != NULL) {
+        (*cache)->entries = malloc(capacity * sizeof(*(*cache)->entries));
+        (*cache)->buckets = malloc(num_buckets * sizeof(unsigned int));
+        (*cache)->lock = NULL;
+        if ((*cache)->entries != NULL && (*cache)->buckets != NULL &&
+            _XYTH_create_lock(&(*cache)->lock) == XYTH_SUCCESS) {
+            memset((*cache)->buckets, 0xFF, num_buckets * sizeof(unsigned int));
+            (*cache)->bucket_mask = num_buckets - 1;
+            (*cache)->capacity = capacity;
+            (*cache)->num_entries = 0;
+            (*cache)->lru_head = _XYTH_NO_ENTRY;
+            (*cache)->lru_tail = _XYTH_NO_ENTRY;
+            status = XYTH_SUCCESS;
+        } else {
+            free((*cache)->entries);
+            free((*cache)->buckets);
+            free(*cache);
+            *cache = NULL;
+        }
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+void _XYTH_destroy_result_cache(struct _XYTH_result_cache *cache)
+{
+    if (cache != NULL) {
+        _XYTH_destroy_lock(cache->lock);
+        free(cache->entries);
+        free(cache->buckets);
+        free(cache);
+    }
+}
+
+void _XYTH_calc_query_key(struct _XYTH_match_config *match_cfg,
+                          struct XYTH_template *tpl,
+                          struct _XYTH_query_key *key)
+{
+    struct _XYTH_hash hash = {0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL};
+
+    _XYTH_hash_word(&hash, match_cfg->minutia_threshold);
+    _XYTH_hash_word(&hash, match_cfg->template_threshold);
+    _XYTH_hash_word(&hash, match_cfg->failure_threshold);
+    _XYTH_hash_word(&hash, match_cfg->accept_threshold);
+    _XYTH_hash_word(&hash, match_cfg->rerank_candidates);
+    _XYTH_hash_word(&hash, match_cfg->rerank_threshold);
+    _XYTH_hash_word(&hash, match_cfg->group_policy);
+    _XYTH_hash_word(&hash, match_cfg->group_length_limit);
+    _XYTH_hash_word(&hash, match_cfg->probe_order);
+    _XYTH_hash_word(&hash, match_cfg->probe_drop_percent);
+    _XYTH_hash_word(&hash, match_cfg->x_tolerance);
+    _XYTH_hash_word(&hash, match_cfg->y_tolerance);
+    _XYTH_hash_word(&hash, match_cfg->t_tolerance);
+
+    _XYTH_hash_word(&hash, tpl->num_minutiae);
+    for (unsigned int i = 0; i < tpl->num_minutiae; i++) {
+        struct _XYTH_minutia *min = &tpl->minutiae[i];
+
+        _XYTH_hash_word(&hash, min->id);
+        _XYTH_hash_word(&hash, min->x);
+        _XYTH_hash_word(&hash, min->y);
+        _XYTH_hash_word(&hash, min->angle);
+        _XYTH_hash_word(&hash, min->num_neighbors);
+        for (unsigned int j = 0; j < min->num_neighbors; j++) {
+            _XYTH_hash_word(&hash, (uint32_t)min->neighbors[j].relative_x);
+            _XYTH_hash_word(&hash, (uint32_t)min->neighbors[j].relative_y);
+            _XYTH_hash_word(&hash, min->neighbors[j].relative_angle);
+            _XYTH_hash_word(&hash, min->neighbors[j].neighbor_id);
+        }
+    }
+
+    hash.h1 += hash.h2;
+    hash.h2 += hash.h1;
+    key->high = _XYTH_fmix64(hash.h1);
+    key->low = _XYTH_fmix64(hash.h2);
+}
+
+bool _XYTH_lookup_result(struct _XYTH_result_cache *cache,
+                         struct _XYTH_query_key *key, unsigned int generation,
+                         bool with_evidence, unsigned int *num_candidates,
+                         struct XYTH_candidate *candidates,
+                         struct XYTH_identify_stats *stats)
+{
+    struct _XYTH_cache_entry *entry;
+    unsigned int index;
+
+    _XYTH_acquire_lock(cache->lock);
+
+    index = _XYTH_find_entry(cache, key);
+    if (index == _XYTH_NO_ENTRY) {
+        _XYTH_release_lock(cache->lock);
+        return false;
+    }
+
+    entry = &cache->entries[index];
+    if (entry->generation != generation ||
+        (with_evidence && !entry->with_evidence)) {
+        // The context changed since the result was stored, or the result
+        // lacks the evidence asked for
+        _XYTH_release_lock(cache->lock);
+        return false;
+    }
+
+    _XYTH_lru_unlink(cache, index);
+    _XYTH_lru_push_front(cache, index);
+
+    if (entry->num_candidates < *num_candidates) {
+        *num_candidates = entry->num_candidates;
+    }
+    memcpy(candidates, entry->candidates,
+           *num_candidates * sizeof(candidates[0]));
+    if (stats != NULL) {
+        *stats = entry->stats;
+        stats->cached = 1;
+    }
+
+    _XYTH_release_lock(cache->lock);
+    return true;
+}
+
+void _XYTH_store_result(struct _XYTH_result_cache *cache,
+                        struct _XYTH_query_key *key, unsigned int generation,
+                        bool with_evidence, unsigned int num_candidates,
+                        struct XYTH_candidate *candidates,
+                        struct XYTH_identify_stats *stats)
+{
+    struct _XYTH_cache_entry *entry;
+    unsigned int index;
+
+    _XYTH_acquire_lock(cache->lock);
+
+    index = _XYTH_find_entry(cache, key);
+    if (index != _XYTH_NO_ENTRY) {
+        // Refresh the entry, which is outdated
+        _XYTH_lru_unlink(cache, index);
+    } else {
+        if (cache->num_entries < cache->capacity) {
+            index = cache->num_entries++;
+        } else {
+            // Evict the least recently used entry
+            index = cache->lru_tail;
+            _XYTH_lru_unlink(cache, index);
+            _XYTH_unchain(cache, index);
+        }
+        cache->entries[index].key = *key;
+        cache->entries[index].chain = *_XYTH_bucket_of(cache, key);
+        *_XYTH_bucket_of(cache, key) = index;
+    }
+    _XYTH_lru_push_front(cache, index);
+
+    entry = &cache->entries[index];
+    entry->generation = generation;
+    entry->with_evidence = with_evidence;
+    entry->stats = *stats;
+    if (num_candidates > MATCH_MAX_CANDIDATES) {
+        num_candidates = MATCH_MAX_CANDIDATES;
+    }
+    entry->num_candidates = num_candidates;
+    memcpy(entry->candidates, candidates,
+           num_candidates * sizeof(candidates[0]));
+
+    _XYTH_release_lock(cache->lock);
+}
@@ -0,0 +1,57 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+
+#include <xyth.h>
+
+// Identifies a query: the probe template and the match configuration
+struct _XYTH_query_key {
+    uint64_t high;
+    uint64_t low;
+};
+
+struct _XYTH_result_cache;
+
+XYTH_status _XYTH_create_result_cache(unsigned int capacity,
+                                      struct _XYTH_result_cache **cache);
+
+void _XYTH_destroy_result_cache(struct _XYTH_result_cache *cache);
+
+void _XYTH_calc_query_key(struct _XYTH_match_config *match_cfg,
+                          struct XYTH_template *tpl,
+                          struct _XYTH_query_key *key);
+
+bool _XYTH_lookup_result(struct _XYTH_result_cache *cache,
+                         struct _XYTH_query_key *key, unsigned int generation,
+                         bool with_evidence, unsigned int *num_candidates,
+                         struct XYTH_candidate *candidates,
+                         struct XYTH_identify_stats *stats);
+
+void _XYTH_store_result(struct _XYTH_result_cache *cache,
+                        struct _XYTH_query_key *key, unsigned int generation,
+                        bool with_evidence, unsigned int num_candidates,
+                        struct XYTH_candidate *candidates,
+                        struct XYTH_identify_stats *stats);
+
+#endif // CACHE_H
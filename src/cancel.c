@@ -0,0 +1,71 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <stdlib.h>
+
+#include <debug.h>
+#include <xyth.h>
+
+#include "cancel.h"
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  P U B L I C  /////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+XYTH_status XYTH_create_cancel_token(struct XYTH_cancel_token **token)
+{
+    XYTH_status status;
+
+    if (token == NULL) {
+        PRINT_IF_NULL(token);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    *token = calloc(1, sizeof(**token));
+    status = *token != NULL ? XYTH_SUCCESS : XYTH_E_NO_MEMORY;
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+void XYTH_destroy_cancel_token(struct XYTH_cancel_token *token)
+{
+    free(token);
+}
+
+void XYTH_cancel(struct XYTH_cancel_token *token)
+{
+    if (token != NULL) {
+        _XYTH_set_cancelled(token, 1);
+    } else {
+        PRINT_IF_NULL(token);
+    }
+}
+
+void XYTH_reset_cancel_token(struct XYTH_cancel_token *token)
+{
+    if (token != NULL) {
+        _XYTH_set_cancelled(token, 0);
+    } else {
+        PRINT_IF_NULL(token);
+    }
+}
@@ -0,0 +1,45 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef CANCEL_H
+#define CANCEL_H
+
+#include <stdbool.h>
+
+#include <xyth.h>
+
+// Set from any thread to stop the searches given the token
+struct XYTH_cancel_token {
+    int cancelled; // Only accessed through atomic builtins
+};
+
+static inline bool _XYTH_is_cancelled(const struct XYTH_cancel_token *token)
+{
+    return token != NULL &&
+           __atomic_load_n(&token->cancelled, __ATOMIC_RELAXED) != 0;
+}
+
+static inline void _XYTH_set_cancelled(struct XYTH_cancel_token *token,
+                                       int cancelled)
+{
+    __atomic_store_n(&token->cancelled, cancelled, __ATOMIC_RELAXED);
+}
+
+#endif // CANCEL_H
@@ -18,7 +18,14 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+// clock_gettime() is POSIX
+#define _POSIX_C_SOURCE 200112L
+
+#include <time.h>
+
+#include "common.h"
 #include "config.h"
+#include "segment.h"
 #include <context.h>
 #include <debug.h>
 
@@ -84,3 +91,248 @@ XYTH_status _XYTH_calc_group_index(struct XYTH_context *ctx, int x, int y,
     PRINT_IF_ERROR(status);
     return status;
 }
+
+//
+// Given a linear value and its tolerance, calculates a range of values.
+// - 'range_begin' and 'range_end' are included in the range.
+//
+static void _XYTH_calculate_linear_range(int value, unsigned int tolerance,
+                                         int min_possible_value,
+                                         int max_possible_value,
+                                         int *range_begin, int *range_end)
+{
+    *range_begin = value - tolerance;
+    if (*range_begin < min_possible_value) {
+        *range_begin = min_possible_value;
+    }
+
+    *range_end = value + tolerance;
+    if (*range_end > max_possible_value) {
+        *range_end = max_possible_value;
+    }
+}
+
+//
+// Given an angular value and its tolerance, calculates a range of values.
+// - 'range_begin' and 'range_end' are part of the range.
+// - 'range_end' may be greater than 360.
+//
+static void _XYTH_define_angular_range(unsigned int value,
+                                       unsigned int tolerance,
+                                       unsigned int *range_begin,
+                                       unsigned int *range_end)
+{
+    int temp_begin;
+
+    temp_begin = value - tolerance;
+    if (temp_begin < 0) {
+        temp_begin += 360;
+    }
+
+    *range_begin = temp_begin;
+
+    // Don't care whether the angle is greater than 360.
+    *range_end = value + tolerance;
+    if (*range_end < *range_begin) {
+        *range_end += 360;
+    }
+}
+
+//
+// Given an angular range, calculates the runs of consecutive angle groups that
+// it covers. The groups are the same visited by stepping through the range
+// 'degrees_per_group' at a time.
+//
+static unsigned int _XYTH_calc_angle_runs(struct XYTH_context *ctx,
+                                          unsigned int angle_begin,
+                                          unsigned int angle_end,
+                                          struct _XYTH_group_run *runs)
+{
+    unsigned int num_runs = 0;
+
+    for (unsigned int t = angle_begin; t <= angle_end;
+         t += ctx->db_cfg.degrees_per_group) {
+        unsigned int group = (t % 360) / ctx->db_cfg.degrees_per_group;
+        if (num_runs > 0 && runs[num_runs - 1].last + 1 == group) {
+            runs[num_runs - 1].last = group;
+        } else if (num_runs < _XYTH_MAX_ANGLE_RUNS) {
+            runs[num_runs].first = group;
+            runs[num_runs].last = group;
+            num_runs++;
+        } else {
+            PERROR("angle tolerance too large\n");
+            break;
+        }
+    }
+
+    return num_runs;
+}
+
+
+//
+// Calculates the x and y groups covered by the tolerance window around
+// (x, y). Returns false if the window is empty.
+//
+bool _XYTH_calc_xy_window(struct XYTH_context *ctx, int x, int y,
+                          unsigned int x_tol, unsigned int y_tol,
+                          struct _XYTH_group_window *window)
+{
+    int x_begin, x_end;
+    int y_begin, y_end;
+    unsigned int ppg = ctx->db_cfg.pixels_per_group;
+
+    _XYTH_calculate_linear_range(x, x_tol, -(ctx->db_cfg.max_x),
+                                 ctx->db_cfg.max_x, &x_begin, &x_end);
+    _XYTH_calculate_linear_range(y, y_tol, -(ctx->db_cfg.max_y),
+                                 ctx->db_cfg.max_y, &y_begin, &y_end);
+
+    if (x_begin > x_end || y_begin > y_end) {
+        return false;
+    }
+
+    // Stepping 'ppg' pixels at a time visits consecutive groups
+    window->x.first = (ctx->db_cfg.max_x + x_begin) / ppg;
+    window->x.last = window->x.first + (x_end - x_begin) / ppg;
+    window->y.first = (ctx->db_cfg.max_y + y_begin) / ppg;
+    window->y.last = window->y.first + (y_end - y_begin) / ppg;
+
+    return true;
+}
+
+//
+// Calculates the angle groups covered by the tolerance window around 't'.
+// Returns false if the window is empty.
+//
+bool _XYTH_calc_angle_window(struct XYTH_context *ctx, unsigned int t,
+                             unsigned int t_tol,
+                             struct _XYTH_angle_window *window)
+{
+    unsigned int angle_begin, angle_end;
+
+    _XYTH_define_angular_range(t, t_tol, &angle_begin, &angle_end);
+
+    window->num_runs =
+        _XYTH_calc_angle_runs(ctx, angle_begin, angle_end, window->runs);
+    if (window->num_runs == 0) {
+        return false;
+    }
+
+    window->min_group = window->runs[0].first;
+    window->max_group = window->runs[0].last;
+    for (unsigned int i = 1; i < window->num_runs; i++) {
+        if (window->runs[i].first < window->min_group) {
+            window->min_group = window->runs[i].first;
+        }
+        if (window->runs[i].last > window->max_group) {
+            window->max_group = window->runs[i].last;
+        }
+    }
+
+    return true;
+}
+
+//
+// Calculates the groups covered by the tolerance window around (x, y, t).
+// Returns false if the window is empty.
+//
+bool _XYTH_calc_group_window(struct XYTH_context *ctx, int x, int y,
+                             unsigned int t, unsigned int x_tol,
+                             unsigned int y_tol, unsigned int t_tol,
+                             struct _XYTH_group_window *window)
+{
+    return _XYTH_calc_xy_window(ctx, x, y, x_tol, y_tol, window) &&
+           _XYTH_calc_angle_window(ctx, t, t_tol, &window->angle);
+}
+
+//
+// Calculates the position of (x, y, t) inside its group.
+// - Only meaningful in DB_INDEX_MULTIRES mode, 0 otherwise.
+//
+uint32_t _XYTH_calc_residual(struct XYTH_context *ctx, int x, int y,
+                             unsigned int t)
+{
+    unsigned int ppg = ctx->db_cfg.pixels_per_group;
+
+    if (ctx->db_cfg.index_mode != DB_INDEX_MULTIRES) {
+        return 0;
+    }
+
+    return _XYTH_RESIDUAL((ctx->db_cfg.max_x + x) % ppg,
+                          (ctx->db_cfg.max_y + y) % ppg,
+                          t % ctx->db_cfg.degrees_per_group);
+}
+
+//
+// Calculates the exact tolerance window around (x, y, t), without quantizing
+// it into groups.
+//
+void _XYTH_calc_fine_window(struct XYTH_context *ctx, int x, int y,
+                            unsigned int t, unsigned int x_tol,
+                            unsigned int y_tol, unsigned int t_tol,
+                            struct _XYTH_fine_window *window)
+{
+    int begin, end;
+    unsigned int angle_begin, angle_end;
+
+    _XYTH_calculate_linear_range(x, x_tol, -(ctx->db_cfg.max_x),
+                                 ctx->db_cfg.max_x, &begin, &end);
+    window->x_begin = ctx->db_cfg.max_x + begin;
+    window->x_end = ctx->db_cfg.max_x + end;
+
+    _XYTH_calculate_linear_range(y, y_tol, -(ctx->db_cfg.max_y),
+                                 ctx->db_cfg.max_y, &begin, &end);
+    window->y_begin = ctx->db_cfg.max_y + begin;
+    window->y_end = ctx->db_cfg.max_y + end;
+
+    _XYTH_define_angular_range(t, t_tol, &angle_begin, &angle_end);
+    if (angle_end - angle_begin >= 359) {
+        window->angle_begin[0] = 0;
+        window->angle_end[0] = 359;
+        window->num_angle_intervals = 1;
+    } else if (angle_end < 360) {
+        window->angle_begin[0] = angle_begin;
+        window->angle_end[0] = angle_end;
+        window->num_angle_intervals = 1;
+    } else {
+        window->angle_begin[0] = angle_begin;
+        window->angle_end[0] = 359;
+        window->angle_begin[1] = 0;
+        window->angle_end[1] = angle_end - 360;
+        window->num_angle_intervals = 2;
+    }
+}
+
+void _XYTH_mark_group_occupied(struct XYTH_context *ctx,
+                               unsigned int group_index)
+{
+    unsigned int word = group_index / 64;
+
+    ctx->db.occupancy[word] |= (uint64_t)1 << (group_index % 64);
+    ctx->db.occupancy_summary[word / 64] |= (uint64_t)1 << (word % 64);
+}
+
+void _XYTH_mark_group_empty(struct XYTH_context *ctx, unsigned int group_index)
+{
+    unsigned int word = group_index / 64;
+
+    // Sealed segments may still hold the group
+    if (_XYTH_total_group_length(&ctx->db, group_index) > 0) {
+        return;
+    }
+
+    ctx->db.occupancy[word] &= ~((uint64_t)1 << (group_index % 64));
+    if (ctx->db.occupancy[word] == 0) {
+        ctx->db.occupancy_summary[word / 64] &= ~((uint64_t)1 << (word % 64));
+    }
+}
+
+//
+// Reads the monotonic clock, in microseconds.
+//
+uint64_t _XYTH_monotonic_usec(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
@@ -21,6 +21,9 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include <context.h>
 
 int _XYTH_calc_group_index(struct XYTH_context *ctx, int x, int y,
@@ -29,4 +32,151 @@ int _XYTH_calc_group_index(struct XYTH_context *ctx, int x, int y,
 void _XYTH_calc_num_groups(struct XYTH_context *ctx, unsigned int *x_groups,
                            unsigned int *y_groups, unsigned int *t_groups);
 
+// Runs of consecutive angle groups covered by a window (more than one if the
+// window wraps around 360 degrees)
+#define _XYTH_MAX_ANGLE_RUNS 8
+
+struct _XYTH_group_run {
+    unsigned int first;
+    unsigned int last;
+};
+
+// Angle groups covered by a tolerance window, which only depend on the angle
+// and its tolerance
+struct _XYTH_angle_window {
+    struct _XYTH_group_run runs[_XYTH_MAX_ANGLE_RUNS];
+    unsigned int num_runs;
+    unsigned int min_group;
+    unsigned int max_group;
+};
+
+// Groups covered by a tolerance window. Groups are laid out with the angle
+// varying fastest, so each (x, y) cell is one or more runs of consecutive
+// groups.
+struct _XYTH_group_window {
+    struct _XYTH_group_run x;
+    struct _XYTH_group_run y;
+    struct _XYTH_angle_window angle;
+};
+
+// Tolerance window in pixels/degrees. Coordinates are shifted to start at 0,
+// and the angles are split in two intervals if the window wraps around 360.
+struct _XYTH_fine_window {
+    unsigned int x_begin, x_end;
+    unsigned int y_begin, y_end;
+    unsigned int angle_begin[2], angle_end[2];
+    unsigned int num_angle_intervals;
+};
+
+// Residuals pack the position of a posting inside its group, one byte per
+// dimension, so they can be compared a whole posting at a time
+#define _XYTH_RESIDUAL(x, y, t) ((uint32_t)(x) | (uint32_t)(y) << 8 | \
+                                 (uint32_t)(t) << 16)
+#define _XYTH_RESIDUAL_HIGH_BITS 0x00808080u
+
+uint32_t _XYTH_calc_residual(struct XYTH_context *ctx, int x, int y,
+                             unsigned int t);
+
+void _XYTH_calc_fine_window(struct XYTH_context *ctx, int x, int y,
+                            unsigned int t, unsigned int x_tol,
+                            unsigned int y_tol, unsigned int t_tol,
+                            struct _XYTH_fine_window *window);
+
+bool _XYTH_calc_xy_window(struct XYTH_context *ctx, int x, int y,
+                          unsigned int x_tol, unsigned int y_tol,
+                          struct _XYTH_group_window *window);
+
+bool _XYTH_calc_angle_window(struct XYTH_context *ctx, unsigned int t,
+                             unsigned int t_tol,
+                             struct _XYTH_angle_window *window);
+
+bool _XYTH_calc_group_window(struct XYTH_context *ctx, int x, int y,
+                             unsigned int t, unsigned int x_tol,
+                             unsigned int y_tol, unsigned int t_tol,
+                             struct _XYTH_group_window *window);
+
+void _XYTH_mark_group_occupied(struct XYTH_context *ctx,
+                               unsigned int group_index);
+
+void _XYTH_mark_group_empty(struct XYTH_context *ctx, unsigned int group_index);
+
+uint64_t _XYTH_monotonic_usec(void);
+
+//
+// Postings of a group, wherever the index keeps them.
+//
+static inline const unsigned int *
+_XYTH_group_postings(const struct _XYTH_database *db, unsigned int group_index)
+{
+    return db->offsets == NULL ? db->data[group_index]
+                               : db->postings + db->offsets[group_index];
+}
+
+//
+// Residuals of a group's postings (DB_INDEX_MULTIRES only).
+//
+static inline const uint32_t *
+_XYTH_group_residuals(const struct _XYTH_database *db, unsigned int group_index)
+{
+    if (db->offsets == NULL) {
+        return db->residuals[group_index];
+    }
+    return db->packed_residuals + db->offsets[group_index];
+}
+
+//
+// Partitions of a group's postings, NULL if the context has a single one.
+//
+static inline const uint8_t *
+_XYTH_group_partitions(const struct _XYTH_database *db,
+                       unsigned int group_index)
+{
+    if (db->offsets == NULL) {
+        return db->partitions != NULL ? db->partitions[group_index] : NULL;
+    }
+    return db->packed_partitions != NULL
+               ? db->packed_partitions + db->offsets[group_index]
+               : NULL;
+}
+
+//
+// Checks whether any bit in [first_bit, last_bit] is set.
+//
+static inline bool _XYTH_bitmap_range_any(const uint64_t *bitmap,
+                                          unsigned int first_bit,
+                                          unsigned int last_bit)
+{
+    unsigned int word = first_bit / 64;
+    unsigned int last_word = last_bit / 64;
+    uint64_t bits = bitmap[word] & (~(uint64_t)0 << (first_bit % 64));
+
+    for (; word < last_word; bits = bitmap[++word]) {
+        if (bits != 0) {
+            return true;
+        }
+    }
+
+    return (bits & (~(uint64_t)0 >> (63 - last_bit % 64))) != 0;
+}
+
+//
+// Finds the first position in [begin, end) whose partition is not below
+// 'partition'. Postings are kept sorted by partition in each group.
+//
+static inline unsigned int
+_XYTH_partition_lower_bound(const uint8_t *partitions, unsigned int begin,
+                            unsigned int end, unsigned int partition)
+{
+    while (begin < end) {
+        unsigned int middle = begin + (end - begin) / 2;
+        if (partitions[middle] < partition) {
+            begin = middle + 1;
+        } else {
+            end = middle;
+        }
+    }
+
+    return begin;
+}
+
 #endif // COMMON_H
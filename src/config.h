@@ -30,6 +30,9 @@
 #define MATCH_Y_TOLERANCE_DFL 5
 #define MATCH_T_TOLERANCE_DFL 7
 
+// Maximum number of candidates kept by an identification
+#define MATCH_MAX_CANDIDATES 100
+
 // Number of matching neighbors needed to consider two minutiae compatible
 #define MATCH_MINUTIA_THRESHOLD_DFL 15
 // Number of matching minutiae needed to consider two fingerprints compatible
@@ -37,5 +40,65 @@
 // Number of non-compatible minutiae needed to abort an identification.
 // 0 - Don't abort
 #define MATCH_FAILURE_THRESHOLD_DFL 0
+// Template score needed to stop an identification early, accepting the best
+// template. 0 - Don't accept early
+#define MATCH_ACCEPT_THRESHOLD_DFL 0
+// Number of candidates re-scored by the pairwise matcher. 0 - Don't re-rank
+#define MATCH_RERANK_CANDIDATES_DFL 0
+// Pairwise score needed to keep a re-ranked candidate
+#define MATCH_RERANK_THRESHOLD_DFL 12
+
+// How groups holding more than MATCH_GROUP_LENGTH_LIMIT_DFL postings are read
+#define MATCH_GROUP_POLICY_DFL XYTH_GROUP_POLICY_NONE
+#define MATCH_GROUP_LENGTH_LIMIT_DFL 0
+
+// Order in which probe minutiae are processed, and percentage of the most
+// expensive ones left out
+#define MATCH_PROBE_ORDER_DFL XYTH_PROBE_ORDER_TEMPLATE
+#define MATCH_PROBE_DROP_PERCENT_DFL 0
+
+// Re-rank config.
+// Minutiae farther apart than this are not paired
+#define RERANK_MAX_DISTANCE 125
+// Relative distance tolerance between two compatible pairs, in percent
+#define RERANK_DISTANCE_TOLERANCE 5
+// Angle tolerance between two compatible pairs, in degrees
+#define RERANK_ANGLE_TOLERANCE 11
+// Compatible pairs are clustered in rotation bins of this size, in degrees
+#define RERANK_ROTATION_BIN 10
+// Upper bound on compatible pairs considered for a single candidate
+#define RERANK_MAX_ASSOCIATIONS 20000
+
+// Pool config.
+// Largest number of threads a pool may run
+#define POOL_MAX_THREADS 64
+
+// NUMA config.
+// Nodes are numbered below this
+#define NUMA_MAX_NODES 64
+// Pages moved by a single system call
+#define NUMA_PAGE_BATCH 256
+// Nodes a context may be replicated to
+#define NUMA_MAX_REPLICAS 8
+
+// Region config.
+// Size of the huge pages large regions are aligned to
+#define REGION_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+// Posting arrays are carved from slabs of one huge page, in chunks of a power
+// of two bytes, from 1 << REGION_MIN_CHUNK_SHIFT up to the whole slab. Larger
+// arrays are mapped on their own.
+#define REGION_MIN_CHUNK_SHIFT 4
+#define REGION_NUM_CHUNK_CLASSES 18
+
+// Shared index config.
+// Longest shared memory name, leaving room for the generation suffix
+#define SHARED_NAME_MAX 240
+// Times a worker looks the current generation up again, when the one it read
+// was replaced before it could open it
+#define SHARED_OPEN_ATTEMPTS 8
+
+// Segmented index config.
+// Most sealed segments a context holds; sealing one more merges them all
+#define SEGMENT_MAX_SEALED 32
 
 #endif // CONFIG_H
@@ -26,11 +26,25 @@
 #include <template.h>
 #include <xyth.h>
 
+#include "add_remove.h"
+#include "async.h"
+#include "cache.h"
 #include "common.h"
+#include "lock.h"
+#include "region.h"
+#include "segment.h"
+#include "shared.h"
 
 static void _XYTH_set_dfl_match_config(struct _XYTH_match_config *cfg)
 {
     cfg->failure_threshold = MATCH_FAILURE_THRESHOLD_DFL;
+    cfg->accept_threshold = MATCH_ACCEPT_THRESHOLD_DFL;
+    cfg->rerank_candidates = MATCH_RERANK_CANDIDATES_DFL;
+    cfg->rerank_threshold = MATCH_RERANK_THRESHOLD_DFL;
+    cfg->group_policy = MATCH_GROUP_POLICY_DFL;
+    cfg->group_length_limit = MATCH_GROUP_LENGTH_LIMIT_DFL;
+    cfg->probe_order = MATCH_PROBE_ORDER_DFL;
+    cfg->probe_drop_percent = MATCH_PROBE_DROP_PERCENT_DFL;
     cfg->minutia_threshold = MATCH_MINUTIA_THRESHOLD_DFL;
     cfg->template_threshold = MATCH_TEMPLATE_THRESHOLD_DFL;
     cfg->t_tolerance = MATCH_T_TOLERANCE_DFL;
@@ -45,6 +59,12 @@ static void _XYTH_set_dfl_database_config(struct XYTH_database_config *db_cfg)
     db_cfg->max_y = DB_MAX_Y_COORD_DFL;
     db_cfg->pixels_per_group = DB_PIXELS_PER_GROUP_DFL;
     db_cfg->alloc_step = DB_ALLOC_STEP_DFL;
+    db_cfg->index_mode = DB_INDEX_MODE_DFL;
+    db_cfg->x_tolerance = DB_X_TOLERANCE_DFL;
+    db_cfg->y_tolerance = DB_Y_TOLERANCE_DFL;
+    db_cfg->t_tolerance = DB_T_TOLERANCE_DFL;
+    db_cfg->num_partitions = DB_NUM_PARTITIONS_DFL;
+    db_cfg->huge_pages = DB_HUGE_PAGES_DFL;
 }
 
 static XYTH_status
@@ -54,12 +74,25 @@ _XYTH_set_custom_database_config(struct XYTH_database_config *in,
     XYTH_status status;
 
     if (in->degrees_per_group < 360 && in->max_x > 0 && in->max_y > 0 &&
-        in->pixels_per_group > 0 && in->alloc_step > 0) {
+        in->pixels_per_group > 0 && in->alloc_step > 0 &&
+        in->num_partitions > 0 && in->num_partitions <= DB_MAX_PARTITIONS &&
+        (in->index_mode == DB_INDEX_QUERY_EXPANSION ||
+         (in->index_mode == DB_INDEX_ENROLL_EXPANSION &&
+          in->t_tolerance < 180) ||
+         (in->index_mode == DB_INDEX_MULTIRES &&
+          in->pixels_per_group <= DB_MULTIRES_MAX_RESIDUAL &&
+          in->degrees_per_group <= DB_MULTIRES_MAX_RESIDUAL))) {
         out->degrees_per_group = in->degrees_per_group;
         out->max_x = in->max_x;
         out->max_y = in->max_y;
         out->pixels_per_group = in->pixels_per_group;
         out->alloc_step = in->alloc_step;
+        out->index_mode = in->index_mode;
+        out->x_tolerance = in->x_tolerance;
+        out->y_tolerance = in->y_tolerance;
+        out->t_tolerance = in->t_tolerance;
+        out->num_partitions = in->num_partitions;
+        out->huge_pages = in->huge_pages != 0;
 
         status = XYTH_SUCCESS;
     } else {
@@ -69,32 +102,103 @@ _XYTH_set_custom_database_config(struct XYTH_database_config *in,
     return status;
 }
 
+// Rounds 'size' up to a whole number of 64-byte cache lines
+#define _XYTH_ROUND_TO_LINE(size) (((size) + 63) / 64 * 64)
+
+//
+// Lays the arrays indexed by group out in one region, so they can share huge
+// pages. Each array starts at a cache line.
+//
+static XYTH_status _XYTH_map_directory(struct XYTH_context *ctx,
+                                       unsigned int num_groups,
+                                       unsigned int num_words)
+{
+    XYTH_status status;
+    struct _XYTH_region *directory = &ctx->regions->directory;
+    size_t pointers_size = _XYTH_ROUND_TO_LINE(num_groups * sizeof(void *));
+    size_t counters_size =
+        _XYTH_ROUND_TO_LINE(num_groups * sizeof(unsigned int));
+    size_t occupancy_size = _XYTH_ROUND_TO_LINE(num_words * sizeof(uint64_t));
+    size_t summary_size =
+        _XYTH_ROUND_TO_LINE((num_words + 63) / 64 * sizeof(uint64_t));
+    // Positions inside each group, for multi-resolution filtering
+    bool with_residuals = ctx->db_cfg.index_mode == DB_INDEX_MULTIRES;
+    // Partition of each posting, so filtered queries skip the others
+    bool with_partitions = ctx->db_cfg.num_partitions > 1;
+    char *next;
+
+    status = _XYTH_map_region(
+        ctx->regions,
+        pointers_size * (1 + with_residuals + with_partitions) +
+            2 * counters_size + occupancy_size + summary_size,
+        directory);
+    if (status == XYTH_SUCCESS) {
+        next = directory->addr;
+        // Each group will hold a pointer
+        ctx->db.data = (unsigned int **)next;
+        next += pointers_size;
+        // For each group, we have counter to control memory allocations
+        ctx->db.alloc_counter = (unsigned int *)next;
+        next += counters_size;
+        // ...and a counter of the postings it holds
+        ctx->db.group_length = (unsigned int *)next;
+        next += counters_size;
+        // Occupancy bitmaps, so empty groups can be skipped
+        ctx->db.occupancy = (uint64_t *)next;
+        next += occupancy_size;
+        ctx->db.occupancy_summary = (uint64_t *)next;
+        next += summary_size;
+        ctx->db.residuals = NULL;
+        if (with_residuals) {
+            ctx->db.residuals = (uint32_t **)next;
+            next += pointers_size;
+        }
+        ctx->db.partitions = NULL;
+        if (with_partitions) {
+            ctx->db.partitions = (uint8_t **)next;
+        }
+    }
+
+    return status;
+}
+
 static XYTH_status _XYTH_create_database(struct XYTH_context *ctx)
 {
     XYTH_status status;
     unsigned int num_groups;
+    unsigned int num_words;
     unsigned int x_groups, y_groups, t_groups;
 
     ctx->db.next_template_id = 0;
     ctx->db.templates_counter = 0;
+    ctx->db.records = NULL;
+    ctx->db.num_records = 0;
+    ctx->db.generation = 0;
+    ctx->db.config_generation = 0;
+    ctx->db.offsets = NULL;
+    ctx->db.postings = NULL;
+    ctx->db.packed_residuals = NULL;
+    ctx->db.packed_partitions = NULL;
+    ctx->db.segments = NULL;
+    ctx->db.num_segments = 0;
+    ctx->db.head_first_template = 0;
+    ctx->db.head_groups = NULL;
+    ctx->db.num_head_groups = 0;
+    ctx->db.head_groups_size = 0;
+    ctx->db.seal_threshold = 0;
 
     if (ctx->db_cfg.degrees_per_group != 0 &&
         ctx->db_cfg.pixels_per_group != 0) {
         _XYTH_calc_num_groups(ctx, &x_groups, &y_groups, &t_groups);
         num_groups = x_groups * y_groups * t_groups;
-        // Each group will hold a pointer
-        ctx->db.data = calloc(num_groups, sizeof(int *));
-        if (ctx->db.data != NULL) {
-            // For each group, we have counter to control memory allocations
-            ctx->db.alloc_counter = calloc(num_groups, sizeof(unsigned int));
-            if (ctx->db.alloc_counter != NULL) {
-                ctx->db.num_groups = num_groups;
-                PDEBUG("num_groups: %d\n", num_groups);
-                status = XYTH_SUCCESS;
-            } else {
-                free(ctx->db.data);
-                status = XYTH_E_NO_MEMORY;
-            }
+        num_words = (num_groups + 63) / 64;
+        status = _XYTH_map_directory(ctx, num_groups, num_words);
+        if (status == XYTH_SUCCESS) {
+            ctx->db.num_groups = num_groups;
+            ctx->db.x_groups = x_groups;
+            ctx->db.y_groups = y_groups;
+            ctx->db.t_groups = t_groups;
+            PDEBUG("num_groups: %d\n", num_groups);
         }
     } else {
         PRINT_IF_TRUE(ctx->db_cfg.degrees_per_group == 0);
@@ -108,22 +212,82 @@ static XYTH_status _XYTH_create_database(struct XYTH_context *ctx)
 
 static void _XYTH_destroy_database(struct XYTH_context *ctx)
 {
+    if (ctx->shared != NULL) {
+        // The index belongs to the published segment
+        _XYTH_close_shared(ctx->shared, &ctx->db);
+        ctx->shared = NULL;
+        return;
+    }
+
+    _XYTH_free_segments(ctx);
+
     if (ctx->db.alloc_counter != NULL) {
         if (ctx->db.data != NULL) {
             PDEBUG("ctx->db_cfg.num_groups: %d\n", ctx->db.num_groups);
             for (unsigned int i = 0; i < ctx->db.num_groups; i++) {
                 if (ctx->db.alloc_counter[i] > 0) {
-                    free(ctx->db.data[i]);
+                    _XYTH_free_group_positions(ctx, i);
                 }
             }
-            free(ctx->db.data);
             ctx->db.data = NULL;
         }
-        free(ctx->db.alloc_counter);
+        // The arrays indexed by group share one region
+        _XYTH_unmap_region(&ctx->regions->directory);
         ctx->db.alloc_counter = NULL;
+        ctx->db.group_length = NULL;
+        ctx->db.occupancy = NULL;
+        ctx->db.occupancy_summary = NULL;
+        ctx->db.residuals = NULL;
+        ctx->db.partitions = NULL;
     } else {
         PRINT_IF_NULL(ctx->db.alloc_counter);
     }
+
+    if (ctx->db.records != NULL) {
+        for (unsigned int i = 0; i < ctx->db.num_records; i++) {
+            free(ctx->db.records[i].minutiae);
+        }
+        free(ctx->db.records);
+        ctx->db.records = NULL;
+        ctx->db.num_records = 0;
+    }
+}
+
+static XYTH_status _XYTH_create_locks(struct XYTH_context *ctx)
+{
+    XYTH_status status;
+
+    status = _XYTH_create_lock(&ctx->enroll_lock);
+    if (status == XYTH_SUCCESS) {
+        status = _XYTH_create_index_lock(&ctx->index_lock);
+        if (status != XYTH_SUCCESS) {
+            _XYTH_destroy_lock(ctx->enroll_lock);
+            ctx->enroll_lock = NULL;
+        }
+    }
+    if (status == XYTH_SUCCESS) {
+        status = _XYTH_create_lock(&ctx->merge_lock);
+        if (status != XYTH_SUCCESS) {
+            _XYTH_destroy_index_lock(ctx->index_lock);
+            ctx->index_lock = NULL;
+            _XYTH_destroy_lock(ctx->enroll_lock);
+            ctx->enroll_lock = NULL;
+        }
+    }
+    ctx->merge_scheduled = false;
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+static void _XYTH_destroy_locks(struct XYTH_context *ctx)
+{
+    _XYTH_destroy_lock(ctx->merge_lock);
+    ctx->merge_lock = NULL;
+    _XYTH_destroy_index_lock(ctx->index_lock);
+    ctx->index_lock = NULL;
+    _XYTH_destroy_lock(ctx->enroll_lock);
+    ctx->enroll_lock = NULL;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -183,6 +347,233 @@ XYTH_status XYTH_set_match_thresholds(struct XYTH_context *ctx,
     return status;
 }
 
+XYTH_status XYTH_set_accept_threshold(struct XYTH_context *ctx,
+                                      unsigned int accept_threshold)
+{
+    XYTH_status status;
+
+    if (ctx == NULL) {
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        ctx->match_cfg.accept_threshold = accept_threshold;
+        status = XYTH_SUCCESS;
+    } else {
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_set_cascade(struct XYTH_context *ctx,
+                             unsigned int rerank_candidates,
+                             unsigned int rerank_threshold)
+{
+    XYTH_status status;
+
+    if (ctx == NULL) {
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        ctx->match_cfg.rerank_candidates = rerank_candidates;
+        ctx->match_cfg.rerank_threshold = rerank_threshold;
+        status = XYTH_SUCCESS;
+    } else {
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_set_group_policy(struct XYTH_context *ctx,
+                                  XYTH_group_policy policy,
+                                  unsigned int max_group_length)
+{
+    XYTH_status status;
+
+    if (ctx == NULL ||
+        (policy != XYTH_GROUP_POLICY_NONE && policy != XYTH_GROUP_POLICY_SKIP &&
+         policy != XYTH_GROUP_POLICY_WEIGHT) ||
+        (policy != XYTH_GROUP_POLICY_NONE && max_group_length == 0)) {
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        ctx->match_cfg.group_policy = policy;
+        ctx->match_cfg.group_length_limit = max_group_length;
+        status = XYTH_SUCCESS;
+    } else {
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_set_probe_plan(struct XYTH_context *ctx,
+                                XYTH_probe_order order,
+                                unsigned int drop_percent)
+{
+    XYTH_status status;
+
+    if (ctx == NULL ||
+        (order != XYTH_PROBE_ORDER_TEMPLATE &&
+         order != XYTH_PROBE_ORDER_CHEAPEST &&
+         order != XYTH_PROBE_ORDER_SELECTIVE) ||
+        drop_percent >= 100) {
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        ctx->match_cfg.probe_order = order;
+        ctx->match_cfg.probe_drop_percent = drop_percent;
+        status = XYTH_SUCCESS;
+    } else {
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_set_result_cache(struct XYTH_context *ctx,
+                                  unsigned int capacity)
+{
+    XYTH_status status;
+
+    if (ctx == NULL) {
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        // Identifications running read the cache
+        _XYTH_lock_index(ctx->index_lock);
+        _XYTH_destroy_result_cache(ctx->result_cache);
+        ctx->result_cache = NULL;
+        if (capacity > 0) {
+            status = _XYTH_create_result_cache(capacity, &ctx->result_cache);
+        } else {
+            status = XYTH_SUCCESS;
+        }
+        _XYTH_unlock_index(ctx->index_lock);
+    } else {
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_set_seal_threshold(struct XYTH_context *ctx,
+                                    unsigned int num_templates)
+{
+    XYTH_status status;
+
+    if (ctx == NULL) {
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        _XYTH_acquire_lock(ctx->enroll_lock);
+        ctx->db.seal_threshold = num_templates;
+        _XYTH_release_lock(ctx->enroll_lock);
+        status = XYTH_SUCCESS;
+    } else {
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_set_workers(struct XYTH_context *ctx,
+                             unsigned int num_workers)
+{
+    XYTH_status status;
+    struct XYTH_pool *pool;
+
+    if (ctx == NULL) {
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (!_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        status = XYTH_E_NOT_INITIALIZED;
+    } else if (num_workers > POOL_MAX_THREADS) {
+        status = XYTH_E_VALUE_OUT_OF_RANGE;
+    } else {
+        // Requests still queued run before the old workers stop
+        _XYTH_destroy_async(ctx->async);
+        ctx->async = NULL;
+        if (num_workers > 0) {
+            status = XYTH_create_pool(num_workers, NULL, &pool);
+            if (status == XYTH_SUCCESS) {
+                status = _XYTH_create_async(ctx, pool, true, &ctx->async);
+                if (status != XYTH_SUCCESS) {
+                    XYTH_destroy_pool(pool);
+                }
+            }
+        } else {
+            status = XYTH_SUCCESS;
+        }
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_attach_pool(struct XYTH_context *ctx, struct XYTH_pool *pool)
+{
+    XYTH_status status;
+
+    if (ctx == NULL) {
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        // Requests still queued complete before the pool is replaced
+        _XYTH_destroy_async(ctx->async);
+        ctx->async = NULL;
+        if (pool != NULL) {
+            status = _XYTH_create_async(ctx, pool, false, &ctx->async);
+        } else {
+            status = XYTH_SUCCESS;
+        }
+    } else {
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
 XYTH_status XYTH_create_context(struct XYTH_context *ctx,
                                 struct XYTH_database_config *db_cfg)
 {
@@ -197,6 +588,9 @@ XYTH_status XYTH_create_context(struct XYTH_context *ctx,
 
     if (!_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
         _XYTH_set_dfl_match_config(&ctx->match_cfg);
+        ctx->result_cache = NULL;
+        ctx->async = NULL;
+        ctx->shared = NULL;
 
         if (db_cfg != NULL) {
             status = _XYTH_set_custom_database_config(db_cfg, &ctx->db_cfg);
@@ -204,10 +598,24 @@ XYTH_status XYTH_create_context(struct XYTH_context *ctx,
             _XYTH_set_dfl_database_config(&ctx->db_cfg);
             status = XYTH_SUCCESS;
         }
+        if (status == XYTH_SUCCESS) {
+            status = _XYTH_create_locks(ctx);
+        }
+        if (status == XYTH_SUCCESS) {
+            status =
+                _XYTH_create_regions(ctx->db_cfg.huge_pages, &ctx->regions);
+            if (status != XYTH_SUCCESS) {
+                _XYTH_destroy_locks(ctx);
+            }
+        }
         if (status == XYTH_SUCCESS) {
             status = _XYTH_create_database(ctx);
             if (status == XYTH_SUCCESS) {
                 ctx->magic_number = _XYTH_CONTEXT_INIT_MAGIC_NUMBER;
+            } else {
+                _XYTH_destroy_regions(ctx->regions);
+                ctx->regions = NULL;
+                _XYTH_destroy_locks(ctx);
             }
         }
     } else {
@@ -218,11 +626,71 @@ XYTH_status XYTH_create_context(struct XYTH_context *ctx,
     return status;
 }
 
+XYTH_status XYTH_attach_index(struct XYTH_context *ctx, const char *name)
+{
+    XYTH_status status;
+
+    if (ctx == NULL || name == NULL) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(name);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (!_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        _XYTH_set_dfl_match_config(&ctx->match_cfg);
+        ctx->result_cache = NULL;
+        ctx->async = NULL;
+
+        status = _XYTH_open_shared(name, &ctx->shared);
+        if (status == XYTH_SUCCESS) {
+            status = _XYTH_view_shared(ctx->shared->header, &ctx->db_cfg,
+                                       &ctx->db);
+            if (status != XYTH_SUCCESS) {
+                _XYTH_close_shared(ctx->shared, NULL);
+            }
+        }
+        if (status == XYTH_SUCCESS) {
+            status = _XYTH_create_locks(ctx);
+            if (status != XYTH_SUCCESS) {
+                _XYTH_close_shared(ctx->shared, &ctx->db);
+            }
+        }
+        if (status == XYTH_SUCCESS) {
+            status =
+                _XYTH_create_regions(ctx->db_cfg.huge_pages, &ctx->regions);
+            if (status == XYTH_SUCCESS) {
+                ctx->magic_number = _XYTH_CONTEXT_INIT_MAGIC_NUMBER;
+            } else {
+                _XYTH_destroy_locks(ctx);
+                _XYTH_close_shared(ctx->shared, &ctx->db);
+            }
+        }
+        if (status != XYTH_SUCCESS) {
+            ctx->shared = NULL;
+        }
+    } else {
+        status = XYTH_E_ALREADY_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
 void XYTH_destroy_context(struct XYTH_context *ctx)
 {
     if (ctx != NULL) {
         if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+            // Workers may still be using the database
+            _XYTH_destroy_async(ctx->async);
+            ctx->async = NULL;
+            _XYTH_destroy_result_cache(ctx->result_cache);
+            ctx->result_cache = NULL;
             _XYTH_destroy_database(ctx);
+            _XYTH_destroy_regions(ctx->regions);
+            ctx->regions = NULL;
+            _XYTH_destroy_locks(ctx);
             ctx->magic_number = 0;
         } else {
             PRINT_IF_TRUE(ctx->magic_number != _XYTH_CONTEXT_INIT_MAGIC_NUMBER);
@@ -255,3 +723,90 @@ XYTH_status XYTH_get_template_counter(struct XYTH_context *ctx,
     PRINT_IF_ERROR(status);
     return status;
 }
+
+XYTH_status XYTH_get_database_stats(struct XYTH_context *ctx,
+                                    struct XYTH_database_stats *stats)
+{
+    XYTH_status status;
+
+    if (ctx == NULL || stats == NULL) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(stats);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        unsigned int num_words = (ctx->db.num_groups + 63) / 64;
+
+        stats->num_templates = ctx->db.templates_counter;
+        stats->num_groups = ctx->db.num_groups;
+        stats->occupied_groups = 0;
+        stats->max_group_length = 0;
+        stats->num_postings = 0;
+        stats->alloc_postings = 0;
+        stats->index_bytes = 0;
+
+        stats->num_segments = ctx->db.num_segments;
+
+        for (unsigned int i = 0; i < ctx->db.num_groups; i++) {
+            unsigned int length = _XYTH_total_group_length(&ctx->db, i);
+            stats->occupied_groups += length > 0 ? 1 : 0;
+            if (length > stats->max_group_length) {
+                stats->max_group_length = length;
+            }
+            stats->num_postings += length;
+            stats->alloc_postings += ctx->db.alloc_counter[i];
+        }
+
+        // Sealed postings have no spare slots
+        for (unsigned int i = 0; i < ctx->db.num_segments; i++) {
+            const struct _XYTH_segment *segment = &ctx->db.segments[i];
+
+            stats->alloc_postings += segment->num_postings;
+            stats->index_bytes +=
+                (segment->num_held + 1) *
+                    (sizeof(unsigned int) + sizeof(uint64_t)) +
+                ((size_t)1 << segment->directory_bits) * sizeof(unsigned int);
+            if (segment->tombstones != NULL) {
+                stats->index_bytes +=
+                    (segment->end_template - segment->first_template + 63) /
+                    64 * sizeof(uint64_t);
+            }
+        }
+
+        stats->index_bytes +=
+            stats->alloc_postings * sizeof(unsigned int) +
+            (unsigned long long)ctx->db.num_groups *
+                (sizeof(unsigned int *) + 2 * sizeof(unsigned int)) +
+            (num_words + (num_words + 63) / 64) * sizeof(uint64_t);
+        if (ctx->db.residuals != NULL) {
+            stats->index_bytes +=
+                stats->alloc_postings * sizeof(uint32_t) +
+                (unsigned long long)ctx->db.num_groups * sizeof(uint32_t *);
+        }
+        if (ctx->db.partitions != NULL) {
+            stats->index_bytes +=
+                stats->alloc_postings * sizeof(uint8_t) +
+                (unsigned long long)ctx->db.num_groups * sizeof(uint8_t *);
+        }
+
+        stats->record_bytes = (unsigned long long)ctx->db.num_records *
+                              sizeof(struct _XYTH_template_record);
+        for (unsigned int i = 0; i < ctx->db.num_records; i++) {
+            stats->record_bytes += ctx->db.records[i].num_minutiae *
+                                   sizeof(struct _XYTH_xyt);
+        }
+
+        _XYTH_get_region_usage(ctx->regions, &stats->region_bytes,
+                               &stats->huge_page_bytes);
+
+        status = XYTH_SUCCESS;
+    } else {
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
@@ -19,6 +19,7 @@
 // THE SOFTWARE.
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -26,10 +27,42 @@
 #include <debug.h>
 #include <xyth.h>
 
+#include "add_remove.h"
+#include "cache.h"
+#include "cancel.h"
 #include "common.h"
 #include "config.h"
+#include "identify.h"
+#include "lock.h"
+#include "options.h"
+#include "plan.h"
+#include "region.h"
+#include "rerank.h"
+#include "segment.h"
+#include "subject.h"
+#include "subset.h"
 
-#define _XYTH_MAX_MATCHES 100
+// Minutiae scores are fixed-point, so votes from over-populated groups can be
+// down-weighted. A vote from an ordinary group is worth _XYTH_VOTE_ONE.
+#define _XYTH_VOTE_ONE 256
+
+// Matched gallery minutiae are tracked as one bit per minutia
+#if MAX_MINUTIAE_PER_TEMPLATE > 64
+#error "MAX_MINUTIAE_PER_TEMPLATE must fit in a 64-bit mask"
+#endif
+
+// Progress callback of a streaming identification
+struct _XYTH_progress {
+    XYTH_progress_callback callback;
+    void *user_data;
+    unsigned int batch_size; // Probe minutiae between calls
+};
+
+// Limits of a bounded identification
+struct _XYTH_budget {
+    unsigned long long max_postings; // 0 - No limit
+    uint64_t deadline_usec;          // Monotonic clock, 0 - No limit
+};
 
 struct _XYTH_global_score {
     // minutiae
@@ -38,168 +71,485 @@ struct _XYTH_global_score {
     // templates
     unsigned int *template_scores;
     unsigned int num_template_scores;
+    // holds 'minutiae_scores' and 'template_scores'
+    struct _XYTH_region scratch;
+    // templates scored (NULL if all), indexes above are slots in it
+    const struct _XYTH_subset *subset;
+    // partitions scored, 0 if all of them
+    uint32_t partition_mask;
+    // called after each batch of probe minutiae (NULL if none)
+    const struct _XYTH_progress *progress;
+    // limits of the search (NULL if none)
+    const struct _XYTH_budget *budget;
+    // match configuration, the context's unless options were given
+    const struct _XYTH_match_config *cfg;
+    // angle window of each relative angle (NULL if not prepared)
+    const struct _XYTH_angle_window *angle_windows;
+    // stops the search once tripped (NULL if none)
+    const struct XYTH_cancel_token *cancel;
+    // groups of the probe's neighbors, worked out to add it (NULL if not)
+    const struct _XYTH_template_groups *probe_groups;
+    // best and runner-up templates
+    unsigned int best_template;
+    unsigned int best_score;
+    unsigned int runner_up_score;
+    // evidence, per template (NULL if not requested)
+    uint64_t *matched_minutiae;
+    unsigned int *best_votes;
+    // query totals
+    struct XYTH_identify_stats stats;
     // result
     unsigned int num_matches;
-    unsigned int matches[_XYTH_MAX_MATCHES];
+    unsigned int matches[MATCH_MAX_CANDIDATES];
+    unsigned int pairwise_scores[MATCH_MAX_CANDIDATES]; // if re-ranked
 };
 
+static void _XYTH_reset_minutiae_scores(struct _XYTH_global_score *score)
+{
+    memset(score->minutiae_scores, 0,
+           score->num_minutiae_scores * sizeof(unsigned int));
+}
+
+static void _XYTH_reset_template_scores(struct _XYTH_global_score *score)
+{
+    memset(score->template_scores, 0,
+           score->num_template_scores * sizeof(unsigned int));
+
+    if (score->matched_minutiae != NULL) {
+        memset(score->matched_minutiae, 0,
+               score->num_template_scores * sizeof(uint64_t));
+        memset(score->best_votes, 0,
+               score->num_template_scores * sizeof(unsigned int));
+    }
+
+    score->best_template = XYTH_RESERVED_TEMPLATE_ID;
+    score->best_score = 0;
+    score->runner_up_score = 0;
+    memset(&score->stats, 0, sizeof(score->stats));
+    memset(score->pairwise_scores, 0, sizeof(score->pairwise_scores));
+    score->num_matches = 0;
+}
+
 //
-// Given a linear value and its tolerance, calculates a range of values.
-// - 'range_begin' and 'range_end' are included in the range.
+// Allocates the per-template evidence arrays.
 //
-static void _XYTH_calculate_linear_range(int value, unsigned int tolerance,
-                                         int min_possible_value,
-                                         int max_possible_value,
-                                         int *range_begin, int *range_end)
+static XYTH_status _XYTH_create_evidence(struct _XYTH_global_score *score)
 {
-    *range_begin = value - tolerance;
-    if (*range_begin < min_possible_value) {
-        *range_begin = min_possible_value;
-    }
+    XYTH_status status;
 
-    *range_end = value + tolerance;
-    if (*range_end > max_possible_value) {
-        *range_end = max_possible_value;
+    score->matched_minutiae =
+        malloc((score->num_template_scores + 1) * sizeof(uint64_t));
+    if (score->matched_minutiae != NULL) {
+        score->best_votes =
+            malloc((score->num_template_scores + 1) * sizeof(unsigned int));
+        if (score->best_votes != NULL) {
+            status = XYTH_SUCCESS;
+        } else {
+            free(score->matched_minutiae);
+            score->matched_minutiae = NULL;
+            status = XYTH_E_NO_MEMORY;
+        }
+    } else {
+        status = XYTH_E_NO_MEMORY;
     }
+
+    return status;
 }
 
 //
-// Given an angular value and its tolerance, calculates a range of values.
-// - 'range_begin' and 'range_end' are part of the range.
-// - 'range_end' may be greater than 360.
+// Creates and initializes a score structure.
+// - 'with_evidence' also collects per-template evidence, which is only needed
+//   by XYTH_identify_ex().
+// - If 'subset' is not NULL, only its members are scored, and the arrays are
+//   sized to it.
 //
-static void _XYTH_define_angular_range(unsigned int value,
-                                       unsigned int tolerance,
-                                       unsigned int *range_begin,
-                                       unsigned int *range_end)
+static XYTH_status _XYTH_create_score(struct XYTH_context *context,
+                                      struct _XYTH_global_score *score,
+                                      bool with_evidence,
+                                      const struct _XYTH_subset *subset)
 {
-    int temp_begin;
+    XYTH_status status;
 
-    temp_begin = value - tolerance;
-    if (temp_begin < 0) {
-        temp_begin += 360;
-    }
+    score->subset = subset;
+    score->partition_mask = 0;
+    score->progress = NULL;
+    score->budget = NULL;
+    score->cfg = &context->match_cfg;
+    score->angle_windows = NULL;
+    score->cancel = NULL;
+    score->probe_groups = NULL;
+    score->num_template_scores = subset != NULL ? subset->num_templates
+                                                : context->db.next_template_id;
+    score->num_minutiae_scores =
+        score->num_template_scores * MAX_MINUTIAE_PER_TEMPLATE;
 
-    *range_begin = temp_begin;
+    score->matched_minutiae = NULL;
+    score->best_votes = NULL;
+
+    // Both arrays share a region, kept from one query to the next
+    status = _XYTH_take_scratch(context->regions,
+                                ((size_t)score->num_minutiae_scores +
+                                 score->num_template_scores) *
+                                    sizeof(unsigned int),
+                                &score->scratch);
+
+    if (status == XYTH_SUCCESS) {
+        score->minutiae_scores = score->scratch.addr;
+        score->template_scores =
+            score->minutiae_scores + score->num_minutiae_scores;
+        _XYTH_reset_minutiae_scores(score);
 
-    // Don't care whether the angle is greater than 360.
-    *range_end = value + tolerance;
-    if (*range_end < *range_begin) {
-        *range_end += 360;
+        status = with_evidence ? _XYTH_create_evidence(score) : XYTH_SUCCESS;
+        if (status == XYTH_SUCCESS) {
+            _XYTH_reset_template_scores(score);
+        } else {
+            _XYTH_give_back_scratch(context->regions, &score->scratch);
+        }
     }
+
+    PRINT_IF_ERROR(status);
+    return status;
 }
 
-static void _XYTH_reset_minutiae_scores(struct _XYTH_global_score *score)
+//
+// Destroys a score structure.
+//
+static void _XYTH_destroy_score(struct XYTH_context *context,
+                                struct _XYTH_global_score *score)
 {
-    memset(score->minutiae_scores, 0,
-           score->num_minutiae_scores * sizeof(unsigned int));
+    _XYTH_give_back_scratch(context->regions, &score->scratch);
+
+    if (score->matched_minutiae != NULL) {
+        free(score->matched_minutiae);
+        free(score->best_votes);
+    }
 }
 
-static void _XYTH_reset_template_scores(struct _XYTH_global_score *score)
+//
+// Maps a posting to its member of 'minutiae_scores'. Returns false if its
+// template is not scored.
+//
+static inline bool _XYTH_calc_score_index(struct _XYTH_global_score *score,
+                                          unsigned int posting,
+                                          unsigned int *index)
 {
-    memset(score->template_scores, 0,
-           score->num_template_scores * sizeof(unsigned int));
+    unsigned int slot;
 
-    score->num_matches = 0;
+    if (score->subset == NULL) {
+        // The posting is a combination of template/minutia, and it can be
+        // used directly as an index
+        *index = posting;
+        return true;
+    }
+
+    if (!_XYTH_subset_slot(score->subset, posting / MAX_MINUTIAE_PER_TEMPLATE,
+                           &slot)) {
+        return false;
+    }
+
+    *index = slot * MAX_MINUTIAE_PER_TEMPLATE +
+             posting % MAX_MINUTIAE_PER_TEMPLATE;
+    return true;
 }
 
 //
-// Creates and initializes a score structure.
+// Maps a template slot back to the template id.
 //
-static XYTH_status _XYTH_create_score(struct XYTH_context *context,
-                                      struct _XYTH_global_score *score)
+static inline unsigned int
+_XYTH_calc_template_id(struct _XYTH_global_score *score, unsigned int slot)
 {
-    XYTH_status status;
-    score->num_minutiae_scores =
-        context->db.next_template_id * MAX_MINUTIAE_PER_TEMPLATE;
+    return score->subset != NULL ? score->subset->ids[slot] : slot;
+}
 
-    score->num_template_scores = context->db.next_template_id;
+//
+// Finds the next stretch of 'run', starting at '*begin', in a partition
+// scored. Postings are sorted by partition, so the stretch ends where its
+// partition does, and partitions not scored are jumped over by binary search.
+// Returns false when there are no more stretches.
+//
+static bool _XYTH_next_partition_run(struct _XYTH_global_score *score,
+                                     const struct _XYTH_posting_run *run,
+                                     unsigned int *begin, unsigned int *end)
+{
+    const uint8_t *partitions = run->partitions;
+    unsigned int length = run->length;
 
-    score->minutiae_scores =
-        malloc(score->num_minutiae_scores * sizeof(unsigned int));
+    if (score->partition_mask == 0 || partitions == NULL) {
+        *end = length;
+        return *begin < length;
+    }
 
-    if (score->minutiae_scores != NULL) {
-        _XYTH_reset_minutiae_scores(score);
-        score->template_scores =
-            malloc(score->num_template_scores * sizeof(unsigned int));
+    while (*begin < length) {
+        unsigned int partition = partitions[*begin];
+        uint64_t above;
 
-        if (score->template_scores != NULL) {
-            _XYTH_reset_template_scores(score);
-            status = XYTH_SUCCESS;
-        } else {
-            status = XYTH_E_NO_MEMORY;
+        if (score->partition_mask & ((uint32_t)1 << partition)) {
+            *end = _XYTH_partition_lower_bound(partitions, *begin, length,
+                                               partition + 1);
+            return true;
         }
 
-        if (status != XYTH_SUCCESS) {
-            free(score->minutiae_scores);
+        above = score->partition_mask & ~(((uint64_t)2 << partition) - 1);
+        if (above == 0) {
+            break;
         }
-    } else {
-        status = XYTH_E_NO_MEMORY;
+        *begin = _XYTH_partition_lower_bound(partitions, *begin, length,
+                                             __builtin_ctzll(above));
     }
 
-    return status;
+    return false;
 }
 
 //
-// Destroys a score structure.
+// Calculates how much a vote from a group holding 'group_length' postings is
+// worth, according to the group policy. Returns 0 if the group is skipped.
 //
-static void _XYTH_destroy_score(struct _XYTH_global_score *score)
+static unsigned int _XYTH_calc_vote_weight(struct _XYTH_global_score *score,
+                                           unsigned int group_length)
 {
-    if (score->minutiae_scores != NULL) {
-        free(score->minutiae_scores);
+    unsigned int limit = score->cfg->group_length_limit;
+    unsigned int weight;
+
+    if (score->cfg->group_policy == XYTH_GROUP_POLICY_NONE ||
+        group_length <= limit) {
+        return _XYTH_VOTE_ONE;
     }
 
-    if (score->template_scores != NULL) {
-        free(score->template_scores);
+    if (score->cfg->group_policy == XYTH_GROUP_POLICY_SKIP) {
+        score->stats.groups_skipped++;
+        return 0;
     }
+
+    weight = (uint64_t)_XYTH_VOTE_ONE * limit / group_length;
+    return weight > 0 ? weight : 1;
 }
 
 //
-// Given a neighbor, calculates the ranges for X, Y, and angle.
+// Adds a vote worth 'weight' to each posting of 'run', skipping templates
+// removed from its segment.
 //
-static void _XYTH_calc_compatibility_window(struct XYTH_context *context,
-                                            struct _XYTH_neighbor *neighbor,
-                                            int *x_begin, int *x_end,
-                                            int *y_begin, int *y_end,
-                                            unsigned int *angle_begin,
-                                            unsigned int *angle_end)
+static void _XYTH_score_run(struct _XYTH_global_score *score,
+                            const struct _XYTH_posting_run *run,
+                            unsigned int weight)
 {
-    _XYTH_calculate_linear_range(
-        neighbor->relative_x, context->match_cfg.x_tolerance,
-        -(context->db_cfg.max_x), context->db_cfg.max_x, x_begin, x_end);
+    bool with_tombstones =
+        run->segment != NULL && run->segment->tombstones != NULL;
+    unsigned int begin = 0, end;
 
-    _XYTH_calculate_linear_range(
-        neighbor->relative_y, context->match_cfg.y_tolerance,
-        -(context->db_cfg.max_y), context->db_cfg.max_y, y_begin, y_end);
+    while (_XYTH_next_partition_run(score, run, &begin, &end)) {
+        for (unsigned int position = begin; position < end; position++) {
+            unsigned int posting = run->postings[position];
+            unsigned int index;
 
-    _XYTH_define_angular_range(neighbor->relative_angle,
-                               context->match_cfg.t_tolerance, angle_begin,
-                               angle_end);
+            if (with_tombstones &&
+                _XYTH_is_tombstoned(run->segment, posting)) {
+                continue;
+            }
+            if (_XYTH_calc_score_index(score, posting, &index)) {
+                score->minutiae_scores[index] += weight;
+            }
+        }
+        score->stats.postings_scanned += end - begin;
+        begin = end;
+    }
 }
 
 //
-// Computes one point (+1) in the score for each minutia referenced by the group
+// Computes one vote in the score for each minutia referenced by the group
 // associated with 'group_index'.
 //
 static void _XYTH_update_minutia_score(struct XYTH_context *context,
                                        struct _XYTH_global_score *score,
                                        unsigned int group_index)
 {
-    unsigned int *group;
-    unsigned int group_length;
-    unsigned int position = 0;
-    unsigned int global_minutia_index;
+    struct _XYTH_posting_run runs[SEGMENT_MAX_SEALED + 1];
+    unsigned int num_runs;
+    unsigned int group_length = 0;
+    unsigned int weight;
+
+    num_runs = _XYTH_gather_runs(&context->db, group_index, true, 0,
+                                 context->db.num_segments, runs);
+    for (unsigned int i = 0; i < num_runs; i++) {
+        group_length += runs[i].length;
+    }
+    weight = _XYTH_calc_vote_weight(score, group_length);
+    if (group_length > 0 && weight > 0) {
+        for (unsigned int i = 0; i < num_runs; i++) {
+            _XYTH_score_run(score, &runs[i], weight);
+        }
+        score->stats.groups_visited++;
+    }
+}
+
+//
+// Updates the score with every non-empty group in [first_group, last_group],
+// walking the occupancy bitmap a word at a time.
+//
+static void _XYTH_scan_occupied_groups(struct XYTH_context *context,
+                                       struct _XYTH_global_score *score,
+                                       unsigned int first_group,
+                                       unsigned int last_group)
+{
+    const uint64_t *occupancy = context->db.occupancy;
+    unsigned int word = first_group / 64;
+    unsigned int last_word = last_group / 64;
+    uint64_t bits = occupancy[word] & (~(uint64_t)0 << (first_group % 64));
+
+    for (;;) {
+        if (word == last_word) {
+            bits &= ~(uint64_t)0 >> (63 - last_group % 64);
+        }
+        while (bits != 0) {
+            _XYTH_update_minutia_score(context, score,
+                                       word * 64 + __builtin_ctzll(bits));
+            bits &= bits - 1;
+        }
+        if (word == last_word) {
+            break;
+        }
+        bits = occupancy[++word];
+    }
+}
+
+//
+// Adds a vote worth 'weight' to each posting of 'run' whose residual lies in
+// [low, high], byte by byte. The comparison is branch-free: with every byte
+// below 0x80, setting the high bit before subtracting leaves it set exactly
+// when the byte did not borrow.
+//
+static void _XYTH_filter_run(struct _XYTH_global_score *score,
+                             const struct _XYTH_posting_run *run, uint32_t low,
+                             uint32_t high, unsigned int weight)
+{
+    const unsigned int *group = run->postings;
+    const uint32_t *residuals = run->residuals;
+    bool with_tombstones =
+        run->segment != NULL && run->segment->tombstones != NULL;
+    unsigned int begin = 0, end;
+
+    while (_XYTH_next_partition_run(score, run, &begin, &end)) {
+        for (unsigned int i = begin; i < end; i++) {
+            unsigned int index;
+            uint32_t in_range =
+                ((residuals[i] | _XYTH_RESIDUAL_HIGH_BITS) - low) &
+                ((high | _XYTH_RESIDUAL_HIGH_BITS) - residuals[i]) &
+                _XYTH_RESIDUAL_HIGH_BITS;
+            if (with_tombstones &&
+                _XYTH_is_tombstoned(run->segment, group[i])) {
+                continue;
+            }
+            if (_XYTH_calc_score_index(score, group[i], &index)) {
+                score->minutiae_scores[index] +=
+                    (in_range == _XYTH_RESIDUAL_HIGH_BITS) * weight;
+            }
+        }
+        score->stats.postings_scanned += end - begin;
+        begin = end;
+    }
+}
+
+//
+// Adds one vote to each posting of 'group_index', in the head and in every
+// sealed segment, whose residual lies in [low, high].
+//
+static void _XYTH_filter_minutia_score(struct XYTH_context *context,
+                                       struct _XYTH_global_score *score,
+                                       unsigned int group_index, uint32_t low,
+                                       uint32_t high)
+{
+    struct _XYTH_posting_run runs[SEGMENT_MAX_SEALED + 1];
+    unsigned int num_runs;
+    unsigned int length = 0;
+    unsigned int weight;
+
+    num_runs = _XYTH_gather_runs(&context->db, group_index, true, 0,
+                                 context->db.num_segments, runs);
+    for (unsigned int i = 0; i < num_runs; i++) {
+        length += runs[i].length;
+    }
+    weight = _XYTH_calc_vote_weight(score, length);
+    if (weight == 0) {
+        return;
+    }
+
+    for (unsigned int i = 0; i < num_runs; i++) {
+        _XYTH_filter_run(score, &runs[i], low, high, weight);
+    }
+
+    score->stats.groups_visited++;
+}
+
+//
+// Given a group of 'size' values starting at 'first_value', calculates the
+// part of [begin, end] inside it, relative to the group's start.
+//
+static void _XYTH_calc_residual_range(unsigned int first_value,
+                                      unsigned int size, unsigned int begin,
+                                      unsigned int end, unsigned int *low,
+                                      unsigned int *high)
+{
+    *low = begin > first_value ? begin - first_value : 0;
+    *high = end - first_value < size - 1 ? end - first_value : size - 1;
+}
+
+//
+// Multi-resolution version of _XYTH_find_matching_minutiae(). Only the coarse
+// groups overlapping the exact window are read, and their postings are
+// filtered by residual, so the tolerances keep their meaning in pixels and
+// degrees.
+//
+static void _XYTH_find_matching_minutiae_multires(
+    struct XYTH_context *context, struct _XYTH_neighbor *neighbor,
+    struct _XYTH_global_score *score)
+{
+    struct _XYTH_fine_window window;
+    unsigned int ppg = context->db_cfg.pixels_per_group;
+    unsigned int dpg = context->db_cfg.degrees_per_group;
+    unsigned int x_block_size = context->db.y_groups * context->db.t_groups;
+    unsigned int y_block_size = context->db.t_groups;
+
+    _XYTH_calc_fine_window(context, neighbor->relative_x, neighbor->relative_y,
+                           neighbor->relative_angle,
+                           score->cfg->x_tolerance, score->cfg->y_tolerance,
+                           score->cfg->t_tolerance, &window);
+
+    if (window.x_begin > window.x_end || window.y_begin > window.y_end) {
+        return;
+    }
+
+    for (unsigned int x = window.x_begin / ppg; x <= window.x_end / ppg; x++) {
+        unsigned int x_low, x_high;
+        _XYTH_calc_residual_range(x * ppg, ppg, window.x_begin, window.x_end,
+                                  &x_low, &x_high);
+
+        for (unsigned int y = window.y_begin / ppg; y <= window.y_end / ppg;
+             y++) {
+            unsigned int y_low, y_high;
+            unsigned int base = x * x_block_size + y * y_block_size;
+            _XYTH_calc_residual_range(y * ppg, ppg, window.y_begin,
+                                      window.y_end, &y_low, &y_high);
+
+            for (unsigned int i = 0; i < window.num_angle_intervals; i++) {
+                for (unsigned int t = window.angle_begin[i] / dpg;
+                     t <= window.angle_end[i] / dpg; t++) {
+                    unsigned int t_low, t_high;
+                    unsigned int group_index = base + t;
 
-    group_length = context->db.alloc_counter[group_index];
-    if (group_length > 0) {
-        group = context->db.data[group_index];
-        while (group[position] != (unsigned int)-1 && position < group_length) {
-            // The value in group[position] is a combination of
-            // template/minutia, and it can be used directly as an index in
-            // 'minutiae_scores'.
-            global_minutia_index = group[position];
-            score->minutiae_scores[global_minutia_index]++;
-            position++;
+                    if (!_XYTH_bitmap_range_any(context->db.occupancy,
+                                                group_index, group_index)) {
+                        continue;
+                    }
+
+                    _XYTH_calc_residual_range(t * dpg, dpg,
+                                              window.angle_begin[i],
+                                              window.angle_end[i], &t_low,
+                                              &t_high);
+                    _XYTH_filter_minutia_score(
+                        context, score, group_index,
+                        _XYTH_RESIDUAL(x_low, y_low, t_low),
+                        _XYTH_RESIDUAL(x_high, y_high, t_high));
+                }
+            }
         }
     }
 }
@@ -207,49 +557,155 @@ static void _XYTH_update_minutia_score(struct XYTH_context *context,
 //
 // Finds minutiae that are compatible with 'neighbor', then updates the score
 // structure accordingly.
+// - Groups are laid out with the angle varying fastest, so each (x, y) cell of
+//   the window is one or two runs of consecutive groups, which are scanned
+//   through the occupancy bitmap. An x slab of the window is skipped if the
+//   summary bitmap shows it is empty.
+// - If the tolerances were applied when the templates were added, the
+//   neighbor's own group is the whole window. 'groups' holds it if it was
+//   already worked out, NULL otherwise.
+// - Prepared options hold the angle part of the window of every relative
+//   angle.
 //
-static void _XYTH_find_matching_minutiae(struct XYTH_context *context,
-                                         struct _XYTH_neighbor *neighbor,
-                                         struct _XYTH_global_score *score)
+static void
+_XYTH_find_matching_minutiae(struct XYTH_context *context,
+                             struct _XYTH_neighbor *neighbor,
+                             const struct _XYTH_neighbor_groups *groups,
+                             struct _XYTH_global_score *score)
 {
-    int x_begin;
-    int x_end;
-    int y_begin;
-    int y_end;
-    unsigned int angle_begin;
-    unsigned int angle_end;
-    XYTH_status status;
+    struct _XYTH_group_window window;
+    const struct _XYTH_angle_window *angle = &window.angle;
+    unsigned int x_block_size = context->db.y_groups * context->db.t_groups;
+    unsigned int y_block_size = context->db.t_groups;
 
-    _XYTH_calc_compatibility_window(context, neighbor, &x_begin, &x_end,
-                                    &y_begin, &y_end, &angle_begin, &angle_end);
-
-    for (int x = x_begin; x <= x_end; x += context->db_cfg.pixels_per_group) {
-        for (int y = y_begin; y <= y_end;
-             y += context->db_cfg.pixels_per_group) {
-            for (unsigned int t = angle_begin; t <= angle_end;
-                 t += context->db_cfg.degrees_per_group) {
-                unsigned int group_index;
-                status = _XYTH_calc_group_index(context, x, y, t % 360,
-                                                &group_index);
-                if (status == XYTH_SUCCESS) {
-                    _XYTH_update_minutia_score(context, score, group_index);
-                }
+    if (context->db_cfg.index_mode == DB_INDEX_MULTIRES) {
+        _XYTH_find_matching_minutiae_multires(context, neighbor, score);
+        return;
+    }
+
+    if (context->db_cfg.index_mode == DB_INDEX_ENROLL_EXPANSION) {
+        unsigned int group_index;
+        if (groups != NULL) {
+            _XYTH_scan_occupied_groups(context, score, groups->group_index,
+                                       groups->group_index);
+        } else if (_XYTH_calc_group_index(context, neighbor->relative_x,
+                                          neighbor->relative_y,
+                                          neighbor->relative_angle,
+                                          &group_index) == XYTH_SUCCESS) {
+            _XYTH_scan_occupied_groups(context, score, group_index,
+                                       group_index);
+        }
+        return;
+    }
+
+    if (score->angle_windows != NULL) {
+        angle = &score->angle_windows[neighbor->relative_angle % 360];
+        if (angle->num_runs == 0 ||
+            !_XYTH_calc_xy_window(context, neighbor->relative_x,
+                                  neighbor->relative_y,
+                                  score->cfg->x_tolerance,
+                                  score->cfg->y_tolerance, &window)) {
+            return;
+        }
+    } else if (!_XYTH_calc_group_window(
+                   context, neighbor->relative_x, neighbor->relative_y,
+                   neighbor->relative_angle, score->cfg->x_tolerance,
+                   score->cfg->y_tolerance, score->cfg->t_tolerance,
+                   &window)) {
+        return;
+    }
+
+    for (unsigned int x = window.x.first; x <= window.x.last; x++) {
+        unsigned int x_comp = x * x_block_size;
+        unsigned int slab_first =
+            x_comp + window.y.first * y_block_size + angle->min_group;
+        unsigned int slab_last =
+            x_comp + window.y.last * y_block_size + angle->max_group;
+
+        if (!_XYTH_bitmap_range_any(context->db.occupancy_summary,
+                                    slab_first / 64, slab_last / 64)) {
+            continue;
+        }
+
+        for (unsigned int y = window.y.first; y <= window.y.last; y++) {
+            unsigned int base = x_comp + y * y_block_size;
+            for (unsigned int i = 0; i < angle->num_runs; i++) {
+                _XYTH_scan_occupied_groups(context, score,
+                                           base + angle->runs[i].first,
+                                           base + angle->runs[i].last);
             }
         }
     }
 }
 
+//
+// Adds one point to the score of 'template_index', keeping track of the best
+// and runner-up templates. Template scores never decrease, so the ranking can
+// be updated incrementally.
+//
+static void _XYTH_increment_template_score(struct _XYTH_global_score *score,
+                                           unsigned int template_index)
+{
+    unsigned int new_score = ++score->template_scores[template_index];
+
+    if (template_index == score->best_template) {
+        score->best_score = new_score;
+    } else if (new_score > score->best_score) {
+        score->runner_up_score = score->best_score;
+        score->best_score = new_score;
+        score->best_template = template_index;
+    } else if (new_score > score->runner_up_score) {
+        score->runner_up_score = new_score;
+    }
+}
+
 // Given a score structure, which contains minutiae's scores, creates a list of
 // candidates.
-static void _XYTH_calculate_templates_score(struct XYTH_context *context,
-                                            struct _XYTH_global_score *score)
+// - Each template scores at most one point per probe minutia, so a template
+//   score never exceeds the number of probe minutiae processed.
+// - Returns the number of compatible minutiae found.
+static unsigned int
+_XYTH_calculate_templates_score(struct _XYTH_global_score *score)
 {
+    unsigned int compatible_minutiae = 0;
+    unsigned int last_template_index = XYTH_RESERVED_TEMPLATE_ID;
+    uint64_t minutia_threshold =
+        (uint64_t)score->cfg->minutia_threshold * _XYTH_VOTE_ONE;
+
     for (unsigned int i = 0; i < score->num_minutiae_scores; i++) {
-        if (score->minutiae_scores[i] >= context->match_cfg.minutia_threshold) {
+        if (score->minutiae_scores[i] >= minutia_threshold) {
             unsigned int template_index = i / MAX_MINUTIAE_PER_TEMPLATE;
-            score->template_scores[template_index]++;
+            if (template_index != last_template_index) {
+                _XYTH_increment_template_score(score, template_index);
+                last_template_index = template_index;
+            }
+            if (score->matched_minutiae != NULL) {
+                score->matched_minutiae[template_index] |=
+                    (uint64_t)1 << (i % MAX_MINUTIAE_PER_TEMPLATE);
+                if (score->minutiae_scores[i] >
+                    score->best_votes[template_index]) {
+                    score->best_votes[template_index] =
+                        score->minutiae_scores[i];
+                }
+            }
+            compatible_minutiae++;
         }
     }
+
+    return compatible_minutiae;
+}
+
+//
+// Checks whether the best template can no longer be overtaken, i.e. it reached
+// the accept threshold and the runner-up would not catch up even if it scored
+// on every remaining probe minutia.
+//
+static bool _XYTH_is_match_certain(struct _XYTH_global_score *score,
+                                   unsigned int remaining_minutiae)
+{
+    return score->cfg->accept_threshold > 0 &&
+           score->best_score >= score->cfg->accept_threshold &&
+           score->best_score - score->runner_up_score > remaining_minutiae;
 }
 
 static void _XYTH_sort_matches_list(struct _XYTH_global_score *score)
@@ -272,77 +728,1144 @@ static void _XYTH_sort_matches_list(struct _XYTH_global_score *score)
     } while (swapped);
 }
 
-static void _XYTH_compile_matches_list(struct XYTH_context *context,
-                                       struct _XYTH_global_score *score)
+//
+// Keeps the MATCH_MAX_CANDIDATES best templates that reached the template
+// threshold. 'stats.num_matches' counts all of them.
+//
+static void _XYTH_compile_matches_list(struct _XYTH_global_score *score)
 {
     for (unsigned int i = 0; i < score->num_template_scores; i++) {
-        if (score->template_scores[i] >=
-            context->match_cfg.template_threshold) {
-            score->matches[score->num_matches++] = i;
+        if (score->template_scores[i] >= score->cfg->template_threshold) {
+            unsigned int lowest = 0;
+
+            score->stats.num_matches++;
+            if (score->num_matches < MATCH_MAX_CANDIDATES) {
+                score->matches[score->num_matches++] = i;
+                continue;
+            }
+            // List is full, replace its lowest score
+            for (unsigned int j = 1; j < score->num_matches; j++) {
+                if (score->template_scores[score->matches[j]] <
+                    score->template_scores[score->matches[lowest]]) {
+                    lowest = j;
+                }
+            }
+            if (score->template_scores[i] >
+                score->template_scores[score->matches[lowest]]) {
+                score->matches[lowest] = i;
+            }
         }
     }
 
     _XYTH_sort_matches_list(score);
 }
 
-static XYTH_status _XYTH_identify(struct XYTH_context *ctx,
-                                  struct XYTH_template *tpl,
-                                  unsigned int *num_matches,
-                                  unsigned int *matches)
+//
+// Re-scores the best candidates with the pairwise matcher. Those that reach
+// the re-rank threshold are kept, best pairwise score first.
+//
+static XYTH_status _XYTH_rerank_matches(struct XYTH_context *ctx,
+                                        struct XYTH_template *tpl,
+                                        struct _XYTH_global_score *score)
 {
     XYTH_status status;
-    struct _XYTH_global_score score;
+    struct _XYTH_rerank *rerank;
+    unsigned int num_reranked = score->num_matches;
+    unsigned int num_kept = 0;
 
-    status = _XYTH_create_score(ctx, &score);
+    if (num_reranked > score->cfg->rerank_candidates) {
+        num_reranked = score->cfg->rerank_candidates;
+    }
 
+    status = _XYTH_create_rerank(tpl, &rerank);
     if (status == XYTH_SUCCESS) {
-        for (unsigned int min_index = 0; min_index < tpl->num_minutiae;
-             min_index++) {
-            for (unsigned int nei_index = 0;
-                 nei_index < tpl->minutiae[min_index].num_neighbors;
-                 nei_index++) {
-                _XYTH_find_matching_minutiae(
-                    ctx, &tpl->minutiae[min_index].neighbors[nei_index],
-                    &score);
+        for (unsigned int i = 0; i < num_reranked; i++) {
+            unsigned int slot = score->matches[i];
+            unsigned int tpl_id = _XYTH_calc_template_id(score, slot);
+            unsigned int pairwise_score = 0;
+            unsigned int position;
+
+            if (tpl_id < ctx->db.num_records) {
+                pairwise_score =
+                    _XYTH_rerank_score(rerank, &ctx->db.records[tpl_id]);
+            }
+            if (pairwise_score < score->cfg->rerank_threshold) {
+                continue;
             }
-            _XYTH_calculate_templates_score(ctx, &score);
-            _XYTH_reset_minutiae_scores(&score);
-        }
-        _XYTH_compile_matches_list(ctx, &score);
 
-        if (score.num_matches < *num_matches) {
-            *num_matches = score.num_matches;
+            // Insert it sorted. Ties keep the template score order.
+            for (position = num_kept;
+                 position > 0 &&
+                 score->pairwise_scores[position - 1] < pairwise_score;
+                 position--) {
+                score->matches[position] = score->matches[position - 1];
+                score->pairwise_scores[position] =
+                    score->pairwise_scores[position - 1];
+            }
+            score->matches[position] = slot;
+            score->pairwise_scores[position] = pairwise_score;
+            num_kept++;
         }
-        memcpy(matches, score.matches, *num_matches * sizeof(matches[0]));
-        _XYTH_destroy_score(&score);
+        score->num_matches = num_kept;
+        score->stats.candidates_reranked = num_reranked;
+        _XYTH_destroy_rerank(rerank);
     }
 
     PRINT_IF_ERROR(status);
     return status;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-////////////////////////////////  P U B L I C  /////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////
+//
+// Copies the matches in 'score' to the caller's candidate list.
+// - Evidence is left zeroed if it was not collected.
+//
+static void _XYTH_fill_candidates(struct _XYTH_global_score *score,
+                                  unsigned int *num_candidates,
+                                  struct XYTH_candidate *candidates)
+{
+    if (score->num_matches < *num_candidates) {
+        *num_candidates = score->num_matches;
+    }
 
-XYTH_status XYTH_identify(struct XYTH_context *ctx, struct XYTH_template *tpl,
-                          unsigned int *num_ids, unsigned int *ids)
+    memset(candidates, 0, *num_candidates * sizeof(candidates[0]));
+    for (unsigned int i = 0; i < *num_candidates; i++) {
+        unsigned int slot = score->matches[i];
+
+        candidates[i].tpl_id = _XYTH_calc_template_id(score, slot);
+        candidates[i].template_score = score->template_scores[slot];
+        candidates[i].pairwise_score = score->pairwise_scores[i];
+        if (score->matched_minutiae != NULL) {
+            uint64_t mask = score->matched_minutiae[slot];
+            for (; mask != 0; mask &= mask - 1) {
+                candidates[i].matched_minutiae++;
+            }
+            candidates[i].best_minutia_votes =
+                score->best_votes[slot] / _XYTH_VOTE_ONE;
+        }
+    }
+}
+
+//
+// Reports the current best templates to the progress callback. Returns false
+// if the callback stopped the search.
+//
+static bool _XYTH_report_progress(struct _XYTH_global_score *score)
 {
-    XYTH_status status;
+    struct XYTH_candidate candidates[MATCH_MAX_CANDIDATES];
+    unsigned int num_candidates = MATCH_MAX_CANDIDATES;
+    unsigned int num_matches = score->stats.num_matches;
 
-    if (ctx == NULL || tpl == NULL || num_ids == NULL || ids == NULL) {
-        PRINT_IF_NULL(ctx);
-        PRINT_IF_NULL(tpl);
-        PRINT_IF_NULL(num_ids);
-        PRINT_IF_NULL(ids);
-        status = XYTH_E_INVALID_PARAMETER;
-        PRINT_IF_ERROR(status);
-        return status;
+    // The list is compiled again when the search ends
+    score->num_matches = 0;
+    _XYTH_compile_matches_list(score);
+    _XYTH_fill_candidates(score, &num_candidates, candidates);
+    score->num_matches = 0;
+    score->stats.num_matches = num_matches;
+
+    return score->progress->callback(score->progress->user_data,
+                                     score->stats.minutiae_processed,
+                                     num_candidates, candidates);
+}
+
+//
+// Checks whether the search used up its budget. The clock is read once per
+// probe minutia, which costs far less than the minutia's windows.
+//
+static bool _XYTH_is_budget_exhausted(struct _XYTH_global_score *score)
+{
+    const struct _XYTH_budget *budget = score->budget;
+
+    return (budget->max_postings > 0 &&
+            score->stats.postings_scanned >= budget->max_postings) ||
+           (budget->deadline_usec > 0 &&
+            _XYTH_monotonic_usec() >= budget->deadline_usec);
+}
+
+//
+// Scores 'tpl' against the templates, leaving their scores in 'score'.
+// - A bounded search processes the most selective minutiae first, so a
+//   truncated search still holds the most telling votes.
+//
+static XYTH_status _XYTH_score_probe(struct XYTH_context *ctx,
+                                     struct XYTH_template *tpl,
+                                     struct _XYTH_global_score *score)
+{
+    XYTH_status status = XYTH_SUCCESS;
+    unsigned int consecutive_failures = 0;
+    struct _XYTH_plan plan = {NULL, tpl->num_minutiae, 0, 0};
+    XYTH_probe_order order = score->cfg->probe_order;
+
+    score->stats.stop_reason = XYTH_STOP_COMPLETED;
+
+    if (score->budget != NULL && order == XYTH_PROBE_ORDER_TEMPLATE) {
+        order = XYTH_PROBE_ORDER_SELECTIVE;
     }
 
-    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
-        if (_XYTH_IS_TEMPLATE_INITIALIZED(*tpl)) {
-            status = _XYTH_identify(ctx, tpl, num_ids, ids);
+    if (order != XYTH_PROBE_ORDER_TEMPLATE ||
+        score->cfg->probe_drop_percent > 0) {
+        status = _XYTH_create_plan(ctx, score->cfg, tpl, order, &plan);
+        if (status != XYTH_SUCCESS) {
+            PRINT_IF_ERROR(status);
+            return status;
+        }
+        score->stats.estimated_postings = plan.estimated_postings;
+        score->stats.minutiae_dropped = plan.num_dropped;
+    }
+
+    for (unsigned int i = 0; i < plan.num_planned; i++) {
+        unsigned int min_index = plan.order != NULL ? plan.order[i] : i;
+        unsigned int num_neighbors = tpl->minutiae[min_index].num_neighbors;
+        const struct _XYTH_neighbor_groups *groups = NULL;
+        bool windows_left = false;
+
+        if (score->probe_groups != NULL) {
+            groups = &score->probe_groups
+                          ->neighbors[score->probe_groups
+                                          ->first_neighbor[min_index]];
+        }
+        for (unsigned int nei_index = 0; nei_index < num_neighbors;
+             nei_index++) {
+            _XYTH_find_matching_minutiae(
+                ctx, &tpl->minutiae[min_index].neighbors[nei_index],
+                groups != NULL ? &groups[nei_index] : NULL, score);
+            // The postings budget is also checked between windows, as a
+            // single minutia may read many postings
+            if (score->budget != NULL && score->budget->max_postings > 0 &&
+                score->stats.postings_scanned >= score->budget->max_postings) {
+                windows_left = nei_index + 1 < num_neighbors;
+                break;
+            }
+            if (_XYTH_is_cancelled(score->cancel)) {
+                break;
+            }
+        }
+        // A cancelled search returns no candidates, so the minutia is not
+        // worth scoring
+        if (_XYTH_is_cancelled(score->cancel)) {
+            PDEBUG("cancelled after %u minutiae\n", i);
+            status = XYTH_E_CANCELLED;
+            break;
+        }
+        if (_XYTH_calculate_templates_score(score) > 0) {
+            consecutive_failures = 0;
+        } else {
+            consecutive_failures++;
+        }
+        _XYTH_reset_minutiae_scores(score);
+        score->stats.minutiae_processed++;
+
+        if (score->cfg->failure_threshold > 0 &&
+            consecutive_failures >= score->cfg->failure_threshold) {
+            PDEBUG("aborted after %u minutiae\n", i + 1);
+            score->stats.stop_reason = XYTH_STOP_FAILURE_THRESHOLD;
+            break;
+        }
+        if (_XYTH_is_match_certain(score, plan.num_planned - i - 1)) {
+            PDEBUG("accepted after %u minutiae\n", i + 1);
+            score->stats.stop_reason = XYTH_STOP_ACCEPTED;
+            break;
+        }
+        if (score->progress != NULL && i + 1 < plan.num_planned &&
+            (i + 1) % score->progress->batch_size == 0 &&
+            !_XYTH_report_progress(score)) {
+            PDEBUG("stopped by the callback after %u minutiae\n", i + 1);
+            score->stats.stop_reason = XYTH_STOP_CALLBACK;
+            break;
+        }
+        if (score->budget != NULL &&
+            (i + 1 < plan.num_planned || windows_left) &&
+            _XYTH_is_budget_exhausted(score)) {
+            PDEBUG("truncated after %u minutiae\n", i + 1);
+            score->stats.stop_reason = XYTH_STOP_TRUNCATED;
+            break;
+        }
+    }
+    _XYTH_destroy_plan(&plan);
+
+    return status;
+}
+
+//
+// Runs an identification, leaving the sorted list of matches in 'score'.
+//
+static XYTH_status _XYTH_identify(struct XYTH_context *ctx,
+                                  struct XYTH_template *tpl,
+                                  struct _XYTH_global_score *score)
+{
+    XYTH_status status;
+
+    status = _XYTH_score_probe(ctx, tpl, score);
+    if (status == XYTH_SUCCESS) {
+        _XYTH_compile_matches_list(score);
+
+        if (score->cfg->rerank_candidates > 0) {
+            status = _XYTH_rerank_matches(ctx, tpl, score);
+        }
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Identifies 'tpl', going through the result cache, if enabled.
+// - 'candidates' must be able to hold MATCH_MAX_CANDIDATES members.
+// - Queries restricted to a 'subset' (not NULL), or to some of the partitions
+//   in 'partition_mask' (0 means all), are not cached.
+//
+static XYTH_status _XYTH_identify_candidates(
+    struct XYTH_context *ctx, struct XYTH_template *tpl, bool with_evidence,
+    const struct _XYTH_subset *subset, uint32_t partition_mask,
+    unsigned int *num_candidates, struct XYTH_candidate *candidates,
+    struct XYTH_identify_stats *stats)
+{
+    XYTH_status status;
+    struct _XYTH_global_score score;
+    struct _XYTH_query_key key;
+    uint32_t all_partitions;
+    bool use_cache;
+
+    // The index is not replaced, nor changed, under the search
+    _XYTH_share_index(ctx->index_lock);
+
+    all_partitions =
+        ~(uint32_t)0 >> (DB_MAX_PARTITIONS - ctx->db_cfg.num_partitions);
+    if ((partition_mask & all_partitions) == all_partitions) {
+        partition_mask = 0;
+    }
+    use_cache =
+        ctx->result_cache != NULL && subset == NULL && partition_mask == 0;
+
+    *num_candidates = MATCH_MAX_CANDIDATES;
+
+    if (use_cache) {
+        _XYTH_calc_query_key(&ctx->match_cfg, tpl, &key);
+        if (_XYTH_lookup_result(ctx->result_cache, &key, ctx->db.generation,
+                                with_evidence, num_candidates, candidates,
+                                stats)) {
+            _XYTH_unlock_index(ctx->index_lock);
+            return XYTH_SUCCESS;
+        }
+    }
+
+    status = _XYTH_create_score(ctx, &score, with_evidence, subset);
+    if (status == XYTH_SUCCESS) {
+        score.partition_mask = partition_mask;
+        status = _XYTH_identify(ctx, tpl, &score);
+        if (status == XYTH_SUCCESS) {
+            _XYTH_fill_candidates(&score, num_candidates, candidates);
+            *stats = score.stats;
+            if (use_cache) {
+                _XYTH_store_result(ctx->result_cache, &key, ctx->db.generation,
+                                   with_evidence, *num_candidates, candidates,
+                                   stats);
+            }
+        }
+        _XYTH_destroy_score(ctx, &score);
+    }
+
+    _XYTH_unlock_index(ctx->index_lock);
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+// Subject scores fused by _XYTH_identify_multi(), by subject slot
+struct _XYTH_fused_score {
+    unsigned int *subject_scores;
+    unsigned int *fingers_matched;
+    unsigned int *probe_best; // Best template score of the current probe
+    unsigned int best_score;
+    unsigned int runner_up_score;
+};
+
+//
+// Adds the totals of one probe's identification to 'total'.
+//
+static void _XYTH_add_stats(struct XYTH_identify_stats *total,
+                            const struct XYTH_identify_stats *stats)
+{
+    total->postings_scanned += stats->postings_scanned;
+    total->groups_visited += stats->groups_visited;
+    total->groups_skipped += stats->groups_skipped;
+    total->estimated_postings += stats->estimated_postings;
+    total->minutiae_processed += stats->minutiae_processed;
+    total->minutiae_dropped += stats->minutiae_dropped;
+}
+
+//
+// Adds the template scores of one probe to the subject scores. A subject gets
+// the best score among its templates of the probe's finger, so enrolling a
+// finger twice does not count it twice.
+//
+static void _XYTH_fuse_probe_scores(struct XYTH_context *ctx,
+                                    struct _XYTH_global_score *score,
+                                    const struct _XYTH_subjects *subjects,
+                                    unsigned int finger,
+                                    struct _XYTH_fused_score *fused)
+{
+    for (unsigned int tpl_id = 0; tpl_id < score->num_template_scores;
+         tpl_id++) {
+        unsigned int template_score = score->template_scores[tpl_id];
+        unsigned int slot = subjects->template_slots[tpl_id];
+        unsigned int tpl_finger;
+
+        if (template_score == 0 || slot == XYTH_RESERVED_SUBJECT_ID) {
+            continue;
+        }
+        tpl_finger = ctx->db.records[tpl_id].finger;
+        if (finger != XYTH_FINGER_UNKNOWN &&
+            tpl_finger != XYTH_FINGER_UNKNOWN && tpl_finger != finger) {
+            continue;
+        }
+        if (template_score > fused->probe_best[slot]) {
+            fused->probe_best[slot] = template_score;
+        }
+    }
+
+    fused->best_score = 0;
+    fused->runner_up_score = 0;
+    for (unsigned int slot = 0; slot < subjects->num_subjects; slot++) {
+        unsigned int subject_score;
+
+        if (fused->probe_best[slot] >= ctx->match_cfg.template_threshold &&
+            fused->probe_best[slot] > 0) {
+            fused->fingers_matched[slot]++;
+        }
+        subject_score = fused->subject_scores[slot] += fused->probe_best[slot];
+        fused->probe_best[slot] = 0;
+
+        if (subject_score > fused->best_score) {
+            fused->runner_up_score = fused->best_score;
+            fused->best_score = subject_score;
+        } else if (subject_score > fused->runner_up_score) {
+            fused->runner_up_score = subject_score;
+        }
+    }
+}
+
+//
+// Copies the subjects that reached the template threshold to the caller's
+// list, best subject score first. 'stats->num_matches' counts all of them.
+//
+static void _XYTH_fill_subject_candidates(
+    struct XYTH_context *ctx, const struct _XYTH_subjects *subjects,
+    const struct _XYTH_fused_score *fused, unsigned int *num_candidates,
+    struct XYTH_subject_candidate *candidates,
+    struct XYTH_identify_stats *stats)
+{
+    unsigned int num_kept = 0;
+
+    for (unsigned int slot = 0; slot < subjects->num_subjects; slot++) {
+        unsigned int subject_score = fused->subject_scores[slot];
+        unsigned int position;
+
+        if (subject_score == 0 ||
+            subject_score < ctx->match_cfg.template_threshold) {
+            continue;
+        }
+        stats->num_matches++;
+
+        // Insert it sorted, dropping the lowest score if the list is full
+        for (position = num_kept;
+             position > 0 &&
+             candidates[position - 1].subject_score < subject_score;
+             position--) {
+            if (position < *num_candidates) {
+                candidates[position] = candidates[position - 1];
+            }
+        }
+        if (position < *num_candidates) {
+            candidates[position].subject_id = subjects->ids[slot];
+            candidates[position].subject_score = subject_score;
+            candidates[position].fingers_matched =
+                fused->fingers_matched[slot];
+            if (num_kept < *num_candidates) {
+                num_kept++;
+            }
+        }
+    }
+
+    *num_candidates = num_kept;
+}
+
+//
+// Identifies several probe fingers of one subject at once. Each probe is
+// scored with the same score buffers, and the template scores are fused per
+// subject. The probes left are skipped once the best subject is certain, as in
+// _XYTH_is_match_certain().
+//
+static XYTH_status _XYTH_identify_multi(
+    struct XYTH_context *ctx, struct XYTH_template *probes,
+    const unsigned int *finger_positions, unsigned int num_probes,
+    unsigned int *num_candidates, struct XYTH_subject_candidate *candidates,
+    struct XYTH_identify_stats *stats)
+{
+    XYTH_status status;
+    struct _XYTH_subjects subjects;
+    struct _XYTH_global_score score;
+    struct _XYTH_fused_score fused = {NULL, NULL, NULL, 0, 0};
+    unsigned int remaining_minutiae = 0;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->stop_reason = XYTH_STOP_COMPLETED;
+    for (unsigned int i = 0; i < num_probes; i++) {
+        remaining_minutiae += probes[i].num_minutiae;
+    }
+
+    _XYTH_share_index(ctx->index_lock);
+    status = _XYTH_create_subjects(ctx, &subjects);
+    if (status != XYTH_SUCCESS) {
+        _XYTH_unlock_index(ctx->index_lock);
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    status = _XYTH_create_score(ctx, &score, false, NULL);
+    if (status == XYTH_SUCCESS) {
+        fused.subject_scores =
+            calloc(subjects.num_subjects + 1, sizeof(unsigned int));
+        fused.fingers_matched =
+            calloc(subjects.num_subjects + 1, sizeof(unsigned int));
+        fused.probe_best =
+            calloc(subjects.num_subjects + 1, sizeof(unsigned int));
+        if (fused.subject_scores == NULL || fused.fingers_matched == NULL ||
+            fused.probe_best == NULL) {
+            status = XYTH_E_NO_MEMORY;
+        }
+
+        for (unsigned int i = 0; status == XYTH_SUCCESS && i < num_probes;
+             i++) {
+            unsigned int finger = finger_positions != NULL
+                                      ? finger_positions[i]
+                                      : XYTH_FINGER_UNKNOWN;
+
+            _XYTH_reset_template_scores(&score);
+            status = _XYTH_score_probe(ctx, &probes[i], &score);
+            if (status != XYTH_SUCCESS) {
+                break;
+            }
+            _XYTH_add_stats(stats, &score.stats);
+            _XYTH_fuse_probe_scores(ctx, &score, &subjects, finger, &fused);
+
+            remaining_minutiae -= probes[i].num_minutiae;
+            if (ctx->match_cfg.accept_threshold > 0 &&
+                fused.best_score >= ctx->match_cfg.accept_threshold &&
+                fused.best_score - fused.runner_up_score >
+                    remaining_minutiae) {
+                PDEBUG("accepted after %u probes\n", i + 1);
+                stats->stop_reason = XYTH_STOP_ACCEPTED;
+                break;
+            }
+        }
+
+        if (status == XYTH_SUCCESS) {
+            _XYTH_fill_subject_candidates(ctx, &subjects, &fused,
+                                          num_candidates, candidates, stats);
+        }
+
+        free(fused.subject_scores);
+        free(fused.fingers_matched);
+        free(fused.probe_best);
+        _XYTH_destroy_score(ctx, &score);
+    }
+    _XYTH_destroy_subjects(&subjects);
+    _XYTH_unlock_index(ctx->index_lock);
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Identifies 'tpl' bypassing the result cache, as the search may be cut short
+// by the 'progress' callback, the 'budget', or the 'cancel' token, or use its
+// own 'options' (any of them may be NULL).
+//
+XYTH_status _XYTH_identify_uncached(struct XYTH_context *ctx,
+                                    struct XYTH_template *tpl,
+                                    const struct XYTH_prepared_options *options,
+                                    const struct _XYTH_progress *progress,
+                                    const struct _XYTH_budget *budget,
+                                    const struct XYTH_cancel_token *cancel,
+                                    unsigned int *num_candidates,
+                                    struct XYTH_candidate *candidates,
+                                    struct XYTH_identify_stats *stats)
+{
+    XYTH_status status;
+    struct _XYTH_global_score score;
+
+    status = _XYTH_create_score(ctx, &score, true, NULL);
+    if (status == XYTH_SUCCESS) {
+        score.progress = progress;
+        score.budget = budget;
+        score.cancel = cancel;
+        if (options != NULL) {
+            score.cfg = &options->cfg;
+            score.angle_windows = options->angle_windows;
+        }
+        status = _XYTH_identify(ctx, tpl, &score);
+        if (status == XYTH_SUCCESS) {
+            _XYTH_fill_candidates(&score, num_candidates, candidates);
+            *stats = score.stats;
+        }
+        _XYTH_destroy_score(ctx, &score);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Looks for templates matching 'tpl' before it is added, reading the groups
+// worked out for its addition. The result cache is left alone, as the
+// addition makes it stale anyway.
+//
+static XYTH_status
+_XYTH_find_duplicates(struct XYTH_context *ctx, struct XYTH_template *tpl,
+                      const struct _XYTH_template_groups *groups,
+                      unsigned int *num_candidates,
+                      struct XYTH_candidate *candidates)
+{
+    XYTH_status status;
+    struct _XYTH_global_score score;
+
+    status = _XYTH_create_score(ctx, &score, false, NULL);
+    if (status == XYTH_SUCCESS) {
+        score.probe_groups = groups;
+        status = _XYTH_identify(ctx, tpl, &score);
+        if (status == XYTH_SUCCESS) {
+            _XYTH_fill_candidates(&score, num_candidates, candidates);
+        }
+        _XYTH_destroy_score(ctx, &score);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  P U B L I C  /////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+XYTH_status XYTH_identify(struct XYTH_context *ctx, struct XYTH_template *tpl,
+                          unsigned int *num_ids, unsigned int *ids)
+{
+    XYTH_status status;
+
+    if (ctx == NULL || tpl == NULL || num_ids == NULL || ids == NULL) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(tpl);
+        PRINT_IF_NULL(num_ids);
+        PRINT_IF_NULL(ids);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        if (_XYTH_IS_TEMPLATE_INITIALIZED(*tpl)) {
+            struct XYTH_candidate candidates[MATCH_MAX_CANDIDATES];
+            struct XYTH_identify_stats stats;
+            unsigned int num_candidates;
+
+            status = _XYTH_identify_candidates(ctx, tpl, false, NULL, 0,
+                                               &num_candidates, candidates,
+                                               &stats);
+            if (status == XYTH_SUCCESS) {
+                if (num_candidates < *num_ids) {
+                    *num_ids = num_candidates;
+                }
+                for (unsigned int i = 0; i < *num_ids; i++) {
+                    ids[i] = candidates[i].tpl_id;
+                }
+            }
+        } else {
+            PERROR("template not initialized\n");
+            status = XYTH_E_NOT_INITIALIZED;
+        }
+    } else {
+        PERROR("context not initialized\n");
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_identify_ex(struct XYTH_context *ctx,
+                             struct XYTH_template *tpl,
+                             unsigned int *num_candidates,
+                             struct XYTH_candidate *candidates,
+                             struct XYTH_identify_stats *stats)
+{
+    XYTH_status status;
+
+    if (ctx == NULL || tpl == NULL || num_candidates == NULL ||
+        candidates == NULL) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(tpl);
+        PRINT_IF_NULL(num_candidates);
+        PRINT_IF_NULL(candidates);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        if (_XYTH_IS_TEMPLATE_INITIALIZED(*tpl)) {
+            struct XYTH_candidate all_candidates[MATCH_MAX_CANDIDATES];
+            struct XYTH_identify_stats all_stats;
+            unsigned int num_all_candidates;
+
+            status = _XYTH_identify_candidates(ctx, tpl, true, NULL, 0,
+                                               &num_all_candidates,
+                                               all_candidates, &all_stats);
+            if (status == XYTH_SUCCESS) {
+                if (num_all_candidates < *num_candidates) {
+                    *num_candidates = num_all_candidates;
+                }
+                memcpy(candidates, all_candidates,
+                       *num_candidates * sizeof(candidates[0]));
+                if (stats != NULL) {
+                    *stats = all_stats;
+                }
+            }
+        } else {
+            PERROR("template not initialized\n");
+            status = XYTH_E_NOT_INITIALIZED;
+        }
+    } else {
+        PERROR("context not initialized\n");
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_identify_in_subset(struct XYTH_context *ctx,
+                                    struct XYTH_template *tpl,
+                                    unsigned int num_subset_ids,
+                                    const unsigned int *subset_ids,
+                                    unsigned int *num_candidates,
+                                    struct XYTH_candidate *candidates,
+                                    struct XYTH_identify_stats *stats)
+{
+    XYTH_status status;
+
+    if (ctx == NULL || tpl == NULL ||
+        (subset_ids == NULL && num_subset_ids > 0) || num_candidates == NULL ||
+        candidates == NULL) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(tpl);
+        PRINT_IF_NULL(subset_ids);
+        PRINT_IF_NULL(num_candidates);
+        PRINT_IF_NULL(candidates);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        if (_XYTH_IS_TEMPLATE_INITIALIZED(*tpl)) {
+            struct XYTH_candidate all_candidates[MATCH_MAX_CANDIDATES];
+            struct XYTH_identify_stats all_stats;
+            unsigned int num_all_candidates;
+            struct _XYTH_subset subset;
+
+            status = _XYTH_create_subset(ctx->db.next_template_id,
+                                         num_subset_ids, subset_ids, &subset);
+            if (status == XYTH_SUCCESS) {
+                status = _XYTH_identify_candidates(
+                    ctx, tpl, true, &subset, 0, &num_all_candidates,
+                    all_candidates, &all_stats);
+                _XYTH_destroy_subset(&subset);
+            }
+            if (status == XYTH_SUCCESS) {
+                if (num_all_candidates < *num_candidates) {
+                    *num_candidates = num_all_candidates;
+                }
+                memcpy(candidates, all_candidates,
+                       *num_candidates * sizeof(candidates[0]));
+                if (stats != NULL) {
+                    *stats = all_stats;
+                }
+            }
+        } else {
+            PERROR("template not initialized\n");
+            status = XYTH_E_NOT_INITIALIZED;
+        }
+    } else {
+        PERROR("context not initialized\n");
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_identify_in_partitions(struct XYTH_context *ctx,
+                                        struct XYTH_template *tpl,
+                                        uint32_t partition_mask,
+                                        unsigned int *num_candidates,
+                                        struct XYTH_candidate *candidates,
+                                        struct XYTH_identify_stats *stats)
+{
+    XYTH_status status;
+
+    if (ctx == NULL || tpl == NULL || partition_mask == 0 ||
+        num_candidates == NULL || candidates == NULL) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(tpl);
+        PRINT_IF_TRUE(partition_mask == 0);
+        PRINT_IF_NULL(num_candidates);
+        PRINT_IF_NULL(candidates);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        if (_XYTH_IS_TEMPLATE_INITIALIZED(*tpl)) {
+            struct XYTH_candidate all_candidates[MATCH_MAX_CANDIDATES];
+            struct XYTH_identify_stats all_stats;
+            unsigned int num_all_candidates;
+
+            status = _XYTH_identify_candidates(
+                ctx, tpl, true, NULL, partition_mask, &num_all_candidates,
+                all_candidates, &all_stats);
+            if (status == XYTH_SUCCESS) {
+                if (num_all_candidates < *num_candidates) {
+                    *num_candidates = num_all_candidates;
+                }
+                memcpy(candidates, all_candidates,
+                       *num_candidates * sizeof(candidates[0]));
+                if (stats != NULL) {
+                    *stats = all_stats;
+                }
+            }
+        } else {
+            PERROR("template not initialized\n");
+            status = XYTH_E_NOT_INITIALIZED;
+        }
+    } else {
+        PERROR("context not initialized\n");
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_identify_multi(struct XYTH_context *ctx,
+                                struct XYTH_template *probes,
+                                const unsigned int *finger_positions,
+                                unsigned int num_probes,
+                                unsigned int *num_candidates,
+                                struct XYTH_subject_candidate *candidates,
+                                struct XYTH_identify_stats *stats)
+{
+    XYTH_status status;
+    struct XYTH_identify_stats all_stats;
+
+    if (ctx == NULL || probes == NULL || num_probes == 0 ||
+        num_candidates == NULL || candidates == NULL) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(probes);
+        PRINT_IF_TRUE(num_probes == 0);
+        PRINT_IF_NULL(num_candidates);
+        PRINT_IF_NULL(candidates);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (!_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        PERROR("context not initialized\n");
+        status = XYTH_E_NOT_INITIALIZED;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    for (unsigned int i = 0; i < num_probes; i++) {
+        if (!_XYTH_IS_TEMPLATE_INITIALIZED(probes[i])) {
+            PERROR("template not initialized\n");
+            status = XYTH_E_NOT_INITIALIZED;
+            PRINT_IF_ERROR(status);
+            return status;
+        }
+        if (finger_positions != NULL &&
+            finger_positions[i] > XYTH_MAX_FINGER_POSITION) {
+            status = XYTH_E_INVALID_PARAMETER;
+            PRINT_IF_ERROR(status);
+            return status;
+        }
+    }
+
+    status = _XYTH_identify_multi(ctx, probes, finger_positions, num_probes,
+                                  num_candidates, candidates, &all_stats);
+    if (status == XYTH_SUCCESS && stats != NULL) {
+        *stats = all_stats;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_enroll_if_unique(struct XYTH_context *ctx,
+                                  struct XYTH_template *tpl,
+                                  unsigned int *tpl_id,
+                                  unsigned int *num_duplicates,
+                                  unsigned int *duplicate_ids)
+{
+    XYTH_status status;
+
+    if (ctx == NULL || tpl == NULL || tpl_id == NULL ||
+        num_duplicates == NULL || duplicate_ids == NULL) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(tpl);
+        PRINT_IF_NULL(tpl_id);
+        PRINT_IF_NULL(num_duplicates);
+        PRINT_IF_NULL(duplicate_ids);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        if (_XYTH_IS_TEMPLATE_INITIALIZED(*tpl)) {
+            struct XYTH_candidate candidates[MATCH_MAX_CANDIDATES];
+            unsigned int num_candidates = MATCH_MAX_CANDIDATES;
+            struct _XYTH_template_groups groups;
+
+            // The check and the insertion are one step for other enrollers
+            // and for identifications
+            _XYTH_lock_index(ctx->index_lock);
+            _XYTH_acquire_lock(ctx->enroll_lock);
+            status = _XYTH_calc_template_groups(ctx, tpl, &groups);
+            if (status == XYTH_SUCCESS) {
+                status = _XYTH_find_duplicates(ctx, tpl, &groups,
+                                               &num_candidates, candidates);
+                if (status == XYTH_SUCCESS && num_candidates > 0) {
+                    if (num_candidates < *num_duplicates) {
+                        *num_duplicates = num_candidates;
+                    }
+                    for (unsigned int i = 0; i < *num_duplicates; i++) {
+                        duplicate_ids[i] = candidates[i].tpl_id;
+                    }
+                    *tpl_id = XYTH_RESERVED_TEMPLATE_ID;
+                } else if (status == XYTH_SUCCESS) {
+                    *num_duplicates = 0;
+                    status = _XYTH_add_template_in_groups(ctx, tpl, 0, &groups,
+                                                          tpl_id);
+                }
+                _XYTH_free_template_groups(&groups);
+            }
+            _XYTH_release_lock(ctx->enroll_lock);
+            _XYTH_unlock_index(ctx->index_lock);
+        } else {
+            PERROR("template not initialized\n");
+            status = XYTH_E_NOT_INITIALIZED;
+        }
+    } else {
+        PERROR("context not initialized\n");
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_identify_streaming(struct XYTH_context *ctx,
+                                    struct XYTH_template *tpl,
+                                    unsigned int batch_size,
+                                    XYTH_progress_callback callback,
+                                    void *user_data,
+                                    unsigned int *num_candidates,
+                                    struct XYTH_candidate *candidates,
+                                    struct XYTH_identify_stats *stats)
+{
+    XYTH_status status;
+
+    if (ctx == NULL || tpl == NULL || batch_size == 0 || callback == NULL ||
+        num_candidates == NULL || candidates == NULL) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(tpl);
+        PRINT_IF_TRUE(batch_size == 0);
+        PRINT_IF_NULL(callback);
+        PRINT_IF_NULL(num_candidates);
+        PRINT_IF_NULL(candidates);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        if (_XYTH_IS_TEMPLATE_INITIALIZED(*tpl)) {
+            struct _XYTH_progress progress = {callback, user_data, batch_size};
+            struct XYTH_identify_stats all_stats;
+
+            _XYTH_share_index(ctx->index_lock);
+            status = _XYTH_identify_uncached(ctx, tpl, NULL, &progress, NULL,
+                                             NULL, num_candidates, candidates,
+                                             &all_stats);
+            _XYTH_unlock_index(ctx->index_lock);
+            if (status == XYTH_SUCCESS && stats != NULL) {
+                *stats = all_stats;
+            }
+        } else {
+            PERROR("template not initialized\n");
+            status = XYTH_E_NOT_INITIALIZED;
+        }
+    } else {
+        PERROR("context not initialized\n");
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_identify_bounded(struct XYTH_context *ctx,
+                                  struct XYTH_template *tpl,
+                                  unsigned long long max_postings,
+                                  unsigned int max_microseconds,
+                                  unsigned int *num_candidates,
+                                  struct XYTH_candidate *candidates,
+                                  struct XYTH_identify_stats *stats)
+{
+    XYTH_status status;
+
+    if (ctx == NULL || tpl == NULL || num_candidates == NULL ||
+        candidates == NULL) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(tpl);
+        PRINT_IF_NULL(num_candidates);
+        PRINT_IF_NULL(candidates);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        if (_XYTH_IS_TEMPLATE_INITIALIZED(*tpl)) {
+            struct _XYTH_budget budget = {max_postings, 0};
+            struct XYTH_identify_stats all_stats;
+
+            if (max_microseconds > 0) {
+                budget.deadline_usec =
+                    _XYTH_monotonic_usec() + max_microseconds;
+            }
+            _XYTH_share_index(ctx->index_lock);
+            status = _XYTH_identify_uncached(ctx, tpl, NULL, NULL, &budget,
+                                             NULL, num_candidates, candidates,
+                                             &all_stats);
+            _XYTH_unlock_index(ctx->index_lock);
+            if (status == XYTH_SUCCESS && stats != NULL) {
+                *stats = all_stats;
+            }
+        } else {
+            PERROR("template not initialized\n");
+            status = XYTH_E_NOT_INITIALIZED;
+        }
+    } else {
+        PERROR("context not initialized\n");
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status
+XYTH_identify_with_options(struct XYTH_context *ctx,
+                           const struct XYTH_prepared_options *options,
+                           struct XYTH_template *tpl,
+                           unsigned int *num_candidates,
+                           struct XYTH_candidate *candidates,
+                           struct XYTH_identify_stats *stats)
+{
+    XYTH_status status;
+
+    if (ctx == NULL || options == NULL || tpl == NULL ||
+        num_candidates == NULL || candidates == NULL) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(options);
+        PRINT_IF_NULL(tpl);
+        PRINT_IF_NULL(num_candidates);
+        PRINT_IF_NULL(candidates);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (options->ctx != ctx) {
+        PERROR("options prepared for another context\n");
+        status = XYTH_E_INVALID_PARAMETER;
+    } else if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        if (_XYTH_IS_TEMPLATE_INITIALIZED(*tpl)) {
+            struct XYTH_identify_stats all_stats;
+
+            _XYTH_share_index(ctx->index_lock);
+            if (options->config_generation != ctx->db.config_generation) {
+                // Their windows were worked out for the old groups
+                PERROR("options prepared before the context was "
+                       "reconfigured\n");
+                status = XYTH_E_INVALID_PARAMETER;
+            } else {
+                status = _XYTH_identify_uncached(
+                    ctx, tpl, options, NULL, NULL, NULL, num_candidates,
+                    candidates, &all_stats);
+            }
+            _XYTH_unlock_index(ctx->index_lock);
+            if (status == XYTH_SUCCESS && stats != NULL) {
+                *stats = all_stats;
+            }
+        } else {
+            PERROR("template not initialized\n");
+            status = XYTH_E_NOT_INITIALIZED;
+        }
+    } else {
+        PERROR("context not initialized\n");
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_identify_cancellable(struct XYTH_context *ctx,
+                                      struct XYTH_template *tpl,
+                                      const struct XYTH_cancel_token *cancel,
+                                      unsigned int *num_candidates,
+                                      struct XYTH_candidate *candidates,
+                                      struct XYTH_identify_stats *stats)
+{
+    XYTH_status status;
+
+    if (ctx == NULL || tpl == NULL || cancel == NULL ||
+        num_candidates == NULL || candidates == NULL) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(tpl);
+        PRINT_IF_NULL(cancel);
+        PRINT_IF_NULL(num_candidates);
+        PRINT_IF_NULL(candidates);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        if (_XYTH_IS_TEMPLATE_INITIALIZED(*tpl)) {
+            struct XYTH_identify_stats all_stats;
+
+            _XYTH_share_index(ctx->index_lock);
+            status = _XYTH_identify_uncached(ctx, tpl, NULL, NULL, NULL,
+                                             cancel, num_candidates,
+                                             candidates, &all_stats);
+            _XYTH_unlock_index(ctx->index_lock);
+            if (status == XYTH_SUCCESS && stats != NULL) {
+                *stats = all_stats;
+            }
         } else {
             PERROR("template not initialized\n");
             status = XYTH_E_NOT_INITIALIZED;
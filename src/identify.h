@@ -0,0 +1,42 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef IDENTIFY_H
+#define IDENTIFY_H
+
+#include <xyth.h>
+
+struct _XYTH_progress;
+struct _XYTH_budget;
+
+// Identifies 'tpl' without going through the result cache, which is not safe
+// to share between threads. 'options', 'progress', 'budget' and 'cancel' may
+// be NULL.
+XYTH_status _XYTH_identify_uncached(struct XYTH_context *ctx,
+                                    struct XYTH_template *tpl,
+                                    const struct XYTH_prepared_options *options,
+                                    const struct _XYTH_progress *progress,
+                                    const struct _XYTH_budget *budget,
+                                    const struct XYTH_cancel_token *cancel,
+                                    unsigned int *num_candidates,
+                                    struct XYTH_candidate *candidates,
+                                    struct XYTH_identify_stats *stats);
+
+#endif // IDENTIFY_H
@@ -0,0 +1,126 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// pthread_rwlock_t is POSIX
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <debug.h>
+
+#include "lock.h"
+
+struct _XYTH_lock {
+    pthread_mutex_t mutex;
+};
+
+struct _XYTH_index_lock {
+    pthread_rwlock_t rwlock;
+};
+
+XYTH_status _XYTH_create_lock(struct _XYTH_lock **lock)
+{
+    XYTH_status status;
+
+    *lock = malloc(sizeof(**lock));
+    if (*lock != NULL) {
+        if (pthread_mutex_init(&(*lock)->mutex, NULL) == 0) {
+            status = XYTH_SUCCESS;
+        } else {
+            free(*lock);
+            *lock = NULL;
+            status = XYTH_E_NO_MEMORY;
+        }
+    } else {
+        status = XYTH_E_NO_MEMORY;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+void _XYTH_destroy_lock(struct _XYTH_lock *lock)
+{
+    if (lock != NULL) {
+        pthread_mutex_destroy(&lock->mutex);
+        free(lock);
+    }
+}
+
+void _XYTH_acquire_lock(struct _XYTH_lock *lock)
+{
+    pthread_mutex_lock(&lock->mutex);
+}
+
+void _XYTH_release_lock(struct _XYTH_lock *lock)
+{
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+bool _XYTH_try_lock(struct _XYTH_lock *lock)
+{
+    return pthread_mutex_trylock(&lock->mutex) == 0;
+}
+
+XYTH_status _XYTH_create_index_lock(struct _XYTH_index_lock **lock)
+{
+    XYTH_status status;
+
+    *lock = malloc(sizeof(**lock));
+    if (*lock != NULL) {
+        if (pthread_rwlock_init(&(*lock)->rwlock, NULL) == 0) {
+            status = XYTH_SUCCESS;
+        } else {
+            free(*lock);
+            *lock = NULL;
+            status = XYTH_E_NO_MEMORY;
+        }
+    } else {
+        status = XYTH_E_NO_MEMORY;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+void _XYTH_destroy_index_lock(struct _XYTH_index_lock *lock)
+{
+    if (lock != NULL) {
+        pthread_rwlock_destroy(&lock->rwlock);
+        free(lock);
+    }
+}
+
+void _XYTH_share_index(struct _XYTH_index_lock *lock)
+{
+    pthread_rwlock_rdlock(&lock->rwlock);
+}
+
+void _XYTH_lock_index(struct _XYTH_index_lock *lock)
+{
+    pthread_rwlock_wrlock(&lock->rwlock);
+}
+
+void _XYTH_unlock_index(struct _XYTH_index_lock *lock)
+{
+    pthread_rwlock_unlock(&lock->rwlock);
+}
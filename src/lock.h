@@ -0,0 +1,58 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef LOCK_H
+#define LOCK_H
+
+#include <stdbool.h>
+
+#include <xyth.h>
+
+// Serializes the operations that change a context's templates
+struct _XYTH_lock;
+
+XYTH_status _XYTH_create_lock(struct _XYTH_lock **lock);
+
+void _XYTH_destroy_lock(struct _XYTH_lock *lock);
+
+void _XYTH_acquire_lock(struct _XYTH_lock *lock);
+
+void _XYTH_release_lock(struct _XYTH_lock *lock);
+
+// Takes the lock only if it is free. Returns whether it was taken
+bool _XYTH_try_lock(struct _XYTH_lock *lock);
+
+// Lets identifications read a context's index together, while changing or
+// replacing it takes the index alone
+struct _XYTH_index_lock;
+
+XYTH_status _XYTH_create_index_lock(struct _XYTH_index_lock **lock);
+
+void _XYTH_destroy_index_lock(struct _XYTH_index_lock *lock);
+
+// Taken by identifications
+void _XYTH_share_index(struct _XYTH_index_lock *lock);
+
+// Taken to change or replace the index
+void _XYTH_lock_index(struct _XYTH_index_lock *lock);
+
+void _XYTH_unlock_index(struct _XYTH_index_lock *lock);
+
+#endif // LOCK_H
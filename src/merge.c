@@ -0,0 +1,585 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Merging and splitting contexts. Both walk the groups holding postings once,
+// copying the live postings of each group (in the head and in every sealed
+// segment) sequentially, partition by partition, so the cost is linear in the
+// postings. Templates are not added again: neither their neighbors nor their
+// groups are computed.
+//
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <context.h>
+#include <debug.h>
+#include <xyth.h>
+
+#include "add_remove.h"
+#include "common.h"
+#include "config.h"
+#include "lock.h"
+#include "region.h"
+#include "segment.h"
+
+// Postings of one group, made for a merge or a split
+struct _XYTH_group_arrays {
+    unsigned int group_index;
+    unsigned int *postings;
+    uint32_t *residuals; // NULL unless DB_INDEX_MULTIRES
+    uint8_t *partitions; // NULL if the context has a single partition
+    unsigned int length;
+    struct _XYTH_regions *regions; // Of the context installing them, NULL if
+                                   // none does
+};
+
+static void _XYTH_free_group_arrays(struct _XYTH_group_arrays *arrays)
+{
+    size_t count = (size_t)arrays->length + 1;
+
+    _XYTH_free_postings(arrays->regions, arrays->postings,
+                        count * sizeof(unsigned int));
+    _XYTH_free_postings(arrays->regions, arrays->residuals,
+                        count * sizeof(uint32_t));
+    _XYTH_free_postings(arrays->regions, arrays->partitions, count);
+}
+
+static XYTH_status _XYTH_alloc_group_arrays(const struct XYTH_context *ctx,
+                                            struct _XYTH_regions *regions,
+                                            unsigned int group_index,
+                                            unsigned int length,
+                                            struct _XYTH_group_arrays *arrays)
+{
+    bool with_residuals = ctx->db_cfg.index_mode == DB_INDEX_MULTIRES;
+    bool with_partitions = ctx->db_cfg.num_partitions > 1;
+    size_t count = (size_t)length + 1;
+
+    // One extra member, as malloc(0) may return NULL
+    arrays->group_index = group_index;
+    arrays->length = length;
+    arrays->regions = regions;
+    arrays->postings =
+        _XYTH_alloc_postings(regions, count * sizeof(unsigned int));
+    arrays->residuals =
+        with_residuals ? _XYTH_alloc_postings(regions, count * sizeof(uint32_t))
+                       : NULL;
+    arrays->partitions =
+        with_partitions ? _XYTH_alloc_postings(regions, count) : NULL;
+    if (arrays->postings == NULL ||
+        (with_residuals && arrays->residuals == NULL) ||
+        (with_partitions && arrays->partitions == NULL)) {
+        _XYTH_free_group_arrays(arrays);
+        return XYTH_E_NO_MEMORY;
+    }
+
+    return XYTH_SUCCESS;
+}
+
+static void _XYTH_arrays_run(const struct _XYTH_group_arrays *arrays,
+                             struct _XYTH_posting_run *run)
+{
+    run->postings = arrays->postings;
+    run->residuals = arrays->residuals;
+    run->partitions = arrays->partitions;
+    run->length = arrays->length;
+    run->segment = NULL;
+}
+
+//
+// Copies the live postings of a group of 'ctx', sorted by partition.
+//
+static XYTH_status _XYTH_collect_group(const struct XYTH_context *ctx,
+                                       unsigned int group_index,
+                                       struct _XYTH_group_arrays *arrays)
+{
+    XYTH_status status;
+    struct _XYTH_posting_run runs[SEGMENT_MAX_SEALED + 1];
+    unsigned int num_runs;
+
+    num_runs = _XYTH_gather_runs(&ctx->db, group_index, true, 0,
+                                 ctx->db.num_segments, runs);
+    status = _XYTH_alloc_group_arrays(
+        ctx, NULL, group_index, _XYTH_count_live_postings(runs, num_runs),
+        arrays);
+    if (status == XYTH_SUCCESS) {
+        _XYTH_copy_live_postings(runs, num_runs, ctx->db_cfg.num_partitions,
+                                 arrays->postings, arrays->residuals,
+                                 arrays->partitions);
+    }
+
+    return status;
+}
+
+//
+// Makes 'arrays' the head postings of its group, which then owns them. Room
+// was made for the group in the list of the head's groups.
+//
+static void _XYTH_install_group(struct XYTH_context *ctx,
+                                struct _XYTH_group_arrays *arrays)
+{
+    struct _XYTH_database *db = &ctx->db;
+    unsigned int group_index = arrays->group_index;
+
+    if (db->alloc_counter[group_index] > 0) {
+        _XYTH_free_group_positions(ctx, group_index);
+    } else {
+        _XYTH_add_head_group(db, group_index);
+    }
+
+    db->data[group_index] = arrays->postings;
+    if (db->residuals != NULL) {
+        db->residuals[group_index] = arrays->residuals;
+    }
+    if (db->partitions != NULL) {
+        db->partitions[group_index] = arrays->partitions;
+    }
+    db->alloc_counter[group_index] = arrays->length + 1;
+    db->group_length[group_index] = arrays->length;
+    _XYTH_mark_group_occupied(ctx, group_index);
+}
+
+static XYTH_status
+_XYTH_copy_template_record(const struct _XYTH_template_record *from,
+                           struct _XYTH_template_record *to)
+{
+    *to = *from;
+    to->minutiae = malloc(from->num_minutiae * sizeof(*to->minutiae));
+    if (to->minutiae == NULL) {
+        return XYTH_E_NO_MEMORY;
+    }
+
+    memcpy(to->minutiae, from->minutiae,
+           from->num_minutiae * sizeof(*to->minutiae));
+    return XYTH_SUCCESS;
+}
+
+static unsigned int _XYTH_count_occupied_groups(const struct XYTH_context *ctx)
+{
+    unsigned int num_words = (ctx->db.num_groups + 63) / 64;
+    unsigned int count = 0;
+
+    for (unsigned int word = 0; word < num_words; word++) {
+        count += __builtin_popcountll(ctx->db.occupancy[word]);
+    }
+
+    return count;
+}
+
+//
+// Checks whether postings of 'a' mean the same in 'b'.
+//
+static bool _XYTH_is_same_index(const struct XYTH_database_config *a,
+                                const struct XYTH_database_config *b)
+{
+    return a->max_x == b->max_x && a->max_y == b->max_y &&
+           a->pixels_per_group == b->pixels_per_group &&
+           a->degrees_per_group == b->degrees_per_group &&
+           a->index_mode == b->index_mode &&
+           a->x_tolerance == b->x_tolerance &&
+           a->y_tolerance == b->y_tolerance &&
+           a->t_tolerance == b->t_tolerance &&
+           a->num_partitions == b->num_partitions;
+}
+
+//
+// Merges every group of 'src' into 'dst', its template ids shifted by
+// 'id_offset'. Everything is made before 'dst' changes, so a failure leaves it
+// as it was.
+//
+static XYTH_status _XYTH_merge_contexts(struct XYTH_context *dst,
+                                        const struct XYTH_context *src,
+                                        unsigned int id_offset)
+{
+    XYTH_status status;
+    const struct _XYTH_database *from = &src->db;
+    struct _XYTH_database *to = &dst->db;
+    unsigned int shift = id_offset * MAX_MINUTIAE_PER_TEMPLATE;
+    unsigned int num_words = (from->num_groups + 63) / 64;
+    unsigned int num_merged = 0;
+    struct _XYTH_group_arrays *merged;
+    struct _XYTH_xyt **minutiae;
+
+    merged = malloc((_XYTH_count_occupied_groups(src) + 1) * sizeof(*merged));
+    minutiae = calloc(from->num_records + 1, sizeof(*minutiae));
+    status = merged != NULL && minutiae != NULL ? XYTH_SUCCESS
+                                                : XYTH_E_NO_MEMORY;
+    if (status == XYTH_SUCCESS) {
+        status = _XYTH_reserve_template_records(
+            dst, id_offset + from->next_template_id);
+    }
+
+    for (unsigned int word = 0; status == XYTH_SUCCESS && word < num_words;
+         word++) {
+        uint64_t bits = from->occupancy[word];
+
+        while (status == XYTH_SUCCESS && bits != 0) {
+            unsigned int group_index = word * 64 + __builtin_ctzll(bits);
+            struct _XYTH_posting_run runs[2];
+            struct _XYTH_group_arrays incoming;
+            unsigned int num_runs;
+
+            bits &= bits - 1;
+            status = _XYTH_collect_group(src, group_index, &incoming);
+            if (status != XYTH_SUCCESS) {
+                break;
+            }
+            if (incoming.length > 0) {
+                for (unsigned int i = 0; i < incoming.length; i++) {
+                    incoming.postings[i] += shift;
+                }
+                // The head of 'dst', then the incoming postings, one
+                // partition at a time
+                num_runs = _XYTH_gather_runs(to, group_index, true, 0, 0, runs);
+                _XYTH_arrays_run(&incoming, &runs[num_runs++]);
+                status = _XYTH_alloc_group_arrays(
+                    dst, dst->regions, group_index,
+                    to->group_length[group_index] + incoming.length,
+                    &merged[num_merged]);
+                if (status == XYTH_SUCCESS) {
+                    _XYTH_copy_live_postings(
+                        runs, num_runs, dst->db_cfg.num_partitions,
+                        merged[num_merged].postings,
+                        merged[num_merged].residuals,
+                        merged[num_merged].partitions);
+                    num_merged++;
+                }
+            }
+            _XYTH_free_group_arrays(&incoming);
+        }
+    }
+
+    for (unsigned int i = 0; status == XYTH_SUCCESS && i < from->num_records;
+         i++) {
+        const struct _XYTH_template_record *record = &from->records[i];
+
+        if (record->minutiae != NULL) {
+            minutiae[i] = malloc(record->num_minutiae * sizeof(**minutiae));
+            if (minutiae[i] != NULL) {
+                memcpy(minutiae[i], record->minutiae,
+                       record->num_minutiae * sizeof(**minutiae));
+            } else {
+                status = XYTH_E_NO_MEMORY;
+            }
+        }
+    }
+
+    if (status == XYTH_SUCCESS) {
+        status = _XYTH_reserve_head_groups(to, num_merged);
+    }
+
+    if (status == XYTH_SUCCESS) {
+        for (unsigned int i = 0; i < num_merged; i++) {
+            _XYTH_install_group(dst, &merged[i]);
+        }
+        for (unsigned int i = 0; i < from->num_records; i++) {
+            if (minutiae[i] != NULL) {
+                to->records[id_offset + i] = from->records[i];
+                to->records[id_offset + i].minutiae = minutiae[i];
+            }
+        }
+        if (to->next_template_id < id_offset + from->next_template_id) {
+            to->next_template_id = id_offset + from->next_template_id;
+        }
+        to->templates_counter += from->templates_counter;
+        to->generation++;
+    } else {
+        for (unsigned int i = 0; i < num_merged; i++) {
+            _XYTH_free_group_arrays(&merged[i]);
+        }
+        for (unsigned int i = 0; minutiae != NULL && i < from->num_records;
+             i++) {
+            free(minutiae[i]);
+        }
+    }
+
+    free(merged);
+    free(minutiae);
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Hands each live posting of 'src' to 'dst_a' or 'dst_b', as 'to_a' tells for
+// its template.
+//
+static XYTH_status _XYTH_split_groups(const struct XYTH_context *src,
+                                      const uint64_t *to_a,
+                                      struct XYTH_context *dst_a,
+                                      struct XYTH_context *dst_b)
+{
+    XYTH_status status = XYTH_SUCCESS;
+    unsigned int num_words = (src->db.num_groups + 63) / 64;
+
+    for (unsigned int word = 0; status == XYTH_SUCCESS && word < num_words;
+         word++) {
+        uint64_t bits = src->db.occupancy[word];
+
+        while (status == XYTH_SUCCESS && bits != 0) {
+            unsigned int group_index = word * 64 + __builtin_ctzll(bits);
+            struct _XYTH_group_arrays incoming, a, b;
+            unsigned int length_a = 0;
+
+            bits &= bits - 1;
+            status = _XYTH_collect_group(src, group_index, &incoming);
+            if (status != XYTH_SUCCESS) {
+                break;
+            }
+            for (unsigned int i = 0; i < incoming.length; i++) {
+                unsigned int tpl_id =
+                    incoming.postings[i] / MAX_MINUTIAE_PER_TEMPLATE;
+                length_a += (to_a[tpl_id / 64] >> (tpl_id % 64)) & 1;
+            }
+
+            status = _XYTH_alloc_group_arrays(dst_a, dst_a->regions,
+                                              group_index, length_a, &a);
+            if (status == XYTH_SUCCESS) {
+                status = _XYTH_alloc_group_arrays(dst_b, dst_b->regions,
+                                                  group_index,
+                                                  incoming.length - length_a,
+                                                  &b);
+                if (status != XYTH_SUCCESS) {
+                    _XYTH_free_group_arrays(&a);
+                }
+            }
+
+            if (status == XYTH_SUCCESS) {
+                // Order is kept, so each side stays sorted by partition
+                a.length = b.length = 0;
+                for (unsigned int i = 0; i < incoming.length; i++) {
+                    unsigned int tpl_id =
+                        incoming.postings[i] / MAX_MINUTIAE_PER_TEMPLATE;
+                    struct _XYTH_group_arrays *side =
+                        (to_a[tpl_id / 64] >> (tpl_id % 64)) & 1 ? &a : &b;
+
+                    side->postings[side->length] = incoming.postings[i];
+                    if (side->residuals != NULL) {
+                        side->residuals[side->length] = incoming.residuals[i];
+                    }
+                    if (side->partitions != NULL) {
+                        side->partitions[side->length] =
+                            incoming.partitions[i];
+                    }
+                    side->length++;
+                }
+                if (a.length > 0) {
+                    _XYTH_install_group(dst_a, &a);
+                } else {
+                    _XYTH_free_group_arrays(&a);
+                }
+                if (b.length > 0) {
+                    _XYTH_install_group(dst_b, &b);
+                } else {
+                    _XYTH_free_group_arrays(&b);
+                }
+            }
+            _XYTH_free_group_arrays(&incoming);
+        }
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Creates 'dst' with the configuration of 'src', holding the same template
+// ids.
+//
+static XYTH_status _XYTH_create_shard(const struct XYTH_context *src,
+                                      struct XYTH_context *dst)
+{
+    XYTH_status status;
+    struct XYTH_database_config db_cfg = src->db_cfg;
+
+    status = XYTH_create_context(dst, &db_cfg);
+    if (status == XYTH_SUCCESS) {
+        dst->match_cfg = src->match_cfg;
+        dst->db.seal_threshold = src->db.seal_threshold;
+        dst->db.next_template_id = src->db.next_template_id;
+        status = _XYTH_reserve_template_records(dst, src->db.num_records);
+        if (status != XYTH_SUCCESS) {
+            XYTH_destroy_context(dst);
+        }
+    }
+
+    return status;
+}
+
+static XYTH_status _XYTH_split_context(const struct XYTH_context *src,
+                                       XYTH_template_predicate predicate,
+                                       void *user_data,
+                                       struct XYTH_context *dst_a,
+                                       struct XYTH_context *dst_b)
+{
+    XYTH_status status = XYTH_SUCCESS;
+    const struct _XYTH_database *from = &src->db;
+    uint64_t *to_a;
+
+    // One bit per template id, set if it goes to 'dst_a'
+    to_a = calloc(from->num_records / 64 + 1, sizeof(uint64_t));
+    if (to_a == NULL) {
+        PRINT_IF_ERROR(XYTH_E_NO_MEMORY);
+        return XYTH_E_NO_MEMORY;
+    }
+    for (unsigned int i = 0; i < from->num_records; i++) {
+        if (from->records[i].minutiae != NULL && predicate(user_data, i)) {
+            to_a[i / 64] |= (uint64_t)1 << (i % 64);
+        }
+    }
+
+    status = _XYTH_create_shard(src, dst_a);
+    if (status == XYTH_SUCCESS) {
+        status = _XYTH_create_shard(src, dst_b);
+        if (status != XYTH_SUCCESS) {
+            XYTH_destroy_context(dst_a);
+        }
+    }
+    if (status == XYTH_SUCCESS) {
+        unsigned int num_groups = _XYTH_count_occupied_groups(src);
+
+        status = _XYTH_reserve_head_groups(&dst_a->db, num_groups);
+        if (status == XYTH_SUCCESS) {
+            status = _XYTH_reserve_head_groups(&dst_b->db, num_groups);
+        }
+    }
+    if (status == XYTH_SUCCESS) {
+        status = _XYTH_split_groups(src, to_a, dst_a, dst_b);
+    }
+
+    for (unsigned int i = 0; status == XYTH_SUCCESS && i < from->num_records;
+         i++) {
+        if (from->records[i].minutiae != NULL) {
+            struct XYTH_context *dst =
+                (to_a[i / 64] >> (i % 64)) & 1 ? dst_a : dst_b;
+
+            status = _XYTH_copy_template_record(&from->records[i],
+                                                &dst->db.records[i]);
+            if (status == XYTH_SUCCESS) {
+                dst->db.templates_counter++;
+            }
+        }
+    }
+
+    if (status != XYTH_SUCCESS && _XYTH_IS_CONTEXT_INITIALIZED(*dst_a)) {
+        XYTH_destroy_context(dst_a);
+        XYTH_destroy_context(dst_b);
+    }
+
+    free(to_a);
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  P U B L I C  /////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+XYTH_status XYTH_merge_contexts(struct XYTH_context *dst,
+                                struct XYTH_context *src,
+                                unsigned int id_offset)
+{
+    XYTH_status status;
+
+    if (dst == NULL || src == NULL || dst == src) {
+        PRINT_IF_NULL(dst);
+        PRINT_IF_NULL(src);
+        PRINT_IF_TRUE(dst == src);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (!_XYTH_IS_CONTEXT_INITIALIZED(*dst) ||
+        !_XYTH_IS_CONTEXT_INITIALIZED(*src)) {
+        status = XYTH_E_NOT_INITIALIZED;
+    } else if (dst->shared != NULL) {
+        PERROR("context is attached to a published index\n");
+        status = XYTH_E_READ_ONLY;
+    } else if (!_XYTH_is_same_index(&dst->db_cfg, &src->db_cfg)) {
+        PERROR("contexts index postings differently\n");
+        status = XYTH_E_INVALID_CONFIGURATION;
+    } else {
+        // Requests in flight finish before the postings change. The
+        // enrollment locks are taken by address, so merges in opposite
+        // directions cannot deadlock.
+        struct _XYTH_lock *first = dst->enroll_lock;
+        struct _XYTH_lock *second = src->enroll_lock;
+
+        if ((uintptr_t)second < (uintptr_t)first) {
+            first = src->enroll_lock;
+            second = dst->enroll_lock;
+        }
+
+        _XYTH_lock_index(dst->index_lock);
+        _XYTH_acquire_lock(first);
+        _XYTH_acquire_lock(second);
+        if (id_offset < dst->db.next_template_id ||
+            (uint64_t)id_offset + src->db.next_template_id >
+                UINT_MAX / MAX_MINUTIAE_PER_TEMPLATE) {
+            PERROR("merged ids overlap, or do not fit\n");
+            status = XYTH_E_VALUE_OUT_OF_RANGE;
+        } else {
+            status = _XYTH_merge_contexts(dst, src, id_offset);
+        }
+        _XYTH_release_lock(second);
+        _XYTH_release_lock(first);
+        _XYTH_unlock_index(dst->index_lock);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_split_context(struct XYTH_context *src,
+                               XYTH_template_predicate predicate,
+                               void *user_data, struct XYTH_context *dst_a,
+                               struct XYTH_context *dst_b)
+{
+    XYTH_status status;
+
+    if (src == NULL || predicate == NULL || dst_a == NULL || dst_b == NULL ||
+        dst_a == dst_b) {
+        PRINT_IF_NULL(src);
+        PRINT_IF_NULL(predicate);
+        PRINT_IF_NULL(dst_a);
+        PRINT_IF_NULL(dst_b);
+        PRINT_IF_TRUE(dst_a == dst_b);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (!_XYTH_IS_CONTEXT_INITIALIZED(*src)) {
+        status = XYTH_E_NOT_INITIALIZED;
+    } else if (_XYTH_IS_CONTEXT_INITIALIZED(*dst_a) ||
+               _XYTH_IS_CONTEXT_INITIALIZED(*dst_b)) {
+        status = XYTH_E_ALREADY_INITIALIZED;
+    } else {
+        _XYTH_acquire_lock(src->enroll_lock);
+        status = _XYTH_split_context(src, predicate, user_data, dst_a, dst_b);
+        _XYTH_release_lock(src->enroll_lock);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
@@ -0,0 +1,542 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// NUMA placement. A context's index is moved, page by page, to the memory of
+// one node, and a pool is pinned to the CPUs of that node, so identifications
+// run next to the postings they read. Memory allocated later lands on the
+// node of the thread that first touches it, so templates added, and score
+// arrays allocated, by the node's pool stay local too.
+//
+// To serve several nodes, a context is replicated: each node gets a whole copy
+// of the index in its own memory, and each identification is routed to the
+// copy of the node its thread runs on. Templates are added to and removed
+// from every copy, so they keep the same ids.
+//
+
+// syscall() is a GNU extension
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <context.h>
+#include <debug.h>
+#include <xyth.h>
+
+#include "config.h"
+#include "lock.h"
+
+// From the kernel's mempolicy.h, not every system ships numaif.h
+#define _XYTH_MPOL_MF_MOVE (1 << 1)
+
+// A copy of a context on each of a few nodes
+struct XYTH_replicas {
+    struct XYTH_context replicas[NUMA_MAX_REPLICAS];
+    unsigned int nodes[NUMA_MAX_REPLICAS];
+    unsigned int num_replicas;
+    // Held while templates are added to or removed from the copies, so they
+    // hand out ids in the same order
+    struct _XYTH_lock *lock;
+};
+
+// Pages waiting to be moved to 'node'
+struct _XYTH_page_batch {
+    void *pages[NUMA_PAGE_BATCH];
+    unsigned int num_pages;
+    int node;
+    uintptr_t page_size;
+    XYTH_status status;
+};
+
+static void _XYTH_flush_pages(struct _XYTH_page_batch *batch)
+{
+    int nodes[NUMA_PAGE_BATCH];
+    int page_status[NUMA_PAGE_BATCH];
+
+    if (batch->num_pages == 0 || batch->status != XYTH_SUCCESS) {
+        batch->num_pages = 0;
+        return;
+    }
+
+    for (unsigned int i = 0; i < batch->num_pages; i++) {
+        nodes[i] = batch->node;
+    }
+
+    if (syscall(SYS_move_pages, 0, (unsigned long)batch->num_pages,
+                batch->pages, nodes, page_status, _XYTH_MPOL_MF_MOVE) < 0) {
+        PERROR("move_pages failed, errno %d\n", errno);
+        batch->status = errno == ENOSYS || errno == EPERM
+                            ? XYTH_E_NOT_IMPLEMENTED
+                            : errno == ENODEV ? XYTH_E_VALUE_OUT_OF_RANGE
+                                              : XYTH_ERROR;
+    }
+    batch->num_pages = 0;
+}
+
+//
+// Queues the pages holding [addr, addr + size) to be moved. Small arrays
+// often share a page, which is then queued once.
+//
+static void _XYTH_add_pages(struct _XYTH_page_batch *batch, const void *addr,
+                            size_t size)
+{
+    uintptr_t page;
+    uintptr_t end = (uintptr_t)addr + size;
+
+    if (addr == NULL || size == 0) {
+        return;
+    }
+
+    for (page = (uintptr_t)addr & ~(batch->page_size - 1); page < end;
+         page += batch->page_size) {
+        if (batch->num_pages > 0 &&
+            batch->pages[batch->num_pages - 1] == (void *)page) {
+            continue;
+        }
+        if (batch->num_pages == NUMA_PAGE_BATCH) {
+            _XYTH_flush_pages(batch);
+        }
+        batch->pages[batch->num_pages++] = (void *)page;
+    }
+}
+
+//
+// Queues every array of the index, and the stored minutiae.
+//
+static void _XYTH_add_database_pages(struct XYTH_context *ctx,
+                                     struct _XYTH_page_batch *batch)
+{
+    struct _XYTH_database *db = &ctx->db;
+    unsigned int num_words = (db->num_groups + 63) / 64;
+
+    _XYTH_add_pages(batch, db->data, db->num_groups * sizeof(*db->data));
+    _XYTH_add_pages(batch, db->alloc_counter,
+                    db->num_groups * sizeof(*db->alloc_counter));
+    _XYTH_add_pages(batch, db->group_length,
+                    db->num_groups * sizeof(*db->group_length));
+    _XYTH_add_pages(batch, db->occupancy, num_words * sizeof(uint64_t));
+    _XYTH_add_pages(batch, db->head_groups,
+                    db->head_groups_size * sizeof(*db->head_groups));
+    _XYTH_add_pages(batch, db->occupancy_summary,
+                    (num_words + 63) / 64 * sizeof(uint64_t));
+    if (db->residuals != NULL) {
+        _XYTH_add_pages(batch, db->residuals,
+                        db->num_groups * sizeof(*db->residuals));
+    }
+    if (db->partitions != NULL) {
+        _XYTH_add_pages(batch, db->partitions,
+                        db->num_groups * sizeof(*db->partitions));
+    }
+
+    // Postings of a published index are not the context's to move
+    for (unsigned int i = 0; db->data != NULL && i < db->num_groups; i++) {
+        unsigned int alloc_counter = db->alloc_counter[i];
+
+        _XYTH_add_pages(batch, db->data[i], alloc_counter * sizeof(int));
+        if (db->residuals != NULL) {
+            _XYTH_add_pages(batch, db->residuals[i],
+                            alloc_counter * sizeof(uint32_t));
+        }
+        if (db->partitions != NULL) {
+            _XYTH_add_pages(batch, db->partitions[i], alloc_counter);
+        }
+    }
+
+    for (unsigned int i = 0; i < db->num_segments; i++) {
+        const struct _XYTH_segment *segment = &db->segments[i];
+        uint64_t num_postings = segment->num_postings;
+
+        _XYTH_add_pages(batch, segment->groups,
+                        (segment->num_held + 1) * sizeof(unsigned int));
+        _XYTH_add_pages(batch, segment->directory,
+                        ((size_t)1 << segment->directory_bits) *
+                            sizeof(unsigned int));
+        _XYTH_add_pages(batch, segment->offsets,
+                        (segment->num_held + 1) * sizeof(uint64_t));
+        _XYTH_add_pages(batch, segment->postings,
+                        num_postings * sizeof(unsigned int));
+        if (segment->residuals != NULL) {
+            _XYTH_add_pages(batch, segment->residuals,
+                            num_postings * sizeof(uint32_t));
+        }
+        if (segment->partitions != NULL) {
+            _XYTH_add_pages(batch, segment->partitions, num_postings);
+        }
+    }
+
+    _XYTH_add_pages(batch, db->records,
+                    db->num_records * sizeof(*db->records));
+    for (unsigned int i = 0; i < db->num_records; i++) {
+        _XYTH_add_pages(batch, db->records[i].minutiae,
+                        db->records[i].num_minutiae *
+                            sizeof(*db->records[i].minutiae));
+    }
+}
+
+//
+// Reads the CPUs of 'node', a list of ranges such as "0-3,8-11". Returns the
+// number of CPUs read, 0 if the node does not exist.
+//
+static unsigned int _XYTH_read_node_cpus(unsigned int node, unsigned int *cpus,
+                                         unsigned int max_cpus)
+{
+    char path[64];
+    unsigned int num_cpus = 0;
+    unsigned int first, last;
+    FILE *file;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist",
+             node);
+    file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+
+    while (fscanf(file, "%u", &first) == 1) {
+        last = first;
+        if (fscanf(file, "-%u", &last) < 0) {
+            break;
+        }
+        for (unsigned int cpu = first; cpu <= last && num_cpus < max_cpus;
+             cpu++) {
+            cpus[num_cpus++] = cpu;
+        }
+        if (fgetc(file) != ',') {
+            break;
+        }
+    }
+
+    fclose(file);
+    return num_cpus;
+}
+
+//
+// Creates a copy of 'ctx', holding its templates under the same ids, and moves
+// it to 'node'. Systems that cannot move pages leave it where it was built.
+//
+static XYTH_status _XYTH_create_replica(struct XYTH_context *ctx,
+                                        unsigned int node,
+                                        struct XYTH_context *replica)
+{
+    XYTH_status status;
+    struct XYTH_database_config db_cfg = ctx->db_cfg;
+
+    status = XYTH_create_context(replica, &db_cfg);
+    if (status == XYTH_SUCCESS) {
+        replica->match_cfg = ctx->match_cfg;
+        replica->db.seal_threshold = ctx->db.seal_threshold;
+        status = XYTH_merge_contexts(replica, ctx, 0);
+        if (status == XYTH_SUCCESS) {
+            status = XYTH_move_to_node(replica, node);
+            if (status == XYTH_E_NOT_IMPLEMENTED) {
+                status = XYTH_SUCCESS;
+            }
+        }
+        if (status != XYTH_SUCCESS) {
+            XYTH_destroy_context(replica);
+        }
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  P U B L I C  /////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+XYTH_status XYTH_move_to_node(struct XYTH_context *ctx, unsigned int node)
+{
+    XYTH_status status;
+    struct _XYTH_page_batch batch;
+
+    if (ctx == NULL) {
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (!_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        status = XYTH_E_NOT_INITIALIZED;
+    } else if (node >= NUMA_MAX_NODES) {
+        status = XYTH_E_VALUE_OUT_OF_RANGE;
+    } else {
+        _XYTH_acquire_lock(ctx->enroll_lock);
+        batch.num_pages = 0;
+        batch.node = node;
+        batch.page_size = sysconf(_SC_PAGESIZE);
+        batch.status = XYTH_SUCCESS;
+        _XYTH_add_database_pages(ctx, &batch);
+        _XYTH_flush_pages(&batch);
+        status = batch.status;
+        _XYTH_release_lock(ctx->enroll_lock);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_create_node_pool(unsigned int node, struct XYTH_pool **pool)
+{
+    XYTH_status status;
+    unsigned int cpus[POOL_MAX_THREADS];
+    unsigned int num_cpus;
+
+    if (pool == NULL) {
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_NULL(pool);
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    num_cpus = _XYTH_read_node_cpus(node, cpus, POOL_MAX_THREADS);
+    if (num_cpus > 0) {
+        status = XYTH_create_pool(num_cpus, cpus, pool);
+    } else {
+        PERROR("node %u has no CPUs\n", node);
+        status = XYTH_E_VALUE_OUT_OF_RANGE;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_create_replicas(struct XYTH_context *ctx,
+                                 unsigned int num_nodes,
+                                 const unsigned int *nodes,
+                                 struct XYTH_replicas **replicas)
+{
+    XYTH_status status = XYTH_SUCCESS;
+    struct XYTH_replicas *new_replicas;
+
+    if (ctx == NULL || nodes == NULL || replicas == NULL || num_nodes == 0) {
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(nodes);
+        PRINT_IF_NULL(replicas);
+        PRINT_IF_TRUE(num_nodes == 0);
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (!_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        PRINT_IF_ERROR(XYTH_E_NOT_INITIALIZED);
+        return XYTH_E_NOT_INITIALIZED;
+    }
+    if (num_nodes > NUMA_MAX_REPLICAS) {
+        PRINT_IF_ERROR(XYTH_E_VALUE_OUT_OF_RANGE);
+        return XYTH_E_VALUE_OUT_OF_RANGE;
+    }
+    for (unsigned int i = 0; i < num_nodes; i++) {
+        if (nodes[i] >= NUMA_MAX_NODES) {
+            status = XYTH_E_VALUE_OUT_OF_RANGE;
+        }
+        for (unsigned int j = 0; j < i; j++) {
+            if (nodes[j] == nodes[i]) {
+                PERROR("node %u given twice\n", nodes[i]);
+                status = XYTH_E_INVALID_PARAMETER;
+            }
+        }
+    }
+    if (status != XYTH_SUCCESS) {
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    new_replicas = calloc(1, sizeof(*new_replicas));
+    if (new_replicas == NULL) {
+        PRINT_IF_ERROR(XYTH_E_NO_MEMORY);
+        return XYTH_E_NO_MEMORY;
+    }
+
+    status = _XYTH_create_lock(&new_replicas->lock);
+    for (unsigned int i = 0; status == XYTH_SUCCESS && i < num_nodes; i++) {
+        status = _XYTH_create_replica(ctx, nodes[i],
+                                      &new_replicas->replicas[i]);
+        if (status == XYTH_SUCCESS) {
+            new_replicas->nodes[i] = nodes[i];
+            new_replicas->num_replicas++;
+        }
+    }
+
+    if (status == XYTH_SUCCESS) {
+        *replicas = new_replicas;
+    } else {
+        XYTH_destroy_replicas(new_replicas);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+void XYTH_destroy_replicas(struct XYTH_replicas *replicas)
+{
+    if (replicas != NULL) {
+        for (unsigned int i = 0; i < replicas->num_replicas; i++) {
+            XYTH_destroy_context(&replicas->replicas[i]);
+        }
+        _XYTH_destroy_lock(replicas->lock);
+        free(replicas);
+    }
+}
+
+XYTH_status XYTH_get_replica(struct XYTH_replicas *replicas, unsigned int node,
+                             struct XYTH_context **ctx)
+{
+    if (replicas == NULL || ctx == NULL) {
+        PRINT_IF_NULL(replicas);
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_ERROR(XYTH_E_INVALID_PARAMETER);
+        return XYTH_E_INVALID_PARAMETER;
+    }
+
+    for (unsigned int i = 0; i < replicas->num_replicas; i++) {
+        if (replicas->nodes[i] == node) {
+            *ctx = &replicas->replicas[i];
+            return XYTH_SUCCESS;
+        }
+    }
+
+    PRINT_IF_ERROR(XYTH_E_NOT_FOUND);
+    return XYTH_E_NOT_FOUND;
+}
+
+XYTH_status XYTH_get_local_replica(struct XYTH_replicas *replicas,
+                                   struct XYTH_context **ctx)
+{
+    unsigned int cpu, node;
+
+    if (replicas == NULL || ctx == NULL) {
+        PRINT_IF_NULL(replicas);
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_ERROR(XYTH_E_INVALID_PARAMETER);
+        return XYTH_E_INVALID_PARAMETER;
+    }
+
+    // Nodes holding no replica, and systems that cannot tell the node of a
+    // thread, get the first one
+    *ctx = &replicas->replicas[0];
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0) {
+        for (unsigned int i = 0; i < replicas->num_replicas; i++) {
+            if (replicas->nodes[i] == node) {
+                *ctx = &replicas->replicas[i];
+            }
+        }
+    }
+
+    return XYTH_SUCCESS;
+}
+
+XYTH_status XYTH_add_to_replicas(struct XYTH_replicas *replicas,
+                                 struct XYTH_template *tpl,
+                                 unsigned int *tpl_id)
+{
+    XYTH_status status = XYTH_SUCCESS;
+    unsigned int num_added = 0;
+    unsigned int first_id = XYTH_RESERVED_TEMPLATE_ID;
+    unsigned int id;
+
+    if (replicas == NULL || tpl == NULL || tpl_id == NULL) {
+        PRINT_IF_NULL(replicas);
+        PRINT_IF_NULL(tpl);
+        PRINT_IF_NULL(tpl_id);
+        PRINT_IF_ERROR(XYTH_E_INVALID_PARAMETER);
+        return XYTH_E_INVALID_PARAMETER;
+    }
+
+    // The replicas hand out ids in lockstep, so each gives it the same one
+    _XYTH_acquire_lock(replicas->lock);
+    while (status == XYTH_SUCCESS && num_added < replicas->num_replicas) {
+        status = XYTH_add_template(&replicas->replicas[num_added], tpl, &id);
+        if (status == XYTH_SUCCESS && num_added == 0) {
+            first_id = id;
+        } else if (status == XYTH_SUCCESS && id != first_id) {
+            PERROR("replicas are out of step\n");
+            XYTH_remove_template(&replicas->replicas[num_added], tpl, id);
+            status = XYTH_ERROR;
+        }
+        if (status == XYTH_SUCCESS) {
+            num_added++;
+        }
+    }
+
+    if (status == XYTH_SUCCESS) {
+        *tpl_id = first_id;
+    } else {
+        // The copies that took the template keep its id used up, as a sealed
+        // segment may hold it under a tombstone. The others skip it too.
+        for (unsigned int i = 0; i < num_added; i++) {
+            XYTH_status debug_status =
+                XYTH_remove_template(&replicas->replicas[i], tpl, first_id);
+            PRINT_IF_ERROR(debug_status);
+        }
+        for (unsigned int i = num_added;
+             num_added > 0 && i < replicas->num_replicas; i++) {
+            struct XYTH_context *replica = &replicas->replicas[i];
+
+            _XYTH_lock_index(replica->index_lock);
+            _XYTH_acquire_lock(replica->enroll_lock);
+            if (replica->db.next_template_id == first_id) {
+                replica->db.next_template_id++;
+            }
+            _XYTH_release_lock(replica->enroll_lock);
+            _XYTH_unlock_index(replica->index_lock);
+        }
+        *tpl_id = XYTH_RESERVED_TEMPLATE_ID;
+    }
+    _XYTH_release_lock(replicas->lock);
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_remove_from_replicas(struct XYTH_replicas *replicas,
+                                      struct XYTH_template *tpl,
+                                      unsigned int tpl_id)
+{
+    XYTH_status status = XYTH_SUCCESS;
+
+    if (replicas == NULL || tpl == NULL) {
+        PRINT_IF_NULL(replicas);
+        PRINT_IF_NULL(tpl);
+        PRINT_IF_ERROR(XYTH_E_INVALID_PARAMETER);
+        return XYTH_E_INVALID_PARAMETER;
+    }
+
+    _XYTH_acquire_lock(replicas->lock);
+    for (unsigned int i = 0; i < replicas->num_replicas; i++) {
+        XYTH_status replica_status =
+            XYTH_remove_template(&replicas->replicas[i], tpl, tpl_id);
+
+        if (status == XYTH_SUCCESS) {
+            status = replica_status;
+        }
+    }
+    _XYTH_release_lock(replicas->lock);
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
@@ -0,0 +1,195 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Per-call match options. They are checked, and the angle windows of their
+// tolerances computed, once; identifications then only read them, so any
+// number of threads may share a set of options and the context's index.
+//
+
+#include <stdlib.h>
+
+#include <context.h>
+#include <debug.h>
+#include <xyth.h>
+
+#include "common.h"
+#include "options.h"
+
+static bool _XYTH_are_options_valid(const struct XYTH_match_options *options)
+{
+    if (options->group_policy != XYTH_GROUP_POLICY_NONE &&
+        options->group_policy != XYTH_GROUP_POLICY_SKIP &&
+        options->group_policy != XYTH_GROUP_POLICY_WEIGHT) {
+        return false;
+    }
+    if (options->group_policy != XYTH_GROUP_POLICY_NONE &&
+        options->group_length_limit == 0) {
+        return false;
+    }
+    if (options->probe_order != XYTH_PROBE_ORDER_TEMPLATE &&
+        options->probe_order != XYTH_PROBE_ORDER_CHEAPEST &&
+        options->probe_order != XYTH_PROBE_ORDER_SELECTIVE) {
+        return false;
+    }
+
+    return options->probe_drop_percent < 100;
+}
+
+//
+// Computes the angle window of every relative angle, so queries only work
+// out the x and y groups of each neighbor.
+//
+static XYTH_status
+_XYTH_create_angle_windows(struct XYTH_context *ctx, unsigned int t_tol,
+                           struct _XYTH_angle_window **angle_windows)
+{
+    struct _XYTH_angle_window *windows;
+
+    windows = malloc(360 * sizeof(*windows));
+    if (windows == NULL) {
+        PRINT_IF_ERROR(XYTH_E_NO_MEMORY);
+        return XYTH_E_NO_MEMORY;
+    }
+
+    for (unsigned int t = 0; t < 360; t++) {
+        if (!_XYTH_calc_angle_window(ctx, t, t_tol, &windows[t])) {
+            windows[t].num_runs = 0;
+        }
+    }
+
+    *angle_windows = windows;
+    return XYTH_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  P U B L I C  /////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+XYTH_status XYTH_get_match_options(struct XYTH_context *ctx,
+                                   struct XYTH_match_options *options)
+{
+    XYTH_status status;
+    struct _XYTH_match_config *cfg;
+
+    if (ctx == NULL || options == NULL) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(options);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        cfg = &ctx->match_cfg;
+        options->x_tolerance = cfg->x_tolerance;
+        options->y_tolerance = cfg->y_tolerance;
+        options->t_tolerance = cfg->t_tolerance;
+        options->minutia_threshold = cfg->minutia_threshold;
+        options->template_threshold = cfg->template_threshold;
+        options->failure_threshold = cfg->failure_threshold;
+        options->accept_threshold = cfg->accept_threshold;
+        options->rerank_candidates = cfg->rerank_candidates;
+        options->rerank_threshold = cfg->rerank_threshold;
+        options->group_policy = cfg->group_policy;
+        options->group_length_limit = cfg->group_length_limit;
+        options->probe_order = cfg->probe_order;
+        options->probe_drop_percent = cfg->probe_drop_percent;
+        status = XYTH_SUCCESS;
+    } else {
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_prepare_options(struct XYTH_context *ctx,
+                                 const struct XYTH_match_options *options,
+                                 struct XYTH_prepared_options **prepared)
+{
+    XYTH_status status;
+    struct XYTH_prepared_options *new_prepared;
+
+    if (ctx == NULL || options == NULL || prepared == NULL ||
+        !_XYTH_are_options_valid(options)) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(options);
+        PRINT_IF_NULL(prepared);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (!_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        status = XYTH_E_NOT_INITIALIZED;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    new_prepared = malloc(sizeof(*new_prepared));
+    if (new_prepared == NULL) {
+        status = XYTH_E_NO_MEMORY;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    new_prepared->ctx = ctx;
+    new_prepared->config_generation = ctx->db.config_generation;
+    new_prepared->cfg = ctx->match_cfg;
+    new_prepared->cfg.x_tolerance = options->x_tolerance;
+    new_prepared->cfg.y_tolerance = options->y_tolerance;
+    new_prepared->cfg.t_tolerance = options->t_tolerance;
+    new_prepared->cfg.minutia_threshold = options->minutia_threshold;
+    new_prepared->cfg.template_threshold = options->template_threshold;
+    new_prepared->cfg.failure_threshold = options->failure_threshold;
+    new_prepared->cfg.accept_threshold = options->accept_threshold;
+    new_prepared->cfg.rerank_candidates = options->rerank_candidates;
+    new_prepared->cfg.rerank_threshold = options->rerank_threshold;
+    new_prepared->cfg.group_policy = options->group_policy;
+    new_prepared->cfg.group_length_limit = options->group_length_limit;
+    new_prepared->cfg.probe_order = options->probe_order;
+    new_prepared->cfg.probe_drop_percent = options->probe_drop_percent;
+    new_prepared->angle_windows = NULL;
+
+    if (ctx->db_cfg.index_mode == DB_INDEX_QUERY_EXPANSION) {
+        status = _XYTH_create_angle_windows(ctx, options->t_tolerance,
+                                            &new_prepared->angle_windows);
+    } else {
+        status = XYTH_SUCCESS;
+    }
+
+    if (status == XYTH_SUCCESS) {
+        *prepared = new_prepared;
+    } else {
+        free(new_prepared);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+void XYTH_destroy_prepared_options(struct XYTH_prepared_options *prepared)
+{
+    if (prepared != NULL) {
+        free(prepared->angle_windows);
+        free(prepared);
+    }
+}
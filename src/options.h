@@ -0,0 +1,39 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <context.h>
+#include <xyth.h>
+
+#include "common.h"
+
+// Match options checked, and their windows precomputed, for one context
+struct XYTH_prepared_options {
+    struct XYTH_context *ctx; // Context they were prepared for
+    unsigned int config_generation; // Of its index, when they were prepared
+    struct _XYTH_match_config cfg;
+    // Angle window of each relative angle, NULL unless the tolerances are
+    // applied by each query (DB_INDEX_QUERY_EXPANSION)
+    struct _XYTH_angle_window *angle_windows;
+};
+
+#endif // OPTIONS_H
@@ -0,0 +1,293 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// Query planner. The cost of a probe minutia is estimated as the postings its
+// neighbor windows will read, from the length kept for each group (and in
+// each sealed segment), without reading the postings themselves. Minutiae
+// are then ordered (cheapest, or most selective, first), and the most
+// expensive ones may be left out.
+//
+
+#include <stdlib.h>
+
+#include <debug.h>
+#include <xyth.h>
+
+#include "common.h"
+#include "config.h"
+#include "plan.h"
+#include "segment.h"
+
+// Cost of a probe minutia, used to order them
+struct _XYTH_minutia_cost {
+    unsigned int index;
+    unsigned int hit_windows; // Neighbor windows holding postings
+    unsigned long long postings;
+};
+
+//
+// Postings read from a group holding 'length' of them, according to the group
+// policy.
+//
+static unsigned int
+_XYTH_calc_group_cost(const struct _XYTH_match_config *cfg,
+                      unsigned int length)
+{
+    if (cfg->group_policy == XYTH_GROUP_POLICY_SKIP &&
+        length > cfg->group_length_limit) {
+        return 0;
+    }
+
+    return length;
+}
+
+//
+// Estimates the postings read for one probe neighbor, in every index mode.
+// Multi-resolution groups are counted whole, before residual filtering.
+//
+static unsigned long long
+_XYTH_estimate_neighbor_cost(struct XYTH_context *ctx,
+                             const struct _XYTH_match_config *cfg,
+                             struct _XYTH_neighbor *nei)
+{
+    unsigned long long postings = 0;
+    unsigned int x_block_size = ctx->db.y_groups * ctx->db.t_groups;
+    unsigned int y_block_size = ctx->db.t_groups;
+    struct _XYTH_group_window window;
+
+    if (ctx->db_cfg.index_mode == DB_INDEX_ENROLL_EXPANSION) {
+        unsigned int group_index;
+        if (_XYTH_calc_group_index(ctx, nei->relative_x, nei->relative_y,
+                                   nei->relative_angle,
+                                   &group_index) == XYTH_SUCCESS) {
+            postings = _XYTH_calc_group_cost(
+                cfg, _XYTH_total_group_length(&ctx->db, group_index));
+        }
+        return postings;
+    }
+
+    if (ctx->db_cfg.index_mode == DB_INDEX_MULTIRES) {
+        struct _XYTH_fine_window fine;
+        unsigned int ppg = ctx->db_cfg.pixels_per_group;
+        unsigned int dpg = ctx->db_cfg.degrees_per_group;
+
+        _XYTH_calc_fine_window(ctx, nei->relative_x, nei->relative_y,
+                               nei->relative_angle, cfg->x_tolerance,
+                               cfg->y_tolerance, cfg->t_tolerance, &fine);
+        if (fine.x_begin > fine.x_end || fine.y_begin > fine.y_end) {
+            return 0;
+        }
+
+        // Buckets are few, so they are turned into a group window
+        window.x.first = fine.x_begin / ppg;
+        window.x.last = fine.x_end / ppg;
+        window.y.first = fine.y_begin / ppg;
+        window.y.last = fine.y_end / ppg;
+        window.angle.num_runs = fine.num_angle_intervals;
+        for (unsigned int i = 0; i < fine.num_angle_intervals; i++) {
+            window.angle.runs[i].first = fine.angle_begin[i] / dpg;
+            window.angle.runs[i].last = fine.angle_end[i] / dpg;
+        }
+    } else if (!_XYTH_calc_group_window(
+                   ctx, nei->relative_x, nei->relative_y, nei->relative_angle,
+                   cfg->x_tolerance, cfg->y_tolerance, cfg->t_tolerance,
+                   &window)) {
+        return 0;
+    }
+
+    for (unsigned int x = window.x.first; x <= window.x.last; x++) {
+        for (unsigned int y = window.y.first; y <= window.y.last; y++) {
+            unsigned int base = x * x_block_size + y * y_block_size;
+            for (unsigned int i = 0; i < window.angle.num_runs; i++) {
+                for (unsigned int t = window.angle.runs[i].first;
+                     t <= window.angle.runs[i].last; t++) {
+                    postings += _XYTH_calc_group_cost(
+                        cfg, _XYTH_total_group_length(&ctx->db, base + t));
+                }
+            }
+        }
+    }
+
+    return postings;
+}
+
+//
+// Estimates the postings read for all the neighbors of 'min'.
+// - 'hit_windows' receives the number of neighbor windows holding postings.
+//
+unsigned long long
+_XYTH_estimate_minutia_cost(struct XYTH_context *ctx,
+                            const struct _XYTH_match_config *cfg,
+                            struct _XYTH_minutia *min,
+                            unsigned int *hit_windows)
+{
+    unsigned long long postings = 0;
+
+    *hit_windows = 0;
+    for (unsigned int i = 0; i < min->num_neighbors; i++) {
+        unsigned long long neighbor_postings =
+            _XYTH_estimate_neighbor_cost(ctx, cfg, &min->neighbors[i]);
+        postings += neighbor_postings;
+        *hit_windows += neighbor_postings > 0 ? 1 : 0;
+    }
+
+    return postings;
+}
+
+static int _XYTH_compare_index(const void *a, const void *b)
+{
+    const struct _XYTH_minutia_cost *cost_a = a;
+    const struct _XYTH_minutia_cost *cost_b = b;
+
+    return (int)cost_a->index - (int)cost_b->index;
+}
+
+static int _XYTH_compare_cheapest(const void *a, const void *b)
+{
+    const struct _XYTH_minutia_cost *cost_a = a;
+    const struct _XYTH_minutia_cost *cost_b = b;
+
+    if (cost_a->postings != cost_b->postings) {
+        return cost_a->postings < cost_b->postings ? -1 : 1;
+    }
+    // Keep the template order between equals
+    return _XYTH_compare_index(a, b);
+}
+
+static int _XYTH_compare_selective(const void *a, const void *b)
+{
+    const struct _XYTH_minutia_cost *cost_a = a;
+    const struct _XYTH_minutia_cost *cost_b = b;
+
+    if (cost_a->hit_windows != cost_b->hit_windows) {
+        return cost_a->hit_windows > cost_b->hit_windows ? -1 : 1;
+    }
+    return _XYTH_compare_cheapest(a, b);
+}
+
+//
+// Plans the identification of 'tpl' in the given probe order, dropping
+// minutiae according to the match configuration 'cfg'.
+//
+XYTH_status _XYTH_create_plan(struct XYTH_context *ctx,
+                              const struct _XYTH_match_config *cfg,
+                              struct XYTH_template *tpl,
+                              XYTH_probe_order order,
+                              struct _XYTH_plan *plan)
+{
+    struct _XYTH_minutia_cost *costs;
+    unsigned int num_minutiae = tpl->num_minutiae;
+
+    plan->order = malloc(num_minutiae * sizeof(*plan->order));
+    costs = malloc(num_minutiae * sizeof(*costs));
+    if (plan->order == NULL || costs == NULL) {
+        free(plan->order);
+        free(costs);
+        plan->order = NULL;
+        PRINT_IF_ERROR(XYTH_E_NO_MEMORY);
+        return XYTH_E_NO_MEMORY;
+    }
+
+    for (unsigned int i = 0; i < num_minutiae; i++) {
+        costs[i].index = i;
+        costs[i].postings = _XYTH_estimate_minutia_cost(
+            ctx, cfg, &tpl->minutiae[i], &costs[i].hit_windows);
+    }
+
+    // The most expensive minutiae are dropped first, always keeping one
+    plan->num_dropped = num_minutiae * cfg->probe_drop_percent / 100;
+    if (plan->num_dropped >= num_minutiae && num_minutiae > 0) {
+        plan->num_dropped = num_minutiae - 1;
+    }
+    plan->num_planned = num_minutiae - plan->num_dropped;
+    if (plan->num_dropped > 0) {
+        qsort(costs, num_minutiae, sizeof(*costs), _XYTH_compare_cheapest);
+    }
+
+    switch (order) {
+    case XYTH_PROBE_ORDER_CHEAPEST:
+        qsort(costs, plan->num_planned, sizeof(*costs),
+              _XYTH_compare_cheapest);
+        break;
+    case XYTH_PROBE_ORDER_SELECTIVE:
+        qsort(costs, plan->num_planned, sizeof(*costs),
+              _XYTH_compare_selective);
+        break;
+    default:
+        qsort(costs, plan->num_planned, sizeof(*costs), _XYTH_compare_index);
+        break;
+    }
+
+    plan->estimated_postings = 0;
+    for (unsigned int i = 0; i < plan->num_planned; i++) {
+        plan->order[i] = costs[i].index;
+        plan->estimated_postings += costs[i].postings;
+    }
+
+    free(costs);
+    return XYTH_SUCCESS;
+}
+
+void _XYTH_destroy_plan(struct _XYTH_plan *plan)
+{
+    free(plan->order);
+    plan->order = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  P U B L I C  /////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+XYTH_status XYTH_estimate_identify_cost(struct XYTH_context *ctx,
+                                        struct XYTH_template *tpl,
+                                        unsigned long long *postings)
+{
+    XYTH_status status;
+
+    if (ctx == NULL || tpl == NULL || postings == NULL) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_NULL(tpl);
+        PRINT_IF_NULL(postings);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        if (_XYTH_IS_TEMPLATE_INITIALIZED(*tpl)) {
+            struct _XYTH_plan plan;
+            status = _XYTH_create_plan(ctx, &ctx->match_cfg, tpl,
+                                       ctx->match_cfg.probe_order, &plan);
+            if (status == XYTH_SUCCESS) {
+                *postings = plan.estimated_postings;
+                _XYTH_destroy_plan(&plan);
+            }
+        } else {
+            PERROR("template not initialized\n");
+            status = XYTH_E_NOT_INITIALIZED;
+        }
+    } else {
+        PERROR("context not initialized\n");
+        status = XYTH_E_NOT_INITIALIZED;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
@@ -0,0 +1,49 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#ifndef PLAN_H
+#define PLAN_H
+
+#include <context.h>
+#include <template.h>
+#include <xyth.h>
+
+// Order, and subset, in which the probe minutiae are processed
+struct _XYTH_plan {
+    unsigned int *order;      // Indexes into the probe's minutiae
+    unsigned int num_planned; // Members of 'order'
+    unsigned int num_dropped; // Most expensive minutiae left out
+    unsigned long long estimated_postings; // For the planned minutiae
+};
+
+unsigned long long
+_XYTH_estimate_minutia_cost(struct XYTH_context *ctx,
+                            const struct _XYTH_match_config *cfg,
+                            struct _XYTH_minutia *min,
+                            unsigned int *hit_windows);
+
+XYTH_status _XYTH_create_plan(struct XYTH_context *ctx,
+                              const struct _XYTH_match_config *cfg,
+                              struct XYTH_template *tpl,
+                              XYTH_probe_order order,
+                              struct _XYTH_plan *plan);
+
+void _XYTH_destroy_plan(struct _XYTH_plan *plan);
+
+#endif // PLAN_H
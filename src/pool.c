@@ -0,0 +1,321 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Work-stealing thread pool. Each thread owns a deque: it takes its newest
+// task first, and, once it runs dry, steals the oldest task of another
+// thread. Tasks submitted from outside the pool are spread round-robin
+// across the deques. Idle threads sleep until a task is queued.
+//
+
+// pthread_setaffinity_np() is a GNU extension
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <debug.h>
+#include <xyth.h>
+
+#include "config.h"
+#include "pool.h"
+
+// Tasks queued on one thread
+struct _XYTH_deque {
+    pthread_mutex_t mutex;
+    struct _XYTH_task *head; // Oldest, taken by thieves
+    struct _XYTH_task *tail; // Newest, taken by the owner
+};
+
+struct XYTH_pool {
+    pthread_t *threads;
+    unsigned int num_threads; // Threads started
+    struct _XYTH_deque *deques; // One per thread
+    unsigned int num_deques;
+    unsigned int next_deque;    // Round-robin target of outside submissions
+    // Protects 'num_queued' and 'stopping'
+    pthread_mutex_t idle_mutex;
+    pthread_cond_t queued;
+    unsigned int num_queued; // Tasks in all the deques
+    bool stopping;
+};
+
+// Arguments of a pool thread
+struct _XYTH_pool_thread {
+    struct XYTH_pool *pool;
+    unsigned int index;
+};
+
+// Pool, and deque, of the calling thread (NULL outside any pool)
+static __thread struct XYTH_pool *_XYTH_current_pool;
+static __thread unsigned int _XYTH_current_deque;
+
+static void _XYTH_push_task(struct _XYTH_deque *deque,
+                            struct _XYTH_task *task)
+{
+    pthread_mutex_lock(&deque->mutex);
+    task->next = NULL;
+    task->prev = deque->tail;
+    if (deque->tail != NULL) {
+        deque->tail->next = task;
+    } else {
+        deque->head = task;
+    }
+    deque->tail = task;
+    pthread_mutex_unlock(&deque->mutex);
+}
+
+//
+// Takes the newest task ('newest' true) or the oldest one. Returns NULL if the
+// deque is empty.
+//
+static struct _XYTH_task *_XYTH_pop_task(struct _XYTH_deque *deque,
+                                         bool newest)
+{
+    struct _XYTH_task *task;
+
+    pthread_mutex_lock(&deque->mutex);
+    task = newest ? deque->tail : deque->head;
+    if (task != NULL) {
+        if (task->prev != NULL) {
+            task->prev->next = task->next;
+        } else {
+            deque->head = task->next;
+        }
+        if (task->next != NULL) {
+            task->next->prev = task->prev;
+        } else {
+            deque->tail = task->prev;
+        }
+    }
+    pthread_mutex_unlock(&deque->mutex);
+
+    return task;
+}
+
+//
+// Takes a task for thread 'index': its own newest, or another's oldest.
+//
+static struct _XYTH_task *_XYTH_find_task(struct XYTH_pool *pool,
+                                          unsigned int index)
+{
+    struct _XYTH_task *task = _XYTH_pop_task(&pool->deques[index], true);
+
+    for (unsigned int i = 1; task == NULL && i < pool->num_deques; i++) {
+        task = _XYTH_pop_task(&pool->deques[(index + i) % pool->num_deques],
+                              false);
+    }
+
+    return task;
+}
+
+static void *_XYTH_run_pool_thread(void *arg)
+{
+    struct XYTH_pool *pool = ((struct _XYTH_pool_thread *)arg)->pool;
+    unsigned int index = ((struct _XYTH_pool_thread *)arg)->index;
+
+    free(arg);
+    _XYTH_current_pool = pool;
+    _XYTH_current_deque = index;
+
+    for (;;) {
+        struct _XYTH_task *task = _XYTH_find_task(pool, index);
+
+        if (task != NULL) {
+            pthread_mutex_lock(&pool->idle_mutex);
+            pool->num_queued--;
+            pthread_mutex_unlock(&pool->idle_mutex);
+            task->run(task);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->idle_mutex);
+        while (pool->num_queued == 0 && !pool->stopping) {
+            pthread_cond_wait(&pool->queued, &pool->idle_mutex);
+        }
+        if (pool->num_queued == 0) {
+            // Stopping, and nothing left to run
+            pthread_mutex_unlock(&pool->idle_mutex);
+            break;
+        }
+        pthread_mutex_unlock(&pool->idle_mutex);
+    }
+
+    return NULL;
+}
+
+//
+// Pins thread 'index' to 'cpu'. Failing to do so is not fatal.
+//
+static void _XYTH_set_thread_affinity(struct XYTH_pool *pool,
+                                      unsigned int index, unsigned int cpu)
+{
+    cpu_set_t cpus;
+
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if (pthread_setaffinity_np(pool->threads[index], sizeof(cpus), &cpus) !=
+        0) {
+        PERROR("thread %u not pinned to cpu %u\n", index, cpu);
+    }
+}
+
+void _XYTH_submit_task(struct XYTH_pool *pool, struct _XYTH_task *task)
+{
+    unsigned int index;
+
+    if (_XYTH_current_pool == pool) {
+        index = _XYTH_current_deque;
+    } else {
+        index = __atomic_fetch_add(&pool->next_deque, 1, __ATOMIC_RELAXED) %
+                pool->num_deques;
+    }
+    _XYTH_push_task(&pool->deques[index], task);
+
+    pthread_mutex_lock(&pool->idle_mutex);
+    pool->num_queued++;
+    pthread_cond_signal(&pool->queued);
+    pthread_mutex_unlock(&pool->idle_mutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  P U B L I C  /////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+XYTH_status XYTH_create_pool(unsigned int num_threads,
+                             const unsigned int *cpus,
+                             struct XYTH_pool **pool)
+{
+    XYTH_status status = XYTH_E_NO_MEMORY;
+    struct XYTH_pool *new_pool;
+
+    if (pool == NULL || num_threads == 0) {
+        PRINT_IF_NULL(pool);
+        PRINT_IF_TRUE(num_threads == 0);
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (num_threads > POOL_MAX_THREADS) {
+        status = XYTH_E_VALUE_OUT_OF_RANGE;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    new_pool = calloc(1, sizeof(*new_pool));
+    if (new_pool == NULL) {
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    new_pool->threads = malloc(num_threads * sizeof(pthread_t));
+    new_pool->deques = calloc(num_threads, sizeof(*new_pool->deques));
+    if (new_pool->threads != NULL && new_pool->deques != NULL &&
+        pthread_mutex_init(&new_pool->idle_mutex, NULL) == 0) {
+        if (pthread_cond_init(&new_pool->queued, NULL) == 0) {
+            status = XYTH_SUCCESS;
+        } else {
+            pthread_mutex_destroy(&new_pool->idle_mutex);
+        }
+    }
+
+    for (; status == XYTH_SUCCESS && new_pool->num_deques < num_threads;
+         new_pool->num_deques++) {
+        if (pthread_mutex_init(&new_pool->deques[new_pool->num_deques].mutex,
+                               NULL) != 0) {
+            pthread_cond_destroy(&new_pool->queued);
+            pthread_mutex_destroy(&new_pool->idle_mutex);
+            status = XYTH_E_NO_MEMORY;
+            break;
+        }
+    }
+
+    if (status != XYTH_SUCCESS) {
+        for (unsigned int i = 0; i < new_pool->num_deques; i++) {
+            pthread_mutex_destroy(&new_pool->deques[i].mutex);
+        }
+        free(new_pool->deques);
+        free(new_pool->threads);
+        free(new_pool);
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    for (unsigned int i = 0; i < num_threads; i++) {
+        struct _XYTH_pool_thread *thread = malloc(sizeof(*thread));
+
+        if (thread == NULL) {
+            status = XYTH_E_NO_MEMORY;
+            break;
+        }
+        thread->pool = new_pool;
+        thread->index = i;
+        if (pthread_create(&new_pool->threads[i], NULL, _XYTH_run_pool_thread,
+                           thread) != 0) {
+            free(thread);
+            status = XYTH_E_NO_MEMORY;
+            break;
+        }
+        new_pool->num_threads++;
+        if (cpus != NULL) {
+            _XYTH_set_thread_affinity(new_pool, i, cpus[i]);
+        }
+    }
+
+    if (status == XYTH_SUCCESS) {
+        *pool = new_pool;
+    } else {
+        XYTH_destroy_pool(new_pool);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Runs the tasks still queued, then stops the threads.
+//
+void XYTH_destroy_pool(struct XYTH_pool *pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->idle_mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->queued);
+    pthread_mutex_unlock(&pool->idle_mutex);
+
+    for (unsigned int i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    for (unsigned int i = 0; i < pool->num_deques; i++) {
+        pthread_mutex_destroy(&pool->deques[i].mutex);
+    }
+    pthread_cond_destroy(&pool->queued);
+    pthread_mutex_destroy(&pool->idle_mutex);
+    free(pool->deques);
+    free(pool->threads);
+    free(pool);
+}
@@ -0,0 +1,38 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <xyth.h>
+
+// A unit of work run by a pool's threads. Tasks are embedded in the caller's
+// own structures, so submitting one does not allocate.
+struct _XYTH_task {
+    void (*run)(struct _XYTH_task *task);
+    struct _XYTH_task *prev; // Links in a worker's deque
+    struct _XYTH_task *next;
+};
+
+// Queues 'task'. Submitted from one of the pool's threads, it goes to that
+// thread's own deque, so nested work stays local until stolen.
+void _XYTH_submit_task(struct XYTH_pool *pool, struct _XYTH_task *task);
+
+#endif // POOL_H
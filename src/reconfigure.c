@@ -0,0 +1,291 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// Online re-indexing. The index is rebuilt in a staging context while
+// identifications go on reading the old one. Multi-resolution postings keep
+// the exact position of each neighbor, so they are re-bucketed as they are;
+// other indexes are rebuilt from the minutiae kept for each template. The
+// templates added or removed meanwhile are then replayed on the staging
+// context, which trades its index for the old one and releases it.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <context.h>
+#include <debug.h>
+#include <xyth.h>
+
+#include "add_remove.h"
+#include "config.h"
+#include "lock.h"
+#include "region.h"
+#include "segment.h"
+
+//
+// Adds to 'staging' the postings of a group of 'ctx', at the positions they
+// were found at. The templates removed from 'ctx' are skipped.
+//
+static XYTH_status _XYTH_rebucket_group(struct XYTH_context *ctx,
+                                        struct XYTH_context *staging,
+                                        unsigned int group_index)
+{
+    XYTH_status status = XYTH_SUCCESS;
+    struct _XYTH_posting_run runs[SEGMENT_MAX_SEALED + 1];
+    unsigned int num_runs = _XYTH_gather_runs(
+        &ctx->db, group_index, true, 0, ctx->db.num_segments, runs);
+    unsigned int ppg = ctx->db_cfg.pixels_per_group;
+    unsigned int t_group = group_index % ctx->db.t_groups;
+    unsigned int y_group = group_index / ctx->db.t_groups % ctx->db.y_groups;
+    unsigned int x_group = group_index / ctx->db.t_groups / ctx->db.y_groups;
+
+    for (unsigned int i = 0; status == XYTH_SUCCESS && i < num_runs; i++) {
+        for (unsigned int j = 0; status == XYTH_SUCCESS && j < runs[i].length;
+             j++) {
+            unsigned int posting = runs[i].postings[j];
+            uint32_t residual = runs[i].residuals[j];
+
+            // Tombstoned templates have no record either
+            if (ctx->db.records[posting / MAX_MINUTIAE_PER_TEMPLATE]
+                    .minutiae == NULL) {
+                continue;
+            }
+            status = _XYTH_add_neighbor_posting(
+                staging,
+                (int)(x_group * ppg + (residual & 0xFF)) -
+                    (int)ctx->db_cfg.max_x,
+                (int)(y_group * ppg + (residual >> 8 & 0xFF)) -
+                    (int)ctx->db_cfg.max_y,
+                t_group * ctx->db_cfg.degrees_per_group +
+                    (residual >> 16 & 0xFF),
+                posting);
+        }
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Fills 'staging' with the postings of 'ctx', records first, as they tell the
+// partition of each posting.
+//
+static XYTH_status _XYTH_rebucket_index(struct XYTH_context *ctx,
+                                        struct XYTH_context *staging)
+{
+    XYTH_status status = XYTH_SUCCESS;
+    unsigned int num_words = (ctx->db.num_groups + 63) / 64;
+
+    for (unsigned int i = 0;
+         status == XYTH_SUCCESS && i < ctx->db.num_records; i++) {
+        if (ctx->db.records[i].minutiae != NULL) {
+            status =
+                _XYTH_keep_template_record(staging, &ctx->db.records[i], i);
+            if (status == XYTH_SUCCESS) {
+                staging->db.templates_counter++;
+            }
+        }
+    }
+
+    // The occupancy of the head covers the groups of the segments too
+    for (unsigned int word = 0; status == XYTH_SUCCESS && word < num_words;
+         word++) {
+        uint64_t bits = ctx->db.occupancy[word];
+
+        while (status == XYTH_SUCCESS && bits != 0) {
+            status = _XYTH_rebucket_group(ctx, staging,
+                                          word * 64 + __builtin_ctzll(bits));
+            bits &= bits - 1;
+        }
+    }
+
+    staging->db.next_template_id = ctx->db.next_template_id;
+    if (status == XYTH_SUCCESS && staging->db.seal_threshold > 0 &&
+        staging->db.next_template_id >= staging->db.seal_threshold) {
+        // Left in the head if it fails, as when adding a template
+        XYTH_status debug_status = _XYTH_seal_head(staging);
+        PRINT_IF_ERROR(debug_status);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Creates 'staging' with 'db_cfg', holding every template of 'ctx'. The caller
+// keeps the templates of 'ctx' from changing.
+//
+static XYTH_status _XYTH_rebuild_index(struct XYTH_context *ctx,
+                                       struct XYTH_database_config *db_cfg,
+                                       struct XYTH_context *staging)
+{
+    XYTH_status status;
+
+    status = XYTH_create_context(staging, db_cfg);
+    if (status == XYTH_SUCCESS) {
+        staging->db.seal_threshold = ctx->db.seal_threshold;
+        if (ctx->db_cfg.index_mode == DB_INDEX_MULTIRES) {
+            status = _XYTH_rebucket_index(ctx, staging);
+        } else {
+            for (unsigned int i = 0;
+                 status == XYTH_SUCCESS && i < ctx->db.num_records; i++) {
+                if (ctx->db.records[i].minutiae != NULL) {
+                    status = _XYTH_add_template_record(
+                        staging, &ctx->db.records[i], i);
+                }
+            }
+        }
+        if (status != XYTH_SUCCESS) {
+            XYTH_destroy_context(staging);
+        }
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Brings 'staging' up to date with the templates of 'ctx', added or removed
+// since it was rebuilt. Their ids are never given out again, so a kept record
+// tells on each side whether an id is in use.
+//
+static XYTH_status _XYTH_replay_changes(struct XYTH_context *ctx,
+                                        struct XYTH_context *staging)
+{
+    XYTH_status status = XYTH_SUCCESS;
+    unsigned int num_records = ctx->db.num_records > staging->db.num_records
+                                   ? ctx->db.num_records
+                                   : staging->db.num_records;
+
+    for (unsigned int i = 0; status == XYTH_SUCCESS && i < num_records; i++) {
+        bool in_ctx = i < ctx->db.num_records &&
+                      ctx->db.records[i].minutiae != NULL;
+        bool in_staging = i < staging->db.num_records &&
+                          staging->db.records[i].minutiae != NULL;
+
+        if (in_ctx && !in_staging) {
+            status = _XYTH_add_template_record(staging, &ctx->db.records[i], i);
+        } else if (!in_ctx && in_staging) {
+            status = _XYTH_remove_template_record(staging, i);
+        }
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Trades the index of 'ctx' for the one of 'staging'. The index directory and
+// the slabs of the postings are traded along, as each context unmaps its own.
+//
+static void _XYTH_swap_index(struct XYTH_context *ctx,
+                             struct XYTH_context *staging)
+{
+    struct _XYTH_database db = ctx->db;
+    struct XYTH_database_config db_cfg = ctx->db_cfg;
+    struct _XYTH_region directory = ctx->regions->directory;
+    struct _XYTH_slabs slabs = ctx->regions->slabs;
+    bool huge_pages = ctx->regions->huge_pages;
+
+    ctx->db = staging->db;
+    ctx->db_cfg = staging->db_cfg;
+    ctx->regions->directory = staging->regions->directory;
+    ctx->regions->slabs = staging->regions->slabs;
+    ctx->regions->huge_pages = staging->regions->huge_pages;
+    staging->db = db;
+    staging->db_cfg = db_cfg;
+    staging->regions->directory = directory;
+    staging->regions->slabs = slabs;
+    staging->regions->huge_pages = huge_pages;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  P U B L I C  /////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+XYTH_status XYTH_reconfigure_context(struct XYTH_context *ctx,
+                                     struct XYTH_database_config *db_cfg)
+{
+    XYTH_status status;
+    struct XYTH_context staging = {0};
+    unsigned int generation;
+
+    if (ctx == NULL) {
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (!_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        status = XYTH_E_NOT_INITIALIZED;
+    } else if (ctx->shared != NULL) {
+        PERROR("context is attached to a published index\n");
+        status = XYTH_E_READ_ONLY;
+    } else {
+        // Identifications go on meanwhile. Additions and removals wait, as
+        // they take the index lock alone. Merges wait for the whole run, as
+        // they would install segments of the old index
+        _XYTH_acquire_lock(ctx->merge_lock);
+        _XYTH_share_index(ctx->index_lock);
+        generation = ctx->db.generation;
+        status = _XYTH_rebuild_index(ctx, db_cfg, &staging);
+        _XYTH_unlock_index(ctx->index_lock);
+
+        if (status == XYTH_SUCCESS) {
+            // Identifications in flight finish on the old index. The locks
+            // are taken in the order additions take them
+            _XYTH_lock_index(ctx->index_lock);
+            _XYTH_acquire_lock(ctx->enroll_lock);
+            if (ctx->db.generation != generation) {
+                // Templates were added or removed in between
+                status = _XYTH_replay_changes(ctx, &staging);
+            }
+            if (status == XYTH_SUCCESS) {
+                // Subjects are set without either lock, so they are taken
+                // last. Removed ids are not given out again, and cached
+                // results and prepared options of the old index are stale
+                for (unsigned int i = 0; i < ctx->db.num_records; i++) {
+                    if (ctx->db.records[i].minutiae != NULL) {
+                        staging.db.records[i].subject =
+                            ctx->db.records[i].subject;
+                        staging.db.records[i].finger =
+                            ctx->db.records[i].finger;
+                    }
+                }
+                staging.db.next_template_id = ctx->db.next_template_id;
+                staging.db.generation = ctx->db.generation + 1;
+                staging.db.config_generation = ctx->db.config_generation + 1;
+                _XYTH_swap_index(ctx, &staging);
+            }
+            _XYTH_release_lock(ctx->enroll_lock);
+            _XYTH_unlock_index(ctx->index_lock);
+        }
+        _XYTH_release_lock(ctx->merge_lock);
+
+        // It holds the old index now
+        if (_XYTH_IS_CONTEXT_INITIALIZED(staging)) {
+            XYTH_destroy_context(&staging);
+        }
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
@@ -0,0 +1,463 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Large regions, mapped on their own and aligned to huge pages. Reserved huge
+// pages (MAP_HUGETLB) are tried first; when none are free, the region falls
+// back to normal pages the kernel may merge into transparent huge pages
+// (MADV_HUGEPAGE). Random reads over gigabytes of postings then miss the TLB
+// far less often.
+//
+// The posting arrays of the groups are many and small, and grow one step at a
+// time, so they are carved from slabs of one huge page each. A chunk holds a
+// power of two bytes; freed chunks are kept, per size, for the next array of
+// that size. Arrays larger than a slab are mapped on their own.
+//
+
+// MAP_ANONYMOUS, MAP_HUGETLB and MADV_HUGEPAGE are not POSIX
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <debug.h>
+#include <xyth.h>
+
+#include "config.h"
+#include "lock.h"
+#include "region.h"
+
+static size_t _XYTH_round_up(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+//
+// Maps 'size' bytes starting at a huge page boundary, so every huge page of
+// the region can be backed by a transparent one.
+//
+static void *_XYTH_map_aligned(size_t size)
+{
+    uintptr_t addr, aligned;
+    size_t extra = REGION_HUGE_PAGE_SIZE;
+    void *mapped = mmap(NULL, size + extra, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (mapped == MAP_FAILED) {
+        return NULL;
+    }
+
+    addr = (uintptr_t)mapped;
+    aligned = _XYTH_round_up(addr, REGION_HUGE_PAGE_SIZE);
+    if (aligned > addr) {
+        munmap(mapped, aligned - addr);
+    }
+    if (aligned + size < addr + size + extra) {
+        munmap((void *)(aligned + size), addr + extra - aligned);
+    }
+
+#ifdef MADV_HUGEPAGE
+    // Fails if transparent huge pages are disabled, normal pages do then
+    madvise((void *)aligned, size, MADV_HUGEPAGE);
+#endif
+
+    return (void *)aligned;
+}
+
+//
+// Bytes mapped for a region asked 'size' bytes.
+//
+static size_t _XYTH_region_size(const struct _XYTH_regions *regions,
+                                size_t size)
+{
+    // One extra byte, as mmap() refuses empty regions
+    return _XYTH_round_up(size + 1, regions->huge_pages
+                                        ? REGION_HUGE_PAGE_SIZE
+                                        : (size_t)sysconf(_SC_PAGESIZE));
+}
+
+//
+// Size class of the chunks holding 'size' bytes.
+//
+static unsigned int _XYTH_chunk_class(size_t size)
+{
+    unsigned int chunk_class = 0;
+
+    while (((size_t)1 << (REGION_MIN_CHUNK_SHIFT + chunk_class)) < size) {
+        chunk_class++;
+    }
+
+    return chunk_class;
+}
+
+static XYTH_status _XYTH_add_map(struct _XYTH_slabs *slabs, size_t size,
+                                 struct _XYTH_regions *regions)
+{
+    XYTH_status status;
+
+    if (slabs->num_maps == slabs->alloc_maps) {
+        unsigned int alloc_maps = slabs->alloc_maps * 2 + 16;
+        struct _XYTH_region *maps =
+            realloc(slabs->maps, alloc_maps * sizeof(*maps));
+
+        if (maps == NULL) {
+            return XYTH_E_NO_MEMORY;
+        }
+        slabs->maps = maps;
+        slabs->alloc_maps = alloc_maps;
+    }
+
+    status = _XYTH_map_region(regions, size, &slabs->maps[slabs->num_maps]);
+    if (status == XYTH_SUCCESS) {
+        slabs->num_maps++;
+    }
+
+    return status;
+}
+
+//
+// Pushes a chunk of 'chunk_class' to its free list.
+//
+static void _XYTH_push_chunk(struct _XYTH_slabs *slabs,
+                             unsigned int chunk_class, void *chunk)
+{
+    *(void **)chunk = slabs->free_chunks[chunk_class];
+    slabs->free_chunks[chunk_class] = chunk;
+}
+
+//
+// Carves a chunk of 'chunk_class' from the newest slab, mapping another one
+// once it is used up. What is left of the old one is kept as smaller chunks.
+//
+static void *_XYTH_carve_chunk(struct _XYTH_regions *regions,
+                               unsigned int chunk_class)
+{
+    struct _XYTH_slabs *slabs = &regions->slabs;
+    size_t size = (size_t)1 << (REGION_MIN_CHUNK_SHIFT + chunk_class);
+    void *chunk;
+
+    if (slabs->left < size) {
+        for (unsigned int i = chunk_class; i-- > 0 && slabs->left > 0;) {
+            size_t piece = (size_t)1 << (REGION_MIN_CHUNK_SHIFT + i);
+
+            if (slabs->left >= piece) {
+                _XYTH_push_chunk(slabs, i, slabs->next);
+                slabs->next += piece;
+                slabs->left -= piece;
+            }
+        }
+        // The byte added to every region makes it a single huge page
+        if (_XYTH_add_map(slabs, REGION_HUGE_PAGE_SIZE - 1, regions) !=
+            XYTH_SUCCESS) {
+            return NULL;
+        }
+        slabs->next = slabs->maps[slabs->num_maps - 1].addr;
+        slabs->left = REGION_HUGE_PAGE_SIZE;
+    }
+
+    chunk = slabs->next;
+    slabs->next += size;
+    slabs->left -= size;
+    return chunk;
+}
+
+//
+// Region 'i' of a context: the directory, the scratch, then each slab.
+//
+static const struct _XYTH_region *
+_XYTH_nth_region(const struct _XYTH_regions *regions, unsigned int i)
+{
+    return i == 0   ? &regions->directory
+           : i == 1 ? &regions->scratch
+                    : &regions->slabs.maps[i - 2];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////  I N T E R N A L  ///////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+XYTH_status _XYTH_create_regions(bool huge_pages,
+                                 struct _XYTH_regions **regions)
+{
+    XYTH_status status;
+
+    *regions = malloc(sizeof(**regions));
+    if (*regions != NULL) {
+        (*regions)->huge_pages = huge_pages;
+        (*regions)->directory.addr = NULL;
+        (*regions)->directory.size = 0;
+        (*regions)->directory.hugetlb = false;
+        (*regions)->scratch = (*regions)->directory;
+        (*regions)->slabs = (struct _XYTH_slabs){0};
+        status = _XYTH_create_lock(&(*regions)->lock);
+        if (status != XYTH_SUCCESS) {
+            free(*regions);
+            *regions = NULL;
+        }
+    } else {
+        status = XYTH_E_NO_MEMORY;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+void _XYTH_destroy_regions(struct _XYTH_regions *regions)
+{
+    if (regions != NULL) {
+        _XYTH_unmap_region(&regions->directory);
+        _XYTH_unmap_region(&regions->scratch);
+        for (unsigned int i = 0; i < regions->slabs.num_maps; i++) {
+            _XYTH_unmap_region(&regions->slabs.maps[i]);
+        }
+        free(regions->slabs.maps);
+        _XYTH_destroy_lock(regions->lock);
+        free(regions);
+    }
+}
+
+//
+// Maps a zeroed region of at least 'size' bytes, on huge pages if the context
+// asks for them and the system has any.
+//
+XYTH_status _XYTH_map_region(struct _XYTH_regions *regions, size_t size,
+                             struct _XYTH_region *region)
+{
+    XYTH_status status;
+
+    region->addr = NULL;
+    region->hugetlb = false;
+
+    region->size = _XYTH_region_size(regions, size);
+    if (regions->huge_pages) {
+#ifdef MAP_HUGETLB
+        region->addr = mmap(NULL, region->size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (region->addr != MAP_FAILED) {
+            region->hugetlb = true;
+        } else {
+            region->addr = NULL;
+        }
+#endif
+        if (region->addr == NULL) {
+            region->addr = _XYTH_map_aligned(region->size);
+        }
+    } else {
+        region->addr = mmap(NULL, region->size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region->addr == MAP_FAILED) {
+            region->addr = NULL;
+        }
+    }
+
+    if (region->addr != NULL) {
+        status = XYTH_SUCCESS;
+    } else {
+        region->size = 0;
+        status = XYTH_E_NO_MEMORY;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+void _XYTH_unmap_region(struct _XYTH_region *region)
+{
+    if (region->addr != NULL) {
+        munmap(region->addr, region->size);
+        region->addr = NULL;
+        region->size = 0;
+        region->hugetlb = false;
+    }
+}
+
+//
+// Gets a region of at least 'size' bytes for the score arrays of a query,
+// reusing the one kept by the last query when it is large enough. Its contents
+// are not zeroed.
+//
+XYTH_status _XYTH_take_scratch(struct _XYTH_regions *regions, size_t size,
+                               struct _XYTH_region *scratch)
+{
+    scratch->addr = NULL;
+
+    _XYTH_acquire_lock(regions->lock);
+    if (regions->scratch.addr != NULL && regions->scratch.size >= size) {
+        *scratch = regions->scratch;
+        regions->scratch.addr = NULL;
+        regions->scratch.size = 0;
+    }
+    _XYTH_release_lock(regions->lock);
+
+    return scratch->addr != NULL ? XYTH_SUCCESS
+                                 : _XYTH_map_region(regions, size, scratch);
+}
+
+//
+// Keeps the larger of 'scratch' and the region already kept, for the next
+// query. Queries running at the same time unmap theirs.
+//
+void _XYTH_give_back_scratch(struct _XYTH_regions *regions,
+                             struct _XYTH_region *scratch)
+{
+    struct _XYTH_region unused = *scratch;
+
+    _XYTH_acquire_lock(regions->lock);
+    if (scratch->size > regions->scratch.size) {
+        unused = regions->scratch;
+        regions->scratch = *scratch;
+    }
+    _XYTH_release_lock(regions->lock);
+
+    _XYTH_unmap_region(&unused);
+    scratch->addr = NULL;
+    scratch->size = 0;
+}
+
+//
+// Allocates a posting array of 'size' bytes, from the slabs if the context
+// asks for huge pages. 'regions' is NULL for arrays no context keeps.
+//
+void *_XYTH_alloc_postings(struct _XYTH_regions *regions, size_t size)
+{
+    struct _XYTH_slabs *slabs;
+    unsigned int chunk_class;
+    void *array = NULL;
+
+    if (regions == NULL || !regions->huge_pages) {
+        return malloc(size);
+    }
+
+    slabs = &regions->slabs;
+    chunk_class = _XYTH_chunk_class(size);
+
+    _XYTH_acquire_lock(regions->lock);
+    if (chunk_class >= REGION_NUM_CHUNK_CLASSES) {
+        if (_XYTH_add_map(slabs, size, regions) == XYTH_SUCCESS) {
+            array = slabs->maps[slabs->num_maps - 1].addr;
+        }
+    } else if (slabs->free_chunks[chunk_class] != NULL) {
+        array = slabs->free_chunks[chunk_class];
+        slabs->free_chunks[chunk_class] = *(void **)array;
+    } else {
+        array = _XYTH_carve_chunk(regions, chunk_class);
+    }
+    _XYTH_release_lock(regions->lock);
+
+    return array;
+}
+
+//
+// Frees a posting array, given the 'size' it was allocated with.
+//
+void _XYTH_free_postings(struct _XYTH_regions *regions, void *addr,
+                         size_t size)
+{
+    struct _XYTH_slabs *slabs;
+    unsigned int chunk_class;
+
+    if (regions == NULL || !regions->huge_pages) {
+        free(addr);
+        return;
+    }
+    if (addr == NULL) {
+        return;
+    }
+
+    slabs = &regions->slabs;
+    chunk_class = _XYTH_chunk_class(size);
+
+    _XYTH_acquire_lock(regions->lock);
+    if (chunk_class < REGION_NUM_CHUNK_CLASSES) {
+        _XYTH_push_chunk(slabs, chunk_class, addr);
+    } else {
+        // Mapped on its own; few arrays are that large
+        for (unsigned int i = slabs->num_maps; i-- > 0;) {
+            if (slabs->maps[i].addr == addr) {
+                _XYTH_unmap_region(&slabs->maps[i]);
+                slabs->maps[i] = slabs->maps[--slabs->num_maps];
+                break;
+            }
+        }
+    }
+    _XYTH_release_lock(regions->lock);
+}
+
+//
+// Sums the memory of the regions, and how much of it huge pages back.
+// Transparent huge pages are counted from /proc/self/smaps, which reports them
+// per mapping; a region merged with a neighbor is credited at most its size.
+//
+void _XYTH_get_region_usage(struct _XYTH_regions *regions,
+                            unsigned long long *region_bytes,
+                            unsigned long long *huge_page_bytes)
+{
+    const struct _XYTH_region *mapped;
+    unsigned int num_mapped;
+    unsigned long long overlap = 0;
+    unsigned long start, end, kbytes;
+    char line[256];
+    FILE *smaps;
+
+    _XYTH_acquire_lock(regions->lock);
+
+    num_mapped = 2 + regions->slabs.num_maps;
+    *region_bytes = 0;
+    *huge_page_bytes = 0;
+    for (unsigned int i = 0; i < num_mapped; i++) {
+        mapped = _XYTH_nth_region(regions, i);
+        *region_bytes += mapped->size;
+        if (mapped->hugetlb) {
+            *huge_page_bytes += mapped->size;
+        }
+    }
+
+    smaps = regions->huge_pages ? fopen("/proc/self/smaps", "r") : NULL;
+    while (smaps != NULL && fgets(line, sizeof(line), smaps) != NULL) {
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            overlap = 0;
+            for (unsigned int i = 0; i < num_mapped; i++) {
+                uintptr_t begin, finish;
+
+                mapped = _XYTH_nth_region(regions, i);
+                begin = (uintptr_t)mapped->addr;
+                finish = begin + mapped->size;
+                if (mapped->addr != NULL && !mapped->hugetlb &&
+                    begin < end && finish > start) {
+                    overlap += (finish < end ? finish : end) -
+                               (begin > start ? begin : start);
+                }
+            }
+        } else if (overlap > 0 &&
+                   sscanf(line, "AnonHugePages: %lu kB", &kbytes) == 1) {
+            kbytes *= 1024;
+            *huge_page_bytes += kbytes < overlap ? kbytes : overlap;
+            overlap = 0;
+        }
+    }
+    if (smaps != NULL) {
+        fclose(smaps);
+    }
+
+    _XYTH_release_lock(regions->lock);
+}
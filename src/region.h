@@ -0,0 +1,85 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef REGION_H
+#define REGION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <xyth.h>
+
+#include "config.h"
+#include "lock.h"
+
+// Memory mapped on its own, so it can be backed by huge pages
+struct _XYTH_region {
+    void *addr;   // NULL if not mapped
+    size_t size;  // in bytes, a multiple of the page size
+    bool hugetlb; // Backed by reserved huge pages, rather than transparent ones
+};
+
+// Posting arrays packed into huge pages
+struct _XYTH_slabs {
+    struct _XYTH_region *maps; // Slabs, and arrays larger than a slab
+    unsigned int num_maps;
+    unsigned int alloc_maps;      // in members, not bytes
+    char *next;                   // Rest of the newest slab, not carved yet
+    size_t left;                  // in bytes
+    void *free_chunks[REGION_NUM_CHUNK_CLASSES]; // Freed chunks of each size,
+                                                 // linked through their first
+                                                 // bytes
+};
+
+// Large regions of a context
+struct _XYTH_regions {
+    bool huge_pages;               // Regions are asked for huge pages
+    struct _XYTH_region directory; // Arrays indexed by group
+    struct _XYTH_lock *lock;       // Guards 'scratch' and 'slabs'
+    struct _XYTH_region scratch;   // Score arrays kept between queries
+    struct _XYTH_slabs slabs;      // Postings (unused without huge pages)
+};
+
+XYTH_status _XYTH_create_regions(bool huge_pages,
+                                 struct _XYTH_regions **regions);
+
+void _XYTH_destroy_regions(struct _XYTH_regions *regions);
+
+XYTH_status _XYTH_map_region(struct _XYTH_regions *regions, size_t size,
+                             struct _XYTH_region *region);
+
+void _XYTH_unmap_region(struct _XYTH_region *region);
+
+XYTH_status _XYTH_take_scratch(struct _XYTH_regions *regions, size_t size,
+                               struct _XYTH_region *scratch);
+
+void _XYTH_give_back_scratch(struct _XYTH_regions *regions,
+                             struct _XYTH_region *scratch);
+
+void *_XYTH_alloc_postings(struct _XYTH_regions *regions, size_t size);
+
+void _XYTH_free_postings(struct _XYTH_regions *regions, void *addr,
+                         size_t size);
+
+void _XYTH_get_region_usage(struct _XYTH_regions *regions,
+                            unsigned long long *region_bytes,
+                            unsigned long long *huge_page_bytes);
+
+#endif // REGION_H
@@ -0,0 +1,359 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Pairwise matcher in the spirit of NBIS' bozorth3, used to re-rank the best
+// candidates found by the index. Every two minutiae of a template form a
+// rotation and translation invariant pair; pairs of the probe and of the
+// candidate are compatible when their lengths and relative angles agree.
+// Compatible pairs that share the dominant rotation vote for minutiae
+// associations, and the score is the number of compatible pairs consistent
+// with the one-to-one association that won the vote.
+//
+
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <debug.h>
+#include <xyth.h>
+
+#include "config.h"
+#include "rerank.h"
+
+#define _XYTH_MAX_PAIRS                                                        \
+    (MAX_MINUTIAE_PER_TEMPLATE * (MAX_MINUTIAE_PER_TEMPLATE - 1) / 2)
+
+#define _XYTH_ROTATION_BINS (360 / RERANK_ROTATION_BIN)
+
+struct _XYTH_pair {
+    unsigned int distance;
+    unsigned int direction;   // Direction of the line first -> second
+    unsigned int beta_first;  // First minutia's angle relative to the line
+    unsigned int beta_second; // Second minutia's angle relative to the line
+    unsigned char first;
+    unsigned char second;
+};
+
+struct _XYTH_association {
+    unsigned char probe_first;
+    unsigned char probe_second;
+    unsigned char gallery_first;
+    unsigned char gallery_second;
+    unsigned int rotation;
+};
+
+struct _XYTH_rerank {
+    struct _XYTH_pair probe_pairs[_XYTH_MAX_PAIRS];
+    unsigned int num_probe_pairs;
+    struct _XYTH_pair gallery_pairs[_XYTH_MAX_PAIRS];
+    unsigned int num_gallery_pairs;
+    struct _XYTH_association associations[RERANK_MAX_ASSOCIATIONS];
+    unsigned int num_associations;
+    unsigned int rotation_votes[_XYTH_ROTATION_BINS];
+    unsigned int votes[MAX_MINUTIAE_PER_TEMPLATE][MAX_MINUTIAE_PER_TEMPLATE];
+    unsigned char probe_to_gallery[MAX_MINUTIAE_PER_TEMPLATE];
+    unsigned char gallery_to_probe[MAX_MINUTIAE_PER_TEMPLATE];
+};
+
+#define _XYTH_NOT_ASSOCIATED 0xFF
+
+static unsigned int _XYTH_normalize_angle(int angle)
+{
+    angle %= 360;
+    return angle < 0 ? angle + 360 : angle;
+}
+
+static unsigned int _XYTH_angle_difference(unsigned int a, unsigned int b)
+{
+    unsigned int diff = a > b ? a - b : b - a;
+    return diff > 180 ? 360 - diff : diff;
+}
+
+static int _XYTH_sort_pairs_by_distance(const void *ptr1, const void *ptr2)
+{
+    const struct _XYTH_pair *pair1 = ptr1;
+    const struct _XYTH_pair *pair2 = ptr2;
+
+    if (pair1->distance < pair2->distance) {
+        return -1;
+    } else if (pair1->distance > pair2->distance) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+//
+// Creates the pairs of a set of minutiae, sorted by distance.
+//
+static unsigned int _XYTH_create_pairs(const struct _XYTH_xyt *minutiae,
+                                       unsigned int num_minutiae,
+                                       struct _XYTH_pair *pairs)
+{
+    unsigned int num_pairs = 0;
+
+    for (unsigned int i = 0; i + 1 < num_minutiae; i++) {
+        for (unsigned int j = i + 1; j < num_minutiae; j++) {
+            int dx = (int)minutiae[j].x - (int)minutiae[i].x;
+            int dy = (int)minutiae[j].y - (int)minutiae[i].y;
+            double distance = sqrt((double)(dx * dx + dy * dy));
+
+            if (distance <= RERANK_MAX_DISTANCE) {
+                struct _XYTH_pair *pair = &pairs[num_pairs++];
+                pair->distance = (unsigned int)lround(distance);
+                pair->direction =
+                    _XYTH_normalize_angle(lround(atan2(dy, dx) * 180 / M_PI));
+                pair->beta_first = _XYTH_normalize_angle(
+                    (int)pair->direction - (int)minutiae[i].angle);
+                pair->beta_second = _XYTH_normalize_angle(
+                    (int)pair->direction - (int)minutiae[j].angle);
+                pair->first = i;
+                pair->second = j;
+            }
+        }
+    }
+
+    qsort(pairs, num_pairs, sizeof(*pairs), _XYTH_sort_pairs_by_distance);
+    return num_pairs;
+}
+
+//
+// Records an association if the pairs' relative angles agree, assuming that
+// 'gallery' is seen from its first minutia ('reversed' == false), or from its
+// second one.
+//
+static void _XYTH_associate_pairs(struct _XYTH_rerank *rerank,
+                                  const struct _XYTH_pair *probe,
+                                  const struct _XYTH_pair *gallery,
+                                  bool reversed)
+{
+    unsigned int direction, beta_first, beta_second;
+    struct _XYTH_association *assoc;
+
+    if (!reversed) {
+        direction = gallery->direction;
+        beta_first = gallery->beta_first;
+        beta_second = gallery->beta_second;
+    } else {
+        direction = (gallery->direction + 180) % 360;
+        beta_first = (gallery->beta_second + 180) % 360;
+        beta_second = (gallery->beta_first + 180) % 360;
+    }
+
+    if (_XYTH_angle_difference(probe->beta_first, beta_first) >
+            RERANK_ANGLE_TOLERANCE ||
+        _XYTH_angle_difference(probe->beta_second, beta_second) >
+            RERANK_ANGLE_TOLERANCE ||
+        rerank->num_associations >= RERANK_MAX_ASSOCIATIONS) {
+        return;
+    }
+
+    assoc = &rerank->associations[rerank->num_associations++];
+    assoc->probe_first = probe->first;
+    assoc->probe_second = probe->second;
+    assoc->gallery_first = reversed ? gallery->second : gallery->first;
+    assoc->gallery_second = reversed ? gallery->first : gallery->second;
+    assoc->rotation =
+        _XYTH_normalize_angle((int)direction - (int)probe->direction);
+    rerank->rotation_votes[assoc->rotation / RERANK_ROTATION_BIN]++;
+}
+
+//
+// Finds every compatible (probe, gallery) pair. Both lists are sorted by
+// distance, so only a sliding window of gallery pairs is compared.
+//
+static void _XYTH_find_compatible_pairs(struct _XYTH_rerank *rerank)
+{
+    unsigned int window_begin = 0;
+
+    rerank->num_associations = 0;
+    memset(rerank->rotation_votes, 0, sizeof(rerank->rotation_votes));
+
+    for (unsigned int p = 0; p < rerank->num_probe_pairs; p++) {
+        const struct _XYTH_pair *probe = &rerank->probe_pairs[p];
+        unsigned int tolerance =
+            probe->distance * RERANK_DISTANCE_TOLERANCE / 100 + 1;
+
+        while (window_begin < rerank->num_gallery_pairs &&
+               rerank->gallery_pairs[window_begin].distance + tolerance <
+                   probe->distance) {
+            window_begin++;
+        }
+
+        for (unsigned int g = window_begin;
+             g < rerank->num_gallery_pairs &&
+             rerank->gallery_pairs[g].distance <= probe->distance + tolerance;
+             g++) {
+            _XYTH_associate_pairs(rerank, probe, &rerank->gallery_pairs[g],
+                                  false);
+            _XYTH_associate_pairs(rerank, probe, &rerank->gallery_pairs[g],
+                                  true);
+        }
+    }
+}
+
+//
+// Returns the bin, together with its two neighbors, that received the most
+// rotation votes.
+//
+static unsigned int _XYTH_dominant_rotation_bin(struct _XYTH_rerank *rerank)
+{
+    unsigned int best_bin = 0;
+    unsigned int best_votes = 0;
+
+    for (unsigned int bin = 0; bin < _XYTH_ROTATION_BINS; bin++) {
+        unsigned int votes =
+            rerank->rotation_votes[(bin + _XYTH_ROTATION_BINS - 1) %
+                                   _XYTH_ROTATION_BINS] +
+            rerank->rotation_votes[bin] +
+            rerank->rotation_votes[(bin + 1) % _XYTH_ROTATION_BINS];
+        if (votes > best_votes) {
+            best_votes = votes;
+            best_bin = bin;
+        }
+    }
+
+    return best_bin;
+}
+
+static bool _XYTH_is_in_rotation_window(const struct _XYTH_association *assoc,
+                                        unsigned int bin)
+{
+    unsigned int assoc_bin = assoc->rotation / RERANK_ROTATION_BIN;
+    unsigned int distance = assoc_bin > bin ? assoc_bin - bin : bin - assoc_bin;
+
+    return distance <= 1 || distance == _XYTH_ROTATION_BINS - 1;
+}
+
+//
+// Greedily associates each probe minutia to, at most, one gallery minutia,
+// highest vote first.
+//
+static void _XYTH_assign_minutiae(struct _XYTH_rerank *rerank)
+{
+    memset(rerank->probe_to_gallery, _XYTH_NOT_ASSOCIATED,
+           sizeof(rerank->probe_to_gallery));
+    memset(rerank->gallery_to_probe, _XYTH_NOT_ASSOCIATED,
+           sizeof(rerank->gallery_to_probe));
+
+    for (;;) {
+        unsigned int best_votes = 0;
+        unsigned int best_p = 0, best_g = 0;
+
+        for (unsigned int p = 0; p < MAX_MINUTIAE_PER_TEMPLATE; p++) {
+            if (rerank->probe_to_gallery[p] != _XYTH_NOT_ASSOCIATED) {
+                continue;
+            }
+            for (unsigned int g = 0; g < MAX_MINUTIAE_PER_TEMPLATE; g++) {
+                if (rerank->votes[p][g] > best_votes &&
+                    rerank->gallery_to_probe[g] == _XYTH_NOT_ASSOCIATED) {
+                    best_votes = rerank->votes[p][g];
+                    best_p = p;
+                    best_g = g;
+                }
+            }
+        }
+
+        if (best_votes == 0) {
+            break;
+        }
+        rerank->probe_to_gallery[best_p] = best_g;
+        rerank->gallery_to_probe[best_g] = best_p;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+XYTH_status _XYTH_create_rerank(struct XYTH_template *probe,
+                                struct _XYTH_rerank **rerank)
+{
+    XYTH_status status;
+    struct _XYTH_xyt minutiae[MAX_MINUTIAE_PER_TEMPLATE];
+    unsigned int num_minutiae = probe->num_minutiae;
+
+    if (num_minutiae > MAX_MINUTIAE_PER_TEMPLATE) {
+        num_minutiae = MAX_MINUTIAE_PER_TEMPLATE;
+    }
+
+    *rerank = malloc(sizeof(**rerank));
+    if (*rerank != NULL) {
+        for (unsigned int i = 0; i < num_minutiae; i++) {
+            minutiae[i].x = probe->minutiae[i].x;
+            minutiae[i].y = probe->minutiae[i].y;
+            minutiae[i].angle = probe->minutiae[i].angle;
+        }
+        (*rerank)->num_probe_pairs =
+            _XYTH_create_pairs(minutiae, num_minutiae, (*rerank)->probe_pairs);
+        status = XYTH_SUCCESS;
+    } else {
+        status = XYTH_E_NO_MEMORY;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+unsigned int _XYTH_rerank_score(struct _XYTH_rerank *rerank,
+                                struct _XYTH_template_record *record)
+{
+    unsigned int bin;
+    unsigned int score = 0;
+
+    if (record->minutiae == NULL) {
+        return 0;
+    }
+
+    rerank->num_gallery_pairs = _XYTH_create_pairs(
+        record->minutiae, record->num_minutiae, rerank->gallery_pairs);
+    _XYTH_find_compatible_pairs(rerank);
+    bin = _XYTH_dominant_rotation_bin(rerank);
+
+    // Compatible pairs under the dominant rotation vote for associations
+    memset(rerank->votes, 0, sizeof(rerank->votes));
+    for (unsigned int i = 0; i < rerank->num_associations; i++) {
+        struct _XYTH_association *assoc = &rerank->associations[i];
+        if (_XYTH_is_in_rotation_window(assoc, bin)) {
+            rerank->votes[assoc->probe_first][assoc->gallery_first]++;
+            rerank->votes[assoc->probe_second][assoc->gallery_second]++;
+        }
+    }
+    _XYTH_assign_minutiae(rerank);
+
+    // Count the pairs that agree with the association
+    for (unsigned int i = 0; i < rerank->num_associations; i++) {
+        struct _XYTH_association *assoc = &rerank->associations[i];
+        if (_XYTH_is_in_rotation_window(assoc, bin) &&
+            rerank->probe_to_gallery[assoc->probe_first] ==
+                assoc->gallery_first &&
+            rerank->probe_to_gallery[assoc->probe_second] ==
+                assoc->gallery_second) {
+            score++;
+        }
+    }
+
+    return score;
+}
+
+void _XYTH_destroy_rerank(struct _XYTH_rerank *rerank)
+{
+    free(rerank);
+}
@@ -0,0 +1,959 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Segmented index. Templates are added to the head, whose groups are arrays
+// grown in place. Once the head holds the seal threshold of templates, its
+// postings are sealed into an immutable segment, laid out back to back, and
+// the head starts over empty. The head lists the groups it allocates, and a
+// segment lists the groups it holds, so sealing costs at most the postings of
+// the head and is done by the add that fills it. Merging costs the postings
+// of every segment merged, so the seal queues it on the context's pool, which
+// merges the two newest segments while the newest is not the smaller one, and
+// keeps a few segments, larger the older they are. The merged segment is built
+// from copies of the segments, holding no lock but the merge lock, and the
+// index is locked only to install it. Templates removed from a sealed segment
+// get a tombstone, and their postings are dropped when it is merged.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <context.h>
+#include <debug.h>
+#include <xyth.h>
+
+#include "add_remove.h"
+#include "async.h"
+#include "common.h"
+#include "config.h"
+#include "lock.h"
+#include "pool.h"
+#include "region.h"
+#include "segment.h"
+
+// Segments being merged into one
+struct _XYTH_merge {
+    unsigned int first_segment;
+    unsigned int num_segments;
+    struct _XYTH_segment sources[SEGMENT_MAX_SEALED]; // Copies, owning their
+                                                      // tombstones only
+    struct _XYTH_segment merged;
+    unsigned int *groups; // Groups of the sources, ascending
+    unsigned int num_groups;
+};
+
+// Merges the segments of a context on its pool
+struct _XYTH_merge_task {
+    struct _XYTH_task task; // Must be first
+    struct XYTH_context *ctx;
+    struct _XYTH_async *async; // Waits for the task before it is released
+};
+
+static void _XYTH_free_segment(struct _XYTH_regions *regions,
+                               struct _XYTH_segment *segment)
+{
+    uint64_t length = segment->num_postings + 1;
+
+    free(segment->groups);
+    free(segment->directory);
+    free(segment->offsets);
+    _XYTH_free_postings(regions, segment->postings,
+                        length * sizeof(unsigned int));
+    _XYTH_free_postings(regions, segment->residuals,
+                        length * sizeof(uint32_t));
+    _XYTH_free_postings(regions, segment->partitions, length);
+    free(segment->tombstones);
+    memset(segment, 0, sizeof(*segment));
+}
+
+//
+// Copies the live postings of [begin, end) in 'run'. Only counts them if
+// 'postings' is NULL.
+//
+static uint64_t _XYTH_copy_run(const struct _XYTH_posting_run *run,
+                               unsigned int begin, unsigned int end,
+                               unsigned int *postings, uint32_t *residuals,
+                               uint8_t *partitions)
+{
+    bool with_tombstones =
+        run->segment != NULL && run->segment->tombstones != NULL;
+    uint64_t count = 0;
+
+    for (unsigned int i = begin; i < end; i++) {
+        if (with_tombstones &&
+            _XYTH_is_tombstoned(run->segment, run->postings[i])) {
+            continue;
+        }
+        if (postings != NULL) {
+            postings[count] = run->postings[i];
+            if (residuals != NULL) {
+                residuals[count] = run->residuals[i];
+            }
+            if (partitions != NULL) {
+                partitions[count] = run->partitions[i];
+            }
+        }
+        count++;
+    }
+
+    return count;
+}
+
+static int _XYTH_compare_groups(const void *a, const void *b)
+{
+    unsigned int group_a = *(const unsigned int *)a;
+    unsigned int group_b = *(const unsigned int *)b;
+
+    return (group_a > group_b) - (group_a < group_b);
+}
+
+//
+// Lists the groups of the head, if 'with_head', and of the segments
+// [first_segment, first_segment + num_segments), ascending and once each. The
+// cost follows the groups listed, not the groups of the index.
+//
+static XYTH_status _XYTH_list_groups(const struct _XYTH_database *db,
+                                     bool with_head,
+                                     unsigned int first_segment,
+                                     unsigned int num_segments,
+                                     unsigned int **groups,
+                                     unsigned int *num_groups)
+{
+    uint64_t count = with_head ? db->num_head_groups : 0;
+    unsigned int num_unique = 0;
+
+    for (unsigned int i = first_segment; i < first_segment + num_segments;
+         i++) {
+        count += db->segments[i].num_held;
+    }
+
+    // One extra member, as malloc(0) may return NULL
+    *groups = malloc((count + 1) * sizeof(**groups));
+    if (*groups == NULL) {
+        PRINT_IF_ERROR(XYTH_E_NO_MEMORY);
+        return XYTH_E_NO_MEMORY;
+    }
+
+    count = 0;
+    if (with_head) {
+        memcpy(*groups, db->head_groups,
+               db->num_head_groups * sizeof(**groups));
+        count = db->num_head_groups;
+    }
+    for (unsigned int i = first_segment; i < first_segment + num_segments;
+         i++) {
+        memcpy(*groups + count, db->segments[i].groups,
+               db->segments[i].num_held * sizeof(**groups));
+        count += db->segments[i].num_held;
+    }
+
+    qsort(*groups, count, sizeof(**groups), _XYTH_compare_groups);
+    for (uint64_t i = 0; i < count; i++) {
+        if (num_unique == 0 || (*groups)[num_unique - 1] != (*groups)[i]) {
+            (*groups)[num_unique++] = (*groups)[i];
+        }
+    }
+
+    *num_groups = num_unique;
+    return XYTH_SUCCESS;
+}
+
+//
+// Hashes the groups of 'segment' into its directory, at most half full.
+//
+static XYTH_status _XYTH_build_directory(struct _XYTH_segment *segment)
+{
+    unsigned int mask;
+
+    segment->directory_bits = 1;
+    while ((1u << segment->directory_bits) < 2 * (uint64_t)segment->num_held) {
+        segment->directory_bits++;
+    }
+    mask = (1u << segment->directory_bits) - 1;
+
+    segment->directory = calloc(mask + 1, sizeof(*segment->directory));
+    if (segment->directory == NULL) {
+        PRINT_IF_ERROR(XYTH_E_NO_MEMORY);
+        return XYTH_E_NO_MEMORY;
+    }
+
+    for (unsigned int i = 0; i < segment->num_held; i++) {
+        unsigned int slot =
+            _XYTH_directory_slot(segment->directory_bits, segment->groups[i]);
+
+        while (segment->directory[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        segment->directory[slot] = i + 1;
+    }
+
+    return XYTH_SUCCESS;
+}
+
+//
+// Seals the live postings of the head of 'db', if 'with_head', and of its
+// segments [first_segment, first_segment + num_segments) into a new segment
+// of 'ctx'. Only the 'num_groups' groups listed in 'groups' are visited. The
+// template range is left to the caller.
+//
+static XYTH_status _XYTH_build_segment(struct XYTH_context *ctx,
+                                       const struct _XYTH_database *db,
+                                       bool with_head,
+                                       unsigned int first_segment,
+                                       unsigned int num_segments,
+                                       const unsigned int *groups,
+                                       unsigned int num_groups,
+                                       struct _XYTH_segment *segment)
+{
+    struct _XYTH_posting_run runs[SEGMENT_MAX_SEALED + 1];
+    bool with_residuals = ctx->db_cfg.index_mode == DB_INDEX_MULTIRES;
+    bool with_partitions = ctx->db_cfg.num_partitions > 1;
+    uint64_t next = 0;
+
+    // One extra member, as malloc(0) may return NULL
+    memset(segment, 0, sizeof(*segment));
+    segment->groups = malloc((num_groups + 1) * sizeof(*segment->groups));
+    segment->offsets = malloc((num_groups + 1) * sizeof(uint64_t));
+    if (segment->groups == NULL || segment->offsets == NULL) {
+        _XYTH_free_segment(ctx->regions, segment);
+        return XYTH_E_NO_MEMORY;
+    }
+
+    // Counted first, so each array is allocated once
+    for (unsigned int i = 0; i < num_groups; i++) {
+        unsigned int num_runs =
+            _XYTH_gather_runs(db, groups[i], with_head, first_segment,
+                              num_segments, runs);
+        uint64_t count = _XYTH_count_live_postings(runs, num_runs);
+
+        if (count > 0) {
+            segment->groups[segment->num_held++] = groups[i];
+            segment->num_postings += count;
+        }
+    }
+
+    segment->postings = _XYTH_alloc_postings(
+        ctx->regions, (segment->num_postings + 1) * sizeof(unsigned int));
+    if (with_residuals) {
+        segment->residuals = _XYTH_alloc_postings(
+            ctx->regions, (segment->num_postings + 1) * sizeof(uint32_t));
+    }
+    if (with_partitions) {
+        segment->partitions =
+            _XYTH_alloc_postings(ctx->regions, segment->num_postings + 1);
+    }
+    if (segment->postings == NULL ||
+        (with_residuals && segment->residuals == NULL) ||
+        (with_partitions && segment->partitions == NULL) ||
+        _XYTH_build_directory(segment) != XYTH_SUCCESS) {
+        _XYTH_free_segment(ctx->regions, segment);
+        return XYTH_E_NO_MEMORY;
+    }
+
+    for (unsigned int i = 0; i < segment->num_held; i++) {
+        unsigned int num_runs =
+            _XYTH_gather_runs(db, segment->groups[i], with_head,
+                              first_segment, num_segments, runs);
+
+        segment->offsets[i] = next;
+        next += _XYTH_copy_live_postings(
+            runs, num_runs, ctx->db_cfg.num_partitions,
+            segment->postings + next,
+            segment->residuals != NULL ? segment->residuals + next : NULL,
+            segment->partitions != NULL ? segment->partitions + next : NULL);
+    }
+    segment->offsets[segment->num_held] = next;
+
+    return XYTH_SUCCESS;
+}
+
+//
+// Empties the head, once its postings are sealed. Only the groups it
+// allocated are visited.
+//
+static void _XYTH_clear_head(struct XYTH_context *ctx)
+{
+    struct _XYTH_database *db = &ctx->db;
+
+    for (unsigned int i = 0; i < db->num_head_groups; i++) {
+        unsigned int group_index = db->head_groups[i];
+
+        _XYTH_free_group_positions(ctx, group_index);
+        db->data[group_index] = NULL;
+        if (db->residuals != NULL) {
+            db->residuals[group_index] = NULL;
+        }
+        if (db->partitions != NULL) {
+            db->partitions[group_index] = NULL;
+        }
+        db->alloc_counter[group_index] = 0;
+        db->group_length[group_index] = 0;
+    }
+
+    db->num_head_groups = 0;
+    db->head_first_template = db->next_template_id;
+}
+
+//
+// Clears the occupancy of the listed groups left with no postings at all,
+// once merging dropped the postings of removed templates.
+//
+static void _XYTH_clear_empty_groups(struct XYTH_context *ctx,
+                                     const unsigned int *groups,
+                                     unsigned int num_groups)
+{
+    for (unsigned int i = 0; i < num_groups; i++) {
+        _XYTH_mark_group_empty(ctx, groups[i]);
+    }
+}
+
+//
+// Replaces the segments [first_segment, first_segment + num_segments) by
+// 'merged', or by nothing if it holds no postings.
+//
+static void _XYTH_replace_segments(struct XYTH_context *ctx,
+                                   unsigned int first_segment,
+                                   unsigned int num_segments,
+                                   struct _XYTH_segment *merged)
+{
+    struct _XYTH_database *db = &ctx->db;
+    unsigned int end = first_segment + num_segments;
+    unsigned int kept = merged->num_postings > 0 ? 1 : 0;
+
+    for (unsigned int i = first_segment; i < end; i++) {
+        _XYTH_free_segment(ctx->regions, &db->segments[i]);
+    }
+    if (kept) {
+        db->segments[first_segment] = *merged;
+    } else {
+        _XYTH_free_segment(ctx->regions, merged);
+    }
+    memmove(&db->segments[first_segment + kept], &db->segments[end],
+            (db->num_segments - end) * sizeof(*db->segments));
+    db->num_segments = db->num_segments - num_segments + kept;
+}
+
+//
+// Picks the segments to merge next: the two newest ones, from the newest, where
+// the newer is not the smaller one, or all of them once SEGMENT_MAX_SEALED
+// are sealed. Returns false if there is nothing to merge.
+//
+static bool _XYTH_plan_merge(const struct _XYTH_database *db,
+                             unsigned int *first_segment,
+                             unsigned int *num_segments)
+{
+    for (unsigned int i = db->num_segments; i >= 2; i--) {
+        if (db->segments[i - 1].num_postings >=
+            db->segments[i - 2].num_postings) {
+            *first_segment = i - 2;
+            *num_segments = 2;
+            return true;
+        }
+    }
+
+    if (db->num_segments == SEGMENT_MAX_SEALED) {
+        *first_segment = 0;
+        *num_segments = db->num_segments;
+        return true;
+    }
+
+    return false;
+}
+
+//
+// Copies the segments to merge, and their tombstones, so the merged segment
+// can be built without the locks. Only merges drop segments, and they are
+// serialized, so the postings of the copies stay valid until it is installed.
+// The caller holds the enroll lock, as removals add tombstones under it.
+//
+static XYTH_status _XYTH_start_merge(const struct _XYTH_database *db,
+                                     unsigned int first_segment,
+                                     unsigned int num_segments,
+                                     struct _XYTH_merge *merge)
+{
+    memset(merge, 0, sizeof(*merge));
+    merge->first_segment = first_segment;
+    merge->num_segments = num_segments;
+
+    for (unsigned int i = 0; i < num_segments; i++) {
+        const struct _XYTH_segment *segment = &db->segments[first_segment + i];
+        struct _XYTH_segment *source = &merge->sources[i];
+        size_t size = (segment->end_template - segment->first_template + 63) /
+                      64 * sizeof(uint64_t);
+
+        *source = *segment;
+        if (segment->tombstones != NULL) {
+            source->tombstones = malloc(size);
+            if (source->tombstones == NULL) {
+                PRINT_IF_ERROR(XYTH_E_NO_MEMORY);
+                return XYTH_E_NO_MEMORY;
+            }
+            memcpy(source->tombstones, segment->tombstones, size);
+        }
+    }
+
+    return XYTH_SUCCESS;
+}
+
+static void _XYTH_end_merge(struct XYTH_context *ctx,
+                            struct _XYTH_merge *merge)
+{
+    for (unsigned int i = 0; i < merge->num_segments; i++) {
+        free(merge->sources[i].tombstones);
+    }
+    _XYTH_free_segment(ctx->regions, &merge->merged);
+    free(merge->groups);
+}
+
+//
+// Builds the merged segment from the copies. It reads no mutable state of
+// 'ctx', so no lock is needed.
+//
+static XYTH_status _XYTH_build_merge(struct XYTH_context *ctx,
+                                     struct _XYTH_merge *merge)
+{
+    XYTH_status status;
+    struct _XYTH_database sources = {0};
+
+    sources.segments = merge->sources;
+    sources.num_segments = merge->num_segments;
+    status = _XYTH_list_groups(&sources, false, 0, merge->num_segments,
+                               &merge->groups, &merge->num_groups);
+    if (status == XYTH_SUCCESS) {
+        status = _XYTH_build_segment(ctx, &sources, false, 0,
+                                     merge->num_segments, merge->groups,
+                                     merge->num_groups, &merge->merged);
+    }
+    if (status == XYTH_SUCCESS) {
+        merge->merged.first_template = merge->sources[0].first_template;
+        merge->merged.end_template =
+            merge->sources[merge->num_segments - 1].end_template;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Replaces the merged segments by the one built. Templates removed while it
+// was built get their tombstones in it. The caller holds the index lock and
+// the enroll lock.
+//
+static XYTH_status _XYTH_install_merge(struct XYTH_context *ctx,
+                                       struct _XYTH_merge *merge)
+{
+    XYTH_status status = XYTH_SUCCESS;
+    struct _XYTH_database *db = &ctx->db;
+    bool with_tombstones = false;
+
+    for (unsigned int i = 0; i < merge->num_segments; i++) {
+        const struct _XYTH_segment *segment =
+            &db->segments[merge->first_segment + i];
+        const struct _XYTH_segment *source = &merge->sources[i];
+        unsigned int num_words =
+            (segment->end_template - segment->first_template + 63) / 64;
+
+        with_tombstones |= source->num_tombstones > 0;
+        if (segment->num_tombstones == source->num_tombstones ||
+            merge->merged.num_postings == 0) {
+            continue;
+        }
+        for (unsigned int word = 0; status == XYTH_SUCCESS && word < num_words;
+             word++) {
+            uint64_t bits = segment->tombstones[word];
+
+            if (source->tombstones != NULL) {
+                bits &= ~source->tombstones[word];
+            }
+            while (status == XYTH_SUCCESS && bits != 0) {
+                status = _XYTH_add_tombstone(
+                    &merge->merged,
+                    segment->first_template + word * 64 +
+                        __builtin_ctzll(bits));
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    if (status == XYTH_SUCCESS) {
+        _XYTH_replace_segments(ctx, merge->first_segment, merge->num_segments,
+                               &merge->merged);
+        memset(&merge->merged, 0, sizeof(merge->merged));
+        if (with_tombstones) {
+            _XYTH_clear_empty_groups(ctx, merge->groups, merge->num_groups);
+        }
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Merges segments in place. The caller holds every lock of the context.
+//
+static XYTH_status _XYTH_merge_segments(struct XYTH_context *ctx,
+                                        unsigned int first_segment,
+                                        unsigned int num_segments)
+{
+    XYTH_status status;
+    struct _XYTH_merge merge;
+
+    status = _XYTH_start_merge(&ctx->db, first_segment, num_segments, &merge);
+    if (status == XYTH_SUCCESS) {
+        status = _XYTH_build_merge(ctx, &merge);
+    }
+    if (status == XYTH_SUCCESS) {
+        status = _XYTH_install_merge(ctx, &merge);
+    }
+    _XYTH_end_merge(ctx, &merge);
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Runs one merge, if there is anything to merge, leaving whether there was in
+// 'merged'. The caller holds the merge lock only: the merged segment is built
+// while templates are added, removed and identified, and the other locks are
+// taken to install it. A merge task that finds nothing to merge lets the next
+// seal queue another.
+//
+static XYTH_status _XYTH_merge_next(struct XYTH_context *ctx, bool is_task,
+                                    bool *merged)
+{
+    XYTH_status status;
+    struct _XYTH_merge merge;
+    unsigned int first_segment, num_segments;
+    struct _XYTH_database *db = &ctx->db;
+
+    _XYTH_acquire_lock(ctx->enroll_lock);
+    *merged = _XYTH_plan_merge(db, &first_segment, &num_segments);
+    if (!*merged) {
+        if (is_task) {
+            ctx->merge_scheduled = false;
+        }
+        _XYTH_release_lock(ctx->enroll_lock);
+        return XYTH_SUCCESS;
+    }
+    status = _XYTH_start_merge(db, first_segment, num_segments, &merge);
+    _XYTH_release_lock(ctx->enroll_lock);
+
+    if (status == XYTH_SUCCESS) {
+        status = _XYTH_build_merge(ctx, &merge);
+    }
+
+    if (status == XYTH_SUCCESS) {
+        _XYTH_lock_index(ctx->index_lock);
+        _XYTH_acquire_lock(ctx->enroll_lock);
+        status = _XYTH_install_merge(ctx, &merge);
+        if (status == XYTH_SUCCESS && db->seal_threshold > 0 &&
+            db->next_template_id - db->head_first_template >=
+                db->seal_threshold) {
+            // The head left unsealed while the segments were full
+            XYTH_status debug_status = _XYTH_seal_head(ctx);
+            PRINT_IF_ERROR(debug_status);
+        }
+        _XYTH_release_lock(ctx->enroll_lock);
+        _XYTH_unlock_index(ctx->index_lock);
+    }
+    _XYTH_end_merge(ctx, &merge);
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Pool task merging the segments of a context until there is nothing left to
+// merge.
+//
+static void _XYTH_run_merge_task(struct _XYTH_task *task)
+{
+    struct _XYTH_merge_task *merge_task = (struct _XYTH_merge_task *)task;
+    struct XYTH_context *ctx = merge_task->ctx;
+    struct _XYTH_async *async = merge_task->async;
+    XYTH_status status = XYTH_SUCCESS;
+    bool merged = true;
+
+    _XYTH_acquire_lock(ctx->merge_lock);
+    while (status == XYTH_SUCCESS && merged) {
+        status = _XYTH_merge_next(ctx, true, &merged);
+    }
+    if (status != XYTH_SUCCESS) {
+        // The next seal tries again
+        _XYTH_acquire_lock(ctx->enroll_lock);
+        ctx->merge_scheduled = false;
+        _XYTH_release_lock(ctx->enroll_lock);
+    }
+    _XYTH_release_lock(ctx->merge_lock);
+
+    free(merge_task);
+    _XYTH_finish_background(async);
+}
+
+//
+// Queues a merge task on the context's pool, unless one is queued already or
+// there is nothing to merge. The caller holds the enroll lock.
+//
+static void _XYTH_schedule_merge(struct XYTH_context *ctx)
+{
+    struct _XYTH_merge_task *merge_task;
+    unsigned int first_segment, num_segments;
+
+    if (ctx->async == NULL || ctx->merge_scheduled ||
+        !_XYTH_plan_merge(&ctx->db, &first_segment, &num_segments)) {
+        return;
+    }
+
+    merge_task = malloc(sizeof(*merge_task));
+    if (merge_task == NULL) {
+        // Left to the next seal
+        PRINT_IF_ERROR(XYTH_E_NO_MEMORY);
+        return;
+    }
+    merge_task->task.run = _XYTH_run_merge_task;
+    merge_task->ctx = ctx;
+    merge_task->async = ctx->async;
+    ctx->merge_scheduled = true;
+    _XYTH_submit_background(ctx->async, &merge_task->task);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////  I N T E R N A L  ///////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// Collects the postings of a group in the head, if 'with_head', and in the
+// segments [first_segment, first_segment + num_segments). Returns the number
+// of runs found.
+//
+unsigned int _XYTH_gather_runs(const struct _XYTH_database *db,
+                               unsigned int group_index, bool with_head,
+                               unsigned int first_segment,
+                               unsigned int num_segments,
+                               struct _XYTH_posting_run *runs)
+{
+    unsigned int num_runs = 0;
+
+    if (with_head && db->group_length[group_index] > 0) {
+        _XYTH_head_run(db, group_index, &runs[num_runs++]);
+    }
+    for (unsigned int i = first_segment; i < first_segment + num_segments;
+         i++) {
+        if (_XYTH_segment_run(&db->segments[i], group_index,
+                              &runs[num_runs])) {
+            num_runs++;
+        }
+    }
+
+    return num_runs;
+}
+
+uint64_t _XYTH_count_live_postings(const struct _XYTH_posting_run *runs,
+                                   unsigned int num_runs)
+{
+    uint64_t count = 0;
+
+    for (unsigned int i = 0; i < num_runs; i++) {
+        count += _XYTH_copy_run(&runs[i], 0, runs[i].length, NULL, NULL, NULL);
+    }
+
+    return count;
+}
+
+//
+// Copies the live postings of a group's runs back to back. With partitions,
+// they are copied one partition at a time, so the copy stays sorted by
+// partition like each run is.
+//
+uint64_t _XYTH_copy_live_postings(const struct _XYTH_posting_run *runs,
+                                  unsigned int num_runs,
+                                  unsigned int num_partitions,
+                                  unsigned int *postings, uint32_t *residuals,
+                                  uint8_t *partitions)
+{
+    uint64_t count = 0;
+
+    if (partitions == NULL) {
+        for (unsigned int i = 0; i < num_runs; i++) {
+            count += _XYTH_copy_run(&runs[i], 0, runs[i].length,
+                                    postings + count,
+                                    residuals != NULL ? residuals + count
+                                                      : NULL,
+                                    NULL);
+        }
+        return count;
+    }
+
+    for (unsigned int partition = 0; partition < num_partitions; partition++) {
+        for (unsigned int i = 0; i < num_runs; i++) {
+            unsigned int begin = _XYTH_partition_lower_bound(
+                runs[i].partitions, 0, runs[i].length, partition);
+            unsigned int end = _XYTH_partition_lower_bound(
+                runs[i].partitions, begin, runs[i].length, partition + 1);
+
+            count += _XYTH_copy_run(
+                &runs[i], begin, end, postings + count,
+                residuals != NULL ? residuals + count : NULL,
+                partitions + count);
+        }
+    }
+
+    return count;
+}
+
+//
+// Makes room for 'num_groups' more groups in the list of the head's groups.
+//
+XYTH_status _XYTH_reserve_head_groups(struct _XYTH_database *db,
+                                      unsigned int num_groups)
+{
+    XYTH_status status = XYTH_SUCCESS;
+    uint64_t needed = (uint64_t)db->num_head_groups + num_groups;
+
+    if (needed > db->head_groups_size) {
+        uint64_t new_size =
+            db->head_groups_size > 0 ? 2 * (uint64_t)db->head_groups_size
+                                     : 1024;
+        unsigned int *new_groups;
+
+        if (new_size < needed) {
+            new_size = needed;
+        }
+        new_groups = realloc(db->head_groups, new_size * sizeof(*new_groups));
+        if (new_groups != NULL) {
+            db->head_groups = new_groups;
+            db->head_groups_size = new_size;
+        } else {
+            status = XYTH_E_NO_MEMORY;
+        }
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Seals the head into a new segment, and queues a merge on the context's pool
+// if the segments are due one. While the context holds SEGMENT_MAX_SEALED
+// segments, the head is left as it is until the queued merge makes room and
+// seals it. Without a pool, the segments are merged in place first, unless a
+// merge is running already.
+//
+XYTH_status _XYTH_seal_head(struct XYTH_context *ctx)
+{
+    XYTH_status status = XYTH_SUCCESS;
+    struct _XYTH_database *db = &ctx->db;
+    struct _XYTH_segment sealed;
+
+    if (db->num_segments == SEGMENT_MAX_SEALED) {
+        if (ctx->async != NULL) {
+            _XYTH_schedule_merge(ctx);
+            return XYTH_SUCCESS;
+        }
+        if (!_XYTH_try_lock(ctx->merge_lock)) {
+            return XYTH_SUCCESS;
+        }
+        status = _XYTH_merge_segments(ctx, 0, db->num_segments);
+        _XYTH_release_lock(ctx->merge_lock);
+        if (status != XYTH_SUCCESS) {
+            PRINT_IF_ERROR(status);
+            return status;
+        }
+    }
+
+    if (db->segments == NULL) {
+        db->segments = calloc(SEGMENT_MAX_SEALED, sizeof(*db->segments));
+        if (db->segments == NULL) {
+            status = XYTH_E_NO_MEMORY;
+        }
+    }
+    if (status == XYTH_SUCCESS) {
+        // The head groups are sorted in place, so the segment lists them
+        // ascending
+        qsort(db->head_groups, db->num_head_groups, sizeof(*db->head_groups),
+              _XYTH_compare_groups);
+        status = _XYTH_build_segment(ctx, db, true, 0, 0, db->head_groups,
+                                     db->num_head_groups, &sealed);
+    }
+
+    if (status == XYTH_SUCCESS) {
+        sealed.first_template = db->head_first_template;
+        sealed.end_template = db->next_template_id;
+        if (sealed.num_postings > 0) {
+            db->segments[db->num_segments++] = sealed;
+        } else {
+            _XYTH_free_segment(ctx->regions, &sealed);
+        }
+        _XYTH_clear_head(ctx);
+        _XYTH_schedule_merge(ctx);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Finds the sealed segment holding a template, NULL if the head holds it.
+//
+struct _XYTH_segment *_XYTH_find_segment(struct _XYTH_database *db,
+                                         unsigned int tpl_id)
+{
+    for (unsigned int i = 0; i < db->num_segments; i++) {
+        if (tpl_id >= db->segments[i].first_template &&
+            tpl_id < db->segments[i].end_template) {
+            return &db->segments[i];
+        }
+    }
+
+    return NULL;
+}
+
+XYTH_status _XYTH_add_tombstone(struct _XYTH_segment *segment,
+                                unsigned int tpl_id)
+{
+    unsigned int slot = tpl_id - segment->first_template;
+
+    if (segment->tombstones == NULL) {
+        unsigned int num_templates =
+            segment->end_template - segment->first_template;
+
+        segment->tombstones = calloc((num_templates + 63) / 64,
+                                     sizeof(uint64_t));
+        if (segment->tombstones == NULL) {
+            PRINT_IF_ERROR(XYTH_E_NO_MEMORY);
+            return XYTH_E_NO_MEMORY;
+        }
+    }
+
+    segment->tombstones[slot / 64] |= (uint64_t)1 << (slot % 64);
+    segment->num_tombstones++;
+    return XYTH_SUCCESS;
+}
+
+//
+// Frees the segments, and the list of the groups of the head.
+//
+void _XYTH_free_segments(struct XYTH_context *ctx)
+{
+    struct _XYTH_database *db = &ctx->db;
+
+    for (unsigned int i = 0; i < db->num_segments; i++) {
+        _XYTH_free_segment(ctx->regions, &db->segments[i]);
+    }
+    free(db->segments);
+    db->segments = NULL;
+    db->num_segments = 0;
+    free(db->head_groups);
+    db->head_groups = NULL;
+    db->num_head_groups = 0;
+    db->head_groups_size = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  P U B L I C  /////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+XYTH_status XYTH_merge_segments(struct XYTH_context *ctx)
+{
+    XYTH_status status;
+    bool merged = true;
+
+    if (ctx == NULL) {
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (!_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        status = XYTH_E_NOT_INITIALIZED;
+    } else if (ctx->shared != NULL) {
+        PERROR("context is attached to a published index\n");
+        status = XYTH_E_READ_ONLY;
+    } else {
+        _XYTH_acquire_lock(ctx->merge_lock);
+        status = XYTH_SUCCESS;
+        while (status == XYTH_SUCCESS && merged) {
+            status = _XYTH_merge_next(ctx, false, &merged);
+        }
+        _XYTH_release_lock(ctx->merge_lock);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_compact_index(struct XYTH_context *ctx)
+{
+    XYTH_status status;
+    struct _XYTH_database *db;
+    struct _XYTH_segment merged;
+    unsigned int *groups = NULL;
+    unsigned int num_groups;
+
+    if (ctx == NULL) {
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (!_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        status = XYTH_E_NOT_INITIALIZED;
+    } else if (ctx->shared != NULL) {
+        PERROR("context is attached to a published index\n");
+        status = XYTH_E_READ_ONLY;
+    } else {
+        db = &ctx->db;
+        _XYTH_acquire_lock(ctx->merge_lock);
+        _XYTH_lock_index(ctx->index_lock);
+        _XYTH_acquire_lock(ctx->enroll_lock);
+        status = XYTH_SUCCESS;
+        if (db->segments == NULL) {
+            db->segments = calloc(SEGMENT_MAX_SEALED, sizeof(*db->segments));
+            status = db->segments != NULL ? XYTH_SUCCESS : XYTH_E_NO_MEMORY;
+        }
+        if (status == XYTH_SUCCESS) {
+            status = _XYTH_list_groups(db, true, 0, db->num_segments, &groups,
+                                       &num_groups);
+        }
+        if (status == XYTH_SUCCESS) {
+            status = _XYTH_build_segment(ctx, db, true, 0, db->num_segments,
+                                         groups, num_groups, &merged);
+        }
+        if (status == XYTH_SUCCESS) {
+            merged.first_template = db->num_segments > 0
+                                        ? db->segments[0].first_template
+                                        : db->head_first_template;
+            merged.end_template = db->next_template_id;
+            _XYTH_replace_segments(ctx, 0, db->num_segments, &merged);
+            _XYTH_clear_head(ctx);
+            _XYTH_clear_empty_groups(ctx, groups, num_groups);
+        }
+        _XYTH_release_lock(ctx->enroll_lock);
+        _XYTH_unlock_index(ctx->index_lock);
+        _XYTH_release_lock(ctx->merge_lock);
+        free(groups);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
@@ -0,0 +1,172 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <context.h>
+#include <xyth.h>
+
+#include "common.h"
+#include "config.h"
+
+// Postings of one group, in the head or in one sealed segment
+struct _XYTH_posting_run {
+    const unsigned int *postings;
+    const uint32_t *residuals;  // NULL unless DB_INDEX_MULTIRES
+    const uint8_t *partitions;  // NULL if the context has a single partition
+    unsigned int length;
+    const struct _XYTH_segment *segment; // NULL for the head
+};
+
+//
+// Gets the postings of a group in the head.
+//
+static inline void _XYTH_head_run(const struct _XYTH_database *db,
+                                  unsigned int group_index,
+                                  struct _XYTH_posting_run *run)
+{
+    run->length = db->group_length[group_index];
+    run->postings = _XYTH_group_postings(db, group_index);
+    run->residuals = db->residuals != NULL || db->packed_residuals != NULL
+                         ? _XYTH_group_residuals(db, group_index)
+                         : NULL;
+    run->partitions = _XYTH_group_partitions(db, group_index);
+    run->segment = NULL;
+}
+
+//
+// Slot of 'directory' a group hashes to first (Fibonacci hashing, so the
+// top bits are taken).
+//
+static inline unsigned int _XYTH_directory_slot(unsigned int directory_bits,
+                                                unsigned int group_index)
+{
+    return (uint32_t)(group_index * 0x9e3779b1u) >> (32 - directory_bits);
+}
+
+//
+// Gets the postings of a group sealed in 'segment'. Returns false if it holds
+// none.
+//
+static inline bool _XYTH_segment_run(const struct _XYTH_segment *segment,
+                                     unsigned int group_index,
+                                     struct _XYTH_posting_run *run)
+{
+    unsigned int mask = (1u << segment->directory_bits) - 1;
+    unsigned int slot =
+        _XYTH_directory_slot(segment->directory_bits, group_index);
+    unsigned int held;
+    uint64_t begin;
+
+    // The directory is never full, so a free slot ends the probe
+    while ((held = segment->directory[slot]) != 0 &&
+           segment->groups[held - 1] != group_index) {
+        slot = (slot + 1) & mask;
+    }
+    if (held == 0) {
+        return false;
+    }
+
+    begin = segment->offsets[held - 1];
+    run->length = segment->offsets[held] - begin;
+    run->postings = segment->postings + begin;
+    run->residuals =
+        segment->residuals != NULL ? segment->residuals + begin : NULL;
+    run->partitions =
+        segment->partitions != NULL ? segment->partitions + begin : NULL;
+    run->segment = segment;
+    return true;
+}
+
+//
+// Checks whether the template of a posting sealed in 'segment' was removed.
+//
+static inline bool _XYTH_is_tombstoned(const struct _XYTH_segment *segment,
+                                       unsigned int posting)
+{
+    unsigned int slot =
+        posting / MAX_MINUTIAE_PER_TEMPLATE - segment->first_template;
+
+    return (segment->tombstones[slot / 64] >> (slot % 64)) & 1;
+}
+
+//
+// Postings of a group in the head and every sealed segment, removed templates
+// included.
+//
+static inline unsigned int
+_XYTH_total_group_length(const struct _XYTH_database *db,
+                         unsigned int group_index)
+{
+    unsigned int length = db->group_length[group_index];
+    struct _XYTH_posting_run run;
+
+    for (unsigned int i = 0; i < db->num_segments; i++) {
+        if (_XYTH_segment_run(&db->segments[i], group_index, &run)) {
+            length += run.length;
+        }
+    }
+
+    return length;
+}
+
+//
+// Lists a group the head starts allocating. Room was made for it with
+// _XYTH_reserve_head_groups().
+//
+static inline void _XYTH_add_head_group(struct _XYTH_database *db,
+                                        unsigned int group_index)
+{
+    db->head_groups[db->num_head_groups++] = group_index;
+}
+
+XYTH_status _XYTH_reserve_head_groups(struct _XYTH_database *db,
+                                      unsigned int num_groups);
+
+XYTH_status _XYTH_seal_head(struct XYTH_context *ctx);
+
+struct _XYTH_segment *_XYTH_find_segment(struct _XYTH_database *db,
+                                         unsigned int tpl_id);
+
+XYTH_status _XYTH_add_tombstone(struct _XYTH_segment *segment,
+                                unsigned int tpl_id);
+
+unsigned int _XYTH_gather_runs(const struct _XYTH_database *db,
+                               unsigned int group_index, bool with_head,
+                               unsigned int first_segment,
+                               unsigned int num_segments,
+                               struct _XYTH_posting_run *runs);
+
+uint64_t _XYTH_count_live_postings(const struct _XYTH_posting_run *runs,
+                                   unsigned int num_runs);
+
+uint64_t _XYTH_copy_live_postings(const struct _XYTH_posting_run *runs,
+                                  unsigned int num_runs,
+                                  unsigned int num_partitions,
+                                  unsigned int *postings, uint32_t *residuals,
+                                  uint8_t *partitions);
+
+void _XYTH_free_segments(struct XYTH_context *ctx);
+
+#endif // SEGMENT_H
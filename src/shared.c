@@ -0,0 +1,632 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Index published to shared memory. A builder process writes the whole index,
+// postings laid out back to back and records referring to their minutiae by
+// position, into one segment per generation. Worker processes map it
+// read-only and identify against it, so a host keeps a single copy however
+// many workers it runs. A small control object names the current generation;
+// workers swap to a newer one between queries.
+//
+
+// shm_open() and mmap() are POSIX
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <context.h>
+#include <debug.h>
+#include <xyth.h>
+
+#include "config.h"
+#include "lock.h"
+#include "segment.h"
+#include "shared.h"
+
+#define _XYTH_SHARED_MAGIC 0x58595448494e4458ULL // "XYTHINDX"
+#define _XYTH_SHARED_VERSION 3
+
+// Room for a name and its generation suffix
+#define _XYTH_SEGMENT_NAME_SIZE (SHARED_NAME_MAX + 16)
+
+// Sections start at a cache line
+#define _XYTH_SECTION_SIZE(size) (((size) + 63) / 64 * 64)
+
+static bool _XYTH_is_valid_name(const char *name)
+{
+    return name != NULL && name[0] == '/' && strchr(name + 1, '/') == NULL &&
+           strlen(name) <= SHARED_NAME_MAX;
+}
+
+static void _XYTH_segment_name(const char *name, uint32_t generation,
+                               char *segment)
+{
+    snprintf(segment, _XYTH_SEGMENT_NAME_SIZE, "%s.%u", name,
+             (unsigned int)generation);
+}
+
+//
+// Identifies 'db_cfg' across publishers: FNV-1a over its members, all of them
+// unsigned int. Generations built with the same configuration get the same
+// value.
+//
+static uint32_t _XYTH_hash_config(const struct XYTH_database_config *db_cfg)
+{
+    const unsigned int *words = (const unsigned int *)db_cfg;
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < sizeof(*db_cfg) / sizeof(words[0]); i++) {
+        for (unsigned int byte = 0; byte < 4; byte++) {
+            hash ^= (words[i] >> (8 * byte)) & 0xFF;
+            hash *= 16777619u;
+        }
+    }
+
+    return hash;
+}
+
+//
+// Maps the control object of 'name', creating it if 'writable'.
+//
+static XYTH_status _XYTH_map_control(const char *name, bool writable,
+                                     struct _XYTH_shared_control **control)
+{
+    struct stat st;
+    void *mapped = MAP_FAILED;
+    int fd = shm_open(name, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+
+    if (fd < 0) {
+        PERROR("shm_open(%s) failed, errno %d\n", name, errno);
+        return errno == ENOENT ? XYTH_E_NOT_FOUND : XYTH_ERROR;
+    }
+
+    if (fstat(fd, &st) == 0 &&
+        ((size_t)st.st_size >= sizeof(**control) ||
+         (writable && ftruncate(fd, sizeof(**control)) == 0))) {
+        mapped = mmap(NULL, sizeof(**control),
+                      writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                      MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (mapped == MAP_FAILED) {
+        // Created, but not published to yet
+        return writable ? XYTH_ERROR : XYTH_E_NOT_FOUND;
+    }
+
+    *control = mapped;
+    return XYTH_SUCCESS;
+}
+
+//
+// Places the sections of a generation holding the index of 'ctx', setting the
+// segment size.
+//
+static void _XYTH_layout_segment(struct XYTH_context *ctx,
+                                 struct _XYTH_shared_header *header)
+{
+    struct _XYTH_database *db = &ctx->db;
+    uint64_t num_words = (db->num_groups + 63) / 64;
+    uint64_t size = _XYTH_SECTION_SIZE(sizeof(*header));
+    struct _XYTH_posting_run runs[SEGMENT_MAX_SEALED + 1];
+
+    // The head and the sealed segments are published as a single index
+    header->num_postings = 0;
+    for (unsigned int i = 0; i < db->num_groups; i++) {
+        unsigned int num_runs =
+            _XYTH_gather_runs(db, i, true, 0, db->num_segments, runs);
+        header->num_postings += _XYTH_count_live_postings(runs, num_runs);
+    }
+    header->num_minutiae = 0;
+    for (unsigned int i = 0; i < db->num_records; i++) {
+        if (db->records[i].minutiae != NULL) {
+            header->num_minutiae += db->records[i].num_minutiae;
+        }
+    }
+
+    header->offsets_at = size;
+    size += _XYTH_SECTION_SIZE((db->num_groups + 1) * sizeof(uint64_t));
+    header->postings_at = size;
+    size += _XYTH_SECTION_SIZE(header->num_postings * sizeof(unsigned int));
+    header->residuals_at = 0;
+    if (db->residuals != NULL) {
+        header->residuals_at = size;
+        size += _XYTH_SECTION_SIZE(header->num_postings * sizeof(uint32_t));
+    }
+    header->partitions_at = 0;
+    if (db->partitions != NULL) {
+        header->partitions_at = size;
+        size += _XYTH_SECTION_SIZE(header->num_postings * sizeof(uint8_t));
+    }
+    header->group_length_at = size;
+    size += _XYTH_SECTION_SIZE(db->num_groups * sizeof(unsigned int));
+    header->occupancy_at = size;
+    size += _XYTH_SECTION_SIZE(num_words * sizeof(uint64_t));
+    header->summary_at = size;
+    size += _XYTH_SECTION_SIZE((num_words + 63) / 64 * sizeof(uint64_t));
+    header->records_at = size;
+    size += _XYTH_SECTION_SIZE(db->num_records *
+                               sizeof(struct _XYTH_shared_record));
+    header->minutiae_at = size;
+    size += _XYTH_SECTION_SIZE(header->num_minutiae * sizeof(struct _XYTH_xyt));
+
+    header->size = size;
+}
+
+//
+// Copies the index of 'ctx' into the sections of a mapped segment.
+//
+static void _XYTH_fill_segment(struct XYTH_context *ctx, char *base)
+{
+    struct _XYTH_database *db = &ctx->db;
+    const struct _XYTH_shared_header *header = (void *)base;
+    uint64_t *offsets = (uint64_t *)(base + header->offsets_at);
+    unsigned int *postings = (unsigned int *)(base + header->postings_at);
+    uint32_t *residuals = (uint32_t *)(base + header->residuals_at);
+    uint8_t *partitions = (uint8_t *)(base + header->partitions_at);
+    struct _XYTH_shared_record *records =
+        (struct _XYTH_shared_record *)(base + header->records_at);
+    struct _XYTH_xyt *minutiae =
+        (struct _XYTH_xyt *)(base + header->minutiae_at);
+    unsigned int *group_length =
+        (unsigned int *)(base + header->group_length_at);
+    struct _XYTH_posting_run runs[SEGMENT_MAX_SEALED + 1];
+    uint64_t num_words = (db->num_groups + 63) / 64;
+    uint64_t next = 0;
+
+    for (unsigned int i = 0; i < db->num_groups; i++) {
+        unsigned int num_runs =
+            _XYTH_gather_runs(db, i, true, 0, db->num_segments, runs);
+        uint64_t length = _XYTH_copy_live_postings(
+            runs, num_runs, ctx->db_cfg.num_partitions, postings + next,
+            header->residuals_at != 0 ? residuals + next : NULL,
+            header->partitions_at != 0 ? partitions + next : NULL);
+
+        offsets[i] = next;
+        group_length[i] = length;
+        next += length;
+    }
+    offsets[db->num_groups] = next;
+
+    memcpy(base + header->occupancy_at, db->occupancy,
+           num_words * sizeof(uint64_t));
+    memcpy(base + header->summary_at, db->occupancy_summary,
+           (num_words + 63) / 64 * sizeof(uint64_t));
+
+    next = 0;
+    for (unsigned int i = 0; i < db->num_records; i++) {
+        const struct _XYTH_template_record *record = &db->records[i];
+
+        records[i].num_minutiae = record->num_minutiae;
+        records[i].partition = record->partition;
+        records[i].subject = record->subject;
+        records[i].finger = record->finger;
+        records[i].num_neighbors = record->num_neighbors;
+        records[i].first_minutia = UINT64_MAX;
+        if (record->minutiae != NULL) {
+            records[i].first_minutia = next;
+            memcpy(minutiae + next, record->minutiae,
+                   record->num_minutiae * sizeof(*minutiae));
+            next += record->num_minutiae;
+        }
+    }
+}
+
+//
+// Writes a generation of the index of 'ctx' to the shared memory object
+// 'segment', replacing any left over.
+//
+static XYTH_status _XYTH_write_segment(struct XYTH_context *ctx,
+                                       const char *segment,
+                                       const struct _XYTH_shared_header *header)
+{
+    void *base = MAP_FAILED;
+    int fd = shm_open(segment, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0) {
+        PERROR("shm_open(%s) failed, errno %d\n", segment, errno);
+        return XYTH_ERROR;
+    }
+
+    if (ftruncate(fd, header->size) == 0) {
+        base = mmap(NULL, header->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                    0);
+    }
+    close(fd);
+
+    if (base == MAP_FAILED) {
+        PERROR("segment of %llu bytes not mapped\n",
+               (unsigned long long)header->size);
+        shm_unlink(segment);
+        return XYTH_E_NO_MEMORY;
+    }
+
+    memcpy(base, header, sizeof(*header));
+    _XYTH_fill_segment(ctx, base);
+    munmap(base, header->size);
+
+    return XYTH_SUCCESS;
+}
+
+//
+// Maps a generation read-only, checking it is one this library wrote.
+//
+static XYTH_status
+_XYTH_map_segment(const char *name, uint32_t generation,
+                  const struct _XYTH_shared_header **header)
+{
+    char segment[_XYTH_SEGMENT_NAME_SIZE];
+    const struct _XYTH_shared_header *mapped = MAP_FAILED;
+    struct stat st;
+    int fd;
+
+    _XYTH_segment_name(name, generation, segment);
+    fd = shm_open(segment, O_RDONLY, 0);
+    if (fd < 0) {
+        // Replaced by a newer generation since the control object was read
+        return errno == ENOENT ? XYTH_E_NOT_FOUND : XYTH_ERROR;
+    }
+
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(*mapped)) {
+        mapped = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (mapped == MAP_FAILED) {
+        return XYTH_ERROR;
+    }
+
+    if (mapped->magic != _XYTH_SHARED_MAGIC ||
+        mapped->version != _XYTH_SHARED_VERSION ||
+        mapped->generation != generation ||
+        mapped->size != (uint64_t)st.st_size) {
+        PERROR("%s is not a published index\n", segment);
+        munmap((void *)mapped, st.st_size);
+        return XYTH_E_INVALID_CONFIGURATION;
+    }
+
+    *header = mapped;
+    return XYTH_SUCCESS;
+}
+
+//
+// Maps the current generation, looking it up again if the builder replaced it
+// in the meantime.
+//
+static XYTH_status _XYTH_map_current(struct _XYTH_shared *shared,
+                                     const struct _XYTH_shared_header **header)
+{
+    XYTH_status status = XYTH_E_NOT_FOUND;
+
+    for (unsigned int i = 0;
+         i < SHARED_OPEN_ATTEMPTS && status == XYTH_E_NOT_FOUND; i++) {
+        uint32_t generation =
+            __atomic_load_n(&shared->control->generation, __ATOMIC_ACQUIRE);
+
+        if (generation == 0) {
+            break;
+        }
+        status = _XYTH_map_segment(shared->name, generation, header);
+    }
+
+    return status;
+}
+
+static void _XYTH_unmap_segment(const struct _XYTH_shared_header *header)
+{
+    munmap((void *)header, header->size);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////  I N T E R N A L  ///////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// Maps the current generation published under 'name'.
+//
+XYTH_status _XYTH_open_shared(const char *name, struct _XYTH_shared **shared)
+{
+    XYTH_status status;
+    struct _XYTH_shared_control *control;
+
+    if (!_XYTH_is_valid_name(name)) {
+        PERROR("invalid shared memory name\n");
+        return XYTH_E_INVALID_PARAMETER;
+    }
+
+    *shared = malloc(sizeof(**shared));
+    if (*shared == NULL) {
+        return XYTH_E_NO_MEMORY;
+    }
+    strcpy((*shared)->name, name);
+
+    status = _XYTH_map_control(name, false, &control);
+    if (status == XYTH_SUCCESS) {
+        (*shared)->control = control;
+        status = control->magic == _XYTH_SHARED_MAGIC
+                     ? _XYTH_map_current(*shared, &(*shared)->header)
+                     : XYTH_E_NOT_FOUND;
+        if (status != XYTH_SUCCESS) {
+            munmap(control, sizeof(*control));
+        }
+    }
+
+    if (status != XYTH_SUCCESS) {
+        free(*shared);
+        *shared = NULL;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+//
+// Points 'db' at the sections of a mapped generation. Only the records are
+// copied, as they refer to their minutiae by pointer.
+//
+XYTH_status _XYTH_view_shared(const struct _XYTH_shared_header *header,
+                              struct XYTH_database_config *db_cfg,
+                              struct _XYTH_database *db)
+{
+    const char *base = (const char *)header;
+    const struct _XYTH_shared_record *shared_records =
+        (const struct _XYTH_shared_record *)(base + header->records_at);
+    const struct _XYTH_xyt *minutiae =
+        (const struct _XYTH_xyt *)(base + header->minutiae_at);
+    struct _XYTH_template_record *records;
+
+    // One extra member, as malloc(0) may return NULL
+    records = malloc((header->num_records + 1) * sizeof(*records));
+    if (records == NULL) {
+        PRINT_IF_ERROR(XYTH_E_NO_MEMORY);
+        return XYTH_E_NO_MEMORY;
+    }
+
+    for (unsigned int i = 0; i < header->num_records; i++) {
+        records[i].num_minutiae = shared_records[i].num_minutiae;
+        records[i].partition = shared_records[i].partition;
+        records[i].subject = shared_records[i].subject;
+        records[i].finger = shared_records[i].finger;
+        records[i].num_neighbors = shared_records[i].num_neighbors;
+        records[i].minutiae =
+            shared_records[i].first_minutia == UINT64_MAX
+                ? NULL
+                : (struct _XYTH_xyt *)(minutiae +
+                                       shared_records[i].first_minutia);
+    }
+
+    *db_cfg = header->db_cfg;
+
+    memset(db, 0, sizeof(*db));
+    db->templates_counter = header->templates_counter;
+    db->next_template_id = header->next_template_id;
+    // No slack: each group holds exactly its postings
+    db->group_length = (unsigned int *)(base + header->group_length_at);
+    db->alloc_counter = db->group_length;
+    db->num_groups = header->num_groups;
+    db->x_groups = header->x_groups;
+    db->y_groups = header->y_groups;
+    db->t_groups = header->t_groups;
+    db->occupancy = (uint64_t *)(base + header->occupancy_at);
+    db->occupancy_summary = (uint64_t *)(base + header->summary_at);
+    db->records = records;
+    db->num_records = header->num_records;
+    // Results cached for another generation are not used
+    db->generation = header->generation;
+    // Nor are options prepared for another configuration
+    db->config_generation = header->config_hash;
+    db->offsets = (const uint64_t *)(base + header->offsets_at);
+    db->postings = (const unsigned int *)(base + header->postings_at);
+    if (header->residuals_at != 0) {
+        db->packed_residuals =
+            (const uint32_t *)(base + header->residuals_at);
+    }
+    if (header->partitions_at != 0) {
+        db->packed_partitions =
+            (const uint8_t *)(base + header->partitions_at);
+    }
+
+    return XYTH_SUCCESS;
+}
+
+//
+// Unmaps the index, releasing the records of 'db' (NULL if not viewed yet).
+//
+void _XYTH_close_shared(struct _XYTH_shared *shared, struct _XYTH_database *db)
+{
+    if (db != NULL) {
+        free(db->records);
+        memset(db, 0, sizeof(*db));
+    }
+    _XYTH_unmap_segment(shared->header);
+    munmap((void *)shared->control, sizeof(*shared->control));
+    free(shared);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////  P U B L I C  /////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+XYTH_status XYTH_publish_index(struct XYTH_context *ctx, const char *name,
+                               unsigned int *generation)
+{
+    XYTH_status status;
+    struct _XYTH_shared_control *control;
+    struct _XYTH_shared_header header;
+    char segment[_XYTH_SEGMENT_NAME_SIZE];
+
+    if (ctx == NULL || !_XYTH_is_valid_name(name)) {
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_TRUE(!_XYTH_is_valid_name(name));
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (!_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        status = XYTH_E_NOT_INITIALIZED;
+    } else if (ctx->shared != NULL) {
+        PERROR("context is attached to a published index\n");
+        status = XYTH_E_READ_ONLY;
+    } else {
+        _XYTH_acquire_lock(ctx->enroll_lock);
+        status = _XYTH_map_control(name, true, &control);
+        if (status == XYTH_SUCCESS) {
+            memset(&header, 0, sizeof(header));
+            header.magic = _XYTH_SHARED_MAGIC;
+            header.version = _XYTH_SHARED_VERSION;
+            header.generation =
+                control->magic == _XYTH_SHARED_MAGIC
+                    ? __atomic_load_n(&control->generation, __ATOMIC_RELAXED)
+                    : 0;
+            header.generation++;
+            header.db_cfg = ctx->db_cfg;
+            header.config_hash = _XYTH_hash_config(&ctx->db_cfg);
+            header.num_groups = ctx->db.num_groups;
+            header.x_groups = ctx->db.x_groups;
+            header.y_groups = ctx->db.y_groups;
+            header.t_groups = ctx->db.t_groups;
+            header.templates_counter = ctx->db.templates_counter;
+            header.next_template_id = ctx->db.next_template_id;
+            header.num_records = ctx->db.num_records;
+            _XYTH_layout_segment(ctx, &header);
+
+            _XYTH_segment_name(name, header.generation, segment);
+            status = _XYTH_write_segment(ctx, segment, &header);
+            if (status == XYTH_SUCCESS) {
+                control->magic = _XYTH_SHARED_MAGIC;
+                __atomic_store_n(&control->generation, header.generation,
+                                 __ATOMIC_RELEASE);
+                // Workers still using it keep their mapping
+                if (header.generation > 1) {
+                    _XYTH_segment_name(name, header.generation - 1, segment);
+                    shm_unlink(segment);
+                }
+                if (generation != NULL) {
+                    *generation = header.generation;
+                }
+            }
+            munmap(control, sizeof(*control));
+        }
+        _XYTH_release_lock(ctx->enroll_lock);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_unpublish_index(const char *name)
+{
+    XYTH_status status;
+    struct _XYTH_shared_control *control;
+    char segment[_XYTH_SEGMENT_NAME_SIZE];
+
+    if (!_XYTH_is_valid_name(name)) {
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_TRUE(!_XYTH_is_valid_name(name));
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    status = _XYTH_map_control(name, false, &control);
+    if (status == XYTH_SUCCESS) {
+        if (control->magic == _XYTH_SHARED_MAGIC) {
+            _XYTH_segment_name(name, control->generation, segment);
+            shm_unlink(segment);
+        }
+        munmap(control, sizeof(*control));
+    }
+    if (status == XYTH_SUCCESS || status == XYTH_E_NOT_FOUND) {
+        // Control objects never published to are removed too
+        status = shm_unlink(name) == 0 ? XYTH_SUCCESS : XYTH_E_NOT_FOUND;
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+XYTH_status XYTH_refresh_index(struct XYTH_context *ctx,
+                               unsigned int *generation)
+{
+    XYTH_status status;
+    struct _XYTH_shared *shared;
+    const struct _XYTH_shared_header *header;
+    struct XYTH_database_config db_cfg;
+    struct _XYTH_database db;
+
+    if (ctx == NULL) {
+        status = XYTH_E_INVALID_PARAMETER;
+        PRINT_IF_NULL(ctx);
+        PRINT_IF_ERROR(status);
+        return status;
+    }
+
+    if (!_XYTH_IS_CONTEXT_INITIALIZED(*ctx)) {
+        status = XYTH_E_NOT_INITIALIZED;
+    } else if (ctx->shared == NULL) {
+        PERROR("context is not attached to a published index\n");
+        status = XYTH_E_INVALID_PARAMETER;
+    } else {
+        shared = ctx->shared;
+        status = XYTH_SUCCESS;
+        if (__atomic_load_n(&shared->control->generation, __ATOMIC_ACQUIRE) !=
+            shared->header->generation) {
+            status = _XYTH_map_current(shared, &header);
+            if (status == XYTH_SUCCESS) {
+                status = _XYTH_view_shared(header, &db_cfg, &db);
+                if (status != XYTH_SUCCESS) {
+                    _XYTH_unmap_segment(header);
+                }
+            }
+            if (status == XYTH_SUCCESS) {
+                const struct _XYTH_shared_header *old_header = shared->header;
+                struct _XYTH_template_record *old_records = ctx->db.records;
+
+                // Identifications in flight finish on the generation they
+                // started on
+                _XYTH_lock_index(ctx->index_lock);
+                _XYTH_acquire_lock(ctx->enroll_lock);
+                ctx->db = db;
+                ctx->db_cfg = db_cfg;
+                shared->header = header;
+                _XYTH_release_lock(ctx->enroll_lock);
+                _XYTH_unlock_index(ctx->index_lock);
+
+                free(old_records);
+                _XYTH_unmap_segment(old_header);
+            }
+        }
+        if (status == XYTH_SUCCESS && generation != NULL) {
+            *generation = shared->header->generation;
+        }
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
@@ -0,0 +1,95 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SHARED_H
+#define SHARED_H
+
+#include <stdint.h>
+
+#include <context.h>
+#include <xyth.h>
+
+#include "config.h"
+
+// Names the current generation of a published index. Lives in the shared
+// memory object given to XYTH_publish_index(), each generation in one of its
+// own, named "<name>.<generation>".
+struct _XYTH_shared_control {
+    uint64_t magic;
+    uint32_t generation; // 0 until the first publication
+};
+
+// Start of a published generation. Sections are found at byte offsets from
+// it, so the segment can be mapped anywhere.
+struct _XYTH_shared_header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t generation;
+    uint64_t size; // in bytes, the whole segment
+    struct XYTH_database_config db_cfg;
+    uint32_t config_hash; // of 'db_cfg', config generation of attached contexts
+    uint32_t num_groups;
+    uint32_t x_groups;
+    uint32_t y_groups;
+    uint32_t t_groups;
+    uint32_t templates_counter;
+    uint32_t next_template_id;
+    uint32_t num_records;
+    uint64_t num_postings;
+    uint64_t num_minutiae;
+    // Section offsets (0 if absent)
+    uint64_t offsets_at;    // uint64_t per group, plus one
+    uint64_t postings_at;   // unsigned int per posting
+    uint64_t residuals_at;  // uint32_t per posting
+    uint64_t partitions_at; // uint8_t per posting
+    uint64_t group_length_at;
+    uint64_t occupancy_at;
+    uint64_t summary_at;
+    uint64_t records_at; // struct _XYTH_shared_record per template id
+    uint64_t minutiae_at;
+};
+
+// Template record, its minutiae referenced by position rather than pointer
+struct _XYTH_shared_record {
+    uint32_t num_minutiae;
+    uint32_t partition;
+    uint32_t subject;
+    uint32_t finger;
+    uint32_t num_neighbors;
+    uint64_t first_minutia; // UINT64_MAX if the id is not in use
+};
+
+// A worker's mapping of a published index
+struct _XYTH_shared {
+    char name[SHARED_NAME_MAX + 1];
+    const struct _XYTH_shared_control *control;
+    const struct _XYTH_shared_header *header; // Generation in use
+};
+
+XYTH_status _XYTH_open_shared(const char *name, struct _XYTH_shared **shared);
+
+XYTH_status _XYTH_view_shared(const struct _XYTH_shared_header *header,
+                              struct XYTH_database_config *db_cfg,
+                              struct _XYTH_database *db);
+
+void _XYTH_close_shared(struct _XYTH_shared *shared,
+                        struct _XYTH_database *db);
+
+#endif // SHARED_H
@@ -0,0 +1,105 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <stdlib.h>
+
+#include <debug.h>
+
+#include "subject.h"
+
+//
+// Numbers the subjects of the templates in use, in template id order. Subject
+// ids are mapped to slots through an open-addressing table, sized to at least
+// twice the number of templates, so probes stay short.
+//
+XYTH_status _XYTH_create_subjects(struct XYTH_context *ctx,
+                                  struct _XYTH_subjects *subjects)
+{
+    XYTH_status status = XYTH_E_NO_MEMORY;
+    unsigned int num_templates = ctx->db.next_template_id;
+    unsigned int table_size = 2;
+    unsigned int *table_keys;
+    unsigned int *table_slots;
+
+    while (table_size < 2 * num_templates) {
+        table_size *= 2;
+    }
+
+    subjects->num_templates = num_templates;
+    subjects->num_subjects = 0;
+    // One extra member, as malloc(0) may return NULL
+    subjects->template_slots =
+        malloc((num_templates + 1) * sizeof(unsigned int));
+    subjects->ids = malloc((num_templates + 1) * sizeof(unsigned int));
+    table_keys = malloc(table_size * sizeof(unsigned int));
+    table_slots = malloc(table_size * sizeof(unsigned int));
+
+    if (subjects->template_slots != NULL && subjects->ids != NULL &&
+        table_keys != NULL && table_slots != NULL) {
+        for (unsigned int i = 0; i < table_size; i++) {
+            table_keys[i] = XYTH_RESERVED_SUBJECT_ID;
+        }
+
+        for (unsigned int tpl_id = 0; tpl_id < num_templates; tpl_id++) {
+            unsigned int subject = XYTH_RESERVED_SUBJECT_ID;
+            unsigned int bucket;
+
+            subjects->template_slots[tpl_id] = XYTH_RESERVED_SUBJECT_ID;
+            if (tpl_id < ctx->db.num_records &&
+                ctx->db.records[tpl_id].minutiae != NULL) {
+                subject = ctx->db.records[tpl_id].subject;
+            }
+            if (subject == XYTH_RESERVED_SUBJECT_ID) {
+                continue;
+            }
+
+            // Fibonacci hashing, then linear probing
+            bucket = (subject * 2654435769u) & (table_size - 1);
+            while (table_keys[bucket] != XYTH_RESERVED_SUBJECT_ID &&
+                   table_keys[bucket] != subject) {
+                bucket = (bucket + 1) & (table_size - 1);
+            }
+            if (table_keys[bucket] == XYTH_RESERVED_SUBJECT_ID) {
+                table_keys[bucket] = subject;
+                table_slots[bucket] = subjects->num_subjects;
+                subjects->ids[subjects->num_subjects++] = subject;
+            }
+            subjects->template_slots[tpl_id] = table_slots[bucket];
+        }
+        status = XYTH_SUCCESS;
+    }
+
+    free(table_keys);
+    free(table_slots);
+    if (status != XYTH_SUCCESS) {
+        _XYTH_destroy_subjects(subjects);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+void _XYTH_destroy_subjects(struct _XYTH_subjects *subjects)
+{
+    free(subjects->template_slots);
+    free(subjects->ids);
+    subjects->template_slots = NULL;
+    subjects->ids = NULL;
+}
@@ -0,0 +1,41 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SUBJECT_H
+#define SUBJECT_H
+
+#include <xyth.h>
+
+// The subjects of a context's templates, numbered in dense slots, so scores
+// can be fused per subject.
+struct _XYTH_subjects {
+    unsigned int *template_slots; // Slot of each template id's subject,
+                                  // XYTH_RESERVED_SUBJECT_ID if not set
+    unsigned int num_templates;   // Members of 'template_slots'
+    unsigned int *ids;            // Subject ids, by slot
+    unsigned int num_subjects;
+};
+
+XYTH_status _XYTH_create_subjects(struct XYTH_context *ctx,
+                                  struct _XYTH_subjects *subjects);
+
+void _XYTH_destroy_subjects(struct _XYTH_subjects *subjects);
+
+#endif // SUBJECT_H
@@ -0,0 +1,90 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <stdlib.h>
+
+#include <debug.h>
+
+#include "subset.h"
+
+//
+// Creates a subset from a list of template ids.
+// - Ids that are not below 'num_template_ids' are ignored, and so are
+//   repeated ids.
+//
+XYTH_status _XYTH_create_subset(unsigned int num_template_ids,
+                                unsigned int num_ids, const unsigned int *ids,
+                                struct _XYTH_subset *subset)
+{
+    XYTH_status status;
+    unsigned int num_words = (num_template_ids + 63) / 64;
+    unsigned int num_templates = 0;
+
+    // One extra word, so an empty context still gets a valid bitmap
+    subset->bitmap = calloc(num_words + 1, sizeof(uint64_t));
+    subset->rank = malloc((num_words + 1) * sizeof(unsigned int));
+    subset->ids = NULL;
+
+    if (subset->bitmap != NULL && subset->rank != NULL) {
+        for (unsigned int i = 0; i < num_ids; i++) {
+            if (ids[i] < num_template_ids) {
+                subset->bitmap[ids[i] / 64] |= (uint64_t)1 << (ids[i] % 64);
+            }
+        }
+
+        for (unsigned int i = 0; i <= num_words; i++) {
+            subset->rank[i] = num_templates;
+            num_templates += __builtin_popcountll(subset->bitmap[i]);
+        }
+        subset->num_templates = num_templates;
+
+        subset->ids = malloc((num_templates + 1) * sizeof(unsigned int));
+        if (subset->ids != NULL) {
+            unsigned int slot = 0;
+            for (unsigned int i = 0; i < num_words; i++) {
+                for (uint64_t word = subset->bitmap[i]; word != 0;
+                     word &= word - 1) {
+                    subset->ids[slot++] = i * 64 + __builtin_ctzll(word);
+                }
+            }
+            status = XYTH_SUCCESS;
+        } else {
+            status = XYTH_E_NO_MEMORY;
+        }
+    } else {
+        status = XYTH_E_NO_MEMORY;
+    }
+
+    if (status != XYTH_SUCCESS) {
+        _XYTH_destroy_subset(subset);
+    }
+
+    PRINT_IF_ERROR(status);
+    return status;
+}
+
+void _XYTH_destroy_subset(struct _XYTH_subset *subset)
+{
+    free(subset->bitmap);
+    free(subset->rank);
+    free(subset->ids);
+    subset->bitmap = NULL;
+    subset->rank = NULL;
+    subset->ids = NULL;
+}
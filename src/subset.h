@@ -0,0 +1,60 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#ifndef SUBSET_H
+#define SUBSET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <xyth.h>
+
+// A subset of a context's template ids. Scores are kept for the members only,
+// in dense slots numbered by the rank of each id in the bitmap.
+struct _XYTH_subset {
+    uint64_t *bitmap;           // One bit per template id
+    unsigned int *rank;         // Members before each bitmap word
+    unsigned int *ids;          // Members, by slot
+    unsigned int num_templates; // Members
+};
+
+XYTH_status _XYTH_create_subset(unsigned int num_template_ids,
+                                unsigned int num_ids, const unsigned int *ids,
+                                struct _XYTH_subset *subset);
+
+void _XYTH_destroy_subset(struct _XYTH_subset *subset);
+
+//
+// Maps a template id to its slot. Returns false if it is not a member.
+//
+static inline bool _XYTH_subset_slot(const struct _XYTH_subset *subset,
+                                     unsigned int tpl_id, unsigned int *slot)
+{
+    uint64_t word = subset->bitmap[tpl_id / 64];
+    uint64_t bit = (uint64_t)1 << (tpl_id % 64);
+
+    if ((word & bit) == 0) {
+        return false;
+    }
+
+    *slot = subset->rank[tpl_id / 64] + __builtin_popcountll(word & (bit - 1));
+    return true;
+}
+
+#endif // SUBSET_H
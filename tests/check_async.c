@@ -0,0 +1,217 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// poll() is POSIX
+#define _POSIX_C_SOURCE 200112L
+
+#include <check.h>
+#include <poll.h>
+#include <xyth.h>
+
+#define XYT_OK                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+#define NUM_IDENTIFY_AS 8
+
+struct XYTH_template tpl_as = {0};
+struct XYTH_context ctx_as = {0};
+
+void async_setup()
+{
+    XYTH_status status;
+
+    status = XYTH_template_from_xyt(XYT_OK, &tpl_as, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&ctx_as, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&ctx_as, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+void async_teardown()
+{
+    XYTH_destroy_context(&ctx_as);
+    XYTH_destroy_template(&tpl_as);
+}
+
+// Waits on the completion fd, then takes the completion
+static void wait_completion(struct XYTH_completion *completion)
+{
+    XYTH_status status;
+    struct pollfd pfd;
+
+    status = XYTH_get_completion_fd(&ctx_as, &pfd.fd);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    pfd.events = POLLIN;
+    ck_assert_int_eq(poll(&pfd, 1, 10000), 1);
+
+    status = XYTH_poll_completion(&ctx_as, completion);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+START_TEST(no_workers)
+{
+    XYTH_status status;
+    struct XYTH_completion completion;
+    unsigned int ticket;
+
+    status = XYTH_submit_identify(&ctx_as, &tpl_as, &ticket);
+    ck_assert_int_eq(status, XYTH_E_NOT_INITIALIZED);
+
+    status = XYTH_poll_completion(&ctx_as, &completion);
+    ck_assert_int_eq(status, XYTH_E_NOT_INITIALIZED);
+
+    status = XYTH_set_workers(&ctx_as, 100000);
+    ck_assert_int_eq(status, XYTH_E_VALUE_OUT_OF_RANGE);
+}
+END_TEST
+
+START_TEST(submit_and_poll)
+{
+    XYTH_status status;
+    struct XYTH_completion completion;
+    unsigned int add_ticket, tpl_id;
+    unsigned int tickets[NUM_IDENTIFY_AS];
+    bool completed[NUM_IDENTIFY_AS] = {false};
+
+    status = XYTH_set_workers(&ctx_as, 4);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    // Nothing submitted, nothing completed
+    status = XYTH_poll_completion(&ctx_as, &completion);
+    ck_assert_int_eq(status, XYTH_E_NOT_FOUND);
+
+    status = XYTH_submit_add(&ctx_as, &tpl_as, &add_ticket);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    wait_completion(&completion);
+    ck_assert_int_eq(completion.ticket, add_ticket);
+    ck_assert_int_eq(completion.kind, XYTH_REQUEST_ADD);
+    ck_assert_int_eq(completion.status, XYTH_SUCCESS);
+    tpl_id = completion.tpl_id;
+    ck_assert_int_ne(tpl_id, XYTH_RESERVED_TEMPLATE_ID);
+
+    for (unsigned int i = 0; i < NUM_IDENTIFY_AS; i++) {
+        status = XYTH_submit_identify(&ctx_as, &tpl_as, &tickets[i]);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+
+    // Completions may come in any order, each once
+    for (unsigned int i = 0; i < NUM_IDENTIFY_AS; i++) {
+        unsigned int j;
+
+        wait_completion(&completion);
+        ck_assert_int_eq(completion.kind, XYTH_REQUEST_IDENTIFY);
+        ck_assert_int_eq(completion.status, XYTH_SUCCESS);
+        ck_assert_int_eq(completion.num_candidates, 1);
+        ck_assert_int_eq(completion.candidates[0].tpl_id, tpl_id);
+        ck_assert_int_eq(completion.candidates[0].template_score,
+                         tpl_as.num_minutiae);
+
+        for (j = 0; j < NUM_IDENTIFY_AS; j++) {
+            if (tickets[j] == completion.ticket) {
+                break;
+            }
+        }
+        ck_assert(j < NUM_IDENTIFY_AS);
+        ck_assert(!completed[j]);
+        completed[j] = true;
+    }
+
+    status = XYTH_poll_completion(&ctx_as, &completion);
+    ck_assert_int_eq(status, XYTH_E_NOT_FOUND);
+
+    status = XYTH_set_workers(&ctx_as, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+END_TEST
+
+START_TEST(sync_changes_while_pending)
+{
+    XYTH_status status;
+    struct XYTH_completion completion;
+    unsigned int ticket, tpl_id;
+
+    status = XYTH_set_workers(&ctx_as, 4);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    for (unsigned int i = 0; i < NUM_IDENTIFY_AS; i++) {
+        status = XYTH_submit_identify(&ctx_as, &tpl_as, &ticket);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+
+    // Groups grow and shrink under the workers, which wait their turn
+    for (unsigned int i = 0; i < NUM_IDENTIFY_AS; i++) {
+        status = XYTH_add_template(&ctx_as, &tpl_as, &tpl_id);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+        status = XYTH_remove_template(&ctx_as, &tpl_as, tpl_id);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+
+    // The template added by 'submit_and_poll' is always found
+    for (unsigned int i = 0; i < NUM_IDENTIFY_AS; i++) {
+        wait_completion(&completion);
+        ck_assert_int_eq(completion.kind, XYTH_REQUEST_IDENTIFY);
+        ck_assert_int_eq(completion.status, XYTH_SUCCESS);
+        ck_assert_int_ge(completion.num_candidates, 1);
+    }
+
+    status = XYTH_set_workers(&ctx_as, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+END_TEST
+
+START_TEST(pending_at_destroy)
+{
+    XYTH_status status;
+    unsigned int ticket;
+
+    status = XYTH_set_workers(&ctx_as, 2);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    // Destroying the context waits for the requests still queued
+    for (unsigned int i = 0; i < NUM_IDENTIFY_AS; i++) {
+        status = XYTH_submit_identify(&ctx_as, &tpl_as, &ticket);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+}
+END_TEST
+
+TCase *async_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("Async");
+
+    tcase_add_unchecked_fixture(tcase, async_setup, async_teardown);
+
+    tcase_add_test(tcase, no_workers);
+    tcase_add_test(tcase, submit_and_poll);
+    tcase_add_test(tcase, sync_changes_while_pending);
+    tcase_add_test(tcase, pending_at_destroy);
+
+    return tcase;
+}
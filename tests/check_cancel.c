@@ -0,0 +1,170 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// poll() is POSIX
+#define _POSIX_C_SOURCE 200112L
+
+#include <check.h>
+#include <poll.h>
+#include <xyth.h>
+
+#define XYT_OK                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+#define NUM_REQUESTS_CN 8
+
+struct XYTH_template tpl_cn = {0};
+struct XYTH_context ctx_cn = {0};
+struct XYTH_cancel_token *token_cn;
+unsigned int tpl_id_cn;
+
+void cancel_setup()
+{
+    XYTH_status status;
+
+    status = XYTH_template_from_xyt(XYT_OK, &tpl_cn, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&ctx_cn, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&ctx_cn, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_add_template(&ctx_cn, &tpl_cn, &tpl_id_cn);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_cancel_token(&token_cn);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+void cancel_teardown()
+{
+    XYTH_destroy_cancel_token(token_cn);
+    XYTH_destroy_template(&tpl_cn);
+    XYTH_destroy_context(&ctx_cn);
+}
+
+START_TEST(cancelled_token)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[1];
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates = 1;
+
+    status = XYTH_identify_cancellable(&ctx_cn, &tpl_cn, token_cn,
+                                       &num_candidates, candidates, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(candidates[0].tpl_id, tpl_id_cn);
+
+    XYTH_cancel(token_cn);
+    num_candidates = 1;
+    status = XYTH_identify_cancellable(&ctx_cn, &tpl_cn, token_cn,
+                                       &num_candidates, candidates, &stats);
+    ck_assert_int_eq(status, XYTH_E_CANCELLED);
+
+    // A reset token can be used again
+    XYTH_reset_cancel_token(token_cn);
+    num_candidates = 1;
+    status = XYTH_identify_cancellable(&ctx_cn, &tpl_cn, token_cn,
+                                       &num_candidates, candidates, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 1);
+}
+END_TEST
+
+START_TEST(cancel_request)
+{
+    XYTH_status status;
+    struct XYTH_completion completion;
+    unsigned int tickets[NUM_REQUESTS_CN];
+    bool cancelled[NUM_REQUESTS_CN];
+
+    status = XYTH_set_workers(&ctx_cn, 1);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    for (unsigned int i = 0; i < NUM_REQUESTS_CN; i++) {
+        status = XYTH_submit_identify(&ctx_cn, &tpl_cn, &tickets[i]);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+
+    // Requests may complete before being cancelled
+    for (unsigned int i = 0; i < NUM_REQUESTS_CN; i++) {
+        status = XYTH_cancel_request(&ctx_cn, tickets[i]);
+        ck_assert(status == XYTH_SUCCESS || status == XYTH_E_NOT_FOUND);
+        cancelled[i] = status == XYTH_SUCCESS;
+    }
+
+    for (unsigned int i = 0; i < NUM_REQUESTS_CN; i++) {
+        struct pollfd pfd;
+        unsigned int j;
+
+        status = XYTH_get_completion_fd(&ctx_cn, &pfd.fd);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+        pfd.events = POLLIN;
+        ck_assert_int_eq(poll(&pfd, 1, 10000), 1);
+        status = XYTH_poll_completion(&ctx_cn, &completion);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+
+        for (j = 0; j < NUM_REQUESTS_CN; j++) {
+            if (tickets[j] == completion.ticket) {
+                break;
+            }
+        }
+        ck_assert(j < NUM_REQUESTS_CN);
+        if (cancelled[j]) {
+            // Unless it was about to complete
+            ck_assert(completion.status == XYTH_E_CANCELLED ||
+                      completion.status == XYTH_SUCCESS);
+        } else {
+            ck_assert_int_eq(completion.status, XYTH_SUCCESS);
+        }
+
+        // Completed requests can no longer be cancelled
+        status = XYTH_cancel_request(&ctx_cn, completion.ticket);
+        ck_assert_int_eq(status, XYTH_E_NOT_FOUND);
+    }
+
+    status = XYTH_cancel_request(&ctx_cn, tickets[NUM_REQUESTS_CN - 1] + 1);
+    ck_assert_int_eq(status, XYTH_E_NOT_FOUND);
+
+    status = XYTH_set_workers(&ctx_cn, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+END_TEST
+
+TCase *cancel_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("Cancel");
+
+    tcase_add_unchecked_fixture(tcase, cancel_setup, cancel_teardown);
+
+    tcase_add_test(tcase, cancelled_token);
+    tcase_add_test(tcase, cancel_request);
+
+    return tcase;
+}
@@ -35,6 +35,75 @@ TCase *remove_template_tcase(void);
 // From check_identify.c
 TCase *identify_tcase(void);
 
+// From check_identify_ex.c
+TCase *identify_ex_tcase(void);
+
+// From check_result_cache.c
+TCase *result_cache_tcase(void);
+
+// From check_enroll_expansion.c
+TCase *enroll_expansion_tcase(void);
+
+// From check_multires.c
+TCase *multires_tcase(void);
+
+// From check_group_policy.c
+TCase *group_policy_tcase(void);
+
+// From check_probe_plan.c
+TCase *probe_plan_tcase(void);
+
+// From check_identify_in_subset.c
+TCase *identify_in_subset_tcase(void);
+
+// From check_partitions.c
+TCase *partitions_tcase(void);
+
+// From check_identify_multi.c
+TCase *identify_multi_tcase(void);
+
+// From check_enroll_if_unique.c
+TCase *enroll_if_unique_tcase(void);
+
+// From check_identify_streaming.c
+TCase *identify_streaming_tcase(void);
+
+// From check_identify_bounded.c
+TCase *identify_bounded_tcase(void);
+
+// From check_async.c
+TCase *async_tcase(void);
+
+// From check_match_options.c
+TCase *match_options_tcase(void);
+
+// From check_cancel.c
+TCase *cancel_tcase(void);
+
+// From check_pool.c
+TCase *pool_tcase(void);
+
+// From check_numa.c
+TCase *numa_tcase(void);
+
+// From check_huge_pages.c
+TCase *huge_pages_tcase(void);
+
+// From check_shared_index.c
+TCase *shared_index_tcase(void);
+
+// From check_segments.c
+TCase *segments_tcase(void);
+
+// From check_reconfigure.c
+TCase *reconfigure_tcase(void);
+
+// From check_merge.c
+TCase *merge_tcase(void);
+
+// From check_occupancy.c
+TCase *occupancy_tcase(void);
+
 Suite *context_suite(void)
 {
     Suite *suite;
@@ -51,5 +120,97 @@ Suite *context_suite(void)
     tcase_set_timeout(id_tcase, 120);
     suite_add_tcase(suite, id_tcase);
 
+    id_tcase = identify_ex_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = result_cache_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = enroll_expansion_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = multires_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = group_policy_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = probe_plan_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = identify_in_subset_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = partitions_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = identify_multi_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = enroll_if_unique_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = identify_streaming_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = identify_bounded_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = async_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = match_options_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = cancel_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = pool_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = numa_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = huge_pages_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = shared_index_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = segments_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = reconfigure_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = merge_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
+    id_tcase = occupancy_tcase();
+    tcase_set_timeout(id_tcase, 120);
+    suite_add_tcase(suite, id_tcase);
+
     return suite;
 }
@@ -0,0 +1,174 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <check.h>
+#include <xyth.h>
+
+#define XYT_OK                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+struct XYTH_template tpl_ee = {0};
+struct XYTH_context ctx_ee = {0};
+unsigned int tpl_id_ee;
+
+void enroll_expansion_setup()
+{
+    XYTH_status status;
+    struct XYTH_database_config cfg;
+
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_DENSITY(cfg, 4, 8);
+    XYTH_DB_CONFIG_SET_ENROLL_EXPANSION(cfg, 5, 5, 7);
+
+    status = XYTH_template_from_xyt(XYT_OK, &tpl_ee, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&ctx_ee, &cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&ctx_ee, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_add_template(&ctx_ee, &tpl_ee, &tpl_id_ee);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+void enroll_expansion_teardown()
+{
+    XYTH_destroy_template(&tpl_ee);
+    XYTH_destroy_context(&ctx_ee);
+}
+
+START_TEST(expanded_identify)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[2];
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates = 2;
+    unsigned int num_neighbors = 0;
+
+    for (unsigned int i = 0; i < tpl_ee.num_minutiae; i++) {
+        num_neighbors += tpl_ee.minutiae[i].num_neighbors;
+    }
+
+    status = XYTH_identify_ex(&ctx_ee, &tpl_ee, &num_candidates, candidates,
+                              &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(candidates[0].tpl_id, tpl_id_ee);
+    ck_assert_int_eq(candidates[0].template_score, tpl_ee.num_minutiae);
+    // A single group is read per probe neighbor
+    ck_assert_int_le(stats.groups_visited, num_neighbors);
+}
+END_TEST
+
+START_TEST(database_stats)
+{
+    XYTH_status status;
+    struct XYTH_database_stats stats;
+    struct XYTH_context query_ctx = {0};
+    struct XYTH_database_stats query_stats;
+    struct XYTH_database_config cfg;
+    unsigned int tpl_id;
+
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_DENSITY(cfg, 4, 8);
+
+    status = XYTH_create_context(&query_ctx, &cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_add_template(&query_ctx, &tpl_ee, &tpl_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_get_database_stats(&query_ctx, &query_stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_get_database_stats(&ctx_ee, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    ck_assert_int_eq(stats.num_templates, 1);
+    ck_assert_int_eq(stats.num_groups, query_stats.num_groups);
+    ck_assert_int_gt(stats.num_postings, query_stats.num_postings);
+    ck_assert_int_gt(stats.occupied_groups, query_stats.occupied_groups);
+    ck_assert_int_ge(stats.alloc_postings, stats.num_postings);
+    ck_assert_int_gt(stats.index_bytes, query_stats.index_bytes);
+    ck_assert_int_eq(stats.record_bytes, query_stats.record_bytes);
+
+    XYTH_destroy_context(&query_ctx);
+
+    status = XYTH_get_database_stats(NULL, &stats);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+    status = XYTH_get_database_stats(&ctx_ee, NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+}
+END_TEST
+
+START_TEST(expanded_remove)
+{
+    XYTH_status status;
+    struct XYTH_database_stats stats;
+    unsigned int num_ids = 1;
+    unsigned int ids[1];
+
+    status = XYTH_remove_template(&ctx_ee, &tpl_ee, tpl_id_ee);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_get_database_stats(&ctx_ee, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(stats.num_postings, 0);
+    ck_assert_int_eq(stats.occupied_groups, 0);
+
+    status = XYTH_identify(&ctx_ee, &tpl_ee, &num_ids, ids);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_ids, 0);
+}
+END_TEST
+
+START_TEST(invalid_expansion)
+{
+    XYTH_status status;
+    struct XYTH_context ctx = {0};
+    struct XYTH_database_config cfg;
+
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_ENROLL_EXPANSION(cfg, 5, 5, 180);
+
+    status = XYTH_create_context(&ctx, &cfg);
+    ck_assert_int_eq(status, XYTH_E_INVALID_CONFIGURATION);
+}
+END_TEST
+
+TCase *enroll_expansion_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("EnrollExpansion");
+
+    tcase_add_unchecked_fixture(tcase, enroll_expansion_setup,
+                                enroll_expansion_teardown);
+
+    tcase_add_test(tcase, expanded_identify);
+    tcase_add_test(tcase, database_stats);
+    tcase_add_test(tcase, expanded_remove);
+    tcase_add_test(tcase, invalid_expansion);
+
+    return tcase;
+}
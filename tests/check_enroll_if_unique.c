@@ -0,0 +1,273 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <check.h>
+#include <pthread.h>
+#include <xyth.h>
+
+#define XYT_OK1                                                                \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+#define XYT_OK2                                                                \
+    "1  2 90\n  4  5 90\n  7  8 90\n 10 11 90\n 13 14 90\n \
+                16 17 90\n 19 20 90\n 22 23 90\n 25 26 90\n \
+                28 29 90\n 31 32 90\n 34 35 90\n 37 38 90\n \
+                40 41 90\n 43 44 90\n 46 47 90\n 49 50 90\n \
+                52 53 90\n 55 56 90\n 58 59 90\n 61 62 90\n"
+
+#define NUM_ENROLLERS 4
+
+struct XYTH_template tpl1_eu = {0};
+struct XYTH_template tpl2_eu = {0};
+struct XYTH_context ctx_eu = {0};
+
+void enroll_if_unique_setup()
+{
+    XYTH_status status;
+
+    status = XYTH_template_from_xyt(XYT_OK1, &tpl1_eu, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_template_from_xyt(XYT_OK2, &tpl2_eu, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+void enroll_if_unique_teardown()
+{
+    XYTH_destroy_template(&tpl1_eu);
+    XYTH_destroy_template(&tpl2_eu);
+}
+
+static void create_context_eu(void)
+{
+    XYTH_status status;
+
+    status = XYTH_create_context(&ctx_eu, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&ctx_eu, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+START_TEST(enroll_unique)
+{
+    XYTH_status status;
+    unsigned int tpl_id1, tpl_id2, tpl_id;
+    unsigned int duplicates[2];
+    unsigned int num_duplicates = 2;
+    unsigned int tpl_counter;
+
+    create_context_eu();
+
+    status = XYTH_enroll_if_unique(&ctx_eu, &tpl1_eu, &tpl_id1,
+                                   &num_duplicates, duplicates);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_ne(tpl_id1, XYTH_RESERVED_TEMPLATE_ID);
+    ck_assert_int_eq(num_duplicates, 0);
+
+    num_duplicates = 2;
+    status = XYTH_enroll_if_unique(&ctx_eu, &tpl2_eu, &tpl_id2,
+                                   &num_duplicates, duplicates);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_ne(tpl_id2, XYTH_RESERVED_TEMPLATE_ID);
+    ck_assert_int_eq(num_duplicates, 0);
+
+    // A second enrollment of the same finger is refused
+    num_duplicates = 2;
+    status = XYTH_enroll_if_unique(&ctx_eu, &tpl1_eu, &tpl_id,
+                                   &num_duplicates, duplicates);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(tpl_id, XYTH_RESERVED_TEMPLATE_ID);
+    ck_assert_int_eq(num_duplicates, 1);
+    ck_assert_int_eq(duplicates[0], tpl_id1);
+
+    status = XYTH_get_template_counter(&ctx_eu, &tpl_counter);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(tpl_counter, 2);
+
+    XYTH_destroy_context(&ctx_eu);
+}
+END_TEST
+
+static void *enroll_thread_eu(void *arg)
+{
+    unsigned int *tpl_id = arg;
+    unsigned int duplicates[1];
+    unsigned int num_duplicates = 1;
+
+    if (XYTH_enroll_if_unique(&ctx_eu, &tpl1_eu, tpl_id, &num_duplicates,
+                              duplicates) != XYTH_SUCCESS) {
+        *tpl_id = 0;
+    }
+
+    return NULL;
+}
+
+START_TEST(concurrent_enrollers)
+{
+    XYTH_status status;
+    pthread_t threads[NUM_ENROLLERS];
+    unsigned int tpl_ids[NUM_ENROLLERS];
+    unsigned int num_enrolled = 0;
+    unsigned int tpl_counter;
+
+    create_context_eu();
+
+    for (unsigned int i = 0; i < NUM_ENROLLERS; i++) {
+        ck_assert_int_eq(
+            pthread_create(&threads[i], NULL, enroll_thread_eu, &tpl_ids[i]),
+            0);
+    }
+    for (unsigned int i = 0; i < NUM_ENROLLERS; i++) {
+        pthread_join(threads[i], NULL);
+        if (tpl_ids[i] != XYTH_RESERVED_TEMPLATE_ID) {
+            num_enrolled++;
+        }
+    }
+    ck_assert_int_eq(num_enrolled, 1);
+
+    status = XYTH_get_template_counter(&ctx_eu, &tpl_counter);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(tpl_counter, 1);
+
+    XYTH_destroy_context(&ctx_eu);
+}
+END_TEST
+
+START_TEST(expanded_enroll)
+{
+    XYTH_status status;
+    struct XYTH_database_config cfg;
+    unsigned int tpl_id1, tpl_id;
+    unsigned int duplicates[2];
+    unsigned int num_duplicates = 2;
+
+    // The check reads the groups worked out for the insertion
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_DENSITY(cfg, 4, 8);
+    XYTH_DB_CONFIG_SET_ENROLL_EXPANSION(cfg, 5, 5, 7);
+
+    status = XYTH_create_context(&ctx_eu, &cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_match_thresholds(&ctx_eu, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_enroll_if_unique(&ctx_eu, &tpl1_eu, &tpl_id1,
+                                   &num_duplicates, duplicates);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_ne(tpl_id1, XYTH_RESERVED_TEMPLATE_ID);
+    ck_assert_int_eq(num_duplicates, 0);
+
+    num_duplicates = 2;
+    status = XYTH_enroll_if_unique(&ctx_eu, &tpl1_eu, &tpl_id,
+                                   &num_duplicates, duplicates);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(tpl_id, XYTH_RESERVED_TEMPLATE_ID);
+    ck_assert_int_eq(num_duplicates, 1);
+    ck_assert_int_eq(duplicates[0], tpl_id1);
+
+    XYTH_destroy_context(&ctx_eu);
+}
+END_TEST
+
+START_TEST(enroll_with_workers)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[2];
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates = 2;
+    unsigned int tpl_id1, tpl_id, ticket;
+    unsigned int duplicates[2];
+    unsigned int num_duplicates = 2;
+
+    create_context_eu();
+
+    status = XYTH_set_result_cache(&ctx_eu, 4);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_workers(&ctx_eu, 2);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    // Requests run by the workers wait for each enrollment
+    for (unsigned int i = 0; i < NUM_ENROLLERS; i++) {
+        status = XYTH_submit_identify(&ctx_eu, &tpl1_eu, &ticket);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+        status = XYTH_submit_add(&ctx_eu, &tpl2_eu, &ticket);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+
+    status = XYTH_enroll_if_unique(&ctx_eu, &tpl1_eu, &tpl_id1,
+                                   &num_duplicates, duplicates);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_ne(tpl_id1, XYTH_RESERVED_TEMPLATE_ID);
+
+    num_duplicates = 2;
+    status = XYTH_enroll_if_unique(&ctx_eu, &tpl1_eu, &tpl_id,
+                                   &num_duplicates, duplicates);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(tpl_id, XYTH_RESERVED_TEMPLATE_ID);
+    ck_assert_int_eq(duplicates[0], tpl_id1);
+
+    status = XYTH_set_workers(&ctx_eu, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    // The checks left the result cache alone
+    status = XYTH_identify_ex(&ctx_eu, &tpl1_eu, &num_candidates, candidates,
+                              &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(stats.cached, 0);
+    ck_assert_int_eq(candidates[0].tpl_id, tpl_id1);
+
+    XYTH_destroy_context(&ctx_eu);
+}
+END_TEST
+
+START_TEST(invalid_enroll)
+{
+    XYTH_status status;
+    unsigned int tpl_id;
+    unsigned int num_duplicates = 1;
+
+    status = XYTH_enroll_if_unique(&ctx_eu, &tpl1_eu, &tpl_id,
+                                   &num_duplicates, NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+}
+END_TEST
+
+TCase *enroll_if_unique_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("EnrollIfUnique");
+
+    tcase_add_unchecked_fixture(tcase, enroll_if_unique_setup,
+                                enroll_if_unique_teardown);
+
+    tcase_add_test(tcase, enroll_unique);
+    tcase_add_test(tcase, concurrent_enrollers);
+    tcase_add_test(tcase, expanded_enroll);
+    tcase_add_test(tcase, enroll_with_workers);
+    tcase_add_test(tcase, invalid_enroll);
+
+    return tcase;
+}
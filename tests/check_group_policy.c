@@ -0,0 +1,157 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <check.h>
+#include <xyth.h>
+
+#define XYT_OK                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+struct XYTH_template tpl_gp = {0};
+struct XYTH_context ctx_gp = {0};
+
+void group_policy_setup()
+{
+    XYTH_status status;
+    unsigned int tpl_id;
+
+    status = XYTH_template_from_xyt(XYT_OK, &tpl_gp, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&ctx_gp, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&ctx_gp, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    // Every non-empty group holds at least two postings
+    status = XYTH_add_template(&ctx_gp, &tpl_gp, &tpl_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_add_template(&ctx_gp, &tpl_gp, &tpl_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+void group_policy_teardown()
+{
+    XYTH_destroy_template(&tpl_gp);
+    XYTH_destroy_context(&ctx_gp);
+}
+
+START_TEST(skip_groups)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[2];
+    struct XYTH_identify_stats stats;
+    struct XYTH_database_stats db_stats;
+    unsigned int num_candidates = 2;
+
+    status = XYTH_get_database_stats(&ctx_gp, &db_stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_ge(db_stats.max_group_length, 2);
+
+    status = XYTH_set_group_policy(&ctx_gp, XYTH_GROUP_POLICY_SKIP, 1);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_identify_ex(&ctx_gp, &tpl_gp, &num_candidates, candidates,
+                              &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 0);
+    ck_assert_int_eq(stats.groups_visited, 0);
+    ck_assert_int_ne(stats.groups_skipped, 0);
+
+    status = XYTH_set_group_policy(&ctx_gp, XYTH_GROUP_POLICY_SKIP,
+                                   db_stats.max_group_length);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    num_candidates = 2;
+    status = XYTH_identify_ex(&ctx_gp, &tpl_gp, &num_candidates, candidates,
+                              &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 2);
+    ck_assert_int_eq(stats.groups_skipped, 0);
+
+    status = XYTH_set_group_policy(&ctx_gp, XYTH_GROUP_POLICY_NONE, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+END_TEST
+
+START_TEST(weight_groups)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[2];
+    struct XYTH_candidate weighted[2];
+    unsigned int num_candidates = 2;
+
+    status = XYTH_identify_ex(&ctx_gp, &tpl_gp, &num_candidates, candidates,
+                              NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 2);
+
+    // The template's minutiae are evenly spaced, so many neighbors share a
+    // group, and a few groups are much longer than 10 postings
+    status = XYTH_set_group_policy(&ctx_gp, XYTH_GROUP_POLICY_WEIGHT, 10);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    num_candidates = 2;
+    status = XYTH_identify_ex(&ctx_gp, &tpl_gp, &num_candidates, weighted,
+                              NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 2);
+    ck_assert_int_lt(weighted[0].best_minutia_votes,
+                     candidates[0].best_minutia_votes);
+
+    status = XYTH_set_group_policy(&ctx_gp, XYTH_GROUP_POLICY_NONE, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+END_TEST
+
+START_TEST(invalid_policy)
+{
+    XYTH_status status;
+
+    status = XYTH_set_group_policy(NULL, XYTH_GROUP_POLICY_SKIP, 1);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+
+    status = XYTH_set_group_policy(&ctx_gp, XYTH_GROUP_POLICY_SKIP, 0);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+
+    status = XYTH_set_group_policy(&ctx_gp, (XYTH_group_policy)3, 1);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+}
+END_TEST
+
+TCase *group_policy_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("GroupPolicy");
+
+    tcase_add_unchecked_fixture(tcase, group_policy_setup,
+                                group_policy_teardown);
+
+    tcase_add_test(tcase, skip_groups);
+    tcase_add_test(tcase, weight_groups);
+    tcase_add_test(tcase, invalid_policy);
+
+    return tcase;
+}
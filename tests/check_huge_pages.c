@@ -0,0 +1,234 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <check.h>
+#include <xyth.h>
+
+#define XYT_OK                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+#define NUM_TEMPLATES_HP 10
+// Enough postings for a compacted segment larger than a huge page
+#define NUM_LARGE_HP 1400
+
+struct XYTH_template tpl_hp = {0};
+struct XYTH_context ctx_hp = {0};
+unsigned int tpl_id_hp;
+
+void huge_pages_setup()
+{
+    XYTH_status status;
+    struct XYTH_database_config db_cfg;
+
+    XYTH_DB_CONFIG_INIT(db_cfg);
+    XYTH_DB_CONFIG_SET_HUGE_PAGES(db_cfg, 1);
+
+    status = XYTH_template_from_xyt(XYT_OK, &tpl_hp, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&ctx_hp, &db_cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&ctx_hp, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_add_template(&ctx_hp, &tpl_hp, &tpl_id_hp);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+void huge_pages_teardown()
+{
+    XYTH_destroy_context(&ctx_hp);
+    XYTH_destroy_template(&tpl_hp);
+}
+
+START_TEST(huge_page_identify)
+{
+    XYTH_status status;
+    struct XYTH_database_stats first, second;
+    unsigned int ids[1];
+    unsigned int num_ids;
+
+    // Results do not depend on the pages backing the index
+    for (unsigned int i = 0; i < 2; i++) {
+        num_ids = 1;
+        status = XYTH_identify(&ctx_hp, &tpl_hp, &num_ids, ids);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+        ck_assert_int_eq(num_ids, 1);
+        ck_assert_int_eq(ids[0], tpl_id_hp);
+
+        status = XYTH_get_database_stats(&ctx_hp, i == 0 ? &first : &second);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+
+    // The system may grant no huge pages at all
+    ck_assert(first.region_bytes > 0);
+    ck_assert(first.huge_page_bytes <= first.region_bytes);
+
+    // The second query reused the score arrays of the first
+    ck_assert(second.region_bytes == first.region_bytes);
+}
+END_TEST
+
+//
+// Creates 'ctx' on huge pages, and adds 'num_templates' copies of 'tpl_hp'.
+//
+static void create_postings_context_hp(struct XYTH_context *ctx,
+                                       unsigned int seal_threshold,
+                                       unsigned int num_templates)
+{
+    XYTH_status status;
+    struct XYTH_database_config db_cfg;
+    unsigned int tpl_id;
+
+    XYTH_DB_CONFIG_INIT(db_cfg);
+    XYTH_DB_CONFIG_SET_HUGE_PAGES(db_cfg, 1);
+
+    status = XYTH_create_context(ctx, &db_cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_match_thresholds(ctx, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_seal_threshold(ctx, seal_threshold);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    for (unsigned int i = 0; i < num_templates; i++) {
+        status = XYTH_add_template(ctx, &tpl_hp, &tpl_id);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+}
+
+static unsigned int count_found_hp(struct XYTH_context *ctx)
+{
+    XYTH_status status;
+    unsigned int ids[NUM_TEMPLATES_HP];
+    unsigned int num_ids = NUM_TEMPLATES_HP;
+
+    status = XYTH_identify(ctx, &tpl_hp, &num_ids, ids);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    return num_ids;
+}
+
+START_TEST(huge_page_postings)
+{
+    XYTH_status status;
+    struct XYTH_context ctx = {0};
+    struct XYTH_database_config db_cfg;
+    struct XYTH_database_stats stats;
+
+    // The head and the sealed segments are carved from slabs
+    create_postings_context_hp(&ctx, 4, NUM_TEMPLATES_HP);
+    status = XYTH_get_database_stats(&ctx, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(stats.num_segments, 2);
+    ck_assert(stats.region_bytes >=
+              stats.alloc_postings * sizeof(unsigned int));
+    ck_assert(stats.huge_page_bytes <= stats.region_bytes);
+    ck_assert_int_eq(count_found_hp(&ctx), NUM_TEMPLATES_HP);
+
+    // Chunks freed by removing, merging and compacting are used again
+    status = XYTH_remove_template(&ctx, &tpl_hp, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_remove_template(&ctx, &tpl_hp, NUM_TEMPLATES_HP - 1);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_merge_segments(&ctx);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_compact_index(&ctx);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(count_found_hp(&ctx), NUM_TEMPLATES_HP - 2);
+
+    // The slabs are traded along with the index
+    XYTH_DB_CONFIG_INIT(db_cfg);
+    XYTH_DB_CONFIG_SET_DENSITY(db_cfg, 8, 16);
+    XYTH_DB_CONFIG_SET_MULTIRES(db_cfg);
+    XYTH_DB_CONFIG_SET_HUGE_PAGES(db_cfg, 1);
+    status = XYTH_reconfigure_context(&ctx, &db_cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(count_found_hp(&ctx), NUM_TEMPLATES_HP - 2);
+
+    XYTH_destroy_context(&ctx);
+}
+END_TEST
+
+START_TEST(large_postings)
+{
+    XYTH_status status;
+    struct XYTH_context ctx = {0};
+    struct XYTH_database_stats after;
+
+    create_postings_context_hp(&ctx, 0, NUM_LARGE_HP);
+
+    // The segment's postings are mapped on their own, past the slabs
+    status = XYTH_compact_index(&ctx);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_get_database_stats(&ctx, &after);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert(after.num_postings * sizeof(unsigned int) > 2 * 1024 * 1024);
+    ck_assert(after.region_bytes >=
+              after.num_postings * sizeof(unsigned int));
+    ck_assert_int_eq(count_found_hp(&ctx), NUM_TEMPLATES_HP);
+
+    // Compacting again unmaps it
+    status = XYTH_remove_template(&ctx, &tpl_hp, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_compact_index(&ctx);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(count_found_hp(&ctx), NUM_TEMPLATES_HP);
+
+    XYTH_destroy_context(&ctx);
+}
+END_TEST
+
+START_TEST(normal_pages)
+{
+    XYTH_status status;
+    struct XYTH_context ctx = {0};
+    struct XYTH_database_stats stats;
+
+    status = XYTH_create_context(&ctx, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_get_database_stats(&ctx, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert(stats.region_bytes > 0);
+    ck_assert(stats.huge_page_bytes == 0);
+
+    XYTH_destroy_context(&ctx);
+}
+END_TEST
+
+TCase *huge_pages_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("Huge pages");
+
+    tcase_add_unchecked_fixture(tcase, huge_pages_setup, huge_pages_teardown);
+
+    tcase_add_test(tcase, huge_page_identify);
+    tcase_add_test(tcase, huge_page_postings);
+    tcase_add_test(tcase, large_postings);
+    tcase_add_test(tcase, normal_pages);
+
+    return tcase;
+}
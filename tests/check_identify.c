@@ -35,6 +35,13 @@
                 40 41 90\n 43 44 90\n 46 47 90\n 49 50 90\n \
                 52 53 90\n 55 56 90\n 58 59 90\n 61 62 90\n"
 
+#define XYT_OK3                                                                \
+    "1  2 180\n  4  5 180\n  7  8 180\n 10 11 180\n 13 14 180\n \
+                16 17 180\n 19 20 180\n 22 23 180\n 25 26 180\n \
+                28 29 180\n 31 32 180\n 34 35 180\n 37 38 180\n \
+                40 41 180\n 43 44 180\n 46 47 180\n 49 50 180\n \
+                52 53 180\n 55 56 180\n 58 59 180\n 61 62 180\n"
+
 struct XYTH_template tpl1 = {0};
 struct XYTH_template tpl2 = {0};
 struct XYTH_context ctx2 = {0};
@@ -120,6 +127,74 @@ START_TEST(success_2_templates)
 }
 END_TEST
 
+START_TEST(failure_threshold)
+{
+    XYTH_status status;
+    unsigned int matches[2];
+    unsigned int matches_length = 2;
+    struct XYTH_template tpl3 = {0};
+    struct XYTH_candidate candidates[2];
+    struct XYTH_identify_stats stats;
+
+    status = XYTH_template_from_xyt(XYT_OK3, &tpl3, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&ctx2, 10, 1, 1);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_identify_ex(&ctx2, &tpl3, &matches_length, candidates,
+                              &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(matches_length, 0);
+    ck_assert_int_eq(stats.stop_reason, XYTH_STOP_FAILURE_THRESHOLD);
+    ck_assert_int_lt(stats.minutiae_processed, tpl3.num_minutiae);
+
+    matches_length = 2;
+    status = XYTH_identify(&ctx2, &tpl1, &matches_length, matches);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(matches_length, 1);
+    ck_assert_int_eq(matches[0], tpl_id1);
+
+    status = XYTH_set_match_thresholds(&ctx2, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    XYTH_destroy_template(&tpl3);
+}
+END_TEST
+
+START_TEST(accept_threshold)
+{
+    XYTH_status status;
+    unsigned int matches[2];
+    unsigned int matches_length = 2;
+    struct XYTH_candidate candidates[2];
+    struct XYTH_identify_stats stats;
+
+    status = XYTH_set_accept_threshold(&ctx2, 1);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_identify_ex(&ctx2, &tpl2, &matches_length, candidates,
+                              &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(matches_length, 1);
+    ck_assert_int_eq(candidates[0].tpl_id, tpl_id2);
+    ck_assert_int_eq(stats.stop_reason, XYTH_STOP_ACCEPTED);
+    ck_assert_int_lt(stats.minutiae_processed, tpl2.num_minutiae);
+
+    matches_length = 2;
+    status = XYTH_identify(&ctx2, &tpl2, &matches_length, matches);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(matches_length, 1);
+    ck_assert_int_eq(matches[0], tpl_id2);
+
+    status = XYTH_set_accept_threshold(&ctx2, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_accept_threshold(NULL, 1);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+}
+END_TEST
+
 TCase *identify_tcase(void)
 {
     TCase *tcase;
@@ -131,6 +206,8 @@ TCase *identify_tcase(void)
     tcase_add_test(tcase, simple_success);
     tcase_add_test(tcase, tpl_not_found);
     tcase_add_test(tcase, success_2_templates);
+    tcase_add_test(tcase, failure_threshold);
+    tcase_add_test(tcase, accept_threshold);
     //    tcase_add_test(tcase, null_template);
     //    tcase_add_test(tcase, invalid_template);
     //    tcase_add_test(tcase, null_id);
@@ -0,0 +1,132 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <check.h>
+#include <xyth.h>
+
+#define XYT_OK                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+struct XYTH_template tpl_bd = {0};
+struct XYTH_context ctx_bd = {0};
+unsigned int tpl_id_bd;
+
+void identify_bounded_setup()
+{
+    XYTH_status status;
+
+    status = XYTH_template_from_xyt(XYT_OK, &tpl_bd, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&ctx_bd, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&ctx_bd, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_add_template(&ctx_bd, &tpl_bd, &tpl_id_bd);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+void identify_bounded_teardown()
+{
+    XYTH_destroy_template(&tpl_bd);
+    XYTH_destroy_context(&ctx_bd);
+}
+
+START_TEST(within_budget)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[1];
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates = 1;
+
+    // A generous time budget does not cut the search
+    status = XYTH_identify_bounded(&ctx_bd, &tpl_bd, 0, 10000000,
+                                   &num_candidates, candidates, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(stats.stop_reason, XYTH_STOP_COMPLETED);
+    ck_assert_int_eq(stats.minutiae_processed, tpl_bd.num_minutiae);
+    ck_assert(stats.estimated_postings > 0);
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(candidates[0].tpl_id, tpl_id_bd);
+    ck_assert_int_eq(candidates[0].template_score, tpl_bd.num_minutiae);
+}
+END_TEST
+
+START_TEST(postings_budget)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[1];
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates = 1;
+    unsigned long long all_postings;
+
+    status = XYTH_identify_bounded(&ctx_bd, &tpl_bd, 0, 0, &num_candidates,
+                                   candidates, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    all_postings = stats.postings_scanned;
+
+    num_candidates = 1;
+    status = XYTH_identify_bounded(&ctx_bd, &tpl_bd, all_postings / 2, 0,
+                                   &num_candidates, candidates, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(stats.stop_reason, XYTH_STOP_TRUNCATED);
+    ck_assert(stats.minutiae_processed < tpl_bd.num_minutiae);
+    ck_assert(stats.postings_scanned >= all_postings / 2);
+    ck_assert(stats.postings_scanned < all_postings);
+
+    // The best candidate so far is still returned
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(candidates[0].tpl_id, tpl_id_bd);
+    ck_assert(candidates[0].template_score < tpl_bd.num_minutiae);
+}
+END_TEST
+
+START_TEST(invalid_bounded)
+{
+    XYTH_status status;
+    unsigned int num_candidates = 1;
+
+    status = XYTH_identify_bounded(&ctx_bd, &tpl_bd, 1, 0, &num_candidates,
+                                   NULL, NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+}
+END_TEST
+
+TCase *identify_bounded_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("IdentifyBounded");
+
+    tcase_add_unchecked_fixture(tcase, identify_bounded_setup,
+                                identify_bounded_teardown);
+
+    tcase_add_test(tcase, within_budget);
+    tcase_add_test(tcase, postings_budget);
+    tcase_add_test(tcase, invalid_bounded);
+
+    return tcase;
+}
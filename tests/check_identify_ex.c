@@ -0,0 +1,277 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <check.h>
+#include <xyth.h>
+
+#define XYT_OK                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+// Three blocks of scattered minutiae. A template made of the first blocks
+// only matches the probe minutiae of those blocks.
+#define XYT_BLOCK1                                                             \
+    "22 66 195\n 25 157 355\n 25 221 115\n 159 111 65\n 84 117 120\n \
+                242 139 235\n 67 171 60\n 46 148 350\n"
+#define XYT_BLOCK2                                                             \
+    " 92 48 40\n 154 41 35\n 229 44 130\n 64 19 315\n 170 159 340\n \
+                151 118 270\n 40 156 200\n 21 152 295\n"
+#define XYT_BLOCK3                                                             \
+    " 22 28 290\n 32 121 230\n 34 103 190\n 111 176 155\n 220 147 115\n \
+                159 24 155\n 117 27 50\n 71 33 190\n"
+
+// MATCH_MAX_CANDIDATES
+#define MAX_CANDIDATES_EX 100
+
+struct XYTH_template tpl_ex = {0};
+struct XYTH_context ctx_ex = {0};
+unsigned int tpl_id_ex;
+
+void identify_ex_setup()
+{
+    XYTH_status status;
+
+    status = XYTH_template_from_xyt(XYT_OK, &tpl_ex, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&ctx_ex, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&ctx_ex, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_add_template(&ctx_ex, &tpl_ex, &tpl_id_ex);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+void identify_ex_teardown()
+{
+    XYTH_destroy_template(&tpl_ex);
+    XYTH_destroy_context(&ctx_ex);
+}
+
+START_TEST(simple_success)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[2];
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates = 2;
+
+    status = XYTH_identify_ex(&ctx_ex, &tpl_ex, &num_candidates, candidates,
+                              &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(candidates[0].tpl_id, tpl_id_ex);
+    ck_assert_int_eq(candidates[0].template_score, tpl_ex.num_minutiae);
+    ck_assert_int_eq(candidates[0].matched_minutiae, tpl_ex.num_minutiae);
+    ck_assert_int_ge(candidates[0].best_minutia_votes, 10);
+    ck_assert_int_eq(stats.minutiae_processed, tpl_ex.num_minutiae);
+    ck_assert_int_eq(stats.num_matches, 1);
+    ck_assert_int_eq(stats.stop_reason, XYTH_STOP_COMPLETED);
+    ck_assert_int_ne(stats.groups_visited, 0);
+    ck_assert_int_ne(stats.postings_scanned, 0);
+}
+END_TEST
+
+START_TEST(early_accept)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[2];
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates = 2;
+
+    status = XYTH_set_accept_threshold(&ctx_ex, 1);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_identify_ex(&ctx_ex, &tpl_ex, &num_candidates, candidates,
+                              &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(candidates[0].tpl_id, tpl_id_ex);
+    ck_assert_int_eq(stats.stop_reason, XYTH_STOP_ACCEPTED);
+    // The runner-up scores 0, so the match is certain after 11 of 21 minutiae
+    ck_assert_int_eq(stats.minutiae_processed, 11);
+
+    status = XYTH_set_accept_threshold(&ctx_ex, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+END_TEST
+
+START_TEST(cascade)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[2];
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates = 2;
+
+    status = XYTH_set_cascade(&ctx_ex, 5, 12);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_identify_ex(&ctx_ex, &tpl_ex, &num_candidates, candidates,
+                              &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(candidates[0].tpl_id, tpl_id_ex);
+    ck_assert_int_ge(candidates[0].pairwise_score, 12);
+    ck_assert_int_eq(stats.candidates_reranked, 1);
+
+    // No candidate reaches the re-rank threshold
+    status = XYTH_set_cascade(&ctx_ex, 5, 100000);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    num_candidates = 2;
+    status = XYTH_identify_ex(&ctx_ex, &tpl_ex, &num_candidates, candidates,
+                              &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 0);
+    ck_assert_int_eq(stats.candidates_reranked, 1);
+
+    status = XYTH_set_cascade(&ctx_ex, 0, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_cascade(NULL, 5, 12);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+}
+END_TEST
+
+START_TEST(null_stats)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[1];
+    unsigned int num_candidates = 1;
+
+    status = XYTH_identify_ex(&ctx_ex, &tpl_ex, &num_candidates, candidates,
+                              NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 1);
+}
+END_TEST
+
+START_TEST(null_candidates)
+{
+    XYTH_status status;
+    unsigned int num_candidates = 1;
+
+    status = XYTH_identify_ex(&ctx_ex, &tpl_ex, &num_candidates, NULL, NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+}
+END_TEST
+
+START_TEST(invalid_template)
+{
+    XYTH_status status;
+    struct XYTH_template invalid_tpl = {0};
+    struct XYTH_candidate candidates[1];
+    unsigned int num_candidates = 1;
+
+    status = XYTH_identify_ex(&ctx_ex, &invalid_tpl, &num_candidates,
+                              candidates, NULL);
+    ck_assert_int_eq(status, XYTH_E_NOT_INITIALIZED);
+}
+END_TEST
+
+START_TEST(top_candidates)
+{
+    XYTH_status status;
+    struct XYTH_context ctx = {0};
+    struct XYTH_template tpl_top = {0};
+    struct XYTH_template tpl_mid = {0};
+    struct XYTH_template tpl_low = {0};
+    struct XYTH_candidate candidates[MAX_CANDIDATES_EX];
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates = 2;
+    unsigned int tpl_id_mid, tpl_id_low, tpl_id;
+    unsigned int mid_score, low_score;
+
+    status = XYTH_template_from_xyt(XYT_BLOCK1 XYT_BLOCK2 XYT_BLOCK3,
+                                    &tpl_top, 7);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_template_from_xyt(XYT_BLOCK1 XYT_BLOCK2, &tpl_mid, 7);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_template_from_xyt(XYT_BLOCK1, &tpl_low, 7);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&ctx, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_match_thresholds(&ctx, 1, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    // The first slot of the list holds a weaker template than the second
+    status = XYTH_add_template(&ctx, &tpl_mid, &tpl_id_mid);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_add_template(&ctx, &tpl_low, &tpl_id_low);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_identify_ex(&ctx, &tpl_top, &num_candidates, candidates,
+                              NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 2);
+    ck_assert_int_eq(candidates[0].tpl_id, tpl_id_mid);
+    ck_assert_int_eq(candidates[1].tpl_id, tpl_id_low);
+    mid_score = candidates[0].template_score;
+    low_score = candidates[1].template_score;
+    ck_assert_int_gt(mid_score, low_score);
+
+    // Every later template beats both, so neither may stay in the list
+    for (unsigned int i = 0; i < MAX_CANDIDATES_EX; i++) {
+        status = XYTH_add_template(&ctx, &tpl_top, &tpl_id);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+
+    num_candidates = MAX_CANDIDATES_EX;
+    status = XYTH_identify_ex(&ctx, &tpl_top, &num_candidates, candidates,
+                              &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, MAX_CANDIDATES_EX);
+    ck_assert_int_eq(stats.num_matches, MAX_CANDIDATES_EX + 2);
+    for (unsigned int i = 0; i < num_candidates; i++) {
+        ck_assert_int_ne(candidates[i].tpl_id, tpl_id_mid);
+        ck_assert_int_ne(candidates[i].tpl_id, tpl_id_low);
+        ck_assert_int_eq(candidates[i].template_score, tpl_top.num_minutiae);
+    }
+
+    XYTH_destroy_context(&ctx);
+    XYTH_destroy_template(&tpl_top);
+    XYTH_destroy_template(&tpl_mid);
+    XYTH_destroy_template(&tpl_low);
+}
+END_TEST
+
+TCase *identify_ex_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("IdentifyEx");
+
+    tcase_add_unchecked_fixture(tcase, identify_ex_setup, identify_ex_teardown);
+
+    tcase_add_test(tcase, simple_success);
+    tcase_add_test(tcase, early_accept);
+    tcase_add_test(tcase, cascade);
+    tcase_add_test(tcase, null_stats);
+    tcase_add_test(tcase, null_candidates);
+    tcase_add_test(tcase, invalid_template);
+    tcase_add_test(tcase, top_candidates);
+
+    return tcase;
+}
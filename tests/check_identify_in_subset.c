@@ -0,0 +1,139 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <check.h>
+#include <xyth.h>
+
+#define XYT_OK                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+struct XYTH_template tpl_ss = {0};
+struct XYTH_context ctx_ss = {0};
+unsigned int tpl_ids_ss[3];
+
+void identify_in_subset_setup()
+{
+    XYTH_status status;
+
+    status = XYTH_template_from_xyt(XYT_OK, &tpl_ss, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&ctx_ss, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&ctx_ss, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    for (unsigned int i = 0; i < 3; i++) {
+        status = XYTH_add_template(&ctx_ss, &tpl_ss, &tpl_ids_ss[i]);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+}
+
+void identify_in_subset_teardown()
+{
+    XYTH_destroy_template(&tpl_ss);
+    XYTH_destroy_context(&ctx_ss);
+}
+
+START_TEST(single_member)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[3];
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates = 3;
+
+    status = XYTH_identify_in_subset(&ctx_ss, &tpl_ss, 1, &tpl_ids_ss[1],
+                                     &num_candidates, candidates, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(candidates[0].tpl_id, tpl_ids_ss[1]);
+    ck_assert_int_eq(candidates[0].template_score, tpl_ss.num_minutiae);
+    ck_assert_int_eq(candidates[0].matched_minutiae, tpl_ss.num_minutiae);
+    ck_assert_int_eq(stats.num_matches, 1);
+}
+END_TEST
+
+START_TEST(several_members)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[3];
+    unsigned int num_candidates = 3;
+    // Repeated and unknown ids are ignored
+    unsigned int subset[] = {tpl_ids_ss[2], tpl_ids_ss[0], tpl_ids_ss[2], 99};
+
+    status = XYTH_identify_in_subset(&ctx_ss, &tpl_ss, 4, subset,
+                                     &num_candidates, candidates, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 2);
+    ck_assert_int_ne(candidates[0].tpl_id, tpl_ids_ss[1]);
+    ck_assert_int_ne(candidates[1].tpl_id, tpl_ids_ss[1]);
+    ck_assert_int_ne(candidates[0].tpl_id, candidates[1].tpl_id);
+}
+END_TEST
+
+START_TEST(empty_subset)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[3];
+    unsigned int num_candidates = 3;
+
+    status = XYTH_identify_in_subset(&ctx_ss, &tpl_ss, 0, NULL,
+                                     &num_candidates, candidates, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 0);
+}
+END_TEST
+
+START_TEST(invalid_subset)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[3];
+    unsigned int num_candidates = 3;
+
+    status = XYTH_identify_in_subset(&ctx_ss, &tpl_ss, 1, NULL,
+                                     &num_candidates, candidates, NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+
+    status = XYTH_identify_in_subset(NULL, &tpl_ss, 1, tpl_ids_ss,
+                                     &num_candidates, candidates, NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+}
+END_TEST
+
+TCase *identify_in_subset_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("IdentifyInSubset");
+
+    tcase_add_unchecked_fixture(tcase, identify_in_subset_setup,
+                                identify_in_subset_teardown);
+
+    tcase_add_test(tcase, single_member);
+    tcase_add_test(tcase, several_members);
+    tcase_add_test(tcase, empty_subset);
+    tcase_add_test(tcase, invalid_subset);
+
+    return tcase;
+}
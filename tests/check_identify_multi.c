@@ -0,0 +1,199 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <check.h>
+#include <xyth.h>
+
+#define XYT_45                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+#define XYT_90                                                                 \
+    "1  2 90\n  4  5 90\n  7  8 90\n 10 11 90\n 13 14 90\n \
+                16 17 90\n 19 20 90\n 22 23 90\n 25 26 90\n \
+                28 29 90\n 31 32 90\n 34 35 90\n 37 38 90\n \
+                40 41 90\n 43 44 90\n 46 47 90\n 49 50 90\n \
+                52 53 90\n 55 56 90\n 58 59 90\n 61 62 90\n"
+
+#define XYT_SMALL "1  2 180\n  4  5 180\n  7  8 180\n 10 11 180\n 13 14 180\n"
+
+// Subject 100 has both fingers enrolled, subject 200 only the first one, and
+// a third template has no subject
+struct XYTH_template tpl_mf[3] = {{0}};
+struct XYTH_context ctx_mf = {0};
+
+void identify_multi_setup()
+{
+    XYTH_status status;
+    unsigned int tpl_id;
+
+    status = XYTH_template_from_xyt(XYT_45, &tpl_mf[0], 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_template_from_xyt(XYT_90, &tpl_mf[1], 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_template_from_xyt(XYT_SMALL, &tpl_mf[2], 4);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&ctx_mf, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&ctx_mf, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_add_template(&ctx_mf, &tpl_mf[0], &tpl_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_template_subject(&ctx_mf, tpl_id, 100, 1);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_add_template(&ctx_mf, &tpl_mf[1], &tpl_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_template_subject(&ctx_mf, tpl_id, 100, 2);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_add_template(&ctx_mf, &tpl_mf[0], &tpl_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_template_subject(&ctx_mf, tpl_id, 200, 1);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_add_template(&ctx_mf, &tpl_mf[0], &tpl_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+void identify_multi_teardown()
+{
+    for (unsigned int i = 0; i < 3; i++) {
+        XYTH_destroy_template(&tpl_mf[i]);
+    }
+    XYTH_destroy_context(&ctx_mf);
+}
+
+START_TEST(fused_subjects)
+{
+    XYTH_status status;
+    struct XYTH_subject_candidate candidates[3];
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates = 3;
+    unsigned int fingers[] = {1, 2};
+
+    status = XYTH_identify_multi(&ctx_mf, tpl_mf, fingers, 2, &num_candidates,
+                                 candidates, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 2);
+    ck_assert_int_eq(stats.num_matches, 2);
+    ck_assert_int_eq(stats.stop_reason, XYTH_STOP_COMPLETED);
+    ck_assert_int_eq(stats.minutiae_processed,
+                     tpl_mf[0].num_minutiae + tpl_mf[1].num_minutiae);
+
+    ck_assert_int_eq(candidates[0].subject_id, 100);
+    ck_assert_int_eq(candidates[0].subject_score,
+                     tpl_mf[0].num_minutiae + tpl_mf[1].num_minutiae);
+    ck_assert_int_eq(candidates[0].fingers_matched, 2);
+
+    ck_assert_int_eq(candidates[1].subject_id, 200);
+    ck_assert_int_eq(candidates[1].subject_score, tpl_mf[0].num_minutiae);
+    ck_assert_int_eq(candidates[1].fingers_matched, 1);
+
+    // Only the best subject fits
+    num_candidates = 1;
+    status = XYTH_identify_multi(&ctx_mf, tpl_mf, fingers, 2, &num_candidates,
+                                 candidates, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(candidates[0].subject_id, 100);
+}
+END_TEST
+
+START_TEST(decisive_subject)
+{
+    XYTH_status status;
+    struct XYTH_subject_candidate candidates[3];
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates = 3;
+    unsigned int fingers[] = {2, 3};
+
+    // After the first probe no other subject can reach subject 100
+    status = XYTH_set_accept_threshold(&ctx_mf, 10);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_identify_multi(&ctx_mf, &tpl_mf[1], fingers, 2,
+                                 &num_candidates, candidates, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(stats.stop_reason, XYTH_STOP_ACCEPTED);
+    // The second probe is skipped
+    ck_assert(stats.minutiae_processed <= tpl_mf[1].num_minutiae);
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(candidates[0].subject_id, 100);
+
+    status = XYTH_set_accept_threshold(&ctx_mf, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    num_candidates = 3;
+    status = XYTH_identify_multi(&ctx_mf, &tpl_mf[1], fingers, 2,
+                                 &num_candidates, candidates, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(stats.stop_reason, XYTH_STOP_COMPLETED);
+    ck_assert_int_eq(stats.minutiae_processed,
+                     tpl_mf[1].num_minutiae + tpl_mf[2].num_minutiae);
+}
+END_TEST
+
+START_TEST(invalid_multi)
+{
+    XYTH_status status;
+    struct XYTH_subject_candidate candidates[3];
+    unsigned int num_candidates = 3;
+    unsigned int fingers[] = {XYTH_MAX_FINGER_POSITION + 1};
+
+    status = XYTH_identify_multi(&ctx_mf, tpl_mf, NULL, 0, &num_candidates,
+                                 candidates, NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+
+    status = XYTH_identify_multi(&ctx_mf, tpl_mf, fingers, 1, &num_candidates,
+                                 candidates, NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+
+    status = XYTH_set_template_subject(&ctx_mf, 99, 100, 1);
+    ck_assert_int_eq(status, XYTH_E_NOT_FOUND);
+
+    status = XYTH_set_template_subject(&ctx_mf, 0, XYTH_RESERVED_SUBJECT_ID, 1);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+}
+END_TEST
+
+TCase *identify_multi_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("IdentifyMulti");
+
+    tcase_add_unchecked_fixture(tcase, identify_multi_setup,
+                                identify_multi_teardown);
+
+    tcase_add_test(tcase, fused_subjects);
+    tcase_add_test(tcase, decisive_subject);
+    tcase_add_test(tcase, invalid_multi);
+
+    return tcase;
+}
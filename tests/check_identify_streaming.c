@@ -0,0 +1,167 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <check.h>
+#include <xyth.h>
+
+#define XYT_OK                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+struct XYTH_template tpl_st = {0};
+struct XYTH_context ctx_st = {0};
+unsigned int tpl_id_st;
+
+// What the progress callback saw
+struct progress_st {
+    unsigned int num_calls;
+    unsigned int last_minutiae_processed;
+    unsigned int last_num_candidates;
+    unsigned int last_score;
+    unsigned int stop_score; // Stops the search once reached (0 - Never)
+};
+
+static bool progress_callback_st(void *user_data,
+                                 unsigned int minutiae_processed,
+                                 unsigned int num_candidates,
+                                 const struct XYTH_candidate *candidates)
+{
+    struct progress_st *progress = user_data;
+
+    progress->num_calls++;
+    progress->last_minutiae_processed = minutiae_processed;
+    progress->last_num_candidates = num_candidates;
+    progress->last_score = num_candidates > 0 ? candidates[0].template_score
+                                              : 0;
+
+    return progress->stop_score == 0 ||
+           progress->last_score < progress->stop_score;
+}
+
+void identify_streaming_setup()
+{
+    XYTH_status status;
+
+    status = XYTH_template_from_xyt(XYT_OK, &tpl_st, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&ctx_st, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&ctx_st, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_add_template(&ctx_st, &tpl_st, &tpl_id_st);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+void identify_streaming_teardown()
+{
+    XYTH_destroy_template(&tpl_st);
+    XYTH_destroy_context(&ctx_st);
+}
+
+START_TEST(progress_reported)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[1];
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates = 1;
+    struct progress_st progress = {0};
+
+    status = XYTH_identify_streaming(&ctx_st, &tpl_st, 5,
+                                     progress_callback_st, &progress,
+                                     &num_candidates, candidates, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(stats.stop_reason, XYTH_STOP_COMPLETED);
+    ck_assert_int_eq(stats.minutiae_processed, tpl_st.num_minutiae);
+
+    // Not called after the last minutia, the final list is returned instead
+    ck_assert_int_eq(progress.num_calls, (tpl_st.num_minutiae - 1) / 5);
+    ck_assert_int_eq(progress.last_minutiae_processed,
+                     progress.num_calls * 5);
+    ck_assert_int_eq(progress.last_num_candidates, 1);
+    ck_assert_int_eq(progress.last_score, progress.last_minutiae_processed);
+
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(candidates[0].tpl_id, tpl_id_st);
+    ck_assert_int_eq(candidates[0].template_score, tpl_st.num_minutiae);
+}
+END_TEST
+
+START_TEST(stopped_by_callback)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[1];
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates = 1;
+    struct progress_st progress = {0};
+
+    progress.stop_score = 8;
+    status = XYTH_identify_streaming(&ctx_st, &tpl_st, 4,
+                                     progress_callback_st, &progress,
+                                     &num_candidates, candidates, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(stats.stop_reason, XYTH_STOP_CALLBACK);
+    ck_assert_int_eq(stats.minutiae_processed, 8);
+    ck_assert_int_eq(progress.num_calls, 2);
+
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(candidates[0].tpl_id, tpl_id_st);
+    ck_assert_int_eq(candidates[0].template_score, 8);
+}
+END_TEST
+
+START_TEST(invalid_streaming)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[1];
+    unsigned int num_candidates = 1;
+    struct progress_st progress = {0};
+
+    status = XYTH_identify_streaming(&ctx_st, &tpl_st, 0,
+                                     progress_callback_st, &progress,
+                                     &num_candidates, candidates, NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+
+    status = XYTH_identify_streaming(&ctx_st, &tpl_st, 5, NULL, &progress,
+                                     &num_candidates, candidates, NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+}
+END_TEST
+
+TCase *identify_streaming_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("IdentifyStreaming");
+
+    tcase_add_unchecked_fixture(tcase, identify_streaming_setup,
+                                identify_streaming_teardown);
+
+    tcase_add_test(tcase, progress_reported);
+    tcase_add_test(tcase, stopped_by_callback);
+    tcase_add_test(tcase, invalid_streaming);
+
+    return tcase;
+}
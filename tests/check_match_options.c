@@ -0,0 +1,171 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <check.h>
+#include <xyth.h>
+
+#define XYT_OK                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+struct XYTH_template tpl_mo = {0};
+struct XYTH_context ctx_mo = {0};
+unsigned int tpl_id_mo;
+
+void match_options_setup()
+{
+    XYTH_status status;
+
+    status = XYTH_template_from_xyt(XYT_OK, &tpl_mo, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&ctx_mo, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&ctx_mo, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_add_template(&ctx_mo, &tpl_mo, &tpl_id_mo);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+void match_options_teardown()
+{
+    XYTH_destroy_template(&tpl_mo);
+    XYTH_destroy_context(&ctx_mo);
+}
+
+START_TEST(same_as_context)
+{
+    XYTH_status status;
+    struct XYTH_match_options options;
+    struct XYTH_prepared_options *prepared;
+    struct XYTH_candidate candidates[2], expected[2];
+    struct XYTH_identify_stats stats, expected_stats;
+    unsigned int num_candidates = 2, num_expected = 2;
+
+    status = XYTH_get_match_options(&ctx_mo, &options);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(options.minutia_threshold, 10);
+    ck_assert_int_eq(options.template_threshold, 1);
+
+    status = XYTH_prepare_options(&ctx_mo, &options, &prepared);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    // The precomputed windows read the same postings
+    status = XYTH_identify_with_options(&ctx_mo, prepared, &tpl_mo,
+                                        &num_candidates, candidates, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_identify_ex(&ctx_mo, &tpl_mo, &num_expected, expected,
+                              &expected_stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    ck_assert_int_eq(num_candidates, num_expected);
+    ck_assert_int_eq(candidates[0].tpl_id, expected[0].tpl_id);
+    ck_assert_int_eq(candidates[0].template_score,
+                     expected[0].template_score);
+    ck_assert_int_eq(stats.postings_scanned, expected_stats.postings_scanned);
+    ck_assert_int_eq(stats.groups_visited, expected_stats.groups_visited);
+
+    XYTH_destroy_prepared_options(prepared);
+}
+END_TEST
+
+START_TEST(strict_options)
+{
+    XYTH_status status;
+    struct XYTH_match_options options;
+    struct XYTH_prepared_options *prepared;
+    struct XYTH_candidate candidates[1];
+    unsigned int num_candidates = 1;
+
+    status = XYTH_get_match_options(&ctx_mo, &options);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    options.template_threshold = tpl_mo.num_minutiae + 1;
+
+    status = XYTH_prepare_options(&ctx_mo, &options, &prepared);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_identify_with_options(&ctx_mo, prepared, &tpl_mo,
+                                        &num_candidates, candidates, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 0);
+
+    // The context's configuration is left untouched
+    num_candidates = 1;
+    status = XYTH_identify_ex(&ctx_mo, &tpl_mo, &num_candidates, candidates,
+                              NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 1);
+
+    XYTH_destroy_prepared_options(prepared);
+}
+END_TEST
+
+START_TEST(invalid_options)
+{
+    XYTH_status status;
+    struct XYTH_match_options options;
+    struct XYTH_prepared_options *prepared;
+    struct XYTH_context other_ctx = {0};
+    struct XYTH_candidate candidates[1];
+    unsigned int num_candidates = 1;
+
+    status = XYTH_get_match_options(&ctx_mo, &options);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    options.probe_drop_percent = 100;
+    status = XYTH_prepare_options(&ctx_mo, &options, &prepared);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+    options.probe_drop_percent = 0;
+
+    // Options only work with the context they were prepared for
+    status = XYTH_create_context(&other_ctx, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_prepare_options(&other_ctx, &options, &prepared);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_identify_with_options(&ctx_mo, prepared, &tpl_mo,
+                                        &num_candidates, candidates, NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+
+    XYTH_destroy_prepared_options(prepared);
+    XYTH_destroy_context(&other_ctx);
+}
+END_TEST
+
+TCase *match_options_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("MatchOptions");
+
+    tcase_add_unchecked_fixture(tcase, match_options_setup,
+                                match_options_teardown);
+
+    tcase_add_test(tcase, same_as_context);
+    tcase_add_test(tcase, strict_options);
+    tcase_add_test(tcase, invalid_options);
+
+    return tcase;
+}
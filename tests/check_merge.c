@@ -0,0 +1,313 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <check.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <xyth.h>
+
+#define XYT_OK                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+#define NUM_CANDIDATES_MG 8
+#define SUBJECT_MG 9
+#define NUM_MERGES_MG 200
+
+struct XYTH_template tpl_mg = {0};
+// 'src_mg' is merged into 'dst_mg', which then holds what 'reference_mg'
+// holds. 'dst_mg' is then split into 'even_mg' and 'odd_mg'
+struct XYTH_context dst_mg = {0};
+struct XYTH_context src_mg = {0};
+struct XYTH_context reference_mg = {0};
+struct XYTH_context even_mg = {0};
+struct XYTH_context odd_mg = {0};
+
+static void create_context_mg(struct XYTH_context *ctx)
+{
+    XYTH_status status;
+    struct XYTH_database_config cfg;
+
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_DENSITY(cfg, 4, 8);
+    XYTH_DB_CONFIG_SET_MULTIRES(cfg);
+    XYTH_DB_CONFIG_SET_PARTITIONS(cfg, 2);
+
+    status = XYTH_create_context(ctx, &cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_match_thresholds(ctx, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+static void add_templates_mg(struct XYTH_context *ctx,
+                             const unsigned int *partitions,
+                             unsigned int num_templates)
+{
+    XYTH_status status;
+    unsigned int tpl_id;
+
+    for (unsigned int i = 0; i < num_templates; i++) {
+        status = XYTH_add_template_to_partition(ctx, &tpl_mg, partitions[i],
+                                                &tpl_id);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+}
+
+void merge_setup()
+{
+    XYTH_status status;
+    const unsigned int dst_partitions[] = {0, 1};
+    const unsigned int src_partitions[] = {1, 0, 1};
+
+    status = XYTH_template_from_xyt(XYT_OK, &tpl_mg, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    create_context_mg(&dst_mg);
+    add_templates_mg(&dst_mg, dst_partitions, 2);
+
+    // Merged from a sealed segment, past a removed template, and the head
+    create_context_mg(&src_mg);
+    status = XYTH_set_seal_threshold(&src_mg, 2);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    add_templates_mg(&src_mg, src_partitions, 3);
+    status = XYTH_remove_template(&src_mg, &tpl_mg, 1);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_template_subject(&src_mg, 2, SUBJECT_MG,
+                                       XYTH_FINGER_UNKNOWN);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    create_context_mg(&reference_mg);
+    add_templates_mg(&reference_mg, dst_partitions, 2);
+    add_templates_mg(&reference_mg, src_partitions, 3);
+    status = XYTH_remove_template(&reference_mg, &tpl_mg, 3);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+void merge_teardown()
+{
+    XYTH_destroy_context(&odd_mg);
+    XYTH_destroy_context(&even_mg);
+    XYTH_destroy_context(&reference_mg);
+    XYTH_destroy_context(&src_mg);
+    XYTH_destroy_context(&dst_mg);
+    XYTH_destroy_template(&tpl_mg);
+}
+
+//
+// Identifies 'tpl_mg' in the partitions of 'mask', returning the number of
+// candidates found.
+//
+static unsigned int identify_mg(struct XYTH_context *ctx, unsigned int mask,
+                                struct XYTH_candidate *candidates,
+                                struct XYTH_identify_stats *stats)
+{
+    XYTH_status status;
+    unsigned int num_candidates = NUM_CANDIDATES_MG;
+
+    status = XYTH_identify_in_partitions(ctx, &tpl_mg, mask, &num_candidates,
+                                         candidates, stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    return num_candidates;
+}
+
+static bool is_even_mg(void *user_data, unsigned int tpl_id)
+{
+    (void)user_data;
+    return tpl_id % 2 == 0;
+}
+
+START_TEST(merge_contexts)
+{
+    XYTH_status status;
+    struct XYTH_database_stats merged, reference;
+    struct XYTH_candidate merged_candidates[NUM_CANDIDATES_MG];
+    struct XYTH_candidate reference_candidates[NUM_CANDIDATES_MG];
+    struct XYTH_identify_stats merged_stats, reference_stats;
+    struct XYTH_subject_candidate subjects[NUM_CANDIDATES_MG];
+    unsigned int num_merged, num_reference;
+    unsigned int num_subjects = NUM_CANDIDATES_MG;
+    unsigned int tpl_id;
+
+    // Source ids 0 and 2 become 2 and 4
+    status = XYTH_merge_contexts(&dst_mg, &src_mg, 2);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_get_database_stats(&dst_mg, &merged);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_get_database_stats(&reference_mg, &reference);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(merged.num_templates, 4);
+    ck_assert_int_eq(merged.num_postings, reference.num_postings);
+    ck_assert_int_eq(merged.occupied_groups, reference.occupied_groups);
+
+    for (unsigned int mask = 1; mask <= 0x3; mask++) {
+        num_merged = identify_mg(&dst_mg, mask, merged_candidates,
+                                 &merged_stats);
+        num_reference = identify_mg(&reference_mg, mask, reference_candidates,
+                                    &reference_stats);
+        ck_assert_int_eq(num_merged, num_reference);
+        for (unsigned int i = 0; i < num_merged; i++) {
+            ck_assert_int_eq(merged_candidates[i].tpl_id,
+                             reference_candidates[i].tpl_id);
+            ck_assert_int_eq(merged_candidates[i].template_score,
+                             reference_candidates[i].template_score);
+        }
+        ck_assert_int_eq(merged_stats.postings_scanned,
+                         reference_stats.postings_scanned);
+    }
+
+    status = XYTH_identify_multi(&dst_mg, &tpl_mg, NULL, 1, &num_subjects,
+                                 subjects, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_subjects, 1);
+    ck_assert_int_eq(subjects[0].subject_id, SUBJECT_MG);
+
+    // Merged templates are removed like any other, and ids go on after them
+    status = XYTH_remove_template(&dst_mg, &tpl_mg, 4);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_add_template_to_partition(&dst_mg, &tpl_mg, 1, &tpl_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(tpl_id, 5);
+}
+END_TEST
+
+START_TEST(invalid_merge)
+{
+    XYTH_status status;
+    struct XYTH_context other = {0};
+
+    status = XYTH_merge_contexts(&dst_mg, &dst_mg, 0);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+    status = XYTH_merge_contexts(NULL, &src_mg, 0);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+
+    // The ids would overlap those of 'dst_mg'
+    status = XYTH_merge_contexts(&dst_mg, &src_mg, 1);
+    ck_assert_int_eq(status, XYTH_E_VALUE_OUT_OF_RANGE);
+
+    status = XYTH_create_context(&other, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_merge_contexts(&dst_mg, &other, 100);
+    ck_assert_int_eq(status, XYTH_E_INVALID_CONFIGURATION);
+    XYTH_destroy_context(&other);
+}
+END_TEST
+
+START_TEST(split_context)
+{
+    XYTH_status status;
+    struct XYTH_database_stats whole, even, odd;
+    struct XYTH_candidate candidates[NUM_CANDIDATES_MG];
+
+    // 'dst_mg' holds ids 0, 1, 2 and 5
+    status = XYTH_split_context(&dst_mg, is_even_mg, NULL, &even_mg, &odd_mg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_get_database_stats(&dst_mg, &whole);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_get_database_stats(&even_mg, &even);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_get_database_stats(&odd_mg, &odd);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(even.num_templates, 2);
+    ck_assert_int_eq(odd.num_templates, 2);
+    ck_assert_int_eq(even.num_postings + odd.num_postings, whole.num_postings);
+
+    // The match configuration comes along
+    ck_assert_int_eq(identify_mg(&even_mg, 0x3, candidates, NULL), 2);
+    for (unsigned int i = 0; i < 2; i++) {
+        ck_assert_int_eq(candidates[i].tpl_id % 2, 0);
+    }
+    ck_assert_int_eq(identify_mg(&odd_mg, 1 << 1, candidates, NULL), 2);
+    for (unsigned int i = 0; i < 2; i++) {
+        ck_assert_int_eq(candidates[i].tpl_id % 2, 1);
+    }
+
+    status = XYTH_split_context(&dst_mg, is_even_mg, NULL, &even_mg, &odd_mg);
+    ck_assert_int_eq(status, XYTH_E_ALREADY_INITIALIZED);
+    status = XYTH_split_context(&dst_mg, NULL, NULL, &even_mg, &odd_mg);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+}
+END_TEST
+
+struct merge_args_mg {
+    struct XYTH_context *dst;
+    struct XYTH_context *src;
+    unsigned int num_failures;
+};
+
+static void *merge_thread_mg(void *arg)
+{
+    struct merge_args_mg *args = arg;
+
+    args->num_failures = 0;
+    for (unsigned int i = 0; i < NUM_MERGES_MG; i++) {
+        if (XYTH_merge_contexts(args->dst, args->src, 0) != XYTH_SUCCESS) {
+            args->num_failures++;
+        }
+    }
+
+    return NULL;
+}
+
+START_TEST(opposite_merges)
+{
+    struct XYTH_context a = {0};
+    struct XYTH_context b = {0};
+    struct merge_args_mg args[2] = {{&a, &b, 0}, {&b, &a, 0}};
+    pthread_t threads[2];
+
+    // Both threads lock the two contexts, in opposite argument order. The
+    // contexts stay empty, so every merge succeeds.
+    create_context_mg(&a);
+    create_context_mg(&b);
+
+    for (unsigned int i = 0; i < 2; i++) {
+        ck_assert_int_eq(
+            pthread_create(&threads[i], NULL, merge_thread_mg, &args[i]), 0);
+    }
+    for (unsigned int i = 0; i < 2; i++) {
+        pthread_join(threads[i], NULL);
+        ck_assert_int_eq(args[i].num_failures, 0);
+    }
+
+    XYTH_destroy_context(&b);
+    XYTH_destroy_context(&a);
+}
+END_TEST
+
+TCase *merge_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("Merge");
+
+    tcase_add_unchecked_fixture(tcase, merge_setup, merge_teardown);
+
+    tcase_add_test(tcase, merge_contexts);
+    tcase_add_test(tcase, invalid_merge);
+    tcase_add_test(tcase, split_context);
+    tcase_add_test(tcase, opposite_merges);
+
+    return tcase;
+}
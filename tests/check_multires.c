@@ -0,0 +1,158 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <check.h>
+#include <xyth.h>
+
+#define XYT_OK                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+struct XYTH_template tpl_mr = {0};
+struct XYTH_context ctx_mr = {0};
+unsigned int tpl_id_mr;
+
+void multires_setup()
+{
+    XYTH_status status;
+    struct XYTH_database_config cfg;
+
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_MAX_COORD(cfg, 100, 100);
+    XYTH_DB_CONFIG_SET_DENSITY(cfg, 8, 16);
+    XYTH_DB_CONFIG_SET_MULTIRES(cfg);
+
+    status = XYTH_template_from_xyt(XYT_OK, &tpl_mr, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&ctx_mr, &cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&ctx_mr, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_add_template(&ctx_mr, &tpl_mr, &tpl_id_mr);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+void multires_teardown()
+{
+    XYTH_destroy_template(&tpl_mr);
+    XYTH_destroy_context(&ctx_mr);
+}
+
+START_TEST(same_as_fine_index)
+{
+    XYTH_status status;
+    struct XYTH_context fine_ctx = {0};
+    struct XYTH_database_config cfg;
+    struct XYTH_candidate candidates[2];
+    struct XYTH_candidate fine_candidates[2];
+    struct XYTH_identify_stats stats;
+    struct XYTH_identify_stats fine_stats;
+    unsigned int num_candidates = 2;
+    unsigned int tpl_id;
+
+    // One pixel and one degree per group: the window is exact
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_MAX_COORD(cfg, 100, 100);
+    XYTH_DB_CONFIG_SET_DENSITY(cfg, 1, 1);
+
+    status = XYTH_create_context(&fine_ctx, &cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_match_thresholds(&fine_ctx, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_add_template(&fine_ctx, &tpl_mr, &tpl_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_identify_ex(&fine_ctx, &tpl_mr, &num_candidates,
+                              fine_candidates, &fine_stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 1);
+
+    num_candidates = 2;
+    status = XYTH_identify_ex(&ctx_mr, &tpl_mr, &num_candidates, candidates,
+                              &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(candidates[0].tpl_id, tpl_id_mr);
+    ck_assert_int_eq(candidates[0].template_score,
+                     fine_candidates[0].template_score);
+    ck_assert_int_eq(candidates[0].matched_minutiae,
+                     fine_candidates[0].matched_minutiae);
+    ck_assert_int_eq(candidates[0].best_minutia_votes,
+                     fine_candidates[0].best_minutia_votes);
+    ck_assert_int_lt(stats.groups_visited, fine_stats.groups_visited);
+
+    XYTH_destroy_context(&fine_ctx);
+}
+END_TEST
+
+START_TEST(multires_remove)
+{
+    XYTH_status status;
+    struct XYTH_database_stats stats;
+    unsigned int num_ids = 1;
+    unsigned int ids[1];
+
+    status = XYTH_remove_template(&ctx_mr, &tpl_mr, tpl_id_mr);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_get_database_stats(&ctx_mr, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(stats.num_postings, 0);
+
+    status = XYTH_identify(&ctx_mr, &tpl_mr, &num_ids, ids);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_ids, 0);
+}
+END_TEST
+
+START_TEST(invalid_multires)
+{
+    XYTH_status status;
+    struct XYTH_context ctx = {0};
+    struct XYTH_database_config cfg;
+
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_DENSITY(cfg, DB_MULTIRES_MAX_RESIDUAL + 1, 16);
+    XYTH_DB_CONFIG_SET_MULTIRES(cfg);
+
+    status = XYTH_create_context(&ctx, &cfg);
+    ck_assert_int_eq(status, XYTH_E_INVALID_CONFIGURATION);
+}
+END_TEST
+
+TCase *multires_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("Multires");
+
+    tcase_add_unchecked_fixture(tcase, multires_setup, multires_teardown);
+
+    tcase_add_test(tcase, same_as_fine_index);
+    tcase_add_test(tcase, multires_remove);
+    tcase_add_test(tcase, invalid_multires);
+
+    return tcase;
+}
@@ -0,0 +1,278 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// poll() is POSIX
+#define _POSIX_C_SOURCE 200112L
+
+#include <check.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <xyth.h>
+
+#define XYT_OK                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+#define NUM_ADDERS_NU 4
+#define NUM_ADDS_NU 8
+
+struct XYTH_template tpl_nu = {0};
+struct XYTH_context ctx_nu = {0};
+unsigned int tpl_id_nu;
+
+void numa_setup()
+{
+    XYTH_status status;
+
+    status = XYTH_template_from_xyt(XYT_OK, &tpl_nu, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&ctx_nu, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&ctx_nu, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_add_template(&ctx_nu, &tpl_nu, &tpl_id_nu);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+void numa_teardown()
+{
+    XYTH_destroy_context(&ctx_nu);
+    XYTH_destroy_template(&tpl_nu);
+}
+
+START_TEST(node_local_identify)
+{
+    XYTH_status status;
+    struct XYTH_pool *pool;
+    struct XYTH_completion completion;
+    unsigned int ids[1];
+    unsigned int num_ids = 1;
+    unsigned int ticket;
+    struct pollfd pfd;
+
+    // Every Linux system has node 0, but may not allow moving pages
+    status = XYTH_move_to_node(&ctx_nu, 0);
+    ck_assert(status == XYTH_SUCCESS || status == XYTH_E_NOT_IMPLEMENTED);
+
+    // Moving does not change the results
+    status = XYTH_identify(&ctx_nu, &tpl_nu, &num_ids, ids);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_ids, 1);
+    ck_assert_int_eq(ids[0], tpl_id_nu);
+
+    status = XYTH_create_node_pool(0, &pool);
+    if (status == XYTH_E_VALUE_OUT_OF_RANGE) {
+        // No /sys/devices/system/node, e.g. a kernel without NUMA
+        return;
+    }
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_attach_pool(&ctx_nu, pool);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_submit_identify(&ctx_nu, &tpl_nu, &ticket);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_get_completion_fd(&ctx_nu, &pfd.fd);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    pfd.events = POLLIN;
+    ck_assert_int_eq(poll(&pfd, 1, 10000), 1);
+
+    status = XYTH_poll_completion(&ctx_nu, &completion);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(completion.status, XYTH_SUCCESS);
+    ck_assert_int_eq(completion.num_candidates, 1);
+    ck_assert_int_eq(completion.candidates[0].tpl_id, tpl_id_nu);
+
+    status = XYTH_attach_pool(&ctx_nu, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    XYTH_destroy_pool(pool);
+}
+END_TEST
+
+START_TEST(replicate_context)
+{
+    XYTH_status status;
+    struct XYTH_replicas *replicas;
+    struct XYTH_context *local, *replica;
+    unsigned int nodes[1] = {0};
+    unsigned int ids[2];
+    unsigned int num_ids = 2;
+    unsigned int tpl_id;
+
+    status = XYTH_create_replicas(&ctx_nu, 1, nodes, &replicas);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    // Every thread of a single-node system runs on node 0
+    status = XYTH_get_local_replica(replicas, &local);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_get_replica(replicas, 0, &replica);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_ptr_eq(local, replica);
+    ck_assert(local != &ctx_nu);
+    status = XYTH_get_replica(replicas, 1, &replica);
+    ck_assert_int_eq(status, XYTH_E_NOT_FOUND);
+
+    // The copy holds the templates under the same ids, and takes new ones
+    status = XYTH_add_to_replicas(replicas, &tpl_nu, &tpl_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(tpl_id, tpl_id_nu + 1);
+
+    status = XYTH_identify(local, &tpl_nu, &num_ids, ids);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_ids, 2);
+    ck_assert(ids[0] == tpl_id_nu || ids[1] == tpl_id_nu);
+    ck_assert(ids[0] == tpl_id || ids[1] == tpl_id);
+
+    status = XYTH_remove_from_replicas(replicas, &tpl_nu, tpl_id_nu);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    num_ids = 2;
+    status = XYTH_identify(local, &tpl_nu, &num_ids, ids);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_ids, 1);
+    ck_assert_int_eq(ids[0], tpl_id);
+
+    // The replicated context is left as it was
+    num_ids = 2;
+    status = XYTH_identify(&ctx_nu, &tpl_nu, &num_ids, ids);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_ids, 1);
+    ck_assert_int_eq(ids[0], tpl_id_nu);
+
+    XYTH_destroy_replicas(replicas);
+}
+END_TEST
+
+START_TEST(invalid_node)
+{
+    XYTH_status status;
+    struct XYTH_pool *pool;
+    struct XYTH_replicas *replicas;
+    struct XYTH_context *ctx;
+    unsigned int twice[2] = {0, 0};
+    unsigned int far[1] = {100000};
+
+    status = XYTH_move_to_node(NULL, 0);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+
+    status = XYTH_move_to_node(&ctx_nu, 100000);
+    ck_assert_int_eq(status, XYTH_E_VALUE_OUT_OF_RANGE);
+
+    status = XYTH_create_node_pool(0, NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+
+    status = XYTH_create_node_pool(100000, &pool);
+    ck_assert_int_eq(status, XYTH_E_VALUE_OUT_OF_RANGE);
+
+    status = XYTH_create_replicas(&ctx_nu, 2, twice, NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+    status = XYTH_create_replicas(&ctx_nu, 0, twice, &replicas);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+    status = XYTH_create_replicas(&ctx_nu, 2, twice, &replicas);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+    status = XYTH_create_replicas(&ctx_nu, 1, far, &replicas);
+    ck_assert_int_eq(status, XYTH_E_VALUE_OUT_OF_RANGE);
+    status = XYTH_get_local_replica(NULL, &ctx);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+}
+END_TEST
+
+struct add_args_nu {
+    struct XYTH_replicas *replicas;
+    unsigned int ids[NUM_ADDS_NU];
+};
+
+static void *add_thread_nu(void *arg)
+{
+    struct add_args_nu *args = arg;
+
+    for (unsigned int i = 0; i < NUM_ADDS_NU; i++) {
+        if (XYTH_add_to_replicas(args->replicas, &tpl_nu, &args->ids[i]) !=
+            XYTH_SUCCESS) {
+            args->ids[i] = XYTH_RESERVED_TEMPLATE_ID;
+        }
+    }
+
+    return NULL;
+}
+
+START_TEST(concurrent_replica_adds)
+{
+    XYTH_status status;
+    struct XYTH_replicas *replicas;
+    struct XYTH_context *replica;
+    struct add_args_nu args[NUM_ADDERS_NU];
+    pthread_t threads[NUM_ADDERS_NU];
+    bool seen[NUM_ADDERS_NU * NUM_ADDS_NU + 1] = {false};
+    unsigned int nodes[1] = {0};
+    unsigned int tpl_counter;
+
+    status = XYTH_create_replicas(&ctx_nu, 1, nodes, &replicas);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    for (unsigned int i = 0; i < NUM_ADDERS_NU; i++) {
+        args[i].replicas = replicas;
+        ck_assert_int_eq(
+            pthread_create(&threads[i], NULL, add_thread_nu, &args[i]), 0);
+    }
+
+    // Ids follow those of 'ctx_nu', each handed out once
+    for (unsigned int i = 0; i < NUM_ADDERS_NU; i++) {
+        pthread_join(threads[i], NULL);
+        for (unsigned int j = 0; j < NUM_ADDS_NU; j++) {
+            ck_assert_int_gt(args[i].ids[j], tpl_id_nu);
+            ck_assert_int_le(args[i].ids[j], NUM_ADDERS_NU * NUM_ADDS_NU);
+            ck_assert(!seen[args[i].ids[j]]);
+            seen[args[i].ids[j]] = true;
+        }
+    }
+
+    status = XYTH_get_replica(replicas, 0, &replica);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_get_template_counter(replica, &tpl_counter);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(tpl_counter, NUM_ADDERS_NU * NUM_ADDS_NU + 1);
+
+    XYTH_destroy_replicas(replicas);
+}
+END_TEST
+
+TCase *numa_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("NUMA");
+
+    tcase_add_unchecked_fixture(tcase, numa_setup, numa_teardown);
+
+    tcase_add_test(tcase, node_local_identify);
+    tcase_add_test(tcase, replicate_context);
+    tcase_add_test(tcase, concurrent_replica_adds);
+    tcase_add_test(tcase, invalid_node);
+
+    return tcase;
+}
@@ -0,0 +1,325 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <check.h>
+#include <stdio.h>
+#include <xyth.h>
+
+// A coarse density whose last x, y and angle groups are only partly used, so
+// windows get clamped at the edges of the index and wrap around 359 degrees
+#define MAX_COORD_OC 33
+#define PIXELS_PER_GROUP_OC 4
+#define DEGREES_PER_GROUP_OC 7
+#define X_TOLERANCE_OC 5
+#define Y_TOLERANCE_OC 5
+#define T_TOLERANCE_OC 7
+#define MINUTIA_THRESHOLD_OC 2
+
+#define NUM_TEMPLATES_OC 8
+#define NUM_PROBES_OC (NUM_TEMPLATES_OC + 4)
+#define NUM_MINUTIAE_OC 12
+#define BOX_SIZE_OC 24 // Keeps every neighbor inside MAX_COORD_OC
+
+struct XYTH_template gallery_oc[NUM_TEMPLATES_OC];
+struct XYTH_template probes_oc[NUM_PROBES_OC];
+unsigned int tpl_ids_oc[NUM_TEMPLATES_OC];
+struct XYTH_context ctx_oc = {0};
+unsigned int seed_oc = 12345;
+const int edge_minutiae_oc[4][3] = {
+    {1, 12, 0}, {MAX_COORD_OC - 1, 12, 359}, {12, 1, 0},
+    {12, MAX_COORD_OC - 1, 270}};
+
+static unsigned int random_oc(unsigned int range)
+{
+    seed_oc = seed_oc * 1103515245 + 12345;
+    return (seed_oc >> 16) % range;
+}
+
+//
+// Creates a template of scattered minutiae. With 'base' set, the minutiae are
+// those of 'base', jittered by a few pixels and degrees.
+//
+static void create_template_oc(struct XYTH_template *base,
+                               struct XYTH_template *tpl)
+{
+    XYTH_status status;
+    char xyt[NUM_MINUTIAE_OC * 16];
+    unsigned int length = 0;
+
+    for (unsigned int i = 0; i < NUM_MINUTIAE_OC; i++) {
+        int x, y, angle;
+
+        if (base != NULL) {
+            x = base->minutiae[i].x + random_oc(3) - 1;
+            y = base->minutiae[i].y + random_oc(3) - 1;
+            angle = base->minutiae[i].angle + 360 + random_oc(5) - 2;
+        } else if (i < 4) {
+            // Two pairs MAX_COORD_OC - 2 pixels apart along each axis. Their
+            // angles give relative angles on both ends of the range.
+            x = edge_minutiae_oc[i][0];
+            y = edge_minutiae_oc[i][1];
+            angle = edge_minutiae_oc[i][2];
+        } else {
+            x = random_oc(BOX_SIZE_OC - 2) + 1;
+            y = random_oc(BOX_SIZE_OC - 2) + 1;
+            angle = random_oc(360);
+        }
+        length += snprintf(&xyt[length], sizeof(xyt) - length, "%d %d %d\n",
+                           x, y, angle % 360);
+    }
+
+    status = XYTH_template_from_xyt(xyt, tpl, NUM_MINUTIAE_OC - 1);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+void occupancy_setup()
+{
+    XYTH_status status;
+    struct XYTH_database_config cfg;
+
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_MAX_COORD(cfg, MAX_COORD_OC, MAX_COORD_OC);
+    XYTH_DB_CONFIG_SET_DENSITY(cfg, PIXELS_PER_GROUP_OC,
+                               DEGREES_PER_GROUP_OC);
+
+    status = XYTH_create_context(&ctx_oc, &cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_match_tolerances(&ctx_oc, X_TOLERANCE_OC,
+                                       Y_TOLERANCE_OC, T_TOLERANCE_OC);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_match_thresholds(&ctx_oc, MINUTIA_THRESHOLD_OC, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    for (unsigned int i = 0; i < NUM_TEMPLATES_OC; i++) {
+        create_template_oc(NULL, &gallery_oc[i]);
+        status = XYTH_add_template(&ctx_oc, &gallery_oc[i], &tpl_ids_oc[i]);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+
+    // A jittered copy of each template, then probes matching none of them
+    for (unsigned int i = 0; i < NUM_PROBES_OC; i++) {
+        create_template_oc(i < NUM_TEMPLATES_OC ? &gallery_oc[i] : NULL,
+                           &probes_oc[i]);
+    }
+}
+
+void occupancy_teardown()
+{
+    for (unsigned int i = 0; i < NUM_TEMPLATES_OC; i++) {
+        XYTH_destroy_template(&gallery_oc[i]);
+    }
+    for (unsigned int i = 0; i < NUM_PROBES_OC; i++) {
+        XYTH_destroy_template(&probes_oc[i]);
+    }
+    XYTH_destroy_context(&ctx_oc);
+}
+
+static unsigned int linear_group_oc(int value)
+{
+    return (MAX_COORD_OC + value) / PIXELS_PER_GROUP_OC;
+}
+
+//
+// Checks whether 'stored' is in one of the groups visited by stepping through
+// the tolerance window of 'probe', one group at a time, whether the groups
+// are empty or not.
+//
+static bool in_window_oc(struct _XYTH_neighbor *probe,
+                         struct _XYTH_neighbor *stored)
+{
+    int x_begin = probe->relative_x - X_TOLERANCE_OC;
+    int x_end = probe->relative_x + X_TOLERANCE_OC;
+    int y_begin = probe->relative_y - Y_TOLERANCE_OC;
+    int y_end = probe->relative_y + Y_TOLERANCE_OC;
+    int t_begin = (int)probe->relative_angle - T_TOLERANCE_OC;
+    int t_end = probe->relative_angle + T_TOLERANCE_OC;
+    bool x_found = false, y_found = false, t_found = false;
+
+    x_begin = x_begin < -MAX_COORD_OC ? -MAX_COORD_OC : x_begin;
+    x_end = x_end > MAX_COORD_OC ? MAX_COORD_OC : x_end;
+    y_begin = y_begin < -MAX_COORD_OC ? -MAX_COORD_OC : y_begin;
+    y_end = y_end > MAX_COORD_OC ? MAX_COORD_OC : y_end;
+    if (t_begin < 0) {
+        t_begin += 360;
+        t_end += 360;
+    }
+
+    for (int x = x_begin; x <= x_end; x += PIXELS_PER_GROUP_OC) {
+        x_found |= linear_group_oc(x) == linear_group_oc(stored->relative_x);
+    }
+    for (int y = y_begin; y <= y_end; y += PIXELS_PER_GROUP_OC) {
+        y_found |= linear_group_oc(y) == linear_group_oc(stored->relative_y);
+    }
+    for (int t = t_begin; t <= t_end; t += DEGREES_PER_GROUP_OC) {
+        t_found |= (t % 360) / DEGREES_PER_GROUP_OC ==
+                   stored->relative_angle / DEGREES_PER_GROUP_OC;
+    }
+
+    return x_found && y_found && t_found;
+}
+
+//
+// Scores 'probe' against 'stored' the way identify does, without an index:
+// a probe minutia counts if any minutia of 'stored' collects
+// MINUTIA_THRESHOLD_OC votes from its neighbors.
+//
+static unsigned int brute_force_score_oc(struct XYTH_template *probe,
+                                         struct XYTH_template *stored)
+{
+    unsigned int score = 0;
+
+    for (unsigned int i = 0; i < probe->num_minutiae; i++) {
+        struct _XYTH_minutia *probe_min = &probe->minutiae[i];
+        bool matched = false;
+
+        for (unsigned int j = 0; j < stored->num_minutiae && !matched; j++) {
+            struct _XYTH_minutia *stored_min = &stored->minutiae[j];
+            unsigned int votes = 0;
+
+            for (unsigned int p = 0; p < probe_min->num_neighbors; p++) {
+                for (unsigned int s = 0; s < stored_min->num_neighbors; s++) {
+                    votes += in_window_oc(&probe_min->neighbors[p],
+                                          &stored_min->neighbors[s]);
+                }
+            }
+            matched = votes >= MINUTIA_THRESHOLD_OC;
+        }
+        score += matched;
+    }
+
+    return score;
+}
+
+START_TEST(edge_groups_used)
+{
+    unsigned int last_xy_group = linear_group_oc(MAX_COORD_OC);
+    unsigned int last_t_group = 359 / DEGREES_PER_GROUP_OC;
+    bool last_x = false, last_y = false, last_t = false;
+    bool wrapping = false;
+
+    // The gallery fills the last groups, and probes' windows wrap around
+    for (unsigned int i = 0; i < NUM_TEMPLATES_OC; i++) {
+        for (unsigned int j = 0; j < gallery_oc[i].num_minutiae; j++) {
+            struct _XYTH_minutia *min = &gallery_oc[i].minutiae[j];
+            for (unsigned int k = 0; k < min->num_neighbors; k++) {
+                struct _XYTH_neighbor *nei = &min->neighbors[k];
+                last_x |= linear_group_oc(nei->relative_x) == last_xy_group;
+                last_y |= linear_group_oc(nei->relative_y) == last_xy_group;
+                last_t |= nei->relative_angle / DEGREES_PER_GROUP_OC ==
+                          last_t_group;
+            }
+        }
+    }
+    for (unsigned int i = 0; i < NUM_PROBES_OC; i++) {
+        for (unsigned int j = 0; j < probes_oc[i].num_minutiae; j++) {
+            struct _XYTH_minutia *min = &probes_oc[i].minutiae[j];
+            for (unsigned int k = 0; k < min->num_neighbors; k++) {
+                unsigned int angle = min->neighbors[k].relative_angle;
+                wrapping |= angle < T_TOLERANCE_OC ||
+                            angle + T_TOLERANCE_OC >= 360;
+            }
+        }
+    }
+
+    ck_assert(last_x);
+    ck_assert(last_y);
+    ck_assert(last_t);
+    ck_assert(wrapping);
+}
+END_TEST
+
+START_TEST(same_as_brute_force)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[NUM_TEMPLATES_OC];
+    unsigned int num_matched = 0;
+
+    for (unsigned int i = 0; i < NUM_PROBES_OC; i++) {
+        unsigned int num_candidates = NUM_TEMPLATES_OC;
+        unsigned int num_expected = 0;
+
+        status = XYTH_identify_ex(&ctx_oc, &probes_oc[i], &num_candidates,
+                                  candidates, NULL);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+
+        for (unsigned int j = 0; j < NUM_TEMPLATES_OC; j++) {
+            unsigned int expected =
+                brute_force_score_oc(&probes_oc[i], &gallery_oc[j]);
+            unsigned int found = 0;
+
+            for (unsigned int k = 0; k < num_candidates; k++) {
+                if (candidates[k].tpl_id == tpl_ids_oc[j]) {
+                    found = candidates[k].template_score;
+                }
+            }
+            ck_assert_int_eq(found, expected);
+            num_expected += expected > 0;
+        }
+        ck_assert_int_eq(num_candidates, num_expected);
+        num_matched += num_candidates > 0;
+    }
+
+    // Neither every window is empty nor every probe matches everything
+    ck_assert_int_gt(num_matched, 0);
+}
+END_TEST
+
+START_TEST(empty_windows)
+{
+    XYTH_status status;
+    struct XYTH_context empty_ctx = {0};
+    struct XYTH_candidate candidates[NUM_TEMPLATES_OC];
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates = NUM_TEMPLATES_OC;
+    unsigned int tpl_id;
+
+    // Once its only template is removed, every window of the index is empty
+    status = XYTH_create_context(&empty_ctx, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_add_template(&empty_ctx, &gallery_oc[0], &tpl_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_remove_template(&empty_ctx, &gallery_oc[0], tpl_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_identify_ex(&empty_ctx, &gallery_oc[0], &num_candidates,
+                              candidates, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 0);
+    ck_assert_int_eq(stats.groups_visited, 0);
+    ck_assert_int_eq(stats.postings_scanned, 0);
+
+    XYTH_destroy_context(&empty_ctx);
+}
+END_TEST
+
+TCase *occupancy_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("Occupancy");
+
+    tcase_add_unchecked_fixture(tcase, occupancy_setup, occupancy_teardown);
+
+    tcase_add_test(tcase, edge_groups_used);
+    tcase_add_test(tcase, same_as_brute_force);
+    tcase_add_test(tcase, empty_windows);
+
+    return tcase;
+}
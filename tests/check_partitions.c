@@ -0,0 +1,178 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <check.h>
+#include <xyth.h>
+
+#define XYT_OK                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+struct XYTH_template tpl_pt = {0};
+struct XYTH_context ctx_pt = {0};
+// Templates 0 and 2 go to partition 2, template 1 to partition 0
+unsigned int tpl_ids_pt[3];
+unsigned int tpl_partitions_pt[3] = {2, 0, 2};
+
+void partitions_setup()
+{
+    XYTH_status status;
+    struct XYTH_database_config cfg;
+
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_PARTITIONS(cfg, 3);
+
+    status = XYTH_template_from_xyt(XYT_OK, &tpl_pt, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&ctx_pt, &cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&ctx_pt, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    for (unsigned int i = 0; i < 3; i++) {
+        status = XYTH_add_template_to_partition(
+            &ctx_pt, &tpl_pt, tpl_partitions_pt[i], &tpl_ids_pt[i]);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+}
+
+void partitions_teardown()
+{
+    XYTH_destroy_template(&tpl_pt);
+    XYTH_destroy_context(&ctx_pt);
+}
+
+START_TEST(single_partition)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[3];
+    struct XYTH_identify_stats stats, all_stats;
+    unsigned int num_candidates = 3;
+
+    status = XYTH_identify_in_partitions(&ctx_pt, &tpl_pt, 1 << 0,
+                                         &num_candidates, candidates, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(candidates[0].tpl_id, tpl_ids_pt[1]);
+    ck_assert_int_eq(candidates[0].template_score, tpl_pt.num_minutiae);
+
+    // Postings of the other partitions are not read
+    num_candidates = 3;
+    status = XYTH_identify_ex(&ctx_pt, &tpl_pt, &num_candidates, candidates,
+                              &all_stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 3);
+    ck_assert_int_eq(stats.postings_scanned * 3, all_stats.postings_scanned);
+}
+END_TEST
+
+START_TEST(several_partitions)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[3];
+    unsigned int num_candidates = 3;
+
+    status = XYTH_identify_in_partitions(&ctx_pt, &tpl_pt, 1 << 2,
+                                         &num_candidates, candidates, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 2);
+    ck_assert_int_ne(candidates[0].tpl_id, tpl_ids_pt[1]);
+    ck_assert_int_ne(candidates[1].tpl_id, tpl_ids_pt[1]);
+
+    // Partition 1 is empty
+    num_candidates = 3;
+    status = XYTH_identify_in_partitions(&ctx_pt, &tpl_pt, 1 << 1,
+                                         &num_candidates, candidates, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 0);
+
+    num_candidates = 3;
+    status = XYTH_identify_in_partitions(&ctx_pt, &tpl_pt, (1 << 0) | (1 << 1),
+                                         &num_candidates, candidates, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(candidates[0].tpl_id, tpl_ids_pt[1]);
+}
+END_TEST
+
+START_TEST(remove_from_partition)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[3];
+    unsigned int num_candidates = 3;
+
+    status = XYTH_remove_template(&ctx_pt, &tpl_pt, tpl_ids_pt[0]);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_identify_in_partitions(&ctx_pt, &tpl_pt, 1 << 2,
+                                         &num_candidates, candidates, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(candidates[0].tpl_id, tpl_ids_pt[2]);
+
+    status = XYTH_add_template_to_partition(&ctx_pt, &tpl_pt, 2,
+                                            &tpl_ids_pt[0]);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+END_TEST
+
+START_TEST(invalid_partition)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[3];
+    struct XYTH_database_config cfg;
+    struct XYTH_context ctx = {0};
+    unsigned int num_candidates = 3;
+    unsigned int tpl_id;
+
+    status = XYTH_add_template_to_partition(&ctx_pt, &tpl_pt, 3, &tpl_id);
+    ck_assert_int_eq(status, XYTH_E_VALUE_OUT_OF_RANGE);
+
+    status = XYTH_identify_in_partitions(&ctx_pt, &tpl_pt, 0, &num_candidates,
+                                         candidates, NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_PARTITIONS(cfg, DB_MAX_PARTITIONS + 1);
+    status = XYTH_create_context(&ctx, &cfg);
+    ck_assert_int_eq(status, XYTH_E_INVALID_CONFIGURATION);
+}
+END_TEST
+
+TCase *partitions_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("Partitions");
+
+    tcase_add_unchecked_fixture(tcase, partitions_setup, partitions_teardown);
+
+    tcase_add_test(tcase, single_partition);
+    tcase_add_test(tcase, several_partitions);
+    tcase_add_test(tcase, remove_from_partition);
+    tcase_add_test(tcase, invalid_partition);
+
+    return tcase;
+}
@@ -0,0 +1,151 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// poll() is POSIX
+#define _POSIX_C_SOURCE 200112L
+
+#include <check.h>
+#include <poll.h>
+#include <xyth.h>
+
+#define XYT_OK                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+#define NUM_CONTEXTS_PL 2
+#define NUM_REQUESTS_PL 8
+
+struct XYTH_template tpl_pl = {0};
+struct XYTH_context ctx_pl[NUM_CONTEXTS_PL] = {{0}};
+unsigned int tpl_id_pl[NUM_CONTEXTS_PL];
+
+void pool_setup()
+{
+    XYTH_status status;
+
+    status = XYTH_template_from_xyt(XYT_OK, &tpl_pl, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    for (unsigned int i = 0; i < NUM_CONTEXTS_PL; i++) {
+        status = XYTH_create_context(&ctx_pl[i], NULL);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+
+        status = XYTH_set_match_thresholds(&ctx_pl[i], 10, 1, 0);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+
+        status = XYTH_add_template(&ctx_pl[i], &tpl_pl, &tpl_id_pl[i]);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+}
+
+void pool_teardown()
+{
+    for (unsigned int i = 0; i < NUM_CONTEXTS_PL; i++) {
+        XYTH_destroy_context(&ctx_pl[i]);
+    }
+    XYTH_destroy_template(&tpl_pl);
+}
+
+START_TEST(shared_pool)
+{
+    XYTH_status status;
+    struct XYTH_pool *pool;
+    struct XYTH_completion completion;
+    const unsigned int cpus[2] = {0, 0};
+    unsigned int ticket;
+
+    status = XYTH_create_pool(2, cpus, &pool);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    for (unsigned int i = 0; i < NUM_CONTEXTS_PL; i++) {
+        status = XYTH_attach_pool(&ctx_pl[i], pool);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+
+    for (unsigned int i = 0; i < NUM_REQUESTS_PL; i++) {
+        status = XYTH_submit_identify(&ctx_pl[i % NUM_CONTEXTS_PL], &tpl_pl,
+                                      &ticket);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+
+    // Each context gets the completions of its own requests
+    for (unsigned int i = 0; i < NUM_CONTEXTS_PL; i++) {
+        for (unsigned int j = 0; j < NUM_REQUESTS_PL / NUM_CONTEXTS_PL; j++) {
+            struct pollfd pfd;
+
+            status = XYTH_get_completion_fd(&ctx_pl[i], &pfd.fd);
+            ck_assert_int_eq(status, XYTH_SUCCESS);
+            pfd.events = POLLIN;
+            ck_assert_int_eq(poll(&pfd, 1, 10000), 1);
+
+            status = XYTH_poll_completion(&ctx_pl[i], &completion);
+            ck_assert_int_eq(status, XYTH_SUCCESS);
+            ck_assert_int_eq(completion.status, XYTH_SUCCESS);
+            ck_assert_int_eq(completion.num_candidates, 1);
+            ck_assert_int_eq(completion.candidates[0].tpl_id, tpl_id_pl[i]);
+        }
+        status = XYTH_poll_completion(&ctx_pl[i], &completion);
+        ck_assert_int_eq(status, XYTH_E_NOT_FOUND);
+    }
+
+    // Detached contexts no longer accept requests
+    for (unsigned int i = 0; i < NUM_CONTEXTS_PL; i++) {
+        status = XYTH_attach_pool(&ctx_pl[i], NULL);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+        status = XYTH_submit_identify(&ctx_pl[i], &tpl_pl, &ticket);
+        ck_assert_int_eq(status, XYTH_E_NOT_INITIALIZED);
+    }
+
+    XYTH_destroy_pool(pool);
+}
+END_TEST
+
+START_TEST(invalid_pool)
+{
+    XYTH_status status;
+    struct XYTH_pool *pool;
+
+    status = XYTH_create_pool(0, NULL, &pool);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+
+    status = XYTH_create_pool(100000, NULL, &pool);
+    ck_assert_int_eq(status, XYTH_E_VALUE_OUT_OF_RANGE);
+
+    status = XYTH_attach_pool(NULL, NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+}
+END_TEST
+
+TCase *pool_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("Pool");
+
+    tcase_add_unchecked_fixture(tcase, pool_setup, pool_teardown);
+
+    tcase_add_test(tcase, shared_pool);
+    tcase_add_test(tcase, invalid_pool);
+
+    return tcase;
+}
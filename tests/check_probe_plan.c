@@ -0,0 +1,168 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <check.h>
+#include <xyth.h>
+
+#define XYT_OK                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+struct XYTH_template tpl_pp = {0};
+struct XYTH_context ctx_pp = {0};
+unsigned int tpl_id_pp;
+
+void probe_plan_setup()
+{
+    XYTH_status status;
+
+    status = XYTH_template_from_xyt(XYT_OK, &tpl_pp, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&ctx_pp, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&ctx_pp, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_add_template(&ctx_pp, &tpl_pp, &tpl_id_pp);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+void probe_plan_teardown()
+{
+    XYTH_destroy_template(&tpl_pp);
+    XYTH_destroy_context(&ctx_pp);
+}
+
+START_TEST(estimate_cost)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[2];
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates = 2;
+    unsigned long long postings;
+
+    status = XYTH_estimate_identify_cost(&ctx_pp, &tpl_pp, &postings);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_identify_ex(&ctx_pp, &tpl_pp, &num_candidates, candidates,
+                              &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(stats.estimated_postings, 0);
+    // Every group in the windows is read, so the estimate is exact
+    ck_assert_int_eq(postings, stats.postings_scanned);
+
+    status = XYTH_estimate_identify_cost(NULL, &tpl_pp, &postings);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+    status = XYTH_estimate_identify_cost(&ctx_pp, &tpl_pp, NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+}
+END_TEST
+
+START_TEST(ordered_identify)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[2];
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates;
+    XYTH_probe_order orders[] = {XYTH_PROBE_ORDER_CHEAPEST,
+                                 XYTH_PROBE_ORDER_SELECTIVE};
+
+    for (unsigned int i = 0; i < 2; i++) {
+        status = XYTH_set_probe_plan(&ctx_pp, orders[i], 0);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+
+        num_candidates = 2;
+        status = XYTH_identify_ex(&ctx_pp, &tpl_pp, &num_candidates,
+                                  candidates, &stats);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+        ck_assert_int_eq(num_candidates, 1);
+        ck_assert_int_eq(candidates[0].tpl_id, tpl_id_pp);
+        ck_assert_int_eq(candidates[0].template_score, tpl_pp.num_minutiae);
+        ck_assert_int_eq(stats.estimated_postings, stats.postings_scanned);
+        ck_assert_int_eq(stats.minutiae_dropped, 0);
+    }
+
+    status = XYTH_set_probe_plan(&ctx_pp, XYTH_PROBE_ORDER_TEMPLATE, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+END_TEST
+
+START_TEST(drop_expensive)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[2];
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates = 2;
+    unsigned long long all_postings;
+
+    status = XYTH_estimate_identify_cost(&ctx_pp, &tpl_pp, &all_postings);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_probe_plan(&ctx_pp, XYTH_PROBE_ORDER_CHEAPEST, 50);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_identify_ex(&ctx_pp, &tpl_pp, &num_candidates, candidates,
+                              &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(stats.minutiae_dropped, tpl_pp.num_minutiae / 2);
+    ck_assert_int_eq(stats.minutiae_processed,
+                     tpl_pp.num_minutiae - stats.minutiae_dropped);
+    ck_assert_int_lt(stats.postings_scanned, all_postings);
+
+    status = XYTH_set_probe_plan(&ctx_pp, XYTH_PROBE_ORDER_TEMPLATE, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+END_TEST
+
+START_TEST(invalid_plan)
+{
+    XYTH_status status;
+
+    status = XYTH_set_probe_plan(NULL, XYTH_PROBE_ORDER_CHEAPEST, 0);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+
+    status = XYTH_set_probe_plan(&ctx_pp, XYTH_PROBE_ORDER_CHEAPEST, 100);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+
+    status = XYTH_set_probe_plan(&ctx_pp, (XYTH_probe_order)3, 0);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+}
+END_TEST
+
+TCase *probe_plan_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("ProbePlan");
+
+    tcase_add_unchecked_fixture(tcase, probe_plan_setup, probe_plan_teardown);
+
+    tcase_add_test(tcase, estimate_cost);
+    tcase_add_test(tcase, ordered_identify);
+    tcase_add_test(tcase, drop_expensive);
+    tcase_add_test(tcase, invalid_plan);
+
+    return tcase;
+}
@@ -0,0 +1,331 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <check.h>
+#include <pthread.h>
+#include <xyth.h>
+
+#define XYT_OK                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+#define NUM_CANDIDATES_RD 4
+#define SUBJECT_RD 7
+#define NUM_QUERIES_RD 100
+#define NUM_RECONFIGURES_RD 10
+#define NUM_ADDS_RD 20
+
+struct XYTH_template tpl_rd = {0};
+struct XYTH_context ctx_rd = {0};
+
+void reconfigure_setup()
+{
+    XYTH_status status;
+    struct XYTH_database_config cfg;
+    unsigned int tpl_id;
+
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_DENSITY(cfg, 4, 8);
+    XYTH_DB_CONFIG_SET_PARTITIONS(cfg, 2);
+
+    status = XYTH_template_from_xyt(XYT_OK, &tpl_rd, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&ctx_rd, &cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_match_thresholds(&ctx_rd, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    // Ids 0 and 2 are left, in different partitions, 2 with a subject
+    for (unsigned int i = 0; i < 3; i++) {
+        status = XYTH_add_template_to_partition(&ctx_rd, &tpl_rd, i / 2,
+                                                &tpl_id);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+    status = XYTH_remove_template(&ctx_rd, &tpl_rd, 1);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_template_subject(&ctx_rd, 2, SUBJECT_RD,
+                                       XYTH_FINGER_UNKNOWN);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+void reconfigure_teardown()
+{
+    XYTH_destroy_context(&ctx_rd);
+    XYTH_destroy_template(&tpl_rd);
+}
+
+START_TEST(reconfigure_density)
+{
+    XYTH_status status;
+    struct XYTH_database_config cfg;
+    struct XYTH_database_stats before, after;
+    struct XYTH_candidate candidates[NUM_CANDIDATES_RD];
+    struct XYTH_subject_candidate subjects[NUM_CANDIDATES_RD];
+    unsigned int num_candidates = NUM_CANDIDATES_RD;
+    unsigned int tpl_id;
+
+    status = XYTH_get_database_stats(&ctx_rd, &before);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_DENSITY(cfg, 8, 16);
+    XYTH_DB_CONFIG_SET_MULTIRES(cfg);
+    XYTH_DB_CONFIG_SET_PARTITIONS(cfg, 2);
+    status = XYTH_reconfigure_context(&ctx_rd, &cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_get_database_stats(&ctx_rd, &after);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(after.num_templates, 2);
+    ck_assert_int_lt(after.num_groups, before.num_groups);
+
+    // Ids, partitions and subjects are kept
+    status = XYTH_identify_in_partitions(&ctx_rd, &tpl_rd, 1 << 1,
+                                         &num_candidates, candidates, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(candidates[0].tpl_id, 2);
+
+    num_candidates = NUM_CANDIDATES_RD;
+    status = XYTH_identify_ex(&ctx_rd, &tpl_rd, &num_candidates, candidates,
+                              NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 2);
+    ck_assert(candidates[0].tpl_id != 1 && candidates[1].tpl_id != 1);
+
+    num_candidates = NUM_CANDIDATES_RD;
+    status = XYTH_identify_multi(&ctx_rd, &tpl_rd, NULL, 1, &num_candidates,
+                                 subjects, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(subjects[0].subject_id, SUBJECT_RD);
+
+    // Removed ids are not given out again
+    status = XYTH_add_template(&ctx_rd, &tpl_rd, &tpl_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(tpl_id, 3);
+    status = XYTH_remove_template(&ctx_rd, &tpl_rd, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+END_TEST
+
+START_TEST(stale_options)
+{
+    XYTH_status status;
+    struct XYTH_context ctx;
+    struct XYTH_database_config cfg;
+    struct XYTH_match_options options;
+    struct XYTH_prepared_options *prepared;
+    struct XYTH_candidate candidates[NUM_CANDIDATES_RD];
+    unsigned int num_candidates = NUM_CANDIDATES_RD;
+    unsigned int tpl_id;
+
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_DENSITY(cfg, 4, 8);
+    status = XYTH_create_context(&ctx, &cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_match_thresholds(&ctx, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_add_template(&ctx, &tpl_rd, &tpl_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_get_match_options(&ctx, &options);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_prepare_options(&ctx, &options, &prepared);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    // The angle windows of the options were worked out for 8 degrees
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_DENSITY(cfg, 4, 4);
+    status = XYTH_reconfigure_context(&ctx, &cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_identify_with_options(&ctx, prepared, &tpl_rd,
+                                        &num_candidates, candidates, NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+    XYTH_destroy_prepared_options(prepared);
+
+    status = XYTH_prepare_options(&ctx, &options, &prepared);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    num_candidates = NUM_CANDIDATES_RD;
+    status = XYTH_identify_with_options(&ctx, prepared, &tpl_rd,
+                                        &num_candidates, candidates, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 1);
+    ck_assert_int_eq(candidates[0].tpl_id, tpl_id);
+
+    XYTH_destroy_prepared_options(prepared);
+    XYTH_destroy_context(&ctx);
+}
+END_TEST
+
+START_TEST(invalid_reconfigure)
+{
+    XYTH_status status;
+    struct XYTH_database_config cfg;
+    struct XYTH_candidate candidates[NUM_CANDIDATES_RD];
+    unsigned int num_candidates = NUM_CANDIDATES_RD;
+
+    status = XYTH_reconfigure_context(NULL, NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+
+    // The context keeps its index
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_DENSITY(cfg, 0, 8);
+    status = XYTH_reconfigure_context(&ctx_rd, &cfg);
+    ck_assert_int_eq(status, XYTH_E_INVALID_CONFIGURATION);
+
+    status = XYTH_identify_ex(&ctx_rd, &tpl_rd, &num_candidates, candidates,
+                              NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 2);
+}
+END_TEST
+
+static void *identify_thread_rd(void *arg)
+{
+    unsigned int *num_failures = arg;
+
+    *num_failures = 0;
+    for (unsigned int i = 0; i < NUM_QUERIES_RD; i++) {
+        struct XYTH_candidate candidates[NUM_CANDIDATES_RD];
+        unsigned int num_candidates = NUM_CANDIDATES_RD;
+
+        if (XYTH_identify_ex(&ctx_rd, &tpl_rd, &num_candidates, candidates,
+                             NULL) != XYTH_SUCCESS ||
+            num_candidates != 2) {
+            (*num_failures)++;
+        }
+    }
+
+    return NULL;
+}
+
+START_TEST(identify_during_reconfigure)
+{
+    XYTH_status status;
+    struct XYTH_database_config cfg;
+    pthread_t thread;
+    unsigned int num_failures;
+
+    // Each identification reads either the old index or the new one whole
+    ck_assert_int_eq(
+        pthread_create(&thread, NULL, identify_thread_rd, &num_failures), 0);
+    for (unsigned int i = 0; i < NUM_RECONFIGURES_RD; i++) {
+        XYTH_DB_CONFIG_INIT(cfg);
+        if (i % 2 == 0) {
+            XYTH_DB_CONFIG_SET_DENSITY(cfg, 4, 8);
+        } else {
+            XYTH_DB_CONFIG_SET_DENSITY(cfg, 8, 16);
+        }
+        XYTH_DB_CONFIG_SET_MULTIRES(cfg);
+        XYTH_DB_CONFIG_SET_PARTITIONS(cfg, 2);
+        status = XYTH_reconfigure_context(&ctx_rd, &cfg);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+    pthread_join(thread, NULL);
+    ck_assert_int_eq(num_failures, 0);
+}
+END_TEST
+
+struct changes_rd {
+    unsigned int tpl_ids[NUM_ADDS_RD];
+    unsigned int num_failures;
+};
+
+static void *change_thread_rd(void *arg)
+{
+    struct changes_rd *changes = arg;
+
+    changes->num_failures = 0;
+    for (unsigned int i = 0; i < NUM_ADDS_RD; i++) {
+        if (XYTH_add_template_to_partition(&ctx_rd, &tpl_rd, i % 2,
+                                           &changes->tpl_ids[i]) !=
+                XYTH_SUCCESS ||
+            (i % 2 == 0 && XYTH_remove_template(&ctx_rd, &tpl_rd,
+                                                changes->tpl_ids[i]) !=
+                               XYTH_SUCCESS)) {
+            changes->num_failures++;
+        }
+    }
+
+    return NULL;
+}
+
+START_TEST(change_during_reconfigure)
+{
+    XYTH_status status;
+    struct XYTH_database_config cfg;
+    struct XYTH_database_stats stats;
+    struct changes_rd changes;
+    pthread_t thread;
+
+    ck_assert_int_eq(
+        pthread_create(&thread, NULL, change_thread_rd, &changes), 0);
+    for (unsigned int i = 0; i < NUM_RECONFIGURES_RD; i++) {
+        XYTH_DB_CONFIG_INIT(cfg);
+        if (i % 2 == 0) {
+            XYTH_DB_CONFIG_SET_DENSITY(cfg, 4, 8);
+        } else {
+            XYTH_DB_CONFIG_SET_DENSITY(cfg, 8, 16);
+        }
+        XYTH_DB_CONFIG_SET_MULTIRES(cfg);
+        XYTH_DB_CONFIG_SET_PARTITIONS(cfg, 2);
+        status = XYTH_reconfigure_context(&ctx_rd, &cfg);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+    pthread_join(thread, NULL);
+    ck_assert_int_eq(changes.num_failures, 0);
+
+    status = XYTH_get_database_stats(&ctx_rd, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(stats.num_templates, 2 + NUM_ADDS_RD / 2);
+
+    // Every template added meanwhile has all its postings, and no removed one
+    // came back
+    for (unsigned int i = 0; i < NUM_ADDS_RD; i++) {
+        status = XYTH_remove_template(&ctx_rd, &tpl_rd, changes.tpl_ids[i]);
+        ck_assert_int_eq(status,
+                         i % 2 == 0 ? XYTH_E_NOT_FOUND : XYTH_SUCCESS);
+    }
+}
+END_TEST
+
+TCase *reconfigure_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("Reconfigure");
+
+    tcase_add_unchecked_fixture(tcase, reconfigure_setup,
+                                reconfigure_teardown);
+
+    tcase_add_test(tcase, reconfigure_density);
+    tcase_add_test(tcase, stale_options);
+    tcase_add_test(tcase, invalid_reconfigure);
+    tcase_add_test(tcase, identify_during_reconfigure);
+    tcase_add_test(tcase, change_during_reconfigure);
+
+    return tcase;
+}
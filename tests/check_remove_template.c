@@ -69,6 +69,32 @@ START_TEST(simple_success)
 }
 END_TEST
 
+START_TEST(remaining_template_found)
+{
+    XYTH_status status;
+    unsigned int removed_id, kept_id;
+    unsigned int matches[2];
+    unsigned int matches_length = 2;
+
+    // Both templates share every group, the removed one at their front
+    status = XYTH_add_template(&ctx1, &tpl3, &removed_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_add_template(&ctx1, &tpl3, &kept_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_remove_template(&ctx1, &tpl3, removed_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_identify(&ctx1, &tpl3, &matches_length, matches);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(matches_length, 1);
+    ck_assert_int_eq(matches[0], kept_id);
+
+    status = XYTH_remove_template(&ctx1, &tpl3, kept_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+END_TEST
+
 START_TEST(null_context)
 {
     XYTH_status status;
@@ -117,6 +143,7 @@ TCase *remove_template_tcase(void)
                                 remove_template_teardown);
 
     tcase_add_test(tcase, simple_success);
+    tcase_add_test(tcase, remaining_template_found);
     tcase_add_test(tcase, null_context);
     tcase_add_test(tcase, invalid_context);
     tcase_add_test(tcase, null_template);
@@ -0,0 +1,237 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <check.h>
+#include <pthread.h>
+#include <xyth.h>
+
+#define XYT_OK1                                                                \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+#define XYT_OK2                                                                \
+    "1  2 90\n  4  5 90\n  7  8 90\n 10 11 90\n 13 14 90\n \
+                16 17 90\n 19 20 90\n 22 23 90\n 25 26 90\n \
+                28 29 90\n 31 32 90\n 34 35 90\n 37 38 90\n \
+                40 41 90\n 43 44 90\n 46 47 90\n 49 50 90\n \
+                52 53 90\n 55 56 90\n 58 59 90\n 61 62 90\n"
+
+#define NUM_IDENTIFIERS_RC 4
+#define NUM_QUERIES_RC 200
+
+struct XYTH_template tpl_rc1 = {0};
+struct XYTH_template tpl_rc2 = {0};
+struct XYTH_context ctx_rc = {0};
+unsigned int tpl_id_rc1;
+
+void result_cache_setup()
+{
+    XYTH_status status;
+
+    status = XYTH_template_from_xyt(XYT_OK1, &tpl_rc1, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_template_from_xyt(XYT_OK2, &tpl_rc2, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&ctx_rc, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&ctx_rc, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_add_template(&ctx_rc, &tpl_rc1, &tpl_id_rc1);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_result_cache(&ctx_rc, 1);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+
+void result_cache_teardown()
+{
+    XYTH_destroy_template(&tpl_rc1);
+    XYTH_destroy_template(&tpl_rc2);
+    XYTH_destroy_context(&ctx_rc);
+}
+
+static void identify_and_check(struct XYTH_template *tpl,
+                               unsigned int expected_matches,
+                               unsigned int expected_cached)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[2];
+    struct XYTH_identify_stats stats;
+    unsigned int num_candidates = 2;
+
+    status = XYTH_identify_ex(&ctx_rc, tpl, &num_candidates, candidates,
+                              &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, expected_matches);
+    ck_assert_int_eq(stats.cached, expected_cached);
+}
+
+START_TEST(repeated_query)
+{
+    identify_and_check(&tpl_rc1, 1, 0);
+    identify_and_check(&tpl_rc1, 1, 1);
+}
+END_TEST
+
+START_TEST(invalidated_by_add)
+{
+    XYTH_status status;
+    unsigned int tpl_id;
+
+    identify_and_check(&tpl_rc2, 0, 0);
+    identify_and_check(&tpl_rc2, 0, 1);
+
+    status = XYTH_add_template(&ctx_rc, &tpl_rc2, &tpl_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    identify_and_check(&tpl_rc2, 1, 0);
+
+    status = XYTH_remove_template(&ctx_rc, &tpl_rc2, tpl_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    identify_and_check(&tpl_rc2, 0, 0);
+}
+END_TEST
+
+START_TEST(invalidated_by_config)
+{
+    XYTH_status status;
+
+    identify_and_check(&tpl_rc1, 1, 0);
+
+    status = XYTH_set_match_thresholds(&ctx_rc, 10, 100, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    identify_and_check(&tpl_rc1, 0, 0);
+
+    status = XYTH_set_match_thresholds(&ctx_rc, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+}
+END_TEST
+
+START_TEST(evicted)
+{
+    // Capacity is 1, so the second query evicts the first one
+    identify_and_check(&tpl_rc1, 1, 0);
+    identify_and_check(&tpl_rc2, 0, 0);
+    identify_and_check(&tpl_rc1, 1, 0);
+}
+END_TEST
+
+START_TEST(evidence_not_cached)
+{
+    XYTH_status status;
+    unsigned int matches[1];
+    unsigned int matches_length = 1;
+
+    status = XYTH_identify(&ctx_rc, &tpl_rc2, &matches_length, matches);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    // XYTH_identify() does not collect the evidence needed here
+    identify_and_check(&tpl_rc2, 0, 0);
+}
+END_TEST
+
+START_TEST(disabled)
+{
+    XYTH_status status;
+
+    status = XYTH_set_result_cache(&ctx_rc, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    identify_and_check(&tpl_rc1, 1, 0);
+    identify_and_check(&tpl_rc1, 1, 0);
+
+    status = XYTH_set_result_cache(NULL, 1);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+}
+END_TEST
+
+static void *identify_thread_rc(void *arg)
+{
+    unsigned int *num_failures = arg;
+
+    *num_failures = 0;
+    for (unsigned int i = 0; i < NUM_QUERIES_RC; i++) {
+        struct XYTH_template *tpl = (i % 2 == 0) ? &tpl_rc1 : &tpl_rc2;
+        struct XYTH_candidate candidates[2];
+        unsigned int num_candidates = 2;
+
+        if (XYTH_identify_ex(&ctx_rc, tpl, &num_candidates, candidates,
+                             NULL) != XYTH_SUCCESS ||
+            num_candidates != (tpl == &tpl_rc1 ? 1 : 0)) {
+            (*num_failures)++;
+        }
+    }
+
+    return NULL;
+}
+
+START_TEST(concurrent_queries)
+{
+    XYTH_status status;
+    pthread_t threads[NUM_IDENTIFIERS_RC];
+    unsigned int num_failures[NUM_IDENTIFIERS_RC];
+
+    // Every query evicts and stores entries, while other threads look them up
+    status = XYTH_set_result_cache(&ctx_rc, 1);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    for (unsigned int i = 0; i < NUM_IDENTIFIERS_RC; i++) {
+        ck_assert_int_eq(pthread_create(&threads[i], NULL, identify_thread_rc,
+                                        &num_failures[i]),
+                         0);
+    }
+    for (unsigned int i = 0; i < NUM_IDENTIFIERS_RC; i++) {
+        pthread_join(threads[i], NULL);
+        ck_assert_int_eq(num_failures[i], 0);
+    }
+
+    identify_and_check(&tpl_rc1, 1, 0);
+    identify_and_check(&tpl_rc1, 1, 1);
+}
+END_TEST
+
+TCase *result_cache_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("ResultCache");
+
+    tcase_add_unchecked_fixture(tcase, result_cache_setup,
+                                result_cache_teardown);
+
+    tcase_add_test(tcase, repeated_query);
+    tcase_add_test(tcase, invalidated_by_add);
+    tcase_add_test(tcase, invalidated_by_config);
+    tcase_add_test(tcase, evicted);
+    tcase_add_test(tcase, evidence_not_cached);
+    tcase_add_test(tcase, disabled);
+    tcase_add_test(tcase, concurrent_queries);
+
+    return tcase;
+}
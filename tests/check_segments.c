@@ -0,0 +1,330 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <check.h>
+#include <stdbool.h>
+#include <xyth.h>
+
+#define XYT_OK                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+#define NUM_TEMPLATES_SG 5
+#define NUM_CANDIDATES_SG 8
+
+struct XYTH_template tpl_sg = {0};
+// Both hold the same templates; only 'segmented_sg' seals its head
+struct XYTH_context reference_sg = {0};
+struct XYTH_context segmented_sg = {0};
+
+void segments_setup()
+{
+    XYTH_status status;
+    struct XYTH_database_config cfg;
+    unsigned int tpl_id;
+
+    // Residuals and partitions are sealed and merged too
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_DENSITY(cfg, 4, 8);
+    XYTH_DB_CONFIG_SET_MULTIRES(cfg);
+    XYTH_DB_CONFIG_SET_PARTITIONS(cfg, 2);
+
+    status = XYTH_template_from_xyt(XYT_OK, &tpl_sg, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&reference_sg, &cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_create_context(&segmented_sg, &cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&reference_sg, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_match_thresholds(&segmented_sg, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_seal_threshold(&segmented_sg, 2);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    for (unsigned int i = 0; i < NUM_TEMPLATES_SG; i++) {
+        status = XYTH_add_template_to_partition(&reference_sg, &tpl_sg, i % 2,
+                                                &tpl_id);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+        status = XYTH_add_template_to_partition(&segmented_sg, &tpl_sg, i % 2,
+                                                &tpl_id);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+        ck_assert_int_eq(tpl_id, i);
+    }
+}
+
+void segments_teardown()
+{
+    XYTH_destroy_context(&segmented_sg);
+    XYTH_destroy_context(&reference_sg);
+    XYTH_destroy_template(&tpl_sg);
+}
+
+//
+// Identifies 'tpl_sg' in both contexts, in the partitions of 'mask', checking
+// that the same templates are found. Returns how many.
+//
+static unsigned int identify_both_sg(unsigned int mask,
+                                     bool same_postings_scanned)
+{
+    XYTH_status status;
+    struct XYTH_candidate reference[NUM_CANDIDATES_SG];
+    struct XYTH_candidate segmented[NUM_CANDIDATES_SG];
+    struct XYTH_identify_stats reference_stats, segmented_stats;
+    unsigned int num_reference = NUM_CANDIDATES_SG;
+    unsigned int num_segmented = NUM_CANDIDATES_SG;
+
+    status = XYTH_identify_in_partitions(&reference_sg, &tpl_sg, mask,
+                                         &num_reference, reference,
+                                         &reference_stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_identify_in_partitions(&segmented_sg, &tpl_sg, mask,
+                                         &num_segmented, segmented,
+                                         &segmented_stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    ck_assert_int_eq(num_segmented, num_reference);
+    for (unsigned int i = 0; i < num_reference; i++) {
+        ck_assert_int_eq(segmented[i].tpl_id, reference[i].tpl_id);
+        ck_assert_int_eq(segmented[i].template_score,
+                         reference[i].template_score);
+    }
+    if (same_postings_scanned) {
+        ck_assert_int_eq(segmented_stats.postings_scanned,
+                         reference_stats.postings_scanned);
+    }
+
+    return num_reference;
+}
+
+START_TEST(seal_head)
+{
+    XYTH_status status;
+    struct XYTH_database_stats reference, segmented;
+
+    status = XYTH_get_database_stats(&reference_sg, &reference);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_get_database_stats(&segmented_sg, &segmented);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    // 2 templates were sealed twice, without merging; the fifth is in the head
+    ck_assert_int_eq(reference.num_segments, 0);
+    ck_assert_int_eq(segmented.num_segments, 2);
+    ck_assert_int_eq(segmented.num_templates, NUM_TEMPLATES_SG);
+    ck_assert_int_eq(segmented.num_postings, reference.num_postings);
+    ck_assert_int_eq(segmented.occupied_groups, reference.occupied_groups);
+    ck_assert_int_eq(segmented.max_group_length, reference.max_group_length);
+    // Segments list only the groups they hold: not a bit for every group
+    ck_assert(segmented.index_bytes <
+              reference.index_bytes + reference.num_groups / 8);
+
+    ck_assert_int_eq(identify_both_sg(0x3, true), NUM_TEMPLATES_SG);
+    ck_assert_int_eq(identify_both_sg(1 << 1, true), NUM_TEMPLATES_SG / 2);
+}
+END_TEST
+
+START_TEST(merge_segments)
+{
+    XYTH_status status;
+    struct XYTH_database_stats reference, segmented;
+
+    // The newest segment is not the smaller one, so both are merged
+    status = XYTH_merge_segments(&segmented_sg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_get_database_stats(&reference_sg, &reference);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_get_database_stats(&segmented_sg, &segmented);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    ck_assert_int_eq(segmented.num_segments, 1);
+    ck_assert_int_eq(segmented.num_templates, NUM_TEMPLATES_SG);
+    ck_assert_int_eq(segmented.num_postings, reference.num_postings);
+    ck_assert_int_eq(segmented.occupied_groups, reference.occupied_groups);
+
+    ck_assert_int_eq(identify_both_sg(0x3, true), NUM_TEMPLATES_SG);
+    ck_assert_int_eq(identify_both_sg(1 << 0, true), 3);
+
+    // Nothing left to merge
+    status = XYTH_merge_segments(&segmented_sg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_get_database_stats(&segmented_sg, &segmented);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(segmented.num_segments, 1);
+
+    status = XYTH_merge_segments(NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+}
+END_TEST
+
+START_TEST(full_segments)
+{
+    XYTH_status status;
+    struct XYTH_context ctx;
+    struct XYTH_database_config cfg;
+    struct XYTH_database_stats stats;
+    unsigned int tpl_id;
+
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_DENSITY(cfg, 4, 8);
+
+    status = XYTH_create_context(&ctx, &cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_seal_threshold(&ctx, 1);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    // Each add seals its template. Without a pool, the 33rd merges the 32
+    // segments into one first
+    for (unsigned int i = 0; i < 34; i++) {
+        status = XYTH_add_template(&ctx, &tpl_sg, &tpl_id);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+
+    status = XYTH_get_database_stats(&ctx, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(stats.num_segments, 3);
+    ck_assert_int_eq(stats.num_templates, 34);
+
+    // The two newest are the same size
+    status = XYTH_merge_segments(&ctx);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_get_database_stats(&ctx, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(stats.num_segments, 2);
+    ck_assert_int_eq(stats.num_templates, 34);
+
+    XYTH_destroy_context(&ctx);
+}
+END_TEST
+
+START_TEST(background_merge)
+{
+    XYTH_status status;
+    struct XYTH_context ctx;
+    struct XYTH_database_config cfg;
+    struct XYTH_database_stats stats;
+    unsigned int tpl_id;
+
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_DENSITY(cfg, 4, 8);
+
+    status = XYTH_create_context(&ctx, &cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_seal_threshold(&ctx, 1);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_workers(&ctx, 2);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    for (unsigned int i = 0; i < 100; i++) {
+        status = XYTH_add_template(&ctx, &tpl_sg, &tpl_id);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+        if (i % 10 == 0) {
+            status = XYTH_remove_template(&ctx, &tpl_sg, tpl_id);
+            ck_assert_int_eq(status, XYTH_SUCCESS);
+        }
+    }
+
+    // Stopping the workers waits for the merges queued. They leave segments
+    // holding fewer postings the newer they are: at most 13 for 100 templates
+    status = XYTH_set_workers(&ctx, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_get_database_stats(&ctx, &stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_le(stats.num_segments, 13);
+    ck_assert_int_eq(stats.num_templates, 90);
+
+    XYTH_destroy_context(&ctx);
+}
+END_TEST
+
+START_TEST(remove_sealed_template)
+{
+    XYTH_status status;
+    unsigned int tpl_counter;
+
+    status = XYTH_remove_template(&reference_sg, &tpl_sg, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_remove_template(&segmented_sg, &tpl_sg, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_remove_template(&segmented_sg, &tpl_sg, 0);
+    ck_assert_int_eq(status, XYTH_E_NOT_FOUND);
+
+    status = XYTH_get_template_counter(&segmented_sg, &tpl_counter);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(tpl_counter, NUM_TEMPLATES_SG - 1);
+
+    // Its postings are still read, but not scored
+    ck_assert_int_eq(identify_both_sg(0x3, false), NUM_TEMPLATES_SG - 1);
+    ck_assert_int_eq(identify_both_sg(1 << 0, false), 2);
+}
+END_TEST
+
+START_TEST(compact_index)
+{
+    XYTH_status status;
+    struct XYTH_database_stats reference, segmented;
+
+    status = XYTH_compact_index(&segmented_sg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_get_database_stats(&reference_sg, &reference);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_get_database_stats(&segmented_sg, &segmented);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    // The removed template's postings are gone
+    ck_assert_int_eq(segmented.num_segments, 1);
+    ck_assert_int_eq(segmented.num_postings, reference.num_postings);
+    ck_assert_int_eq(segmented.occupied_groups, reference.occupied_groups);
+    ck_assert_int_eq(segmented.alloc_postings, segmented.num_postings);
+
+    ck_assert_int_eq(identify_both_sg(0x3, true), NUM_TEMPLATES_SG - 1);
+    ck_assert_int_eq(identify_both_sg(1 << 0, true), 2);
+
+    status = XYTH_compact_index(NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+    status = XYTH_set_seal_threshold(NULL, 1);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+}
+END_TEST
+
+TCase *segments_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("Segments");
+
+    tcase_add_unchecked_fixture(tcase, segments_setup, segments_teardown);
+
+    tcase_add_test(tcase, seal_head);
+    tcase_add_test(tcase, merge_segments);
+    tcase_add_test(tcase, full_segments);
+    tcase_add_test(tcase, background_merge);
+    tcase_add_test(tcase, remove_sealed_template);
+    tcase_add_test(tcase, compact_index);
+
+    return tcase;
+}
@@ -0,0 +1,256 @@
+// Copyright 2011-2017 Rodrigo Dias Correa
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// getpid() is POSIX
+#define _POSIX_C_SOURCE 200112L
+
+#include <check.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <xyth.h>
+
+#define XYT_OK                                                                 \
+    "1  2 45\n  4  5 45\n  7  8 45\n 10 11 45\n 13 14 45\n \
+                16 17 45\n 19 20 45\n 22 23 45\n 25 26 45\n \
+                28 29 45\n 31 32 45\n 34 35 45\n 37 38 45\n \
+                40 41 45\n 43 44 45\n 46 47 45\n 49 50 45\n \
+                52 53 45\n 55 56 45\n 58 59 45\n 61 62 45\n"
+
+#define NUM_CANDIDATES_SH 4
+
+struct XYTH_template tpl_sh = {0};
+// Builds and publishes the index, 'worker_sh' identifies against it
+struct XYTH_context builder_sh = {0};
+struct XYTH_context worker_sh = {0};
+char name_sh[64];
+
+void shared_index_setup()
+{
+    XYTH_status status;
+    struct XYTH_database_config cfg;
+    unsigned int tpl_id;
+
+    // Residuals and partitions are published too
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_DENSITY(cfg, 4, 8);
+    XYTH_DB_CONFIG_SET_MULTIRES(cfg);
+    XYTH_DB_CONFIG_SET_PARTITIONS(cfg, 2);
+
+    snprintf(name_sh, sizeof(name_sh), "/xyth-check-%d", (int)getpid());
+
+    status = XYTH_template_from_xyt(XYT_OK, &tpl_sh, 20);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_create_context(&builder_sh, &cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    status = XYTH_set_match_thresholds(&builder_sh, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    for (unsigned int partition = 0; partition < 2; partition++) {
+        status = XYTH_add_template_to_partition(&builder_sh, &tpl_sh,
+                                                partition, &tpl_id);
+        ck_assert_int_eq(status, XYTH_SUCCESS);
+    }
+}
+
+void shared_index_teardown()
+{
+    XYTH_destroy_context(&worker_sh);
+    XYTH_destroy_context(&builder_sh);
+    XYTH_destroy_template(&tpl_sh);
+    XYTH_unpublish_index(name_sh);
+}
+
+START_TEST(publish_and_attach)
+{
+    XYTH_status status;
+    struct XYTH_candidate built[NUM_CANDIDATES_SH];
+    struct XYTH_candidate shared[NUM_CANDIDATES_SH];
+    struct XYTH_identify_stats built_stats, shared_stats;
+    unsigned int num_built = NUM_CANDIDATES_SH;
+    unsigned int num_shared = NUM_CANDIDATES_SH;
+    unsigned int generation, tpl_id;
+
+    status = XYTH_publish_index(&builder_sh, name_sh, &generation);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(generation, 1);
+
+    status = XYTH_attach_index(&worker_sh, name_sh);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_set_match_thresholds(&worker_sh, 10, 1, 0);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    // The worker finds what the builder finds, reading as many postings
+    status = XYTH_identify_in_partitions(&builder_sh, &tpl_sh, 1 << 1,
+                                         &num_built, built, &built_stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_identify_in_partitions(&worker_sh, &tpl_sh, 1 << 1,
+                                         &num_shared, shared, &shared_stats);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    ck_assert_int_eq(num_built, 1);
+    ck_assert_int_eq(num_shared, num_built);
+    ck_assert_int_eq(shared[0].tpl_id, built[0].tpl_id);
+    ck_assert_int_eq(shared[0].template_score, built[0].template_score);
+    ck_assert_int_eq(shared_stats.postings_scanned,
+                     built_stats.postings_scanned);
+
+    // The published index is read-only
+    status = XYTH_add_template(&worker_sh, &tpl_sh, &tpl_id);
+    ck_assert_int_eq(status, XYTH_E_READ_ONLY);
+    status = XYTH_remove_template(&worker_sh, &tpl_sh, built[0].tpl_id);
+    ck_assert_int_eq(status, XYTH_E_READ_ONLY);
+    status = XYTH_publish_index(&worker_sh, name_sh, NULL);
+    ck_assert_int_eq(status, XYTH_E_READ_ONLY);
+}
+END_TEST
+
+START_TEST(swap_generation)
+{
+    XYTH_status status;
+    struct XYTH_candidate candidates[NUM_CANDIDATES_SH];
+    unsigned int num_candidates = NUM_CANDIDATES_SH;
+    unsigned int generation, tpl_id;
+
+    status = XYTH_add_template(&builder_sh, &tpl_sh, &tpl_id);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_publish_index(&builder_sh, name_sh, &generation);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(generation, 2);
+
+    // Still on the first generation
+    status = XYTH_identify_ex(&worker_sh, &tpl_sh, &num_candidates, candidates,
+                              NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 2);
+
+    status = XYTH_refresh_index(&worker_sh, &generation);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(generation, 2);
+
+    num_candidates = NUM_CANDIDATES_SH;
+    status = XYTH_identify_ex(&worker_sh, &tpl_sh, &num_candidates, candidates,
+                              NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(num_candidates, 3);
+
+    // Nothing newer
+    status = XYTH_refresh_index(&worker_sh, &generation);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(generation, 2);
+}
+END_TEST
+
+START_TEST(invalid_shared_index)
+{
+    XYTH_status status;
+    struct XYTH_context ctx = {0};
+    char missing[80];
+
+    snprintf(missing, sizeof(missing), "%s-missing", name_sh);
+    status = XYTH_attach_index(&ctx, missing);
+    ck_assert_int_eq(status, XYTH_E_NOT_FOUND);
+
+    status = XYTH_attach_index(&ctx, "no-slash");
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+
+    status = XYTH_publish_index(&builder_sh, "/a/b", NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+
+    status = XYTH_attach_index(&worker_sh, name_sh);
+    ck_assert_int_eq(status, XYTH_E_ALREADY_INITIALIZED);
+
+    // Only attached contexts can be refreshed
+    status = XYTH_refresh_index(&builder_sh, NULL);
+    ck_assert_int_eq(status, XYTH_E_INVALID_PARAMETER);
+
+    status = XYTH_unpublish_index(missing);
+    ck_assert_int_eq(status, XYTH_E_NOT_FOUND);
+}
+END_TEST
+
+static XYTH_status identify_with_options_sh(
+    const struct XYTH_prepared_options *prepared)
+{
+    struct XYTH_candidate candidates[NUM_CANDIDATES_SH];
+    unsigned int num_candidates = NUM_CANDIDATES_SH;
+
+    return XYTH_identify_with_options(&worker_sh, prepared, &tpl_sh,
+                                      &num_candidates, candidates, NULL);
+}
+
+START_TEST(stale_shared_options)
+{
+    XYTH_status status;
+    struct XYTH_database_config cfg;
+    struct XYTH_match_options options;
+    struct XYTH_prepared_options *prepared;
+
+    status = XYTH_get_match_options(&worker_sh, &options);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_prepare_options(&worker_sh, &options, &prepared);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+
+    // A generation built with the same configuration keeps them valid
+    status = XYTH_publish_index(&builder_sh, name_sh, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_refresh_index(&worker_sh, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(identify_with_options_sh(prepared), XYTH_SUCCESS);
+
+    // The angle windows of the options were worked out for 8 degrees
+    XYTH_DB_CONFIG_INIT(cfg);
+    XYTH_DB_CONFIG_SET_DENSITY(cfg, 4, 4);
+    XYTH_DB_CONFIG_SET_MULTIRES(cfg);
+    XYTH_DB_CONFIG_SET_PARTITIONS(cfg, 2);
+    status = XYTH_reconfigure_context(&builder_sh, &cfg);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_publish_index(&builder_sh, name_sh, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    status = XYTH_refresh_index(&worker_sh, NULL);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(identify_with_options_sh(prepared),
+                     XYTH_E_INVALID_PARAMETER);
+    XYTH_destroy_prepared_options(prepared);
+
+    status = XYTH_prepare_options(&worker_sh, &options, &prepared);
+    ck_assert_int_eq(status, XYTH_SUCCESS);
+    ck_assert_int_eq(identify_with_options_sh(prepared), XYTH_SUCCESS);
+    XYTH_destroy_prepared_options(prepared);
+}
+END_TEST
+
+TCase *shared_index_tcase(void)
+{
+    TCase *tcase;
+
+    tcase = tcase_create("Shared index");
+
+    tcase_add_unchecked_fixture(tcase, shared_index_setup,
+                                shared_index_teardown);
+
+    tcase_add_test(tcase, publish_and_attach);
+    tcase_add_test(tcase, swap_generation);
+    tcase_add_test(tcase, invalid_shared_index);
+    tcase_add_test(tcase, stale_shared_options);
+
+    return tcase;
+}